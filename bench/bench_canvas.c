@@ -0,0 +1,180 @@
+// SPDX-FileCopyrightText: 2025 Mikko Mononen
+// SPDX-License-Identifier: MIT
+
+#include <stdio.h>
+#include <hb.h>
+
+#include "skb_canvas.h"
+#include "skb_canvas_internal.h"
+#include "skb_common.h"
+#include "skb_font_collection.h"
+
+// Measures the number of flattened points and the time spent flattening all glyph outlines of a few fonts at glyph sizes.
+// Only the path building is measured, the glyphs are not rasterized.
+
+typedef struct bench__flatten_stats_t {
+	int64_t curves_count;
+	int64_t curve_points_count;		// Points added by flattening the curves.
+} bench__flatten_stats_t;
+
+typedef struct bench__draw_context_t {
+	skb_canvas_t* canvas;
+	bench__flatten_stats_t stats;
+} bench__draw_context_t;
+
+static void bench__discard_path(skb_canvas_t* canvas)
+{
+	// Only the flattening is measured, discard the path before it is turned into edges.
+	canvas->points_count = 0;
+	canvas->edges_count = 0;
+	canvas->degenerate_path_count = 0;
+}
+
+static void bench__hb_move_to(hb_draw_funcs_t* dfuncs, void* draw_data, hb_draw_state_t* st, float to_x, float to_y, void* user_data)
+{
+	SKB_UNUSED(dfuncs);
+	SKB_UNUSED(st);
+	SKB_UNUSED(user_data);
+
+	bench__draw_context_t* ctx = (bench__draw_context_t*)draw_data;
+	bench__discard_path(ctx->canvas);
+	skb_canvas_move_to(ctx->canvas, skb_vec2_make(to_x, to_y));
+}
+
+static void bench__hb_line_to(hb_draw_funcs_t* dfuncs, void* draw_data, hb_draw_state_t* st, float to_x, float to_y, void* user_data)
+{
+	SKB_UNUSED(dfuncs);
+	SKB_UNUSED(st);
+	SKB_UNUSED(user_data);
+
+	bench__draw_context_t* ctx = (bench__draw_context_t*)draw_data;
+	skb_canvas_line_to(ctx->canvas, skb_vec2_make(to_x, to_y));
+}
+
+static void bench__hb_quadratic_to(hb_draw_funcs_t* dfuncs, void* draw_data, hb_draw_state_t* st, float control_x, float control_y, float to_x, float to_y, void* user_data)
+{
+	SKB_UNUSED(dfuncs);
+	SKB_UNUSED(st);
+	SKB_UNUSED(user_data);
+
+	bench__draw_context_t* ctx = (bench__draw_context_t*)draw_data;
+	const int32_t points_count = ctx->canvas->points_count;
+	skb_canvas_quad_to(ctx->canvas, skb_vec2_make(control_x, control_y), skb_vec2_make(to_x, to_y));
+	ctx->stats.curves_count++;
+	ctx->stats.curve_points_count += ctx->canvas->points_count - points_count;
+}
+
+static void bench__hb_cubic_to(hb_draw_funcs_t* dfuncs, void* draw_data, hb_draw_state_t* st, float control1_x, float control1_y, float control2_x, float control2_y, float to_x, float to_y, void* user_data)
+{
+	SKB_UNUSED(dfuncs);
+	SKB_UNUSED(st);
+	SKB_UNUSED(user_data);
+
+	bench__draw_context_t* ctx = (bench__draw_context_t*)draw_data;
+	const int32_t points_count = ctx->canvas->points_count;
+	skb_canvas_cubic_to(ctx->canvas, skb_vec2_make(control1_x, control1_y), skb_vec2_make(control2_x, control2_y), skb_vec2_make(to_x, to_y));
+	ctx->stats.curves_count++;
+	ctx->stats.curve_points_count += ctx->canvas->points_count - points_count;
+}
+
+static void bench__hb_close_path(hb_draw_funcs_t* dfuncs, void* draw_data, hb_draw_state_t* st, void* user_data)
+{
+	SKB_UNUSED(dfuncs);
+	SKB_UNUSED(st);
+	SKB_UNUSED(user_data);
+
+	bench__draw_context_t* ctx = (bench__draw_context_t*)draw_data;
+	skb_canvas_close(ctx->canvas);
+}
+
+static int bench_curve_flattening(void)
+{
+	static const char* font_paths[] = {
+		"data/IBMPlexSans-Regular.ttf",
+		"data/IBMPlexSansArabic-Regular.ttf",
+		"data/IBMPlexSansJP-Regular.ttf",
+		"data/NotoSansThai-Regular.ttf",
+	};
+	static const float font_sizes[] = { 12.f, 24.f, 48.f, 96.f };
+	enum { ITERATIONS = 5 };
+
+	skb_temp_alloc_t* temp_alloc = skb_temp_alloc_create(512*1024);
+
+	skb_image_t image = {
+		.width = 128,
+		.height = 128,
+		.bpp = 1,
+	};
+	image.buffer = skb_malloc(image.width * image.height * image.bpp);
+	image.stride_bytes = image.width * image.bpp;
+
+	bench__draw_context_t ctx = {
+		.canvas = skb_canvas_create(temp_alloc, &image),
+	};
+
+	hb_draw_funcs_t* draw_funcs = hb_draw_funcs_create();
+	hb_draw_funcs_set_move_to_func(draw_funcs, bench__hb_move_to, NULL, NULL);
+	hb_draw_funcs_set_line_to_func(draw_funcs, bench__hb_line_to, NULL, NULL);
+	hb_draw_funcs_set_quadratic_to_func(draw_funcs, bench__hb_quadratic_to, NULL, NULL);
+	hb_draw_funcs_set_cubic_to_func(draw_funcs, bench__hb_cubic_to, NULL, NULL);
+	hb_draw_funcs_set_close_path_func(draw_funcs, bench__hb_close_path, NULL, NULL);
+	hb_draw_funcs_make_immutable(draw_funcs);
+
+	skb_font_collection_t* font_collection = skb_font_collection_create();
+
+	printf("Curve flattening, tolerance %.3fpx, %d iterations\n", SKB_CURVE_TOL, ITERATIONS);
+
+	for (int32_t i = 0; i < (int32_t)SKB_COUNTOF(font_paths); i++) {
+		skb_font_handle_t font_handle = skb_font_collection_add_font(font_collection, font_paths[i], SKB_FONT_FAMILY_DEFAULT, NULL);
+		if (!font_handle) {
+			printf("  Failed to load %s\n", font_paths[i]);
+			continue;
+		}
+		hb_font_t* hb_font = skb_font_get_hb_font(font_collection, font_handle);
+		hb_face_t* hb_face = hb_font_get_face(hb_font);
+		const uint32_t glyphs_count = hb_face_get_glyph_count(hb_face);
+		const float upem = (float)hb_face_get_upem(hb_face);
+
+		printf("  %s (%d glyphs)\n", font_paths[i], (int32_t)glyphs_count);
+
+		for (int32_t j = 0; j < (int32_t)SKB_COUNTOF(font_sizes); j++) {
+			const float scale = font_sizes[j] / upem;
+			skb_canvas_push_transform(ctx.canvas, skb_mat2_make_scale(scale, -scale));
+
+			bench__flatten_stats_t stats = {0};
+			const int64_t start = skb_perf_timer_get();
+			for (int32_t iter = 0; iter < ITERATIONS; iter++) {
+				ctx.stats = (bench__flatten_stats_t){0};
+				for (uint32_t glyph_id = 0; glyph_id < glyphs_count; glyph_id++) {
+					hb_font_draw_glyph(hb_font, glyph_id, draw_funcs, &ctx);
+					bench__discard_path(ctx.canvas);
+				}
+				stats = ctx.stats;
+			}
+			const int64_t elapsed_us = skb_perf_timer_elapsed_us(start, skb_perf_timer_get()) / ITERATIONS;
+
+			skb_canvas_pop_transform(ctx.canvas);
+
+			printf("    %5.1fpx: %8lld curves, %9lld points, %.2f points/curve, %7lld us\n",
+				font_sizes[j], (long long)stats.curves_count, (long long)stats.curve_points_count,
+				stats.curves_count > 0 ? (double)stats.curve_points_count / (double)stats.curves_count : 0.0,
+				(long long)elapsed_us);
+		}
+	}
+
+	skb_font_collection_destroy(font_collection);
+	hb_draw_funcs_destroy(draw_funcs);
+	skb_canvas_destroy(ctx.canvas);
+	skb_free(image.buffer);
+	skb_temp_alloc_destroy(temp_alloc);
+
+	return 0;
+}
+
+int main(void)
+{
+	printf("Starting Skribidi benchmarks\n");
+	printf("======================================\n");
+
+	return bench_curve_flattening();
+}
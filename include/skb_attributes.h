@@ -1039,6 +1039,16 @@ int32_t skb_attributes_copy_flat(const skb_attribute_set_t attributes, skb_attri
  */
 uint64_t skb_attributes_hash_append(uint64_t hash, skb_attribute_set_t attributes);
 
+/**
+ * Appends the hash of the text attributes to the provided hash, ignoring the color and paint id of the paint attributes.
+ * Attributes which differ only by paint produce the same layout, and can be updated using skb_layout_update_paints().
+ * Text background paints affect how the background decorations are merged, and are hashed fully.
+ * @param hash hash to append to.
+ * @param attributes attributes to hash.
+ * @return combined hash.
+ */
+uint64_t skb_attributes_hash_append_without_paint(uint64_t hash, skb_attribute_set_t attributes);
+
 /** @} */
 
 #ifdef __cplusplus
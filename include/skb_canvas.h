@@ -99,6 +99,15 @@ typedef enum {
  */
 skb_canvas_t* skb_canvas_create(skb_temp_alloc_t* temp_alloc, skb_image_t* target);
 
+/**
+ * Resets the canvas to draw to a new target, as if it was created again.
+ * The buffers allocated by the canvas are retained, which makes drawing many small images (e.g. glyphs) cheaper than creating a new canvas for each.
+ * Note: buffers allocated for larger targets are allocated from the temp allocator, and held until the canvas is destroyed.
+ * @param c pointer to the canvas to reset.
+ * @param target target to draw to.
+ */
+void skb_canvas_reset(skb_canvas_t* c, skb_image_t* target);
+
 /**
  * Destroys canvas and frees any memory associated with it.
  * Note: the canvas is allocated using the temp allocator passed in the skb_canvas_create().
@@ -301,6 +301,24 @@ void skb_free(void* ptr);
 /** Signature of destroy function */
 typedef void skb_destroy_func_t(void* context);
 
+/**
+ * Signature of a task function run by skb_parallel_for_func_t.
+ * @param task_idx index of the task to run.
+ * @param task_context context passed to the parallel for function.
+ */
+typedef void skb_task_func_t(int32_t task_idx, void* task_context);
+
+/**
+ * Signature of a parallel for function, used to run independent tasks on multiple threads (e.g. layout building, font scanning).
+ * The function should call task_func for each task index in range [0, task_count) and return after all the tasks have completed.
+ * The tasks can be run in any order and on any thread.
+ * @param task_count number of tasks to run.
+ * @param task_func function to call for each task.
+ * @param task_context context to pass to the task function.
+ * @param context user context passed along with the parallel for function.
+ */
+typedef void skb_parallel_for_func_t(int32_t task_count, skb_task_func_t* task_func, void* task_context, void* context);
+
 /**
  * Helper macro to reserve space in an allocated array.
  * The macro relies on naming convention, if your array is called 'apples', then it is expected
@@ -158,6 +158,8 @@ typedef struct skb_editor_params_t {
 	skb_editor_behavior_t editor_behavior;
 	/** Maximum number of undo levels, if zero, set to default undo levels, if < 0 undo is disabled. */
 	int32_t max_undo_levels;
+	/** If true, edits do not update the layout, instead the layout is updated by skb_editor_update_layout(). See skb_editor_update_layout(). */
+	bool defer_layout;
 } skb_editor_params_t;
 
 /** Keys handled by the editor */
@@ -481,6 +483,33 @@ void skb_editor_select_all(skb_editor_t* editor);
  */
 void skb_editor_select_none(skb_editor_t* editor);
 
+/**
+ * Adds secondary selection to the editor. Secondary selections are adjusted when the text changes,
+ * and are edited together with the current selection by skb_editor_insert_text_utf32_at_selections().
+ * Selections which overlap or touch each other or the current selection are merged, and the secondary selections are kept in text order.
+ * Adding selections in text order is fast, otherwise all selections are sorted and merged. Undo, redo and reset clear the secondary selections.
+ * @param editor editor to change.
+ * @param text_range selection to add.
+ */
+void skb_editor_add_secondary_selection(skb_editor_t* editor, skb_text_range_t text_range);
+
+/**
+ * Removes all secondary selections.
+ * @param editor editor to change.
+ */
+void skb_editor_clear_secondary_selections(skb_editor_t* editor);
+
+/** @return number of secondary selections. */
+int32_t skb_editor_get_secondary_selections_count(const skb_editor_t* editor);
+
+/**
+ * Returns secondary selection at specified index.
+ * @param editor editor to query.
+ * @param selection_idx index of the secondary selection.
+ * @return the secondary selection.
+ */
+skb_text_range_t skb_editor_get_secondary_selection(const skb_editor_t* editor, int32_t selection_idx);
+
 
  //
 // Input handling
@@ -542,6 +571,18 @@ skb_text_position_t skb_editor_hit_test(const skb_editor_t* editor, skb_movement
  */
 void skb_editor_iterate_text_range_bounds(const skb_editor_t* editor, skb_text_range_t text_range, skb_text_range_bounds_func_t* callback, void* context);
 
+/**
+ * Iterates over set of rectangles that represent the specified text range, skipping the lines which are outside the view bounds vertically.
+ * Useful for drawing large selections, the cost depends only on the number of visible lines.
+ * @param editor editor to query.
+ * @param text_range the text range to gets the rects for.
+ * @param view_bounds view rectangle, in same coordinates as the reported rectangles.
+ * @param callback callback to call on each rectangle
+ * @param context context passed to the callback.
+ * @return number of visited and clipped paragraphs and lines.
+ */
+skb_text_range_bounds_clip_info_t skb_editor_iterate_text_range_bounds_in_view(const skb_editor_t* editor, skb_text_range_t text_range, skb_rect2_t view_bounds, skb_text_range_bounds_func_t* callback, void* context);
+
 /**
  * Sets temporary IME composition text as utf-32. The text will be laid out at the current cursor location.
  * The function can be called multiple times during while the user composes the input.
@@ -605,6 +646,26 @@ void skb_editor_insert_codepoint(skb_editor_t* editor, skb_temp_alloc_t* temp_al
  */
 void skb_editor_insert_text_utf8(skb_editor_t* editor, skb_temp_alloc_t* temp_alloc, skb_text_range_t text_range, const char* utf8, int32_t utf8_len);
 
+/**
+ * Inserts utf-8 string replacing the current selection and each of the secondary selections.
+ * The edits are done in one batch and undo transaction, see skb_editor_begin_batch(). After the change the secondary selections are placed after the inserted text.
+ * @param editor editor to update
+ * @param temp_alloc temp alloc to use for text modifications and relayout.
+ * @param utf8 pointer to utf-8 string to insert
+ * @param utf8_len length of the string, or -1 if nul terminated
+ */
+void skb_editor_insert_text_utf8_at_selections(skb_editor_t* editor, skb_temp_alloc_t* temp_alloc, const char* utf8, int32_t utf8_len);
+
+/**
+ * Inserts utf-32 string replacing the current selection and each of the secondary selections.
+ * The edits are done in one batch and undo transaction, see skb_editor_begin_batch(). After the change the secondary selections are placed after the inserted text.
+ * @param editor editor to update
+ * @param temp_alloc temp alloc to use for text modifications and relayout.
+ * @param utf32 pointer to utf-32 string to insert
+ * @param utf32_len length of the string
+ */
+void skb_editor_insert_text_utf32_at_selections(skb_editor_t* editor, skb_temp_alloc_t* temp_alloc, const uint32_t* utf32, int32_t utf32_len);
+
 /**
  * Inserts utf-32 string replacing the text range.
  * The function will adjust the current selection to compensate the changed text.
@@ -842,6 +903,155 @@ bool skb_editor_can_redo(skb_editor_t* editor);
 void skb_editor_redo(skb_editor_t* editor, skb_temp_alloc_t* temp_alloc);
 
 
+//
+// Batch
+//
+
+/**
+ * Begins batch of edits. The relayout, selection validation, and change callbacks are deferred until the matching skb_editor_end_batch(),
+ * so that multiple edits (e.g. replace all, or edits from editor rules) are laid out only once.
+ * Batches can be nested. Use skb_editor_undo_transaction_begin() to undo the edits as one change.
+ * Text queries reflect the edits immediately, but layout queries (e.g. hit testing, caret info) are not valid until the batch ends.
+ * @param editor editor to update.
+ */
+void skb_editor_begin_batch(skb_editor_t* editor);
+
+/**
+ * Ends batch of edits. Ending the outermost batch will relayout the changed paragraphs and emit the deferred change callbacks once.
+ * In deferred layout mode the relayout is left for skb_editor_update_layout().
+ * @param editor editor to update.
+ * @param temp_alloc temp allocator used to relayout the text.
+ */
+void skb_editor_end_batch(skb_editor_t* editor, skb_temp_alloc_t* temp_alloc);
+
+/** @return true if the editor is inside a batch of edits. */
+bool skb_editor_is_in_batch(const skb_editor_t* editor);
+
+/** @return true if the text has changed since the layout was last updated, see skb_editor_update_layout(). */
+bool skb_editor_needs_layout_update(const skb_editor_t* editor);
+
+/**
+ * Updates the layout after edits, when the editor is created with skb_editor_params_t.defer_layout.
+ *
+ * In deferred layout mode the edits are applied to the text immediately, and the layout of the changed paragraphs
+ * is rebuilt once when this function is called, e.g. once per frame. This keeps the cost of handling input bounded
+ * by the cost of the text edits, and multiple edits within a frame are laid out once.
+ * Until the layout is updated, layout queries (e.g. caret info, hit testing, drawing) use the previous layout,
+ * remapped to the new paragraph text offsets, and the positions they return are clamped to the new text.
+ * The selection is validated against the new text on update. Key presses update the layout first.
+ *
+ * The function does nothing inside a batch, the layout will be updated when the batch ends.
+ *
+ * @param editor editor to update.
+ * @param temp_alloc temp allocator used to relayout the text.
+ */
+void skb_editor_update_layout(skb_editor_t* editor, skb_temp_alloc_t* temp_alloc);
+
+
+//
+// Input recording
+//
+
+/** Enum describing type of recorded editor input, see skb_editor_begin_input_recording(). */
+typedef enum {
+	/** skb_editor_process_key_pressed() */
+	SKB_EDITOR_INPUT_KEY_PRESSED = 1,
+	/** skb_editor_process_mouse_click() */
+	SKB_EDITOR_INPUT_MOUSE_CLICK,
+	/** skb_editor_process_mouse_drag() */
+	SKB_EDITOR_INPUT_MOUSE_DRAG,
+	/** skb_editor_insert_paragraph() */
+	SKB_EDITOR_INPUT_INSERT_PARAGRAPH,
+	/** skb_editor_insert_codepoint() */
+	SKB_EDITOR_INPUT_INSERT_CODEPOINT,
+	/** skb_editor_insert_text_utf8() and skb_editor_insert_text_utf32() */
+	SKB_EDITOR_INPUT_INSERT_TEXT,
+	/** skb_editor_insert_text_utf8_at_selections() and skb_editor_insert_text_utf32_at_selections() */
+	SKB_EDITOR_INPUT_INSERT_TEXT_AT_SELECTIONS,
+	/** skb_editor_remove() */
+	SKB_EDITOR_INPUT_REMOVE,
+	/** skb_editor_set_composition_utf32() */
+	SKB_EDITOR_INPUT_SET_COMPOSITION,
+	/** skb_editor_commit_composition_utf32() */
+	SKB_EDITOR_INPUT_COMMIT_COMPOSITION,
+	/** skb_editor_clear_composition() */
+	SKB_EDITOR_INPUT_CLEAR_COMPOSITION,
+	/** skb_editor_toggle_attribute() */
+	SKB_EDITOR_INPUT_TOGGLE_ATTRIBUTE,
+	/** skb_editor_undo() */
+	SKB_EDITOR_INPUT_UNDO,
+	/** skb_editor_redo() */
+	SKB_EDITOR_INPUT_REDO,
+	/** skb_editor_update_layout() */
+	SKB_EDITOR_INPUT_UPDATE_LAYOUT,
+} skb_editor_input_type_t;
+
+/**
+ * Starts recording the input calls of the editor into a compact binary stream, see skb_editor_input_type_t for the recorded calls.
+ * The recording can be replayed with skb_editor_replay_input() to reproduce an editing session, e.g. for profiling.
+ * Any previous recording is cleared. The initial text and the editor parameters are not recorded.
+ * Attribute payloads are not recorded, and the current selection is recorded as SKB_CURRENT_SELECTION.
+ * @param editor editor to record.
+ */
+void skb_editor_begin_input_recording(skb_editor_t* editor);
+
+/**
+ * Stops recording the input calls. The recorded data is kept until the next recording starts, or the editor is destroyed.
+ * @param editor editor to update.
+ */
+void skb_editor_end_input_recording(skb_editor_t* editor);
+
+/** @return true if the editor is recording input calls. */
+bool skb_editor_is_recording_input(const skb_editor_t* editor);
+
+/**
+ * Returns the recorded input data.
+ * @param editor editor to query.
+ * @param data_count pointer to integer which receives the size of the data in bytes.
+ * @return pointer to the recorded data, valid until the recording is changed.
+ */
+const uint8_t* skb_editor_get_input_recording(const skb_editor_t* editor, int32_t* data_count);
+
+/** Struct describing the time spent replaying single input call, see skb_editor_replay_input(). */
+typedef struct skb_editor_replay_event_t {
+	/** Index of the event in the recording. */
+	int32_t index;
+	/** Type of the input call. */
+	skb_editor_input_type_t type;
+	/** Total time spent in the input call (us). */
+	int64_t total_us;
+	/** Time spent modifying the rich text (us). */
+	int64_t text_us;
+	/** Time spent updating the layout (us). */
+	int64_t layout_us;
+	/** Time spent capturing undo state (us). */
+	int64_t undo_us;
+} skb_editor_replay_event_t;
+
+/**
+ * Signature of replay event callback.
+ * @param editor editor which replayed the event.
+ * @param event description and timing of the replayed input call.
+ * @param context context passed to skb_editor_replay_input()
+ */
+typedef void skb_editor_replay_event_func_t(skb_editor_t* editor, const skb_editor_replay_event_t* event, void* context);
+
+/**
+ * Replays input recorded with skb_editor_begin_input_recording().
+ * The editor should be set up with the same parameters and text as the recorded editor to reproduce the session.
+ * The time spent in each input call is reported to the callback, split into text modification, layout update, and undo capture.
+ * The split is measured only when the library is compiled with SKB_EDITOR_PROFILE defined, otherwise only the total time is reported.
+ * @param editor editor to replay the input on.
+ * @param temp_alloc temp allocator used for the edits and relayout.
+ * @param data pointer to the recorded data.
+ * @param data_count size of the recorded data in bytes.
+ * @param callback callback called after each replayed input call, can be NULL.
+ * @param context context passed to the callback.
+ * @return number of replayed input calls, or -1 if the data is not valid recording.
+ */
+int32_t skb_editor_replay_input(skb_editor_t* editor, skb_temp_alloc_t* temp_alloc, const uint8_t* data, int32_t data_count, skb_editor_replay_event_func_t* callback, void* context);
+
+
 /** @} */
 
 #ifdef __cplusplus
@@ -382,6 +382,23 @@ skb_font_t* skb_font_collection_get_font(const skb_font_collection_t* font_colle
 /** @returns the id of the font collection, each font collection has unique index. */
 uint32_t skb_font_collection_get_id(const skb_font_collection_t* font_collection);
 
+/**
+ * Finds font based on its hash, see skb_font_get_hash().
+ * @param font_collection font collection to use.
+ * @param font_hash hash of the font to find.
+ * @return handle to the font, or 0 if not found.
+ */
+skb_font_handle_t skb_font_collection_find_font_by_hash(const skb_font_collection_t* font_collection, uint64_t font_hash);
+
+/**
+ * Returns hash of the font, which identifies the font across runs of the application.
+ * The hash is based on the font data, face index, and synthetic style of the font. Fonts with same name but different data have different hash.
+ * @param font_collection font collection to use.
+ * @param font_handle font to use.
+ * @return hash of the font, or 0 if the font is not found.
+ */
+uint64_t skb_font_get_hash(const skb_font_collection_t* font_collection, skb_font_handle_t font_handle);
+
 /**
  * Returns the bounding rect of the specified glyph.
  * @param font_collection font collection to use.
@@ -439,6 +456,150 @@ float skb_font_get_baseline(const skb_font_collection_t* font_collection, skb_fo
  */
 skb_baseline_set_t skb_font_get_baseline_set(const skb_font_collection_t* font_collection, const skb_font_handle_t font_handle, skb_text_direction_t direction, uint8_t script, float font_size);
 
+#if !defined(SKB_NO_OPEN)
+
+//
+// Font index
+//
+
+/**
+ * Opaque type for the font index. Use skb_font_index_create() to create.
+ *
+ * The font index stores the properties of the fonts found in font directories (e.g. the system font directories),
+ * so that a font for a missing script can be found without opening the font files.
+ * The index can be saved to disk, and updated incrementally, only the files whose modification time or size has changed are scanned again.
+ * Use skb_font_index_font_fallback() as font fallback callback to load the fonts from the index on demand.
+ */
+typedef struct skb_font_index_t skb_font_index_t;
+
+/** Struct describing a font face in the font index. */
+typedef struct skb_font_index_face_t {
+	/** Path of the font file. */
+	const char* path;
+	/** Family name of the font. */
+	const char* family_name;
+	/** Index of the face in the font file. */
+	int32_t face_index;
+	/** Generic family of the font, based on the font tables. SKB_FONT_FAMILY_DEFAULT if the family could not be determined. See skb_font_family_t. */
+	uint8_t font_family;
+	/** Weight of the default instance of the font. */
+	int32_t weight;
+	/** Smallest weight supported by the font, differs from weight for variable fonts. */
+	int32_t weight_min;
+	/** Largest weight supported by the font, differs from weight for variable fonts. */
+	int32_t weight_max;
+	/** Style of the font. See skb_style_t. */
+	uint8_t style;
+	/** Stretch of the font, from 0.5 (ultra condensed) -> 1.0 (normal) -> 2.0 (ultra wide). */
+	float stretch;
+} skb_font_index_face_t;
+
+/**
+ * Creates a new empty font index.
+ * @return created font index.
+ */
+skb_font_index_t* skb_font_index_create(void);
+
+/**
+ * Destroys font index.
+ * @param font_index font index to destroy.
+ */
+void skb_font_index_destroy(skb_font_index_t* font_index);
+
+/**
+ * Scans directory and its subdirectories for font files (.ttf, .otf, .ttc, .otc), and updates the index. Symlinked directories are not followed.
+ * Only the files that are new or whose modification time or size has changed are scanned. Fonts of the removed files are removed from the index.
+ * Scanning reads the name, OS/2, cmap, and fvar tables of each face.
+ * @param font_index font index to update.
+ * @param path path to the directory to scan.
+ * @param parallel_for (optional) function to scan the font files in parallel, or NULL to scan on the calling thread.
+ * @param parallel_for_context context passed to the parallel for function.
+ * @return number of font files scanned.
+ */
+int32_t skb_font_index_scan_directory(skb_font_index_t* font_index, const char* path, skb_parallel_for_func_t* parallel_for, void* parallel_for_context);
+
+/** @return number of font faces in the index. */
+int32_t skb_font_index_get_faces_count(const skb_font_index_t* font_index);
+
+/**
+ * Returns properties of a font face in the index. The strings are valid until the index is changed.
+ * @param font_index font index to use.
+ * @param face_idx index of the face.
+ * @return properties of the font face.
+ */
+skb_font_index_face_t skb_font_index_get_face(const skb_font_index_t* font_index, int32_t face_idx);
+
+/**
+ * Finds best font face for the specified language, script and font family.
+ * The script is a hard constraint (except for emoji font family). The font family, language, and regular style are preferred.
+ * @param font_index font index to use.
+ * @param lang language of the text, used to select between Chinese, Japanese, and Korean fonts.
+ * @param script script the font must support.
+ * @param font_family font family to prefer, emoji font family is a hard constraint.
+ * @return index of the best matching face, or SKB_INVALID_INDEX if not found.
+ */
+int32_t skb_font_index_find_face(const skb_font_index_t* font_index, const char* lang, uint8_t script, uint8_t font_family);
+
+/**
+ * Adds font face from the index to the font collection.
+ * @param font_index font index to use.
+ * @param face_idx index of the face to add.
+ * @param font_collection font collection to add the font to.
+ * @param font_family font family to assign to the font in the collection.
+ * @return handle to the added font, or 0 if failed to load the font.
+ */
+skb_font_handle_t skb_font_index_add_font(const skb_font_index_t* font_index, int32_t face_idx, skb_font_collection_t* font_collection, uint8_t font_family);
+
+/**
+ * Font fallback callback which loads the best matching font from the font index, see skb_font_collection_set_on_font_fallback().
+ * Only the selected font file is opened. The context must be pointer to the font index.
+ * @param font_collection font collection to add the font to.
+ * @param lang language of the failed font selection.
+ * @param script script of the failed font selection.
+ * @param font_family font family of the failed font selection.
+ * @param context pointer to skb_font_index_t.
+ * @return true if a font was added.
+ */
+bool skb_font_index_font_fallback(skb_font_collection_t* font_collection, const char* lang, uint8_t script, uint8_t font_family, void* context);
+
+/**
+ * Serializes the font index into binary data, which can be loaded using skb_font_index_deserialize().
+ * Use data_cap of 0 to query the required size.
+ * @param font_index font index to serialize.
+ * @param data pointer to the data to write to, can be NULL if data_cap is 0.
+ * @param data_cap capacity of the data in bytes.
+ * @return total size of the data in bytes (can be larger than data_cap). If the data does not fit, nothing is written.
+ */
+int32_t skb_font_index_serialize(const skb_font_index_t* font_index, uint8_t* data, int32_t data_cap);
+
+/**
+ * Loads the font index from binary data created using skb_font_index_serialize().
+ * Fails if the data is invalid, or created with different version of the library.
+ * @param font_index font index to load the data into. The index is emptied on failure.
+ * @param data pointer to the data.
+ * @param data_count size of the data in bytes.
+ * @return true if the index was loaded.
+ */
+bool skb_font_index_deserialize(skb_font_index_t* font_index, const uint8_t* data, int32_t data_count);
+
+/**
+ * Saves the font index to a file, see skb_font_index_serialize().
+ * @param font_index font index to save.
+ * @param file_name name of the file to write.
+ * @return true if the file was written.
+ */
+bool skb_font_index_save(const skb_font_index_t* font_index, const char* file_name);
+
+/**
+ * Loads the font index from a file, see skb_font_index_deserialize().
+ * @param font_index font index to load the file into. The index is emptied on failure.
+ * @param file_name name of the file to read.
+ * @return true if the file was loaded.
+ */
+bool skb_font_index_load(skb_font_index_t* font_index, const char* file_name);
+
+#endif // !defined(SKB_NO_OPEN)
+
 /** @} */
 
 #ifdef __cplusplus
@@ -294,6 +294,93 @@ skb_quad_t skb_image_atlas_get_glyph_quad(
 	skb_font_collection_t* font_collection, skb_font_handle_t font_handle, uint32_t glyph_id, float font_size,
 	skb_color_t tint_color, skb_rasterize_alpha_mode_t alpha_mode);
 
+/**
+ * Get a quad representing the geometry and texture portion of the specified glyph with an effect applied, e.g. drop shadow, glow, or outline.
+ *
+ * The effect is rasterized once into the atlas from the glyph coverage as an alpha mask, and reused like any other glyph.
+ * The effect radius and spread are in the same units as the font size, and are rounded to whole pixels of the rasterized image.
+ * The quad is positioned at the glyph location, drop shadows can be created by offsetting x and y.
+ * Color glyphs use their outline coverage, which may be empty.
+ *
+ * See skb_image_atlas_get_glyph_quad() for details on the pixel scale.
+ *
+ * @param atlas atlas to use
+ * @param x position x to render the glyph at.
+ * @param y position y to render the glyph at.
+ * @param pixel_scale the size of a pixel compared to the geometry.
+ * @param font_collection font collection to use.
+ * @param font_handle handle to the font in the font collection.
+ * @param glyph_id glyph id to render.
+ * @param font_size font size.
+ * @param effect effect to apply to the glyph.
+ * @param tint_color color of the effect.
+ * @return quad representing the geometry to render, and portion of an image to use.
+ */
+skb_quad_t skb_image_atlas_get_glyph_effect_quad(
+	skb_image_atlas_t* atlas, float x, float y, float pixel_scale,
+	skb_font_collection_t* font_collection, skb_font_handle_t font_handle, uint32_t glyph_id, float font_size,
+	skb_glyph_effect_t effect, skb_color_t tint_color);
+
+/** Opaque type for the image atlas staging. Use skb_image_atlas_staging_create() to create. */
+typedef struct skb_image_atlas_staging_t skb_image_atlas_staging_t;
+
+/**
+ * Creates a staging buffer used to look up glyphs concurrently, see skb_image_atlas_find_glyph_quad().
+ * Each thread should use its own staging buffer.
+ * @return pointer to the created staging buffer.
+ */
+skb_image_atlas_staging_t* skb_image_atlas_staging_create(void);
+
+/**
+ * Destroys a staging buffer.
+ * @param staging pointer to the staging buffer to destroy.
+ */
+void skb_image_atlas_staging_destroy(skb_image_atlas_staging_t* staging);
+
+/**
+ * Finds a quad representing the geometry and texture portion of the specified glyph, without modifying the atlas.
+ *
+ * The function only reads the atlas, and can be called from multiple threads at the same time, as long as each thread
+ * uses its own staging buffer, and the atlas and font collection are not modified at the same time.
+ * Accessed glyphs and missing glyphs are recorded in the staging buffer, and applied to the atlas by skb_image_atlas_commit_staging().
+ *
+ * A frame rendered from multiple threads looks like this:
+ *  - find glyph quads concurrently, each thread using its own staging buffer.
+ *  - commit the staging buffers, and rasterize missing items.
+ *  - find the glyphs that were missing again, or draw them on the next frame.
+ *
+ * See skb_image_atlas_get_glyph_quad() for details on the parameters.
+ *
+ * @param atlas atlas to use
+ * @param staging staging buffer to record the accessed and missing glyphs to.
+ * @param x position x to render the glyph at.
+ * @param y position y to render the glyph at.
+ * @param pixel_scale the size of a pixel compared to the geometry.
+ * @param font_collection font collection to use.
+ * @param font_handle handle to the font in the font collection.
+ * @param glyph_id glyph id to render.
+ * @param font_size font size.
+ * @param tint_color color of the glyph.
+ * @param alpha_mode whether to render the glyph as SDF or alpha mask.
+ * @param quad pointer to the quad to store the result to.
+ * @return true if the glyph was found in the atlas.
+ */
+bool skb_image_atlas_find_glyph_quad(
+	const skb_image_atlas_t* atlas, skb_image_atlas_staging_t* staging, float x, float y, float pixel_scale,
+	skb_font_collection_t* font_collection, skb_font_handle_t font_handle, uint32_t glyph_id, float font_size,
+	skb_color_t tint_color, skb_rasterize_alpha_mode_t alpha_mode, skb_quad_t* quad);
+
+/**
+ * Applies the glyph accesses and requests recorded in the staging buffers to the atlas, and clears the staging buffers.
+ * Must not be called at the same time as skb_image_atlas_find_glyph_quad().
+ * The requested glyphs are rasterized by skb_image_atlas_rasterize_missing_items().
+ * @param atlas atlas to use.
+ * @param stagings array of staging buffers to commit.
+ * @param stagings_count number of staging buffers.
+ * @return number of glyphs requested by the staging buffers.
+ */
+int32_t skb_image_atlas_commit_staging(skb_image_atlas_t* atlas, skb_image_atlas_staging_t** stagings, int32_t stagings_count);
+
 /**
  * Get a quad representing the geometry and texture portion of the specified icon.
  *
@@ -92,6 +92,12 @@ typedef struct skb_layout_params_t {
 	int32_t list_marker_counter;
 	/** Base value for attribute span based content id. */
 	int32_t text_content_id_base;
+	/** Optional function used to run text analysis of very long text (grapheme, word, and line breaks) in chunks on multiple threads.
+	 *  The result is identical to the serial analysis. If NULL, the text is analyzed serially.
+	 *  The tasks write to separate parts of the layout, and do not allocate memory. */
+	skb_parallel_for_func_t* parallel_for;
+	/** Context passed to the parallel_for function. */
+	void* parallel_for_context;
 } skb_layout_params_t;
 
 
@@ -447,6 +453,35 @@ typedef struct skb_text_property_t {
 	uint8_t script;
 } skb_text_property_t;
 
+/**
+ * Struct describing a run of pre-shaped glyphs, used with skb_layout_set_from_shaped_runs().
+ * The data is the same as produced by shaping a run with Harfbuzz: the glyph positions are scaled to the font size,
+ * and the letter and word spacing are not applied (they are applied based on the run attributes).
+ * Note: the struct does not take copy of the data, the pointers must be valid until the function taking the runs is called.
+ */
+typedef struct skb_shaped_run_t {
+	/** Range of codepoints covered by the run, relative to the start of the whole text. */
+	skb_range_t text_range;
+	/** Glyphs of the run in visual order. The offsets include the baseline shift. The glyph cluster index is ignored. */
+	const skb_glyph_t* glyphs;
+	/** Number of glyphs. */
+	int32_t glyphs_count;
+	/** Clusters of the run in logical order. The text offset is relative to the start of the whole text, and the glyph offset is relative to the run glyphs. */
+	const skb_cluster_t* clusters;
+	/** Number of clusters. */
+	int32_t clusters_count;
+	/** Font used to shape the run. */
+	skb_font_handle_t font_handle;
+	/** Font size used to shape the run, including font size scaling. */
+	float font_size;
+	/** Script of the run (see SBScript). */
+	uint8_t script;
+	/** Bidi level of the run, odd levels are right-to-left. */
+	uint8_t bidi_level;
+	/** True if the run contains emojis. */
+	bool is_emoji;
+} skb_shaped_run_t;
+
 /** Opaque type for the text layout. Use skb_layout_create*() to create. */
 typedef struct skb_layout_t skb_layout_t;
 
@@ -465,6 +500,13 @@ uint64_t skb_layout_params_hash_append(uint64_t hash, const skb_layout_params_t*
  */
 skb_layout_t* skb_layout_create(const skb_layout_params_t* params);
 
+/**
+ * Creates a copy of a layout. The copy does not share memory with the source layout.
+ * @param layout layout to copy.
+ * @return newly created copy of the layout.
+ */
+skb_layout_t* skb_layout_create_copy(const skb_layout_t* layout);
+
 /**
  * Creates new layout from the provided parameters, text and text attributes.
  * @param temp_alloc temp alloc to use during building the layout.
@@ -504,6 +546,22 @@ skb_layout_t* skb_layout_create_from_runs(
 	skb_temp_alloc_t* temp_alloc, const skb_layout_params_t* params,
 	const skb_content_run_t* runs, int32_t runs_count);
 
+/**
+ * Creates new layout from the provided parameters, text runs, and pre-shaped glyph runs.
+ * See skb_layout_set_from_shaped_runs() for details.
+ * @param temp_alloc temp alloc to use during building the layout.
+ * @param params paramters to use for the layout.
+ * @param runs text runs to combine into continuous text.
+ * @param runs_count number of runs.
+ * @param shaped_runs shaped glyph runs covering the text in logical order.
+ * @param shaped_runs_count number of shaped runs.
+ * @return newly create layout, or NULL if the shaped runs are not valid.
+ */
+skb_layout_t* skb_layout_create_from_shaped_runs(
+	skb_temp_alloc_t* temp_alloc, const skb_layout_params_t* params,
+	const skb_content_run_t* runs, int32_t runs_count,
+	const skb_shaped_run_t* shaped_runs, int32_t shaped_runs_count);
+
 /**
  * Creates new layout from the provided parameters and text.
  * @param temp_alloc temp alloc to use during building the layout.
@@ -554,9 +612,31 @@ void skb_layout_set_from_runs(
 	skb_layout_t* layout, skb_temp_alloc_t* temp_alloc, const skb_layout_params_t* params,
 	const skb_content_run_t* runs, int32_t runs_count);
 
+/**
+ * Sets the layout from the provided parameters, text runs, and pre-shaped glyph runs.
+ * Itemization and shaping are skipped, the glyphs are taken from the shaped runs, and only the text properties,
+ * line breaking and line layout are calculated. This allows the shaping to be done offline, or on another machine.
+ * The shaped runs must cover the whole text in logical order, and each shaped run must be split at the content run boundaries
+ * where the shaping attributes change. Glyphs for inline objects and icons are created from the content runs.
+ * @param layout layout to set up
+ * @param temp_alloc temp alloc to use during building the layout.
+ * @param params paramters to use for the layout.
+ * @param runs text runs to combine into continuous text.
+ * @param runs_count number of runs.
+ * @param shaped_runs shaped glyph runs covering the text in logical order.
+ * @param shaped_runs_count number of shaped runs.
+ * @return true if the layout was set, false if the shaped runs are not valid (e.g. ranges or indices out of bounds, empty clusters, or unknown font). The layout is reset on failure.
+ */
+bool skb_layout_set_from_shaped_runs(
+	skb_layout_t* layout, skb_temp_alloc_t* temp_alloc, const skb_layout_params_t* params,
+	const skb_content_run_t* runs, int32_t runs_count,
+	const skb_shaped_run_t* shaped_runs, int32_t shaped_runs_count);
+
 /**
  * Sets the layout from the provided parameters and text.
  * The text runs are combined into one attributes string and laid out as one.
+ * The layout shares the codepoints of the text instead of copying them, and the text copies its codepoints
+ * on the next modification while they are shared. Temp allocated and compact texts are copied.
  * @param layout layout to set up
  * @param temp_alloc temp alloc to use during building the layout.
  * @param params paramters to use for the layout.
@@ -566,6 +646,44 @@ void skb_layout_set_from_text(
 	skb_layout_t* layout, skb_temp_alloc_t* temp_alloc, const skb_layout_params_t* params,
 	const skb_text_t* text, skb_attribute_set_t attributes);
 
+/**
+ * Updates the paint attributes of the layout from the provided parameters and text runs, without rebuilding the layout.
+ * The attributes must have the same structure as the ones used to build the layout, and differ only by paint color or paint id,
+ * see skb_attributes_hash_append_without_paint(). Text background paints are expected to be unchanged.
+ * If any of the attributes does not match, the layout is left partially updated, and should be rebuilt.
+ * @param layout layout to update.
+ * @param params parameters used to build the layout, with new paints.
+ * @param runs content runs used to build the layout, with new paints.
+ * @param runs_count number of runs.
+ * @return true if the paints were updated, false if the attributes do not match the layout.
+ */
+bool skb_layout_update_paints(skb_layout_t* layout, const skb_layout_params_t* params, const skb_content_run_t* runs, int32_t runs_count);
+
+/**
+ * Lays out the text of the layout again, with all font sizes scaled by the specified scale.
+ * The scale is relative to the font sizes specified in the attributes, scale of 1 is the original size.
+ * On first call the text is shaped again, and the shaped glyphs are retained. Following calls scale the retained glyphs,
+ * and only break the text into lines again. The text is shaped again if the glyphs do not scale linearly with the font size,
+ * e.g. the font has tracking table or optical size axis, or the layout uses absolute baseline shift.
+ * Letter and word spacing, line height, and inline objects are not scaled.
+ * @param layout layout to update.
+ * @param temp_alloc temp alloc to use during building the layout.
+ * @param font_scale scale to apply for all font sizes.
+ */
+void skb_layout_relayout_at_scale(skb_layout_t* layout, skb_temp_alloc_t* temp_alloc, float font_scale);
+
+/**
+ * Finds the largest font scale between min and max scale, so that all the text fits in the layout box without overflow.
+ * The layout is left laid out at the returned scale. The text is shaped only once, see skb_layout_relayout_at_scale().
+ * If the text does not fit even at min scale, the layout is laid out at min scale.
+ * @param layout layout to fit.
+ * @param temp_alloc temp alloc to use during building the layout.
+ * @param min_scale smallest font scale to try.
+ * @param max_scale largest font scale to try.
+ * @return font scale that fits the layout box.
+ */
+float skb_layout_fit_font_size(skb_layout_t* layout, skb_temp_alloc_t* temp_alloc, float min_scale, float max_scale);
+
 /**
  * Empties the specified layout. Keeps the existing allocations.
  * @param layout layout to reset.
@@ -578,6 +696,30 @@ void skb_layout_reset(skb_layout_t* layout);
  */
 void skb_layout_destroy(skb_layout_t* layout);
 
+/**
+ * Serializes the layout into a binary snapshot, which can be loaded using skb_layout_deserialize().
+ * The snapshot contains the text, attributes, shaping results, and line layout, it does not need to be relocated.
+ * Fonts are referenced by their hash (see skb_font_get_hash()), object data, icon handles, and paint ids are stored as is.
+ * The snapshot is only valid for the same version and build configuration of the library.
+ * @param layout layout to serialize.
+ * @param data pointer to buffer where to store the snapshot, can be NULL.
+ * @param data_cap size of the buffer in bytes.
+ * @return total size of the snapshot in bytes (can be larger than data_cap). If the snapshot does not fit, nothing is written.
+ */
+int32_t skb_layout_serialize(const skb_layout_t* layout, uint8_t* data, int32_t data_cap);
+
+/**
+ * Loads layout from a binary snapshot created using skb_layout_serialize().
+ * The layout dimensions and flags are restored from the snapshot, the collections are taken from the params.
+ * Fails if the snapshot is invalid, created with different version of the library, or if any of the fonts is not found in the font collection.
+ * @param layout layout to load the snapshot into. The layout is reset on failure.
+ * @param params parameters providing the font, icon, and attribute collections to use.
+ * @param data pointer to the snapshot data.
+ * @param data_count size of the snapshot data in bytes.
+ * @return true if the layout was loaded.
+ */
+bool skb_layout_deserialize(skb_layout_t* layout, const skb_layout_params_t* params, const uint8_t* data, int32_t data_count);
+
 /**
  * Returns parameters that were used to create th elayout.
  * @param layout layout to use
@@ -636,10 +778,25 @@ skb_padding2_t skb_layout_get_padding(const skb_layout_t* layout);
 typedef enum {
 	/** Flag indicating that layout is truncated vertically (see skb_text_overflow_t). */
 	SKB_LAYOUT_IS_TRUNCATED	= 1 << 0,
+	/** Flag indicating that shaping was stopped early, because the rest of the text would be clipped (see skb_text_overflow_t).
+	 * The text outside the shaped range does not have glyphs, see skb_layout_get_shaped_text_range(). */
+	SKB_LAYOUT_IS_PARTIALLY_SHAPED = 1 << 1,
 } skb_layout_flags_t;
 
 uint32_t skb_layout_get_flags(const skb_layout_t* layout);
 
+/**
+ * Returns the range of text that was shaped.
+ * When the layout has overflow clip or ellipsis, and the text overflows the layout height, or the text is not wrapped and overflows the layout width,
+ * the shaping is stopped once the rest of the text would not be visible. In that case SKB_LAYOUT_IS_PARTIALLY_SHAPED flag is set.
+ * @param layout layout to query.
+ * @return range of text that has been shaped.
+ */
+skb_range_t skb_layout_get_shaped_text_range(const skb_layout_t* layout);
+
+/** @return the font scale the layout is laid out at, see skb_layout_relayout_at_scale(). */
+float skb_layout_get_font_scale(const skb_layout_t* layout);
+
 /**
  * Returns how much to advance the y position when layouts are stacked.
  * @param layout layout to query
@@ -887,6 +1044,41 @@ void skb_layout_iterate_text_range_bounds(const skb_layout_t* layout, skb_text_r
  */
 void skb_layout_iterate_text_range_bounds_with_offset(const skb_layout_t* layout, skb_vec2_t offset, skb_text_range_t text_range, skb_text_range_bounds_func_t* callback, void* context);
 
+/** Struct describing how a text range bounds query was clipped by a view, see skb_layout_iterate_text_range_bounds_in_view(). */
+typedef struct skb_text_range_bounds_clip_info_t {
+	/** Number of lines overlapping the text range and the view, whose rectangles were reported. */
+	int32_t visible_lines_count;
+	/** Number of lines overlapping the text range but outside the view, which were skipped. Lines of clipped paragraphs are not included. */
+	int32_t clipped_lines_count;
+	/** Number of paragraphs overlapping the text range and the view (rich layout only). */
+	int32_t visible_paragraphs_count;
+	/** Number of paragraphs overlapping the text range but outside the view, which were skipped (rich layout only). */
+	int32_t clipped_paragraphs_count;
+} skb_text_range_bounds_clip_info_t;
+
+/**
+ * Returns the range of lines which vertically overlap the view bounds.
+ * The lines are found using binary search, the cost does not depend on the number of lines outside the view.
+ * @param layout layout to use.
+ * @param offset offset of the layout in the view coordinates.
+ * @param view_bounds view rectangle.
+ * @return range of line indices overlapping the view.
+ */
+skb_range_t skb_layout_get_visible_lines_range(const skb_layout_t* layout, skb_vec2_t offset, skb_rect2_t view_bounds);
+
+/**
+ * Iterates over set of bounding rectangles that represent the text range, skipping the lines which are outside the view bounds vertically.
+ * Works like skb_layout_iterate_text_range_bounds_with_offset(), but the cost depends only on the number of visible lines.
+ * @param layout layout to use.
+ * @param offset offset added to each rectangle.
+ * @param text_range the text range to gets the rects for.
+ * @param view_bounds view rectangle, in same coordinates as the reported rectangles.
+ * @param callback callback to call on each rectangle
+ * @param context context passed to the callback.
+ * @return number of visited and clipped lines.
+ */
+skb_text_range_bounds_clip_info_t skb_layout_iterate_text_range_bounds_in_view(const skb_layout_t* layout, skb_vec2_t offset, skb_text_range_t text_range, skb_rect2_t view_bounds, skb_text_range_bounds_func_t* callback, void* context);
+
 /** Struct describing how to draw indent decoration bars */
 typedef struct skb_layout_indent_decoration_info_t {
 	/** X position of the decoration at level 0. */
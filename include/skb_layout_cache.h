@@ -17,9 +17,16 @@ extern "C" {
  * The Layout cache can be used to reuse layouts. It is specifically suited for immediate mode APIs.
  *
  * The layouts are located based on hash of the inputs provided for the getter functions.
+ * Inputs which differ only by the color or paint id of the paint attributes (see skb_attributes_hash_append_without_paint())
+ * have separate entries, but share one laid out layout: each entry owns only a copy of the attributes with its paints,
+ * and refers to the glyphs, lines, and text of the shared layout. The layouts returned by the cache are not changed
+ * when the same text is requested with different paints.
  *
  * Old entries get evicted by periodically calling skb_layout_cache_compact().
  *
+ * Optionally the cache can store snapshots of the layouts on disk (see skb_layout_cache_set_snapshot_path()),
+ * which allows to skip creating the layouts on later runs of the application.
+ *
  * @{
  */
 
@@ -38,6 +45,18 @@ skb_layout_cache_t* skb_layout_cache_create(void);
  */
 void skb_layout_cache_destroy(skb_layout_cache_t* cache);
 
+#if !defined(SKB_NO_OPEN)
+/**
+ * Sets directory where the layout cache stores snapshots of the layouts (see skb_layout_serialize()).
+ * When a layout is not found in memory, it is loaded from a snapshot file if one exists, otherwise the layout is created and written to a snapshot file.
+ * The files are named based on the hash of the layout inputs, which includes the ids of the collections.
+ * The collections should be created in the same order between runs for the snapshots to be found.
+ * @param cache layout cache to use.
+ * @param path path to existing directory where to store the snapshots, or NULL to disable the snapshots.
+ */
+void skb_layout_cache_set_snapshot_path(skb_layout_cache_t* cache, const char* path);
+#endif // !defined(SKB_NO_OPEN)
+
 /**
  * Layouts specified text, or returns existing layout from cache if one exists.
  * @param cache layout cache to use.
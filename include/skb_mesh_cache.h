@@ -0,0 +1,141 @@
+// SPDX-FileCopyrightText: 2025 Mikko Mononen
+// SPDX-License-Identifier: MIT
+
+#ifndef SKB_MESH_CACHE_H
+#define SKB_MESH_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "skb_common.h"
+#include "skb_font_collection.h"
+#include "skb_layout.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @defgroup mesh_cache Mesh Cache
+ *
+ * The mesh cache creates and caches triangle meshes of glyph outlines.
+ * The meshes are resolution independent, which makes them suitable for large text (e.g. headings, or zoomable views),
+ * where rasterizing the glyphs into an image atlas would require very large images.
+ *
+ * The meshes are in em units (font units divided by units per em), the y-axis is pointing down, and the origin is at the glyph origin.
+ * Scale the mesh by font size to get to the layout units, see skb_mesh_cache_iterate_layout_meshes().
+ *
+ * Each mesh consists of two sets of triangles, which index the same points:
+ * - interior triangles, a triangle fan covering the polygon through the on-curve points of each contour,
+ * - curve triangles, one triangle (start, control, end) for each quadratic segment. Cubic segments are approximated with quadratics.
+ *
+ * The triangles overlap, and the glyph is covered where the winding number of the triangles is non-zero.
+ * The curve triangles add or remove the area between the curve and its chord. To render them, assign the coordinates (0,0), (0.5,0), (1,1)
+ * to the triangle corners, and discard fragments where u*u - v > 0 (Loop-Blinn).
+ *
+ * The meshes can be rendered e.g. using stencil:
+ * - render the interior and curve triangles into stencil, incrementing for front facing and decrementing for back facing triangles,
+ * - render the mesh bounds with the text color where stencil is non-zero, and clear the stencil.
+ *
+ * Multisampling can be used for anti-aliasing. Color glyphs are meshed based on their outline, which may be empty.
+ *
+ * The cache has a memory budget. The meshes are evicted in least recently used order when the cache is compacted using skb_mesh_cache_compact().
+ * The returned meshes are valid until the cache is compacted or destroyed.
+ *
+ * @{
+ */
+
+/** Opaque type for the mesh cache. Use skb_mesh_cache_create() to create. */
+typedef struct skb_mesh_cache_t skb_mesh_cache_t;
+
+/** Triangle mesh of a glyph outline. */
+typedef struct skb_glyph_mesh_t {
+	/** Points of the mesh in em units. */
+	const skb_vec2_t* points;
+	/** Number of points. */
+	int32_t points_count;
+	/** Indices of the interior triangles, 3 indices per triangle. */
+	const uint16_t* interior_indices;
+	/** Number of interior indices. */
+	int32_t interior_indices_count;
+	/** Indices of the curve triangles, 3 indices per triangle in order start, control, end. */
+	const uint16_t* curve_indices;
+	/** Number of curve indices. */
+	int32_t curve_indices_count;
+	/** Bounds of the mesh in em units, covers all the triangles. */
+	skb_rect2_t bounds;
+} skb_glyph_mesh_t;
+
+/** Glyph mesh instance, see skb_mesh_cache_iterate_layout_meshes(). */
+typedef struct skb_glyph_mesh_instance_t {
+	/** Mesh to render. */
+	const skb_glyph_mesh_t* mesh;
+	/** Transform from the mesh em units to the layout units, includes the font size and glyph position. */
+	skb_mat2_t transform;
+	/** Index of the layout run of the glyph, can be used to get the paint of the glyph. */
+	int32_t layout_run_idx;
+	/** Index of the glyph in the layout. */
+	int32_t glyph_idx;
+} skb_glyph_mesh_instance_t;
+
+/**
+ * Signature of glyph mesh instance iterator callback.
+ * @param instance glyph mesh instance to render.
+ * @param context context passed to skb_mesh_cache_iterate_layout_meshes().
+ */
+typedef void skb_glyph_mesh_instance_func_t(const skb_glyph_mesh_instance_t* instance, void* context);
+
+/**
+ * Creates a new mesh cache.
+ * @param memory_budget maximum number of bytes used by the cached meshes after compaction, or 0 for default budget (4 MB).
+ * @return newly created cache.
+ */
+skb_mesh_cache_t* skb_mesh_cache_create(int32_t memory_budget);
+
+/**
+ * Destroys a mesh cache.
+ * @param cache pointer to the mesh cache to destroy.
+ */
+void skb_mesh_cache_destroy(skb_mesh_cache_t* cache);
+
+/**
+ * Returns mesh of specified glyph, or creates a new one if it does not exist in the cache.
+ * @param cache mesh cache to use.
+ * @param font_collection font collection to use.
+ * @param font_handle handle to the font in the font collection.
+ * @param glyph_id glyph id of the mesh.
+ * @return pointer to the glyph mesh, or NULL if the font is not valid. Glyphs without outline have empty mesh.
+ */
+const skb_glyph_mesh_t* skb_mesh_cache_get_glyph_mesh(skb_mesh_cache_t* cache, skb_font_collection_t* font_collection, skb_font_handle_t font_handle, uint32_t glyph_id);
+
+/**
+ * Iterates meshes of all the glyphs in the layout. Glyphs with empty mesh are skipped.
+ * @param cache mesh cache to use.
+ * @param layout layout to iterate.
+ * @param offset offset to add to the glyph positions.
+ * @param callback callback to call for each glyph mesh instance.
+ * @param context context passed to the callback.
+ */
+void skb_mesh_cache_iterate_layout_meshes(skb_mesh_cache_t* cache, const skb_layout_t* layout, skb_vec2_t offset, skb_glyph_mesh_instance_func_t* callback, void* context);
+
+/**
+ * Returns the number of bytes used by the cached meshes.
+ * @param cache mesh cache to query.
+ * @return number of bytes used by the meshes.
+ */
+int32_t skb_mesh_cache_get_memory_usage(const skb_mesh_cache_t* cache);
+
+/**
+ * Compacts the mesh cache by evicting meshes until the cache fits in its memory budget.
+ * The meshes are removed in least recently used fashion. All meshes returned earlier may be invalid after compaction.
+ * @param cache mesh cache to compact.
+ * @return true if meshes were evicted.
+ */
+bool skb_mesh_cache_compact(skb_mesh_cache_t* cache);
+
+/** @} */
+
+#ifdef __cplusplus
+}; // extern "C"
+#endif
+
+#endif // SKB_MESH_CACHE_H
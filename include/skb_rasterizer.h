@@ -39,6 +39,9 @@ typedef struct skb_icon_t skb_icon_t;
 /** Opaque type for the rasterizer. Use skb_rasterizer_create() to create. */
 typedef struct skb_rasterizer_t skb_rasterizer_t;
 
+/** Opaque type for a rasterizer session. Use skb_rasterizer_begin_session() to create. */
+typedef struct skb_rasterizer_session_t skb_rasterizer_session_t;
+
 /** Rasterizer configuration. */
 typedef struct skb_rasterizer_config_t {
 	/** Defines the zero of the SDF when converted to alpha [0..255]. Default: 128 */
@@ -53,6 +56,26 @@ typedef enum {
 	SKB_RASTERIZE_ALPHA_SDF, /**< Rasterize alpha channel as sign distance field. */
 } skb_rasterize_alpha_mode_t;
 
+/** Enum describing glyph effect type. */
+typedef enum {
+	/** No effect, the glyph is rasterized as is. */
+	SKB_GLYPH_EFFECT_NONE = 0,
+	/** Glyph expanded by spread and blurred by radius. Used for drop shadows and glows. */
+	SKB_GLYPH_EFFECT_SHADOW,
+	/** Glyph expanded by spread and blurred by radius, with the glyph itself cut out. Used for outlines. */
+	SKB_GLYPH_EFFECT_OUTLINE,
+} skb_glyph_effect_type_t;
+
+/** Struct describing an effect applied to rasterized glyph coverage. */
+typedef struct skb_glyph_effect_t {
+	/** Type of the effect, see skb_glyph_effect_type_t. */
+	uint8_t type;
+	/** Blur radius. */
+	float radius;
+	/** How much the glyph is expanded before blurring. */
+	float spread;
+} skb_glyph_effect_t;
+
 /**
  * Creates a rasterizer.
  * @param config pointer to rasterizer configuration.
@@ -109,6 +132,32 @@ bool skb_rasterizer_draw_alpha_glyph(
 	uint32_t glyph_id, const skb_font_t* font, float font_size, skb_rasterize_alpha_mode_t alpha_mode,
 	float offset_x, float offset_y, skb_image_t* target);
 
+/**
+ * Returns how much padding the specified glyph effect requires around the glyph.
+ * @param effect effect to apply, the radius and spread are in pixels.
+ * @return padding in pixels.
+ */
+int32_t skb_rasterizer_get_glyph_effect_padding(skb_glyph_effect_t effect);
+
+/**
+ * Rasterizes a glyph as alpha mask, and applies specified effect to it.
+ * The offset and image size can be obtained using skb_rasterizer_get_glyph_dimensions(), the padding should include skb_rasterizer_get_glyph_effect_padding().
+ * @param rasterizer pointer to rasterizer.
+ * @param temp_alloc pointer to temp alloc used during the rasterization.
+ * @param glyph_id glyph id to rasterize.
+ * @param font font where to get the glyph data.
+ * @param font_size font size.
+ * @param effect effect to apply, the radius and spread are in pixels and are truncated to whole pixels.
+ * @param offset_x offset x where to rasterize the glyph.
+ * @param offset_y offset y where to rasterize the glyph.
+ * @param target target image to rasterize to. The image must be 1 byte-per-pixel.
+ * @return true of the rasterization succeeded.
+ */
+bool skb_rasterizer_draw_glyph_effect(
+	skb_rasterizer_t* rasterizer, skb_temp_alloc_t* temp_alloc,
+	uint32_t glyph_id, const skb_font_t* font, float font_size, skb_glyph_effect_t effect,
+	float offset_x, float offset_y, skb_image_t* target);
+
 /**
  * Rasterizes a glyph as RGBA.
  * The offset and image size can be obtained using skb_rasterizer_get_glyph_dimensions().
@@ -128,6 +177,73 @@ bool skb_rasterizer_draw_color_glyph(
 	uint32_t glyph_id, const skb_font_t* font, float font_size, skb_rasterize_alpha_mode_t alpha_mode,
 	int32_t offset_x, int32_t offset_y, skb_image_t* target);
 
+/**
+ * Begins a session for rasterizing multiple glyphs in a row.
+ * The session keeps one canvas and its scanline, edge, and layer buffers alive between the glyphs, and only resets the per glyph state.
+ * The session is allocated from the temp allocator, any temp allocations made during the session must be freed before the session is ended.
+ * @param rasterizer pointer to rasterizer.
+ * @param temp_alloc pointer to temp alloc used during the rasterization.
+ * @return pointer to the session, end with skb_rasterizer_end_session().
+ */
+skb_rasterizer_session_t* skb_rasterizer_begin_session(skb_rasterizer_t* rasterizer, skb_temp_alloc_t* temp_alloc);
+
+/**
+ * Ends rasterizer session and frees the buffers retained by it.
+ * @param session session to end.
+ */
+void skb_rasterizer_end_session(skb_rasterizer_session_t* session);
+
+/**
+ * Rasterizes a glyph as alpha mask using a session. See skb_rasterizer_draw_alpha_glyph().
+ * @param session session to use for the rasterization.
+ * @param glyph_id glyph id to rasterize.
+ * @param font font where to get the glyph data.
+ * @param font_size font size.
+ * @param alpha_mode alpha mode, defines if the alpha channel of the result is SDF or alpha mask.
+ * @param offset_x offset x where to rasterize the glyph.
+ * @param offset_y offset y where to rasterize the glyph.
+ * @param target target image to rasterize to. The image must be 1 byte-per-pixel.
+ * @return true of the rasterization succeeded.
+ */
+bool skb_rasterizer_session_draw_alpha_glyph(
+	skb_rasterizer_session_t* session,
+	uint32_t glyph_id, const skb_font_t* font, float font_size, skb_rasterize_alpha_mode_t alpha_mode,
+	float offset_x, float offset_y, skb_image_t* target);
+
+/**
+ * Rasterizes a glyph as alpha mask, and applies specified effect to it using a session. See skb_rasterizer_draw_glyph_effect().
+ * @param session session to use for the rasterization.
+ * @param glyph_id glyph id to rasterize.
+ * @param font font where to get the glyph data.
+ * @param font_size font size.
+ * @param effect effect to apply, the radius and spread are in pixels and are truncated to whole pixels.
+ * @param offset_x offset x where to rasterize the glyph.
+ * @param offset_y offset y where to rasterize the glyph.
+ * @param target target image to rasterize to. The image must be 1 byte-per-pixel.
+ * @return true of the rasterization succeeded.
+ */
+bool skb_rasterizer_session_draw_glyph_effect(
+	skb_rasterizer_session_t* session,
+	uint32_t glyph_id, const skb_font_t* font, float font_size, skb_glyph_effect_t effect,
+	float offset_x, float offset_y, skb_image_t* target);
+
+/**
+ * Rasterizes a glyph as RGBA using a session. See skb_rasterizer_draw_color_glyph().
+ * @param session session to use for the rasterization.
+ * @param glyph_id glyph id to rasterize.
+ * @param font font.
+ * @param font_size font size .
+ * @param alpha_mode alpha mode, defines if the alpha channel of the result is SDF or alpha mask.
+ * @param offset_x offset x where to rasterize the glyph.
+ * @param offset_y offset y where to rasterize the glyph.
+ * @param target target image to rasterize to. The image must be 4 bytes-per-pixel.
+ * @return true of the rasterization succeeded.
+ */
+bool skb_rasterizer_session_draw_color_glyph(
+	skb_rasterizer_session_t* session,
+	uint32_t glyph_id, const skb_font_t* font, float font_size, skb_rasterize_alpha_mode_t alpha_mode,
+	int32_t offset_x, int32_t offset_y, skb_image_t* target);
+
 /**
  * Calculates the dimensions required to rasterize a specific icon at spcified size.
  * The width and height of the returned rectangle defines the image size, and origin defines the offset the icon should be rasterized at.
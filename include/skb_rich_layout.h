@@ -43,6 +43,18 @@ void skb_rich_layout_destroy(skb_rich_layout_t* rich_layout);
  */
 void skb_rich_layout_reset(skb_rich_layout_t* rich_layout);
 
+/**
+ * Sets the memory budget for retaining the layouts of removed paragraphs.
+ * When a paragraph with identical content and layout parameters is added later (e.g. cut and paste, undo), it will adopt the retained layout instead of being laid out again.
+ * The oldest layouts are evicted first when the budget is exceeded. Default budget is 1 MB.
+ * @param rich_layout rich layout to change.
+ * @param budget max number of bytes used by the retained layouts, 0 to disable.
+ */
+void skb_rich_layout_set_detached_layouts_budget(skb_rich_layout_t* rich_layout, int32_t budget);
+
+/** @returns number of bytes used by the retained layouts of removed paragraphs. */
+int32_t skb_rich_layout_get_detached_layouts_size(const skb_rich_layout_t* rich_layout);
+
 
 /** @returns numner of paragraphs in the rich layout */
 int32_t skb_rich_layout_get_paragraphs_count(const skb_rich_layout_t* rich_layout);
@@ -114,6 +126,27 @@ skb_caret_info_t skb_rich_layout_get_caret_info_at(const skb_rich_layout_t* rich
  */
 void skb_rich_layout_get_text_range_bounds(const skb_rich_layout_t* rich_layout, skb_text_range_t text_range, skb_text_range_bounds_func_t* callback, void* context);
 
+/**
+ * Returns the range of paragraphs which vertically overlap the view bounds.
+ * The paragraphs are found using binary search, the cost does not depend on the number of paragraphs outside the view.
+ * @param rich_layout rich layout to use.
+ * @param view_bounds view rectangle, in same coordinates as the paragraph layouts.
+ * @return range of paragraph indices overlapping the view.
+ */
+skb_range_t skb_rich_layout_get_visible_paragraphs_range(const skb_rich_layout_t* rich_layout, skb_rect2_t view_bounds);
+
+/**
+ * Iterates over set of bounding rectangles that represent the text range, skipping the paragraphs and lines which are outside the view bounds vertically.
+ * Works like skb_rich_layout_get_text_range_bounds(), but the cost depends only on the number of visible lines.
+ * @param rich_layout rich layout to use.
+ * @param text_range the text range to gets the rects for.
+ * @param view_bounds view rectangle, in same coordinates as the reported rectangles.
+ * @param callback callback to call on each rectangle
+ * @param context context passed to the callback.
+ * @return number of visited and clipped paragraphs and lines.
+ */
+skb_text_range_bounds_clip_info_t skb_rich_layout_get_text_range_bounds_in_view(const skb_rich_layout_t* rich_layout, skb_text_range_t text_range, skb_rect2_t view_bounds, skb_text_range_bounds_func_t* callback, void* context);
+
 /**
  * Returns caret text position under the hit location.
  * First or last line is tested if the hit location is outside the vertical bounds.
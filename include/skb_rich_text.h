@@ -69,6 +69,20 @@ void skb_rich_text_destroy(skb_rich_text_t* rich_text);
  */
 void skb_rich_text_reset(skb_rich_text_t* rich_text);
 
+/**
+ * Sets if the paragraph texts should be stored in compact utf-8 form (see skb_text_compact()), which takes about 1/5th of memory for mostly ASCII text.
+ * When enabled, all existing paragraphs are compacted, and appended paragraphs are compacted as they are added.
+ * Paragraphs that are edited are expanded and stay expanded until the storage is set again. Reading the text does not expand the paragraphs,
+ * note that skb_text_get_utf32() returns NULL for compact paragraphs, use skb_text_get_utf32_in_range() instead.
+ * Layouts are built from compact paragraphs by decoding into temporary buffer.
+ * @param rich_text rich text to change.
+ * @param compact true if the paragraphs should be stored in compact form.
+ */
+void skb_rich_text_set_compact_storage(skb_rich_text_t* rich_text, bool compact);
+
+/** @return true if the rich text uses compact storage, see skb_rich_text_set_compact_storage(). */
+bool skb_rich_text_get_compact_storage(const skb_rich_text_t* rich_text);
+
 /** @return number of utf-32 codepoints in the rich text. */
 int32_t skb_rich_text_get_utf32_count(const skb_rich_text_t* rich_text);
 
@@ -224,6 +238,104 @@ skb_rich_text_change_t skb_rich_text_append_utf32_with_payload(
 	const uint32_t* utf32, int32_t utf32_count, skb_attribute_set_t attributes,
 	uint8_t span_flags, const skb_data_blob_t* payload);
 
+/**
+ * Rich text builder is used to append many fragments of text to a rich text efficiently, see skb_text_builder_t.
+ * The text is split into paragraphs as it is appended, and the paragraphs are finished when the next paragraph starts,
+ * or in skb_rich_text_builder_finish(). When compact storage is used, the paragraphs are compacted in skb_rich_text_builder_finish().
+ * The rich text should not be accessed or modified by other functions between skb_rich_text_builder_begin() and skb_rich_text_builder_finish().
+ */
+typedef struct skb_rich_text_builder_t {
+	/** Rich text to append to. */
+	skb_rich_text_t* rich_text;
+	/** Temp alloc used during the build. */
+	skb_temp_alloc_t* temp_alloc;
+	/** Builder of the last paragraph. */
+	skb_text_builder_t paragraph_builder;
+	/** Number of paragraphs when the build started. */
+	int32_t start_paragraphs_count;
+} skb_rich_text_builder_t;
+
+/**
+ * Starts building text at the end of the specified rich text.
+ * @param rich_text rich text to append to.
+ * @param temp_alloc temp alloc used during the build.
+ * @return builder to be used with the skb_rich_text_builder_append*() functions.
+ */
+skb_rich_text_builder_t skb_rich_text_builder_begin(skb_rich_text_t* rich_text, skb_temp_alloc_t* temp_alloc);
+
+/**
+ * Appends new empty paragraph.
+ * @param builder pointer to the builder.
+ * @param paragraph_attributes attributes for the new paragraph.
+ */
+void skb_rich_text_builder_append_paragraph(skb_rich_text_builder_t* builder, skb_attribute_set_t paragraph_attributes);
+
+/**
+ * Appends text.
+ * @param builder pointer to the builder.
+ * @param source_text source text to append
+ */
+void skb_rich_text_builder_append_text(skb_rich_text_builder_t* builder, const skb_text_t* source_text);
+
+/**
+ * Appends range of text from text.
+ * @param builder pointer to the builder.
+ * @param source_text source text to append
+ * @param source_text_range range of text in source to append
+ */
+void skb_rich_text_builder_append_text_range(skb_rich_text_builder_t* builder, const skb_text_t* source_text, skb_text_range_t source_text_range);
+
+/**
+ * Appends utf-8 string with attributes.
+ * @param builder pointer to the builder.
+ * @param utf8 pointer to the utf-8 string.
+ * @param utf8_count length of the utf-8 string, or -1 if zero terminated.
+ * @param attributes attributes to apply for appended text.
+ */
+void skb_rich_text_builder_append_utf8(skb_rich_text_builder_t* builder, const char* utf8, int32_t utf8_count, skb_attribute_set_t attributes);
+
+/**
+ * Appends utf-8 string with attributes and payload.
+ * @param builder pointer to the builder.
+ * @param utf8 pointer to the utf-8 string.
+ * @param utf8_count length of the utf-8 string, or -1 if zero terminated.
+ * @param attributes attributes to apply for appended text.
+ * @param span_flags span flags to apply for the text, see skb_attribute_span_flags_t.
+ * @param payload payload to attach to the text.
+ */
+void skb_rich_text_builder_append_utf8_with_payload(
+	skb_rich_text_builder_t* builder, const char* utf8, int32_t utf8_count, skb_attribute_set_t attributes,
+	uint8_t span_flags, const skb_data_blob_t* payload);
+
+/**
+ * Appends utf-32 string with attributes.
+ * @param builder pointer to the builder.
+ * @param utf32 pointer to the utf-32 string.
+ * @param utf32_count length of the utf-32 string, or -1 if zero terminated.
+ * @param attributes attributes to apply for appended text.
+ */
+void skb_rich_text_builder_append_utf32(skb_rich_text_builder_t* builder, const uint32_t* utf32, int32_t utf32_count, skb_attribute_set_t attributes);
+
+/**
+ * Appends utf-32 string with attributes and payload.
+ * @param builder pointer to the builder.
+ * @param utf32 pointer to the utf-32 string.
+ * @param utf32_count length of the utf-32 string, or -1 if zero terminated.
+ * @param attributes attributes to apply for appended text.
+ * @param span_flags span flags to apply for the text, see skb_attribute_span_flags_t.
+ * @param payload payload to attach to the text.
+ */
+void skb_rich_text_builder_append_utf32_with_payload(
+	skb_rich_text_builder_t* builder, const uint32_t* utf32, int32_t utf32_count, skb_attribute_set_t attributes,
+	uint8_t span_flags, const skb_data_blob_t* payload);
+
+/**
+ * Finishes the build, see skb_text_builder_finish().
+ * @param builder pointer to the builder, the builder is cleared.
+ * @return info about changed paragraphs.
+ */
+skb_rich_text_change_t skb_rich_text_builder_finish(skb_rich_text_builder_t* builder);
+
 /**
  * Replaces text range with source rich text.
  * @param rich_text rich text to insert to
@@ -378,6 +490,65 @@ typedef bool skb_rich_text_remove_func_t(uint32_t codepoint, int32_t paragraph_i
  */
 void skb_rich_text_remove_if(skb_rich_text_t* rich_text, skb_rich_text_remove_func_t* filter_func, void* context);
 
+/** Type of paragraph level change, see skb_rich_text_diff_t. */
+typedef enum {
+	/** The paragraphs are equal in both texts. */
+	SKB_RICH_TEXT_DIFF_EQUAL = 0,
+	/** The paragraphs from the new text are inserted. */
+	SKB_RICH_TEXT_DIFF_INSERT,
+	/** The paragraphs from the old text are removed. */
+	SKB_RICH_TEXT_DIFF_DELETE,
+	/** The paragraphs in the old text are replaced with the paragraphs from the new text. */
+	SKB_RICH_TEXT_DIFF_MODIFY,
+} skb_rich_text_diff_type_t;
+
+/** Paragraph level change between two rich texts, see skb_rich_text_diff(). */
+typedef struct skb_rich_text_diff_t {
+	/** Type of the change, see skb_rich_text_diff_type_t. */
+	uint8_t type;
+	/** Index of the first paragraph in the old text. */
+	int32_t old_paragraph_idx;
+	/** Index of the first paragraph in the new text. */
+	int32_t new_paragraph_idx;
+	/** Number of paragraphs in the change. */
+	int32_t paragraph_count;
+} skb_rich_text_diff_t;
+
+/**
+ * Signature of the change callback, see skb_rich_text_apply_patch().
+ * @param change the paragraphs that changed, the paragraph indices are relative to the text as it was patched so far.
+ * @param context context pointer passed to skb_rich_text_apply_patch().
+ */
+typedef void skb_rich_text_change_func_t(skb_rich_text_change_t change, void* context);
+
+/**
+ * Calculates paragraph level changes required to turn the rich text into the new rich text.
+ * The paragraphs are compared using hash of their text, attribute spans and paragraph attributes, and matched using longest common subsequence.
+ * Large changes are reported as modified paragraphs instead of matching them.
+ * The diff will contain at most old paragraph count + new paragraph count changes.
+ * @param rich_text the old rich text.
+ * @param temp_alloc temp alloc to use for the comparison.
+ * @param new_rich_text the new rich text.
+ * @param diffs pointer to array where to store the changes.
+ * @param diffs_cap capacity of the diffs array.
+ * @return number of changes. If the number is larger than diffs_cap, the array was too small.
+ */
+int32_t skb_rich_text_diff(const skb_rich_text_t* rich_text, skb_temp_alloc_t* temp_alloc, const skb_rich_text_t* new_rich_text, skb_rich_text_diff_t* diffs, int32_t diffs_cap);
+
+/**
+ * Applies changes calculated using skb_rich_text_diff() to the rich text, so that it will match the new rich text.
+ * The equal paragraphs retain their versions, which allows skb_rich_layout_t to lay out only the changed paragraphs.
+ * @param rich_text the rich text to patch, must be the old rich text passed to skb_rich_text_diff().
+ * @param new_rich_text the new rich text passed to skb_rich_text_diff().
+ * @param diffs pointer to the changes.
+ * @param diffs_count number of changes.
+ * @param change_func function called for each paragraph change, can be NULL. Can be used to update rich layout using skb_rich_layout_apply_change().
+ * @param context context pointer passed to the change function.
+ */
+void skb_rich_text_apply_patch(
+	skb_rich_text_t* rich_text, const skb_rich_text_t* new_rich_text, const skb_rich_text_diff_t* diffs, int32_t diffs_count,
+	skb_rich_text_change_func_t* change_func, void* context);
+
 /**
  * Returns paragraph position from text position.
  * @param rich_text rich text to use.
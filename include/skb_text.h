@@ -18,6 +18,8 @@ extern "C" {
  *
  * The attributes are stored in ordered array of spans. The spans of same type of attribute will split and merge as they are modified.
  *
+ * Text which is not actively edited can be stored in compact utf-8 form to save memory, see skb_text_compact(). All offsets stay in codepoints.
+ *
  * @{
  */
 
@@ -78,6 +80,26 @@ void skb_text_destroy(skb_text_t* text);
  */
 void skb_text_reset(skb_text_t* text);
 
+/**
+ * Converts the text to compact utf-8 storage. The utf-32 codepoints and text properties (5 bytes per codepoint) are released,
+ * and the text is stored as utf-8 with a codepoint offset table every 256 codepoints.
+ * Functions which modify the text will expand the text back to utf-32 storage, see skb_text_expand().
+ * Functions taking const text never expand it. Use skb_text_get_utf32_in_range(), skb_text_get_utf8_in_range(), and skb_text_get_codepoint()
+ * to read compact text, skb_text_get_utf32() and skb_text_get_props() return NULL for compact text. Grapheme navigation works on both.
+ * Texts using temp allocator are not compacted.
+ * @param text text to compact.
+ */
+void skb_text_compact(skb_text_t* text);
+
+/** @return true if the text is stored in compact utf-8 form, see skb_text_compact(). */
+bool skb_text_is_compact(const skb_text_t* text);
+
+/**
+ * Converts compact text back to utf-32 storage, see skb_text_compact(). Does nothing if the text is not compact.
+ * @param text text to expand.
+ */
+void skb_text_expand(skb_text_t* text);
+
 /**
  * Reserves memory in the text buffer for text and attributes. If larger buffer is already allocated, nothing changes.
  * @param text text to change
@@ -88,17 +110,62 @@ void skb_text_reserve(skb_text_t* text, int32_t text_count, int32_t spans_count)
 
 /** @return length of the text (utf-32 codeunits).  */
 int32_t skb_text_get_utf32_count(const skb_text_t* text);
-/** @return const pointer to the utf-32 string. */
+/** @return const pointer to the utf-32 string, or NULL if the text is compact (see skb_text_expand()). */
 const uint32_t * skb_text_get_utf32(const skb_text_t* text);
-/** @return const pointer to the text property flags (current supports only grapheme breaks) */
+/** @return const pointer to the text property flags (current supports only grapheme breaks), or NULL if the text is compact (see skb_text_expand()). */
 const uint8_t* skb_text_get_props(const skb_text_t* text);
 
+/**
+ * Returns codepoint at specified offset. Does not expand compact text.
+ * @param text text to read from.
+ * @param offset offset of the codepoint.
+ * @return codepoint at the offset, or 0 if the offset is out of range.
+ */
+uint32_t skb_text_get_codepoint(const skb_text_t* text, int32_t offset);
+
+/**
+ * Copies range of the text as utf-32. Does not expand compact text.
+ * @param text text to copy from.
+ * @param range range of text to copy (codepoints).
+ * @param utf32 pointer to the result utf-32 string.
+ * @param utf32_cap capacity of the result string.
+ * @return number of codepoints in the range.
+ */
+int32_t skb_text_get_utf32_in_range(const skb_text_t* text, skb_range_t range, uint32_t* utf32, int32_t utf32_cap);
+
+/**
+ * Copies range of the text as utf-8. Does not expand compact text.
+ * @param text text to copy from.
+ * @param range range of text to copy (codepoints).
+ * @param utf8 pointer to the result utf-8 string, if NULL, the number of utf-8 code units is returned.
+ * @param utf8_cap capacity of the result string.
+ * @return number of utf-8 code units written, or required if utf8 is NULL.
+ */
+int32_t skb_text_get_utf8_in_range(const skb_text_t* text, skb_range_t range, char* utf8, int32_t utf8_cap);
+
 
 /** @return number of attribute spans of the text. */
 int32_t skb_text_get_attribute_spans_count(const skb_text_t* text);
 /** @return const pointer to the attribute spans of the text. */
 const skb_attribute_span_t* skb_text_get_attribute_spans(const skb_text_t* text);
 
+/**
+ * Appends the text contents (codepoints, attribute spans and their payloads) to a hash.
+ * Two texts with same hash will produce the same layout given same layout parameters.
+ * @param hash hash to append to.
+ * @param text text to hash.
+ * @return combined hash.
+ */
+uint64_t skb_text_hash_append(uint64_t hash, const skb_text_t* text);
+
+/**
+ * Compares the text contents (codepoints, attribute spans and their payloads) of two texts.
+ * @param text text to compare.
+ * @param other text to compare to.
+ * @return true if the texts have the same contents.
+ */
+bool skb_text_equals(const skb_text_t* text, const skb_text_t* other);
+
 /**
  * Get the start of the next grapheme in the layout based on text offset.
  * @param text text to use
@@ -189,6 +256,92 @@ void skb_text_append_utf32(skb_text_t* text, const uint32_t* utf32, int32_t utf3
  */
 void skb_text_append_utf32_with_payload(skb_text_t* text, const uint32_t* utf32, int32_t utf32_count, skb_attribute_set_t attributes, uint8_t span_flags, const skb_data_blob_t* payload);
 
+/**
+ * Text builder is used to append many fragments of text to a text efficiently.
+ * The codepoints and attribute spans are accumulated in append order, and the grapheme breaks are calculated,
+ * and adjacent attribute spans are merged once in skb_text_builder_finish().
+ * The text should not be accessed or modified by other functions between skb_text_builder_begin() and skb_text_builder_finish().
+ */
+typedef struct skb_text_builder_t {
+	/** Text to append to. */
+	skb_text_t* text;
+	/** Offset of the first appended codepoint. */
+	int32_t start_offset;
+	/** Number of attribute spans in the text when the build started. */
+	int32_t start_spans_count;
+	/** Version of the text after last append, used to validate that the text is not changed during the build. */
+	uint32_t text_version;
+} skb_text_builder_t;
+
+/**
+ * Starts building text at the end of the specified text. Compact text is expanded to utf-32 storage.
+ * @param text text to append to.
+ * @return builder to be used with the skb_text_builder_append*() functions.
+ */
+skb_text_builder_t skb_text_builder_begin(skb_text_t* text);
+
+/**
+ * Appends the contents from other text.
+ * @param builder pointer to the builder.
+ * @param text_from text to copy from.
+ */
+void skb_text_builder_append(skb_text_builder_t* builder, const skb_text_t* text_from);
+
+/**
+ * Appends range of contents from other text.
+ * @param builder pointer to the builder.
+ * @param source_text text to copy from.
+ * @param source_text_range text range to copy (in utf-32 codepoints).
+ */
+void skb_text_builder_append_range(skb_text_builder_t* builder, const skb_text_t* source_text, skb_text_range_t source_text_range);
+
+/**
+ * Appends utf-8 string with attributes.
+ * @param builder pointer to the builder.
+ * @param utf8 pointer to a utf-8 string
+ * @param utf8_count length of the utf-8 string, or -1 if the string is zero terminated.
+ * @param attributes slice of attributes to apply to the appended text.
+ */
+void skb_text_builder_append_utf8(skb_text_builder_t* builder, const char* utf8, int32_t utf8_count, skb_attribute_set_t attributes);
+
+/**
+ * Appends utf-8 string with attributes and payload.
+ * @param builder pointer to the builder.
+ * @param utf8 pointer to a utf-8 string
+ * @param utf8_count length of the utf-8 string, or -1 if the string is zero terminated.
+ * @param attributes slice of attributes to apply to the appended text.
+ * @param span_flags span flags to apply for all the attributes, see skb_attribute_span_flags_t.
+ * @param payload payload to apply for all the attributes.
+ */
+void skb_text_builder_append_utf8_with_payload(skb_text_builder_t* builder, const char* utf8, int32_t utf8_count, skb_attribute_set_t attributes, uint8_t span_flags, const skb_data_blob_t* payload);
+
+/**
+ * Appends utf-32 string with attributes.
+ * @param builder pointer to the builder.
+ * @param utf32 pointer to a utf-32 string
+ * @param utf32_count length of the utf-32 string, or -1 if the string is zero terminated.
+ * @param attributes slice of attributes to apply to the appended text.
+ */
+void skb_text_builder_append_utf32(skb_text_builder_t* builder, const uint32_t* utf32, int32_t utf32_count, skb_attribute_set_t attributes);
+
+/**
+ * Appends utf-32 string with attributes and payload.
+ * @param builder pointer to the builder.
+ * @param utf32 pointer to a utf-32 string
+ * @param utf32_count length of the utf-32 string, or -1 if the string is zero terminated.
+ * @param attributes slice of attributes to apply to the appended text.
+ * @param span_flags span flags to apply for all the attributes, see skb_attribute_span_flags_t.
+ * @param payload payload to apply for all the attributes.
+ */
+void skb_text_builder_append_utf32_with_payload(skb_text_builder_t* builder, const uint32_t* utf32, int32_t utf32_count, skb_attribute_set_t attributes, uint8_t span_flags, const skb_data_blob_t* payload);
+
+/**
+ * Finishes the build: calculates the grapheme breaks of the appended text, and merges adjacent attribute spans.
+ * Grapheme clusters spanning multiple appended fragments are detected correctly.
+ * @param builder pointer to the builder, the builder is cleared.
+ */
+void skb_text_builder_finish(skb_text_builder_t* builder);
+
 /**
  * Inserts text replacing the text range.
 * @param text pointer to the text to modify
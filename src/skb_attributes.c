@@ -803,17 +803,40 @@ int32_t skb_attributes_copy_flat(const skb_attribute_set_t attributes, skb_attri
 	return copied;
 }
 
-uint64_t skb_attributes_hash_append(uint64_t hash, skb_attribute_set_t attributes)
+static uint64_t skb__attributes_hash_append(uint64_t hash, skb_attribute_set_t attributes, bool include_paint)
 {
 	if (attributes.parent_set)
-		hash = skb_attributes_hash_append(hash, *attributes.parent_set);
+		hash = skb__attributes_hash_append(hash, *attributes.parent_set, include_paint);
 
 	if (attributes.set_handle)
 		hash = skb_hash64_append(hash, &attributes.set_handle, sizeof(skb_attribute_set_handle_t));
 
 	// Note: The attributes are zero initialized (including padding)
-	for (int32_t i = 0; i < attributes.attributes_count; i++)
-		hash = skb_hash64_append(hash, &attributes.attributes[i], sizeof(skb_attribute_t));
+	for (int32_t i = 0; i < attributes.attributes_count; i++) {
+		if (attributes.attributes[i].kind == SKB_ATTRIBUTE_LANG) {
+			// Hash the language tag instead of the interned pointer, so that the hash is stable across runs (used as layout snapshot key).
+			hash = skb_hash64_append_uint32(hash, attributes.attributes[i].kind);
+			hash = skb_hash64_append_str(hash, attributes.attributes[i].lang.lang ? attributes.attributes[i].lang.lang : "");
+		} else if (!include_paint && attributes.attributes[i].kind == SKB_ATTRIBUTE_PAINT && attributes.attributes[i].paint.paint_tag != SKB_PAINT_TEXT_BACKGROUND) {
+			// Only the structure of the paint is hashed, the color and paint id can be updated without relayout.
+			// Text background paints are compared when the background decorations are built, and are hashed fully.
+			hash = skb_hash64_append_uint32(hash, attributes.attributes[i].kind);
+			hash = skb_hash64_append_uint32(hash, attributes.attributes[i].paint.paint_tag);
+			hash = skb_hash64_append_uint32(hash, attributes.attributes[i].paint.state);
+		} else {
+			hash = skb_hash64_append(hash, &attributes.attributes[i], sizeof(skb_attribute_t));
+		}
+	}
 
 	return hash;
 }
+
+uint64_t skb_attributes_hash_append(uint64_t hash, skb_attribute_set_t attributes)
+{
+	return skb__attributes_hash_append(hash, attributes, true);
+}
+
+uint64_t skb_attributes_hash_append_without_paint(uint64_t hash, skb_attribute_set_t attributes)
+{
+	return skb__attributes_hash_append(hash, attributes, false);
+}
@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: MIT
 
 #include "skb_canvas.h"
+#include "skb_canvas_internal.h"
 #include "skb_common.h"
 
 #include <assert.h>
@@ -16,72 +17,6 @@
 #define SKB_FIX				(1 << SKB_FIXSHIFT)
 #define SKB_FIXMASK			(SKB_FIX-1)
 
-typedef struct skb_image_layer_t {
-	skb_color_t* buffer;
-	int32_t stride;
-} skb_image_layer_t;
-
-typedef struct skb_mask_t {
-	uint8_t* buffer;
-	int32_t stride;
-	skb_rect2i_t region;
-} skb_mask_t;
-
-typedef struct skb_edge_t {
-	float x0,y0, x1,y1;
-	int dir;
-} skb_edge_t;
-
-typedef struct skb_active_edge_t {
-	int x,dx;
-	float ey;
-	int dir;
-	struct skb_active_edge_t *next;
-} skb_active_edge_t;
-
-typedef struct skb_canvas_t {
-	uint8_t* scanline;
-	int32_t width;
-	int32_t height;
-	uint8_t bpp;
-
-	skb_vec2_t start_pt;	// path start
-	skb_vec2_t pen_pt;	// current pen position
-
-	skb_vec2_t* points;
-	int32_t points_count;
-	int32_t points_cap;
-	int32_t degenerate_path_count;
-
-	skb_rect2_t points_bounds;
-
-	skb_edge_t* edges;
-	int32_t edges_count;
-	int32_t edges_cap;
-
-	skb_active_edge_t* active_edges;
-	int32_t active_edges_count;
-	int32_t active_edges_cap;
-	skb_active_edge_t* freelist;
-
-	skb_image_layer_t* layers;
-	int32_t layers_count;
-	int32_t layers_cap;
-
-	skb_mask_t* masks;
-	int32_t masks_count;
-	int32_t masks_cap;
-
-	skb_mat2_t* transform_stack;
-	int32_t transform_stack_count;
-	int32_t transform_stack_cap;
-
-	skb_image_t* target;
-
-	skb_temp_alloc_t* alloc;
-	skb_temp_alloc_mark_t mark;
-} skb_canvas_t;
-
 
 static void skb_path_add_point_(skb_canvas_t* c, skb_vec2_t pt)
 {
@@ -134,30 +69,132 @@ static void skb_add_edge_(skb_canvas_t* c, float x0, float y0, float x1, float y
 	}
 }
 
-static void skb_path_tess_cubic_bezier_(skb_canvas_t* c, const skb_vec2_t p0, const skb_vec2_t p1, const skb_vec2_t p2, const skb_vec2_t p3, const int level, const float dist_tol_sqr)
+#define SKB_CUBIC_TO_QUAD_TOL		0.1f	// Portion of the tolerance spent on approximating cubics with quadratics.
+#define SKB_MAX_CURVE_SEGMENTS		1024
+#define SKB_MAX_CUBIC_QUADS			32
+
+// Approximations of the arc length integral of the basic parabola y = x^2 and its inverse,
+// see "Flattening quadratic Béziers" by Raph Levien.
+static inline float skb__approx_parabola_integral(float x)
 {
-	if (level > 10) return;
+	static const float d = 0.67f;
+	return x / (1.f - d + sqrtf(sqrtf(d*d*d*d + 0.25f * x*x)));
+}
 
-	const skb_vec2_t d30 = skb_vec2_sub(p3, p0);
-	const skb_vec2_t d13 = skb_vec2_sub(p1, p3);
-	const skb_vec2_t d23 = skb_vec2_sub(p2, p3);
-	const float d2 = skb_absf(d13.x * d30.y - d13.y * d30.x);
-	const float d3 = skb_absf(d23.x * d30.y - d23.y * d30.x);
+static inline float skb__approx_parabola_inv_integral(float x)
+{
+	static const float b = 0.39f;
+	return x * (1.f - b + sqrtf(b*b + 0.25f * x*x));
+}
 
-	if ((d2 + d3)*(d2 + d3) < dist_tol_sqr * (d30.x*d30.x + d30.y*d30.y)) {
-		skb_path_add_point_(c, p3);
+static void skb_path_flatten_quad_bezier_(skb_canvas_t* c, const skb_vec2_t p0, const skb_vec2_t p1, const skb_vec2_t p2, const float tol)
+{
+	// Map the curve to a segment of the basic parabola.
+	const float ddx = 2.f * p1.x - p0.x - p2.x;
+	const float ddy = 2.f * p1.y - p0.y - p2.y;
+	const float cross = (p2.x - p0.x) * ddy - (p2.y - p0.y) * ddx;
+
+	// Straight line, or the control point is on the line.
+	if (skb_absf(cross) < 1e-6f) {
+		skb_path_add_point_(c, p2);
 		return;
 	}
 
-	const skb_vec2_t p01 = skb_vec2_lerp(p0, p1, 0.5f);
-	const skb_vec2_t p12 = skb_vec2_lerp(p1, p2, 0.5f);
-	const skb_vec2_t p23 = skb_vec2_lerp(p2, p3, 0.5f);
-	const skb_vec2_t p012 = skb_vec2_lerp(p01, p12, 0.5f);
-	const skb_vec2_t p123 = skb_vec2_lerp(p12, p23, 0.5f);
-	const skb_vec2_t p0123 = skb_vec2_lerp(p012, p123, 0.5f);
+	const float u0 = (p1.x - p0.x) * ddx + (p1.y - p0.y) * ddy;
+	const float u2 = (p2.x - p1.x) * ddx + (p2.y - p1.y) * ddy;
+	const float x0 = u0 / cross;
+	const float x2 = u2 / cross;
+	const float scale = skb_absf(cross) / (sqrtf(ddx*ddx + ddy*ddy) * skb_absf(x2 - x0));
+
+	// The subdivisions are spaced evenly along the integral, which gives the number of segments needed for the tolerance directly.
+	const float sqrt_tol = sqrtf(tol);
+	const float a0 = skb__approx_parabola_integral(x0);
+	const float a2 = skb__approx_parabola_integral(x2);
+	const float da = skb_absf(a2 - a0);
+	const float sqrt_scale = sqrtf(scale);
+	float val = 0.f;
+	if ((x0 < 0.f) == (x2 < 0.f)) {
+		val = da * sqrt_scale;
+	} else {
+		// The segment contains the cusp of the parabola.
+		const float x_min = sqrt_tol / sqrt_scale;
+		val = sqrt_tol * da / skb__approx_parabola_integral(x_min);
+	}
+	const float segments = ceilf(0.5f * val / sqrt_tol);
+	const int32_t n = segments < (float)SKB_MAX_CURVE_SEGMENTS ? skb_maxi((int32_t)segments, 1) : SKB_MAX_CURVE_SEGMENTS;
+
+	const float pu0 = skb__approx_parabola_inv_integral(a0);
+	const float pu2 = skb__approx_parabola_inv_integral(a2);
+	const float u_scale = 1.f / (pu2 - pu0);
+	const float step = 1.f / (float)n;
+
+	for (int32_t i = 1; i < n; i++) {
+		const float a = a0 + (a2 - a0) * ((float)i * step);
+		const float t = (skb__approx_parabola_inv_integral(a) - pu0) * u_scale;
+		const float mt = 1.f - t;
+		const skb_vec2_t pt = {
+			.x = mt*mt * p0.x + 2.f*mt*t * p1.x + t*t * p2.x,
+			.y = mt*mt * p0.y + 2.f*mt*t * p1.y + t*t * p2.y,
+		};
+		skb_path_add_point_(c, pt);
+	}
+	skb_path_add_point_(c, p2);
+}
 
-	skb_path_tess_cubic_bezier_(c, p0, p01, p012, p0123, level+1, dist_tol_sqr);
-	skb_path_tess_cubic_bezier_(c, p0123, p123, p23, p3, level+1, dist_tol_sqr);
+static inline skb_vec2_t skb__cubic_bezier_eval(const skb_vec2_t p0, const skb_vec2_t p1, const skb_vec2_t p2, const skb_vec2_t p3, const float t)
+{
+	const float mt = 1.f - t;
+	const float w0 = mt*mt*mt;
+	const float w1 = 3.f * mt*mt*t;
+	const float w2 = 3.f * mt*t*t;
+	const float w3 = t*t*t;
+	return (skb_vec2_t) {
+		.x = w0 * p0.x + w1 * p1.x + w2 * p2.x + w3 * p3.x,
+		.y = w0 * p0.y + w1 * p1.y + w2 * p2.y + w3 * p3.y,
+	};
+}
+
+static inline skb_vec2_t skb__cubic_bezier_deriv(const skb_vec2_t p0, const skb_vec2_t p1, const skb_vec2_t p2, const skb_vec2_t p3, const float t)
+{
+	const float mt = 1.f - t;
+	const float w0 = 3.f * mt*mt;
+	const float w1 = 6.f * mt*t;
+	const float w2 = 3.f * t*t;
+	return (skb_vec2_t) {
+		.x = w0 * (p1.x - p0.x) + w1 * (p2.x - p1.x) + w2 * (p3.x - p2.x),
+		.y = w0 * (p1.y - p0.y) + w1 * (p2.y - p1.y) + w2 * (p3.y - p2.y),
+	};
+}
+
+static void skb_path_flatten_cubic_bezier_(skb_canvas_t* c, const skb_vec2_t p0, const skb_vec2_t p1, const skb_vec2_t p2, const skb_vec2_t p3, const float tol)
+{
+	// Approximate the cubic with quadratics, and flatten those. The error of the quadratic approximation
+	// is sqrt(3)/36 * |p3 - 3*p2 + 3*p1 - p0|, and it drops with the cube of number of subdivisions.
+	const float quad_tol = tol * SKB_CUBIC_TO_QUAD_TOL;
+	const float ddx = p3.x - 3.f * p2.x + 3.f * p1.x - p0.x;
+	const float ddy = p3.y - 3.f * p2.y + 3.f * p1.y - p0.y;
+	const float err = (sqrtf(3.f) / 36.f) * sqrtf(ddx*ddx + ddy*ddy);
+	const float quads = ceilf(cbrtf(err / quad_tol));
+	const int32_t n = quads < (float)SKB_MAX_CUBIC_QUADS ? skb_maxi((int32_t)quads, 1) : SKB_MAX_CUBIC_QUADS;
+	const float step = 1.f / (float)n;
+
+	skb_vec2_t q0 = p0;
+	skb_vec2_t d0 = skb__cubic_bezier_deriv(p0, p1, p2, p3, 0.f);
+	for (int32_t i = 1; i <= n; i++) {
+		const float t = (float)i * step;
+		const skb_vec2_t q3 = i == n ? p3 : skb__cubic_bezier_eval(p0, p1, p2, p3, t);
+		const skb_vec2_t d3 = skb__cubic_bezier_deriv(p0, p1, p2, p3, t);
+		// Control points of the sub-curve, and quadratic control point which best matches them.
+		const skb_vec2_t c1 = skb_vec2_mad(q0, d0, step / 3.f);
+		const skb_vec2_t c2 = skb_vec2_mad(q3, d3, -step / 3.f);
+		const skb_vec2_t qc = {
+			.x = (3.f * (c1.x + c2.x) - q0.x - q3.x) * 0.25f,
+			.y = (3.f * (c1.y + c2.y) - q0.y - q3.y) * 0.25f,
+		};
+		skb_path_flatten_quad_bezier_(c, q0, qc, q3, tol - quad_tol);
+		q0 = q3;
+		d0 = d3;
+	}
 }
 
 // Used for debugging.
@@ -232,28 +269,20 @@ void skb_canvas_line_to(skb_canvas_t* c, skb_vec2_t pt)
 
 void skb_canvas_quad_to(skb_canvas_t* c, skb_vec2_t cp, skb_vec2_t pt)
 {
-	static const float dist_tol_sqr = 0.5f * 0.5f;
-
 	cp = skb_mat2_point(c->transform_stack[c->transform_stack_count-1], cp);
 	pt = skb_mat2_point(c->transform_stack[c->transform_stack_count-1], pt);
 
-	// Convert to cubic bezier
-	const skb_vec2_t cp0 = skb_vec2_mad(c->pen_pt, skb_vec2_sub(cp, c->pen_pt), 2.f/3.f);
-	const skb_vec2_t cp1 = skb_vec2_mad(pt, skb_vec2_sub(cp, pt), 2.f/3.f);
-
-	skb_path_tess_cubic_bezier_(c, c->pen_pt, cp0, cp1, pt, 0, dist_tol_sqr);
+	skb_path_flatten_quad_bezier_(c, c->pen_pt, cp, pt, SKB_CURVE_TOL);
 	c->pen_pt = pt;
 }
 
 void skb_canvas_cubic_to(skb_canvas_t* c, skb_vec2_t cp0, skb_vec2_t cp1, skb_vec2_t pt)
 {
-	static const float dist_tol_sqr = 0.5f * 0.5f;
-
 	cp0 = skb_mat2_point(c->transform_stack[c->transform_stack_count-1], cp0);
 	cp1 = skb_mat2_point(c->transform_stack[c->transform_stack_count-1], cp1);
 	pt = skb_mat2_point(c->transform_stack[c->transform_stack_count-1], pt);
 
-	skb_path_tess_cubic_bezier_(c, c->pen_pt, cp0, cp1, pt, 0, dist_tol_sqr);
+	skb_path_flatten_cubic_bezier_(c, c->pen_pt, cp0, cp1, pt, SKB_CURVE_TOL);
 	c->pen_pt = pt;
 }
 
@@ -564,10 +593,12 @@ void skb_canvas_push_mask(skb_canvas_t* c)
 	skb_mask_t* cur_mask = c->masks_count > 0 ? &c->masks[c->masks_count-1] : NULL;
 	skb_mask_t* mask = &c->masks[c->masks_count++];
 
-	if (!mask->buffer) {
-		mask->buffer = SKB_TEMP_ALLOC(c->alloc, uint8_t, c->width * c->height);
-		mask->stride = c->width;
+	if (c->width * c->height > mask->owned_buffer_cap) {
+		mask->owned_buffer_cap = c->width * c->height;
+		mask->owned_buffer = SKB_TEMP_REALLOC(c->alloc, mask->owned_buffer, uint8_t, mask->owned_buffer_cap);
 	}
+	mask->buffer = mask->owned_buffer;
+	mask->stride = c->width;
 
 	if (cur_mask) {
 		// Inherit mask
@@ -602,10 +633,12 @@ void skb_canvas_push_layer(skb_canvas_t* c)
 	SKB_TEMP_RESERVE(c->alloc, c->layers, c->layers_count+1);
 	skb_image_layer_t* layer = &c->layers[c->layers_count++];
 
-	if (!layer->buffer) {
-		layer->buffer = SKB_TEMP_ALLOC(c->alloc, skb_color_t, c->width * c->height);
-		layer->stride = c->width;
+	if (c->width * c->height > layer->owned_buffer_cap) {
+		layer->owned_buffer_cap = c->width * c->height;
+		layer->owned_buffer = SKB_TEMP_REALLOC(c->alloc, layer->owned_buffer, skb_color_t, layer->owned_buffer_cap);
 	}
+	layer->buffer = layer->owned_buffer;
+	layer->stride = c->width;
 
 	skb_canvas_push_mask(c);
 
@@ -1042,26 +1075,20 @@ void skb_canvas_fill_radial_gradient(skb_canvas_t* c, skb_vec2_t p0, float r0, s
 	}
 }
 
-skb_canvas_t* skb_canvas_create(skb_temp_alloc_t* alloc, skb_image_t* target)
+static void skb__canvas_init_target(skb_canvas_t* c, skb_image_t* target)
 {
-	assert(alloc);
 	assert(target->width > 0 && target->height > 0);
 	assert(target->bpp == 1 || target->bpp == 4);
 
-	skb_temp_alloc_mark_t mark = skb_temp_alloc_save(alloc);
-
-	skb_canvas_t* c = SKB_TEMP_ALLOC(alloc, skb_canvas_t, 1);
-	memset(c, 0, sizeof(skb_canvas_t));
-
-	c->alloc = alloc;
-	c->mark = mark;
-
 	c->width = target->width;
 	c->height = target->height;
 	c->bpp = target->bpp;
 	c->target = target;
 
-	c->scanline = SKB_TEMP_ALLOC(c->alloc, uint8_t, c->width);
+	if (c->width > c->scanline_cap) {
+		c->scanline_cap = c->width;
+		c->scanline = SKB_TEMP_ALLOC(c->alloc, uint8_t, c->scanline_cap);
+	}
 
 	c->points_bounds = skb_rect2_make_undefined();
 
@@ -1099,10 +1126,44 @@ skb_canvas_t* skb_canvas_create(skb_temp_alloc_t* alloc, skb_image_t* target)
 		mask->region.width = c->width;
 		mask->region.height = c->height;
 	}
+}
+
+skb_canvas_t* skb_canvas_create(skb_temp_alloc_t* alloc, skb_image_t* target)
+{
+	assert(alloc);
+
+	skb_temp_alloc_mark_t mark = skb_temp_alloc_save(alloc);
+
+	skb_canvas_t* c = SKB_TEMP_ALLOC(alloc, skb_canvas_t, 1);
+	memset(c, 0, sizeof(skb_canvas_t));
+
+	c->alloc = alloc;
+	c->mark = mark;
+
+	skb__canvas_init_target(c, target);
 
 	return c;
 }
 
+void skb_canvas_reset(skb_canvas_t* c, skb_image_t* target)
+{
+	assert(c);
+
+	// Clear the drawing state, the allocated arrays and buffers are kept.
+	c->start_pt = (skb_vec2_t){0};
+	c->pen_pt = (skb_vec2_t){0};
+	c->points_count = 0;
+	c->degenerate_path_count = 0;
+	c->edges_count = 0;
+	c->active_edges_count = 0;
+	c->freelist = NULL;
+	c->layers_count = 0;
+	c->masks_count = 0;
+	c->transform_stack_count = 0;
+
+	skb__canvas_init_target(c, target);
+}
+
 void skb_canvas_destroy(skb_canvas_t* c)
 {
 	if (!c) return;
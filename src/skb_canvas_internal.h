@@ -0,0 +1,85 @@
+// SPDX-FileCopyrightText: 2025 Mikko Mononen
+// SPDX-License-Identifier: MIT
+
+#ifndef SKB_CANVAS_INTERNAL_H
+#define SKB_CANVAS_INTERNAL_H
+
+#include <stdint.h>
+
+#include "skb_canvas.h"
+
+// Curves are flattened after they have been transformed to canvas space, so the tolerance is in pixels regardless of the transform.
+#define SKB_CURVE_TOL				0.25f	// Max distance in pixels between the flattened curve and the true curve.
+
+typedef struct skb_image_layer_t {
+	skb_color_t* buffer;				// Points to owned_buffer, or to the target image.
+	int32_t stride;
+	skb_color_t* owned_buffer;			// Buffer allocated by the canvas, retained when the canvas is reset.
+	int32_t owned_buffer_cap;
+} skb_image_layer_t;
+
+typedef struct skb_mask_t {
+	uint8_t* buffer;					// Points to owned_buffer, or to the target image.
+	int32_t stride;
+	skb_rect2i_t region;
+	uint8_t* owned_buffer;				// Buffer allocated by the canvas, retained when the canvas is reset.
+	int32_t owned_buffer_cap;
+} skb_mask_t;
+
+typedef struct skb_edge_t {
+	float x0,y0, x1,y1;
+	int dir;
+} skb_edge_t;
+
+typedef struct skb_active_edge_t {
+	int x,dx;
+	float ey;
+	int dir;
+	struct skb_active_edge_t *next;
+} skb_active_edge_t;
+
+typedef struct skb_canvas_t {
+	uint8_t* scanline;
+	int32_t scanline_cap;
+	int32_t width;
+	int32_t height;
+	uint8_t bpp;
+
+	skb_vec2_t start_pt;	// path start
+	skb_vec2_t pen_pt;	// current pen position
+
+	skb_vec2_t* points;
+	int32_t points_count;
+	int32_t points_cap;
+	int32_t degenerate_path_count;
+
+	skb_rect2_t points_bounds;
+
+	skb_edge_t* edges;
+	int32_t edges_count;
+	int32_t edges_cap;
+
+	skb_active_edge_t* active_edges;
+	int32_t active_edges_count;
+	int32_t active_edges_cap;
+	skb_active_edge_t* freelist;
+
+	skb_image_layer_t* layers;
+	int32_t layers_count;
+	int32_t layers_cap;
+
+	skb_mask_t* masks;
+	int32_t masks_count;
+	int32_t masks_cap;
+
+	skb_mat2_t* transform_stack;
+	int32_t transform_stack_count;
+	int32_t transform_stack_cap;
+
+	skb_image_t* target;
+
+	skb_temp_alloc_t* alloc;
+	skb_temp_alloc_mark_t mark;
+} skb_canvas_t;
+
+#endif // SKB_CANVAS_INTERNAL_H
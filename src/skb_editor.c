@@ -50,6 +50,16 @@ typedef struct skb__editor_undo_transaction_t {
 	skb_text_range_t selection_after;	// Selection after at the change (at the point of undo).
 } skb__editor_undo_transaction_t;
 
+// Selection with its ordered offsets, used for merging selections.
+typedef struct skb__selection_merge_item_t {
+	skb_text_position_t first;	// Position with smaller offset.
+	skb_text_position_t last;	// Position with larger offset.
+	int32_t first_offset;
+	int32_t last_offset;
+	bool is_forward;			// True if the selection start is first.
+	bool is_main;				// True if the item is the current selection.
+} skb__selection_merge_item_t;
+
 typedef struct skb_editor_t {
 	skb_editor_params_t params;
 
@@ -111,12 +121,127 @@ typedef struct skb_editor_t {
 	int32_t undo_states_cap;					// Allocated space for the undo stack.
 
 	int32_t in_undo_transaction;
+
+	// Secondary selections, edited together with the selection, see skb_editor_insert_text_utf32_at_selections().
+	// The selections are kept in text order, and do not overlap or touch each other or the current selection.
+	skb_text_range_t* secondary_selections;
+	int32_t secondary_selections_count;
+	int32_t secondary_selections_cap;
+	skb__selection_merge_item_t* selection_merge_items;	// Scratch space for merging selections.
+	int32_t selection_merge_items_cap;
+	bool is_inserting_at_selections;	// True during skb_editor_insert_text_utf32_at_selections(), which adjusts the secondary selections itself.
+
+	// Batch
+	int32_t batch_depth;					// Nesting depth of skb_editor_begin_batch().
+	uint8_t pending_updates;				// Updates deferred until the end of the batch, or until the layout is updated, see skb__pending_update_t.
+	skb_editor_text_change_reason_t batch_text_change_reason;			// Reason of the first deferred text change.
+	skb_editor_selection_change_reason_t batch_selection_change_reason;	// Reason of the first deferred selection change.
+
+	// Input recording, see skb_editor_begin_input_recording().
+	uint8_t* input_recording;
+	int32_t input_recording_count;
+	int32_t input_recording_cap;
+	bool is_recording_input;
+
+	// Profiling, enabled during skb_editor_replay_input().
+	bool is_profiling;
+	int64_t profile_ticks[3];				// Accumulated performance timer ticks, see skb__profile_counter_t.
 } skb_editor_t;
 
+// Updates deferred during batch, see skb_editor_begin_batch(), or until layout update, see skb_editor_params_t.defer_layout.
+typedef enum {
+	SKB__PENDING_LAYOUT = 1 << 0,
+	SKB__PENDING_ACTIVE_ATTRIBUTES = 1 << 1,
+	SKB__PENDING_TEXT_CHANGE = 1 << 2,
+	SKB__PENDING_SELECTION_CHANGE = 1 << 3,
+	SKB__PENDING_CARET_VISIBLE = 1 << 4,
+} skb__pending_update_t;
+
+// Time spent in different parts of the editor, see skb_editor_replay_input().
+typedef enum {
+	SKB__PROFILE_TEXT = 0,
+	SKB__PROFILE_LAYOUT,
+	SKB__PROFILE_UNDO,
+} skb__profile_counter_t;
+
+// The profiling of the editor internals is compiled in only when SKB_EDITOR_PROFILE is defined, to keep it out of the hot paths.
+#ifdef SKB_EDITOR_PROFILE
+static int64_t skb__profile_begin(const skb_editor_t* editor)
+{
+	return editor->is_profiling ? skb_perf_timer_get() : 0;
+}
+
+static void skb__profile_end(skb_editor_t* editor, skb__profile_counter_t counter, int64_t start)
+{
+	if (editor->is_profiling)
+		editor->profile_ticks[counter] += skb_perf_timer_get() - start;
+}
+#else
+static inline int64_t skb__profile_begin(const skb_editor_t* editor)
+{
+	(void)editor;
+	return 0;
+}
+
+static inline void skb__profile_end(skb_editor_t* editor, skb__profile_counter_t counter, int64_t start)
+{
+	(void)editor;
+	(void)counter;
+	(void)start;
+}
+#endif // SKB_EDITOR_PROFILE
+
+// Recorded input event, followed by args_size bytes of arguments and data_size bytes of data.
+typedef struct skb__input_event_header_t {
+	uint8_t type;			// See skb_editor_input_type_t.
+	int32_t args_size;
+	int32_t data_size;
+} skb__input_event_header_t;
+
+// Arguments of the recorded input events. The args are zeroed before recording, so that the padding does not make the recording non-deterministic.
+typedef struct skb__input_args_key_t {
+	uint32_t key;
+	uint32_t mods;
+} skb__input_args_key_t;
+
+typedef struct skb__input_args_mouse_t {
+	float x;
+	float y;
+	uint32_t mods;
+	double time;
+} skb__input_args_mouse_t;
+
+typedef struct skb__input_args_range_t {
+	skb_text_range_t text_range;
+} skb__input_args_range_t;
+
+typedef struct skb__input_args_codepoint_t {
+	skb_text_range_t text_range;
+	uint32_t codepoint;
+} skb__input_args_codepoint_t;
+
+// Language tag of a SKB_ATTRIBUTE_LANG attribute is stored in the event data.
+typedef struct skb__input_args_attribute_t {
+	skb_text_range_t text_range;
+	skb_attribute_t attribute;
+} skb__input_args_attribute_t;
+
+typedef struct skb__input_args_composition_t {
+	int32_t caret_position;
+} skb__input_args_composition_t;
+
+typedef struct skb__input_args_commit_t {
+	int32_t use_composition_text;
+} skb__input_args_commit_t;
+
 // fwd decl
+static void skb__record_input(skb_editor_t* editor, skb_editor_input_type_t type, const void* args, int32_t args_size, const void* data, int32_t data_size);
+static void skb__record_input_attribute(skb_editor_t* editor, skb_editor_input_type_t type, skb_text_range_t text_range, skb_attribute_t attribute);
 static void skb__reset_undo(skb_editor_t* editor);
 static int32_t skb__capture_undo_text_begin(skb_editor_t* editor, skb_text_range_t text_range, const skb_rich_text_t* rich_text, bool allow_amend_undo);
 static void skb__capture_undo_text_end(skb_editor_t* editor, int32_t transaction_id);
+static bool skb__are_paragraphs_in_sync(const skb_editor_t* editor);
+static void skb__pick_active_attributes(skb_editor_t* editor);
 
 static skb_text_position_t skb__resolve_text_position(const skb_editor_t* editor, skb_text_position_t text_pos)
 {
@@ -159,8 +284,19 @@ static void skb__editor_clamp_view_offset(skb_editor_t* editor)
 	editor->view_offset.y = skb_clampf(editor->view_offset.y, -view_offset_max_y, 0.f);
 }
 
+// Returns true if updates depending on the layout should be deferred.
+static bool skb__is_layout_deferred(const skb_editor_t* editor)
+{
+	return editor->batch_depth > 0 || (editor->pending_updates & SKB__PENDING_LAYOUT);
+}
+
 static void skb__ensure_caret_visible(skb_editor_t* editor)
 {
+	if (skb__is_layout_deferred(editor)) {
+		editor->pending_updates |= SKB__PENDING_CARET_VISIBLE;
+		return;
+	}
+
 	skb_rect2_t view_bounds = skb_editor_get_view_bounds(editor);
 	const skb_caret_info_t caret_info = skb_editor_get_caret_info_at(editor, SKB_CURRENT_SELECTION_END);
 	const skb_rect2_t content_bounds = skb_rich_layout_get_bounds(&editor->rich_layout);
@@ -198,12 +334,10 @@ static void skb__ensure_caret_visible(skb_editor_t* editor)
 	}
 }
 
-static void skb__update_layout(skb_editor_t* editor, skb_temp_alloc_t* temp_alloc, skb_rich_text_change_t change)
+static void skb__relayout(skb_editor_t* editor, skb_temp_alloc_t* temp_alloc)
 {
 	assert(editor);
 
-	skb_rich_layout_apply_change(&editor->rich_layout, change);
-
 	skb_layout_params_t layout_params = {0}; //editor->params.layout_params;
 	layout_params.attribute_collection = editor->params.attribute_collection;
 	layout_params.font_collection = editor->params.font_collection;
@@ -213,7 +347,9 @@ static void skb__update_layout(skb_editor_t* editor, skb_temp_alloc_t* temp_allo
 	layout_params.layout_attributes = editor->params.layout_attributes;
 	layout_params.flags |= SKB_LAYOUT_PARAMS_IGNORE_MUST_LINE_BREAKS | SKB_LAYOUT_PARAMS_IGNORE_OVERFLOW;
 
+	const int64_t layout_profile_start = skb__profile_begin(editor);
 	skb_rich_layout_set_from_rich_text(&editor->rich_layout, temp_alloc, &layout_params, &editor->rich_text, editor->composition_text_offset, &editor->composition_text);
+	skb__profile_end(editor, SKB__PROFILE_LAYOUT, layout_profile_start);
 
 	// Make sure the selection conforms the new layout.
 	skb_paragraph_position_t selection_start_pos = skb_rich_text_get_paragraph_position_from_text_position(&editor->rich_text, editor->selection.start, SKB_AFFINITY_IGNORE);
@@ -221,10 +357,50 @@ static void skb__update_layout(skb_editor_t* editor, skb_temp_alloc_t* temp_allo
 	editor->selection.start.offset = selection_start_pos.global_text_offset;
 	editor->selection.end.offset = selection_end_pos.global_text_offset;
 
+	for (int32_t i = 0; i < editor->secondary_selections_count; i++) {
+		skb_text_range_t* selection = &editor->secondary_selections[i];
+		selection->start.offset = skb_rich_text_get_paragraph_position_from_text_position(&editor->rich_text, selection->start, SKB_AFFINITY_IGNORE).global_text_offset;
+		selection->end.offset = skb_rich_text_get_paragraph_position_from_text_position(&editor->rich_text, selection->end, SKB_AFFINITY_IGNORE).global_text_offset;
+	}
+
 	// Make sure the view offset is in bounds.
 	skb__editor_clamp_view_offset(editor);
 }
 
+static void skb__update_layout(skb_editor_t* editor, skb_temp_alloc_t* temp_alloc, skb_rich_text_change_t change)
+{
+	assert(editor);
+
+	// Keep the paragraphs in sync with the text. Paragraphs which have not changed are reused by the relayout.
+	skb_rich_layout_apply_change(&editor->rich_layout, change);
+
+	// Defer the relayout during batch, or in deferred layout mode.
+	// If the whole text was replaced, the paragraphs are out of sync and we need to relayout immediately.
+	if ((editor->batch_depth > 0 || editor->params.defer_layout) && skb__are_paragraphs_in_sync(editor)) {
+		// Remap the stale layout to the new paragraph text offsets, so that queries on unchanged paragraphs stay valid until the relayout.
+		skb_rich_layout_sync_text_offsets(&editor->rich_layout, &editor->rich_text);
+		editor->pending_updates |= SKB__PENDING_LAYOUT;
+		return;
+	}
+
+	editor->pending_updates &= ~SKB__PENDING_LAYOUT;
+	skb__relayout(editor, temp_alloc);
+}
+
+// Applies the deferred relayout, and the updates depending on it.
+static void skb__update_deferred_layout(skb_editor_t* editor, skb_temp_alloc_t* temp_alloc)
+{
+	const uint8_t pending = editor->pending_updates;
+	editor->pending_updates &= ~(SKB__PENDING_LAYOUT | SKB__PENDING_ACTIVE_ATTRIBUTES | SKB__PENDING_CARET_VISIBLE);
+
+	if (pending & SKB__PENDING_LAYOUT)
+		skb__relayout(editor, temp_alloc);
+	if (pending & SKB__PENDING_ACTIVE_ATTRIBUTES)
+		skb__pick_active_attributes(editor);
+	if (pending & SKB__PENDING_CARET_VISIBLE)
+		skb__ensure_caret_visible(editor);
+}
+
 static const skb_layout_t* skb__get_layout(const skb_editor_t* editor, int32_t paragraph_idx)
 {
 	return skb_rich_layout_get_layout(&editor->rich_layout, paragraph_idx);
@@ -250,6 +426,15 @@ static int32_t skb__get_global_text_offset(const skb_editor_t* editor, int32_t p
 	return skb_rich_text_get_paragraph_text_offset(&editor->rich_text, paragraph_idx);
 }
 
+// In deferred layout mode the layout of a changed paragraph can be stale, and positions derived from it may point past the end of the paragraph text.
+static skb_text_position_t skb__clamp_to_paragraph_content(const skb_editor_t* editor, int32_t paragraph_idx, skb_text_position_t text_pos)
+{
+	if (!(editor->pending_updates & SKB__PENDING_LAYOUT))
+		return text_pos;
+	const skb_text_position_t content_end_pos = skb_editor_get_paragraph_content_end_pos(editor, paragraph_idx);
+	return text_pos.offset > content_end_pos.offset ? content_end_pos : text_pos;
+}
+
 static skb_attribute_set_t skb__get_paragraph_attributes(const skb_editor_t* editor, int32_t paragraph_idx)
 {
 	return skb_rich_text_get_paragraph_attributes(&editor->rich_text, paragraph_idx);
@@ -303,12 +488,12 @@ static void skb__update_preview_caret(skb_editor_t* editor)
 		const skb_weight_t font_weight = skb_attributes_get_font_weight(active_attributes, editor->params.attribute_collection);
 		const skb_style_t font_style = skb_attributes_get_font_style(active_attributes, editor->params.attribute_collection);
 		const skb_stretch_t font_stretch = skb_attributes_get_font_stretch(active_attributes, editor->params.attribute_collection);
+		// The language tag is already canonicalized by skb_attribute_make_lang().
 		const char* lang = skb_attributes_get_lang(active_attributes, editor->params.attribute_collection);
-		const hb_language_t run_lang = hb_language_from_string(lang, -1);
 
 		skb_font_handle_t font_handles[32];
 		int32_t fonts_count = skb_font_collection_match_fonts(
-			editor->params.font_collection, hb_language_to_string(run_lang), script, font_family,
+			editor->params.font_collection, lang, script, font_family,
 			font_weight, font_style, font_stretch,
 			font_handles, SKB_COUNTOF(font_handles));
 
@@ -343,6 +528,12 @@ static bool skb__attribute_span_contains(const skb_attribute_span_t* attribute_s
 
 static void skb__pick_active_attributes(skb_editor_t* editor)
 {
+	// The picking relies on the layout, defer until the layout is up to date.
+	if (skb__is_layout_deferred(editor)) {
+		editor->pending_updates |= SKB__PENDING_ACTIVE_ATTRIBUTES;
+		return;
+	}
+
 	// Pick the active attributes from the text before the cursor.
 	skb_text_position_t caret_pos = skb__resolve_text_position(editor, editor->selection.end);
 	const skb_paragraph_position_t caret_paragraph_pos = skb_rich_text_get_paragraph_position_from_text_position(&editor->rich_text, caret_pos, SKB_AFFINITY_USE);
@@ -371,12 +562,24 @@ static void skb__pick_active_attributes(skb_editor_t* editor)
 
 static void skb__emit_on_text_change(skb_editor_t* editor, skb_editor_text_change_reason_t reason)
 {
+	if (editor->batch_depth > 0) {
+		if (!(editor->pending_updates & SKB__PENDING_TEXT_CHANGE))
+			editor->batch_text_change_reason = reason;
+		editor->pending_updates |= SKB__PENDING_TEXT_CHANGE;
+		return;
+	}
 	if (editor->on_text_change_callback)
 		editor->on_text_change_callback(editor, reason, editor->on_text_change_context);
 }
 
 static void skb__emit_on_selection_change(skb_editor_t* editor, skb_editor_selection_change_reason_t reason)
 {
+	if (editor->batch_depth > 0) {
+		if (!(editor->pending_updates & SKB__PENDING_SELECTION_CHANGE))
+			editor->batch_selection_change_reason = reason;
+		editor->pending_updates |= SKB__PENDING_SELECTION_CHANGE;
+		return;
+	}
 	if (editor->on_selection_change_callback)
 		editor->on_selection_change_callback(editor, reason, editor->on_text_change_context);
 }
@@ -519,11 +722,15 @@ void skb_editor_destroy(skb_editor_t* editor)
 
 	skb_free(editor->attributes);
 	skb_free(editor->active_attributes);
+	skb_free(editor->secondary_selections);
+	skb_free(editor->selection_merge_items);
 
 	skb__reset_undo(editor);
 	skb_free(editor->undo_stack);
 	skb_free(editor->undo_states);
 
+	skb_free(editor->input_recording);
+
 	SKB_ZERO_STRUCT(editor);
 
 	skb_free(editor);
@@ -556,13 +763,9 @@ const skb_editor_params_t* skb_editor_get_params(const skb_editor_t* editor)
 	return &editor->params;
 }
 
-void skb_editor_reset(skb_editor_t* editor, const skb_editor_params_t* params)
+// Resets everything except the text and layout.
+static void skb__reset_state(skb_editor_t* editor, const skb_editor_params_t* params)
 {
-	assert(editor);
-
-	skb_rich_text_reset(&editor->rich_text);
-	skb_rich_layout_reset(&editor->rich_layout);
-
 	editor->view_offset = (skb_vec2_t){ 0 };
 
 	editor->active_attributes_count = 0;
@@ -571,11 +774,22 @@ void skb_editor_reset(skb_editor_t* editor, const skb_editor_params_t* params)
 
 	const skb_text_position_t start_pos = { .offset = 0, .affinity = SKB_AFFINITY_SOL };
 	editor->selection = (skb_text_range_t) { .start = start_pos, .end = start_pos };
+	editor->secondary_selections_count = 0;
 
 	if (params)
 		skb__set_params(editor, params);
 
 	skb__reset_undo(editor);
+}
+
+void skb_editor_reset(skb_editor_t* editor, const skb_editor_params_t* params)
+{
+	assert(editor);
+
+	skb_rich_text_reset(&editor->rich_text);
+	skb_rich_layout_reset(&editor->rich_layout);
+
+	skb__reset_state(editor, params);
 
 	skb__emit_on_text_change(editor, SKB_EDITOR_TEXT_RESET);
 	skb__emit_on_selection_change(editor, SKB_EDITOR_SELECTION_RESET);
@@ -613,14 +827,26 @@ void skb_editor_set_text_utf32(skb_editor_t* editor, skb_temp_alloc_t* temp_allo
 	skb__emit_on_selection_change(editor, SKB_EDITOR_SELECTION_RESET);
 }
 
+static void skb__apply_layout_change(skb_rich_text_change_t change, void* context)
+{
+	skb_editor_t* editor = context;
+	skb_rich_layout_apply_change(&editor->rich_layout, change);
+}
+
 void skb_editor_set_rich_text(skb_editor_t* editor, skb_temp_alloc_t* temp_alloc, skb_rich_text_t* rich_text)
 {
 	assert(editor);
 	assert(rich_text);
 
-	skb_editor_reset(editor, NULL);
+	// Patch the current text to match the new text, so that only the changed paragraphs need to be laid out again.
+	const int32_t diffs_cap = skb_rich_text_get_paragraphs_count(&editor->rich_text) + skb_rich_text_get_paragraphs_count(rich_text);
+	skb_rich_text_diff_t* diffs = SKB_TEMP_ALLOC(temp_alloc, skb_rich_text_diff_t, diffs_cap);
+	const int32_t diffs_count = skb_rich_text_diff(&editor->rich_text, temp_alloc, rich_text, diffs, diffs_cap);
+	assert(diffs_count <= diffs_cap);
+	skb_rich_text_apply_patch(&editor->rich_text, rich_text, diffs, diffs_count, skb__apply_layout_change, editor);
+	SKB_TEMP_FREE(temp_alloc, diffs);
 
-	skb_rich_text_append(&editor->rich_text, rich_text);
+	skb__reset_state(editor, NULL);
 
 	skb__update_layout(editor, temp_alloc, (skb_rich_text_change_t){0});
 
@@ -640,7 +866,8 @@ int32_t skb_editor_get_text_utf8_count(const skb_editor_t* editor)
 	int32_t count = 0;
 	for (int32_t i = 0; i < skb__get_paragraph_count(editor); i++) {
 		const skb_text_t* paragraph_text = skb__get_text(editor, i);
-		count += skb_utf32_to_utf8_count(skb_text_get_utf32(paragraph_text), skb_text_get_utf32_count(paragraph_text));
+		const skb_range_t range = { .start = 0, .end = skb_text_get_utf32_count(paragraph_text) };
+		count += skb_text_get_utf8_in_range(paragraph_text, range, NULL, 0);
 	}
 	return count;
 }
@@ -657,7 +884,8 @@ int32_t skb_editor_get_text_utf8(const skb_editor_t* editor, char* utf8, int32_t
 		if (cur_buf_cap == 0)
 			break;
 		char* cur_buf = utf8 + count;
-		count += skb_utf32_to_utf8(skb_text_get_utf32(paragraph_text), skb_text_get_utf32_count(paragraph_text), cur_buf, cur_buf_cap);
+		const skb_range_t range = { .start = 0, .end = skb_text_get_utf32_count(paragraph_text) };
+		count += skb_text_get_utf8_in_range(paragraph_text, range, cur_buf, cur_buf_cap);
 	}
 	return skb_mini(count, utf8_cap);
 }
@@ -685,7 +913,7 @@ int32_t skb_editor_get_text_utf32(const skb_editor_t* editor, uint32_t* utf32, i
 		const int32_t cur_buf_cap = skb_maxi(0, utf32_cap - count);
 		const int32_t copy_count = skb_mini(cur_buf_cap, skb_text_get_utf32_count(paragraph_text));
 		if (utf32 && copy_count > 0)
-			memcpy(utf32 + count, skb_text_get_utf32(paragraph_text), copy_count * sizeof(uint32_t));
+			skb_text_get_utf32_in_range(paragraph_text, (skb_range_t){ .start = 0, .end = copy_count }, utf32 + count, copy_count);
 		count += skb_text_get_utf32_count(paragraph_text);
 	}
 
@@ -827,9 +1055,8 @@ int32_t skb_editor_get_paragraph_text_content_count(const skb_editor_t* editor,
 	assert(editor);
 	const skb_text_t* text = skb__get_text(editor, paragraph_idx);
 	if (text) {
-		const uint32_t* utf32 = skb_text_get_utf32(text);
 		const int32_t utf32_count = skb_text_get_utf32_count(text);
-		if (utf32_count > 0 && skb_is_paragraph_separator(utf32[utf32_count-1]))
+		if (utf32_count > 0 && skb_is_paragraph_separator(skb_text_get_codepoint(text, utf32_count - 1)))
 			return utf32_count - 1;
 		return utf32_count;
 	}
@@ -893,9 +1120,8 @@ skb_text_position_t skb_editor_get_paragraph_content_end_pos(const skb_editor_t*
 	const int32_t paragraph_global_text_offset = skb__get_global_text_offset(editor, paragraph_idx);
 	const skb_text_t* text = skb_editor_get_paragraph_text(editor, paragraph_idx);
 	if (text) {
-		const uint32_t* utf32 = skb_text_get_utf32(text);
 		int32_t utf32_count = skb_text_get_utf32_count(text);
-		if (utf32_count > 0 && skb_is_paragraph_separator(utf32[utf32_count - 1])) {
+		if (utf32_count > 0 && skb_is_paragraph_separator(skb_text_get_codepoint(text, utf32_count - 1))) {
 			return (skb_text_position_t) {
 				.offset = paragraph_global_text_offset + utf32_count - 1,
 				.affinity = SKB_AFFINITY_TRAILING
@@ -977,6 +1203,10 @@ skb_text_position_t skb_editor_get_line_start_at(const skb_editor_t* editor, skb
 	text_pos = skb__resolve_text_position(editor, text_pos);
 	skb_paragraph_position_t paragraph_pos = skb_rich_text_get_paragraph_position_from_text_position(&editor->rich_text, text_pos, SKB_AFFINITY_USE);
 
+	// A paragraph inserted in deferred layout mode has no lines until the layout is updated.
+	if (skb_layout_get_lines_count(skb__get_layout(editor, paragraph_pos.paragraph_idx)) == 0)
+		return (skb_text_position_t) { .offset = skb__get_global_text_offset(editor, paragraph_pos.paragraph_idx), .affinity = SKB_AFFINITY_SOL };
+
 	int32_t edit_line_idx = skb__get_line_index(editor, paragraph_pos);
 	const skb_layout_line_t* lines = skb_layout_get_lines(skb__get_layout(editor, paragraph_pos.paragraph_idx));
 	const skb_layout_line_t* line = &lines[edit_line_idx];
@@ -985,7 +1215,7 @@ skb_text_position_t skb_editor_get_line_start_at(const skb_editor_t* editor, skb
 		.offset = skb__get_global_text_offset(editor, paragraph_pos.paragraph_idx) + line->text_range.start,
 		.affinity = SKB_AFFINITY_SOL,
 	};
-	return result;
+	return skb__clamp_to_paragraph_content(editor, paragraph_pos.paragraph_idx, result);
 }
 
 // TODO: should we expose this?
@@ -996,6 +1226,10 @@ skb_text_position_t skb_editor_get_line_end_at(const skb_editor_t* editor, skb_t
 	text_pos = skb__resolve_text_position(editor, text_pos);
 	skb_paragraph_position_t paragraph_pos = skb_rich_text_get_paragraph_position_from_text_position(&editor->rich_text, text_pos, SKB_AFFINITY_USE);
 
+	// A paragraph inserted in deferred layout mode has no lines until the layout is updated.
+	if (skb_layout_get_lines_count(skb__get_layout(editor, paragraph_pos.paragraph_idx)) == 0)
+		return skb_editor_get_paragraph_content_end_pos(editor, paragraph_pos.paragraph_idx);
+
 	int32_t edit_line_idx = skb__get_line_index(editor, paragraph_pos);
 	const skb_layout_line_t* lines = skb_layout_get_lines(skb__get_layout(editor, paragraph_pos.paragraph_idx));
 	const skb_layout_line_t* line = &lines[edit_line_idx];
@@ -1004,7 +1238,8 @@ skb_text_position_t skb_editor_get_line_end_at(const skb_editor_t* editor, skb_t
 		.offset = skb__get_global_text_offset(editor, paragraph_pos.paragraph_idx) + line->last_grapheme_offset,
 		.affinity = SKB_AFFINITY_EOL,
 	};
-	return skb__caret_prune_control_eol(skb__get_layout(editor, paragraph_pos.paragraph_idx), line, result);
+	result = skb__caret_prune_control_eol(skb__get_layout(editor, paragraph_pos.paragraph_idx), line, result);
+	return skb__clamp_to_paragraph_content(editor, paragraph_pos.paragraph_idx, result);
 }
 
 // TODO: should we expose this?
@@ -1016,7 +1251,8 @@ skb_text_position_t skb_editor_get_word_start_at(const skb_editor_t* editor, skb
 	// Ignoring affinity, since we want to start from the "character" the user has hit.
 	skb_paragraph_position_t paragraph_pos = skb_rich_text_get_paragraph_position_from_text_position(&editor->rich_text, text_pos, SKB_AFFINITY_IGNORE);
 
-	int32_t offset = paragraph_pos.text_offset;
+	// The layout text can be shorter than the paragraph text in deferred layout mode.
+	int32_t offset = skb_mini(paragraph_pos.text_offset, skb_layout_get_text_count(skb__get_layout(editor, paragraph_pos.paragraph_idx)));
 
 	const skb_text_property_t* text_props = skb_layout_get_text_properties(skb__get_layout(editor, paragraph_pos.paragraph_idx));
 
@@ -1033,10 +1269,11 @@ skb_text_position_t skb_editor_get_word_start_at(const skb_editor_t* editor, skb
 	if (offset < 0)
 		offset = 0;
 
-	return (skb_text_position_t) {
+	const skb_text_position_t result = {
 		.offset = skb__get_global_text_offset(editor, paragraph_pos.paragraph_idx) + offset,
 		.affinity = SKB_AFFINITY_TRAILING,
 	};
+	return skb__clamp_to_paragraph_content(editor, paragraph_pos.paragraph_idx, result);
 }
 
 // TODO: should we expose this?
@@ -1066,10 +1303,11 @@ skb_text_position_t skb_editor_get_word_end_at(const skb_editor_t* editor, skb_t
 	if (offset >= text_count)
 		offset = skb_layout_align_grapheme_offset(skb__get_layout(editor, paragraph_pos.paragraph_idx), text_count-1);
 
-	return (skb_text_position_t) {
+	const skb_text_position_t result = {
 		.offset = skb__get_global_text_offset(editor, paragraph_pos.paragraph_idx) + offset,
 		.affinity = SKB_AFFINITY_LEADING,
 	};
+	return skb__clamp_to_paragraph_content(editor, paragraph_pos.paragraph_idx, result);
 }
 
 // TODO: should we expose this?
@@ -1603,10 +1841,139 @@ void skb_editor_select_none(skb_editor_t* editor)
 	skb__emit_on_selection_change(editor, SKB_EDITOR_SELECTION_EXTERNAL);
 }
 
+static int32_t skb__get_selection_offset(const skb_editor_t* editor, skb_text_position_t pos)
+{
+	return skb_rich_text_get_paragraph_position_from_text_position(&editor->rich_text, pos, SKB_AFFINITY_USE).global_text_offset;
+}
+
+static skb__selection_merge_item_t skb__make_selection_merge_item(const skb_editor_t* editor, skb_text_range_t selection, bool is_main)
+{
+	const int32_t start_offset = skb__get_selection_offset(editor, selection.start);
+	const int32_t end_offset = skb__get_selection_offset(editor, selection.end);
+	const bool is_forward = start_offset <= end_offset;
+	return (skb__selection_merge_item_t) {
+		.first = is_forward ? selection.start : selection.end,
+		.last = is_forward ? selection.end : selection.start,
+		.first_offset = is_forward ? start_offset : end_offset,
+		.last_offset = is_forward ? end_offset : start_offset,
+		.is_forward = is_forward,
+		.is_main = is_main,
+	};
+}
+
+static int skb__compare_selection_merge_items(const void* a, const void* b)
+{
+	const skb__selection_merge_item_t* item_a = a;
+	const skb__selection_merge_item_t* item_b = b;
+	if (item_a->first_offset != item_b->first_offset)
+		return item_a->first_offset < item_b->first_offset ? -1 : 1;
+	if (item_a->last_offset != item_b->last_offset)
+		return item_a->last_offset < item_b->last_offset ? -1 : 1;
+	return 0;
+}
+
+// Merges secondary selections which overlap or touch the current selection or each other, so that each part of the text is edited once.
+// The selections are sorted by offset, and merged in one pass. After the merge the secondary selections are in text order.
+// A merged selection keeps the direction of the current selection if it is part of the merge, or else the direction of the first selection.
+static void skb__merge_secondary_selections(skb_editor_t* editor)
+{
+	if (editor->secondary_selections_count == 0)
+		return;
+
+	const int32_t items_count = editor->secondary_selections_count + 1;
+	SKB_ARRAY_RESERVE(editor->selection_merge_items, items_count);
+	skb__selection_merge_item_t* items = editor->selection_merge_items;
+	items[0] = skb__make_selection_merge_item(editor, editor->selection, true);
+	for (int32_t i = 0; i < editor->secondary_selections_count; i++)
+		items[i + 1] = skb__make_selection_merge_item(editor, editor->secondary_selections[i], false);
+
+	qsort(items, items_count, sizeof(skb__selection_merge_item_t), skb__compare_selection_merge_items);
+
+	int32_t selections_count = 0;
+	skb__selection_merge_item_t merged = items[0];
+	for (int32_t i = 1; i <= items_count; i++) {
+		if (i < items_count && items[i].first_offset <= merged.last_offset) {
+			// Touches or overlaps, extend. The items are sorted, so the first position is not changed.
+			const skb__selection_merge_item_t* item = &items[i];
+			if (item->last_offset > merged.last_offset) {
+				merged.last = item->last;
+				merged.last_offset = item->last_offset;
+			}
+			if (item->is_main) {
+				merged.is_forward = item->is_forward;
+				merged.is_main = true;
+			}
+			continue;
+		}
+		const skb_text_range_t selection = merged.is_forward
+			? (skb_text_range_t){ .start = merged.first, .end = merged.last }
+			: (skb_text_range_t){ .start = merged.last, .end = merged.first };
+		if (merged.is_main)
+			editor->selection = selection;
+		else
+			editor->secondary_selections[selections_count++] = selection;
+		if (i < items_count)
+			merged = items[i];
+	}
+	editor->secondary_selections_count = selections_count;
+}
+
+void skb_editor_add_secondary_selection(skb_editor_t* editor, skb_text_range_t text_range)
+{
+	assert(editor);
+
+	// Selections are usually added in text order, in which case there is nothing to merge if the new selection
+	// is after the last selection, and does not touch the current selection. Otherwise merge all, which also removes duplicates.
+	const skb__selection_merge_item_t item = skb__make_selection_merge_item(editor, text_range, false);
+	const skb__selection_merge_item_t main_item = skb__make_selection_merge_item(editor, editor->selection, true);
+	bool needs_merge = item.first_offset <= main_item.last_offset && main_item.first_offset <= item.last_offset;
+	if (editor->secondary_selections_count > 0) {
+		const skb__selection_merge_item_t last_item = skb__make_selection_merge_item(editor, editor->secondary_selections[editor->secondary_selections_count - 1], false);
+		needs_merge |= item.first_offset <= last_item.last_offset;
+	}
+
+	SKB_ARRAY_RESERVE(editor->secondary_selections, editor->secondary_selections_count + 1);
+	editor->secondary_selections[editor->secondary_selections_count++] = text_range;
+	if (needs_merge)
+		skb__merge_secondary_selections(editor);
+	skb__emit_on_selection_change(editor, SKB_EDITOR_SELECTION_EXTERNAL);
+}
+
+void skb_editor_clear_secondary_selections(skb_editor_t* editor)
+{
+	assert(editor);
+	if (editor->secondary_selections_count == 0)
+		return;
+	editor->secondary_selections_count = 0;
+	skb__emit_on_selection_change(editor, SKB_EDITOR_SELECTION_EXTERNAL);
+}
+
+int32_t skb_editor_get_secondary_selections_count(const skb_editor_t* editor)
+{
+	assert(editor);
+	return editor->secondary_selections_count;
+}
+
+skb_text_range_t skb_editor_get_secondary_selection(const skb_editor_t* editor, int32_t selection_idx)
+{
+	assert(editor);
+	assert(selection_idx >= 0 && selection_idx < editor->secondary_selections_count);
+	return editor->secondary_selections[selection_idx];
+}
+
 skb_text_position_t skb_editor_hit_test(const skb_editor_t* editor, skb_movement_type_t type, float hit_x, float hit_y)
 {
 	assert(editor);
-	return skb_rich_layout_hit_test(&editor->rich_layout, type, hit_x, hit_y);
+	if (!(editor->pending_updates & SKB__PENDING_LAYOUT))
+		return skb_rich_layout_hit_test(&editor->rich_layout, type, hit_x, hit_y);
+
+	// The layout is stale, map the hit through the current paragraph text offsets, and keep it within the paragraph.
+	int32_t hit_paragraph_idx = 0;
+	skb_text_position_t hit_pos = skb_rich_layout_hit_test_paragraph(&editor->rich_layout, type, hit_x, hit_y, &hit_paragraph_idx);
+	if (hit_paragraph_idx >= skb__get_paragraph_count(editor))
+		return (skb_text_position_t){0};
+	hit_pos.offset += skb__get_global_text_offset(editor, hit_paragraph_idx);
+	return skb__clamp_to_paragraph_content(editor, hit_paragraph_idx, hit_pos);
 }
 
 void skb_editor_iterate_text_range_bounds(const skb_editor_t* editor, skb_text_range_t text_range, skb_text_range_bounds_func_t* callback, void* context)
@@ -1620,6 +1987,17 @@ void skb_editor_iterate_text_range_bounds(const skb_editor_t* editor, skb_text_r
 	skb_rich_layout_get_text_range_bounds(&editor->rich_layout, text_range, callback, context);
 }
 
+skb_text_range_bounds_clip_info_t skb_editor_iterate_text_range_bounds_in_view(const skb_editor_t* editor, skb_text_range_t text_range, skb_rect2_t view_bounds, skb_text_range_bounds_func_t* callback, void* context)
+{
+	assert(editor);
+	assert(skb__are_paragraphs_in_sync(editor));
+
+	if (skb_text_range_is_current_selection(text_range))
+		text_range = editor->selection;
+
+	return skb_rich_layout_get_text_range_bounds_in_view(&editor->rich_layout, text_range, view_bounds, callback, context);
+}
+
 enum {
 	SKB_DRAG_NONE,
 	SKB_DRAG_CHAR,
@@ -1632,6 +2010,14 @@ void skb_editor_process_mouse_click(skb_editor_t* editor, float x, float y, uint
 	assert(editor);
 	assert(skb__are_paragraphs_in_sync(editor));
 
+	skb__input_args_mouse_t args;
+	SKB_ZERO_STRUCT(&args);
+	args.x = x;
+	args.y = y;
+	args.mods = mods;
+	args.time = time;
+	skb__record_input(editor, SKB_EDITOR_INPUT_MOUSE_CLICK, &args, sizeof(args), NULL, 0);
+
 	static const double double_click_duration = 0.4;
 	if (skb__get_paragraph_count(editor) <= 0)
 		return;
@@ -1687,6 +2073,12 @@ void skb_editor_process_mouse_drag(skb_editor_t* editor, float x, float y)
 {
 	assert(editor);
 
+	skb__input_args_mouse_t args;
+	SKB_ZERO_STRUCT(&args);
+	args.x = x;
+	args.y = y;
+	skb__record_input(editor, SKB_EDITOR_INPUT_MOUSE_DRAG, &args, sizeof(args), NULL, 0);
+
 	static const float move_threshold = 5.f;
 
 	if (!editor->drag_moved) {
@@ -1746,7 +2138,9 @@ static skb_rich_text_change_t skb__replace_selection(skb_editor_t* editor, const
 	// Insert pos gets clamped to the layout text size.
 	int32_t transaction_id = skb__capture_undo_text_begin(editor, editor->selection, rich_text, allow_amend_undo);
 
+	const int64_t text_profile_start = skb__profile_begin(editor);
 	skb_rich_text_change_t change = skb_rich_text_insert(&editor->rich_text, editor->selection, rich_text);
+	skb__profile_end(editor, SKB__PROFILE_TEXT, text_profile_start);
 
 	skb__update_selection_from_change(editor, change);
 	skb__capture_undo_text_end(editor, transaction_id);
@@ -1830,6 +2224,8 @@ static int32_t skb__capture_undo_text_begin(skb_editor_t* editor, skb_text_range
 	if (editor->params.max_undo_levels < 0)
 		return SKB_INVALID_INDEX;
 
+	const int64_t undo_profile_start = skb__profile_begin(editor);
+
 	const skb_paragraph_range_t range = skb_rich_text_get_paragraph_range_from_text_range(&editor->rich_text, text_range, SKB_AFFINITY_USE);
 
 	// Check if we can amend the last undo state.
@@ -1846,6 +2242,7 @@ static int32_t skb__capture_undo_text_begin(skb_editor_t* editor, skb_text_range
 				assert(prev_undo_state->inserted_range.end.affinity == SKB_AFFINITY_NONE);
 				skb_rich_text_append(&prev_undo_state->inserted_text, rich_text);
 				prev_undo_state->inserted_range.end.offset += skb_rich_text_get_utf32_count(rich_text);
+				skb__profile_end(editor, SKB__PROFILE_UNDO, undo_profile_start);
 				return SKB_INVALID_INDEX;
 			}
 		}
@@ -1873,6 +2270,8 @@ static int32_t skb__capture_undo_text_begin(skb_editor_t* editor, skb_text_range
 	undo_state->inserted_range.end.offset = range.start.global_text_offset + skb_rich_text_get_utf32_count(rich_text);
 	skb_rich_text_append(&undo_state->inserted_text, rich_text);
 
+	skb__profile_end(editor, SKB__PROFILE_UNDO, undo_profile_start);
+
 	return transaction_id;
 }
 
@@ -1888,6 +2287,8 @@ static int32_t skb__capture_undo_attributes_begin(skb_editor_t* editor, skb_text
 	if (editor->params.max_undo_levels < 0)
 		return SKB_INVALID_INDEX;
 
+	const int64_t undo_profile_start = skb__profile_begin(editor);
+
 	const skb_paragraph_range_t range = skb_rich_text_get_paragraph_range_from_text_range(&editor->rich_text, text_range, SKB_AFFINITY_USE);
 
 	const int32_t transaction_id = skb_editor_undo_transaction_begin(editor);
@@ -1909,6 +2310,8 @@ static int32_t skb__capture_undo_attributes_begin(skb_editor_t* editor, skb_text
 	undo_state->inserted_range = undo_state->removed_range;
 	// We capture the attributed of inserted_text in skb__capture_undo_attributes_end().
 
+	skb__profile_end(editor, SKB__PROFILE_UNDO, undo_profile_start);
+
 	return transaction_id;
 }
 
@@ -1918,7 +2321,9 @@ static void skb__capture_undo_attributes_end(skb_editor_t* editor, int32_t trans
 	const skb__editor_undo_transaction_t* transaction = &editor->undo_stack[editor->undo_stack_head];
 	skb__editor_undo_state_t* prev_undo_state = &editor->undo_states[transaction->states_range.end - 1];
 
+	const int64_t undo_profile_start = skb__profile_begin(editor);
 	skb_rich_text_copy_attributes_in_range(&prev_undo_state->inserted_text, &editor->rich_text, prev_undo_state->inserted_range);
+	skb__profile_end(editor, SKB__PROFILE_UNDO, undo_profile_start);
 
 	skb_editor_undo_transaction_end(editor, transaction_id);
 }
@@ -1981,6 +2386,7 @@ bool skb_editor_can_undo(skb_editor_t* editor)
 void skb_editor_undo(skb_editor_t* editor, skb_temp_alloc_t* temp_alloc)
 {
 	assert(editor);
+	skb__record_input(editor, SKB_EDITOR_INPUT_UNDO, NULL, 0, NULL, 0);
 	if (editor->undo_stack_head >= 0) {
 		skb__editor_undo_transaction_t* undo_transaction = &editor->undo_stack[editor->undo_stack_head];
 
@@ -1994,14 +2400,19 @@ void skb_editor_undo(skb_editor_t* editor, skb_temp_alloc_t* temp_alloc)
 			skb__editor_undo_state_t* undo_state = &editor->undo_states[i];
 			skb_rich_text_change_t change = {0};
 			if (undo_state->type == SKB_UNDO_TEXT) {
+				const int64_t text_profile_start = skb__profile_begin(editor);
 				change = skb_rich_text_insert(&editor->rich_text, undo_state->inserted_range, &undo_state->removed_text);
+				skb__profile_end(editor, SKB__PROFILE_TEXT, text_profile_start);
 			} else if (undo_state->type == SKB_UNDO_TEXT_ATTRIBUTES) {
+				const int64_t text_profile_start = skb__profile_begin(editor);
 				skb_rich_text_insert_attributes(&editor->rich_text, undo_state->inserted_range, &undo_state->removed_text);
+				skb__profile_end(editor, SKB__PROFILE_TEXT, text_profile_start);
 			}
 			skb_rich_layout_apply_change(&editor->rich_layout, change);
 		}
 
 		editor->selection = undo_transaction->selection_before;
+		editor->secondary_selections_count = 0;
 		editor->preferred_x = -1.f; // reset preferred.
 
 		skb__update_layout(editor, temp_alloc, (skb_rich_text_change_t){0});
@@ -2021,6 +2432,7 @@ bool skb_editor_can_redo(skb_editor_t* editor)
 void skb_editor_redo(skb_editor_t* editor, skb_temp_alloc_t* temp_alloc)
 {
 	assert(editor);
+	skb__record_input(editor, SKB_EDITOR_INPUT_REDO, NULL, 0, NULL, 0);
 	if (editor->undo_stack_head + 1 < editor->undo_stack_count) {
 		editor->undo_stack_head++;
 		assert(editor->undo_stack_head < editor->undo_stack_count);
@@ -2030,14 +2442,19 @@ void skb_editor_redo(skb_editor_t* editor, skb_temp_alloc_t* temp_alloc)
 			const skb__editor_undo_state_t* undo_state = &editor->undo_states[i];
 			skb_rich_text_change_t change = {0};
 			if (undo_state->type == SKB_UNDO_TEXT) {
+				const int64_t text_profile_start = skb__profile_begin(editor);
 				change = skb_rich_text_insert(&editor->rich_text, undo_state->removed_range, &undo_state->inserted_text);
+				skb__profile_end(editor, SKB__PROFILE_TEXT, text_profile_start);
 			} else if (undo_state->type == SKB_UNDO_TEXT_ATTRIBUTES) {
+				const int64_t text_profile_start = skb__profile_begin(editor);
 				skb_rich_text_insert_attributes(&editor->rich_text, undo_state->removed_range, &undo_state->inserted_text);
+				skb__profile_end(editor, SKB__PROFILE_TEXT, text_profile_start);
 			}
 			skb_rich_layout_apply_change(&editor->rich_layout, change);
 		}
 
 		editor->selection = undo_transaction->selection_after;
+		editor->secondary_selections_count = 0;
 		editor->preferred_x = -1.f; // reset preferred.
 
 		skb__update_layout(editor, temp_alloc, (skb_rich_text_change_t){0});
@@ -2049,6 +2466,61 @@ void skb_editor_redo(skb_editor_t* editor, skb_temp_alloc_t* temp_alloc)
 }
 
 
+//
+// Batch
+//
+
+void skb_editor_begin_batch(skb_editor_t* editor)
+{
+	assert(editor);
+	editor->batch_depth++;
+}
+
+void skb_editor_end_batch(skb_editor_t* editor, skb_temp_alloc_t* temp_alloc)
+{
+	assert(editor);
+	assert(editor->batch_depth > 0);
+
+	editor->batch_depth--;
+	if (editor->batch_depth > 0)
+		return;
+
+	// Apply the deferred updates once. In deferred layout mode the layout is updated later by skb_editor_update_layout().
+	if (!editor->params.defer_layout)
+		skb__update_deferred_layout(editor, temp_alloc);
+
+	const uint8_t pending = editor->pending_updates;
+	editor->pending_updates &= ~(SKB__PENDING_TEXT_CHANGE | SKB__PENDING_SELECTION_CHANGE);
+
+	if (pending & SKB__PENDING_TEXT_CHANGE)
+		skb__emit_on_text_change(editor, editor->batch_text_change_reason);
+	if (pending & SKB__PENDING_SELECTION_CHANGE)
+		skb__emit_on_selection_change(editor, editor->batch_selection_change_reason);
+}
+
+bool skb_editor_is_in_batch(const skb_editor_t* editor)
+{
+	assert(editor);
+	return editor->batch_depth > 0;
+}
+
+bool skb_editor_needs_layout_update(const skb_editor_t* editor)
+{
+	assert(editor);
+	return (editor->pending_updates & SKB__PENDING_LAYOUT) != 0;
+}
+
+void skb_editor_update_layout(skb_editor_t* editor, skb_temp_alloc_t* temp_alloc)
+{
+	assert(editor);
+	skb__record_input(editor, SKB_EDITOR_INPUT_UPDATE_LAYOUT, NULL, 0, NULL, 0);
+	// The batch will update the layout when it ends.
+	if (editor->batch_depth > 0)
+		return;
+	skb__update_deferred_layout(editor, temp_alloc);
+}
+
+
 // Based on android.text.method.BaseKeyListener.getOffsetForBackspaceKey().
 enum {
 	BACKSPACE_STATE_START = 0,	// Initial state
@@ -2096,10 +2568,10 @@ static skb_text_position_t skb__get_backspace_start_offset(const skb_editor_t* e
 	int32_t state = BACKSPACE_STATE_START;
 	int32_t cur_offset = offset;
 
-	const uint32_t* paragraph_text = skb_text_get_utf32(skb__get_text(editor, pos.paragraph_idx));
+	const skb_text_t* paragraph_text = skb__get_text(editor, pos.paragraph_idx);
 
 	do {
-		const uint32_t cp = paragraph_text[cur_offset - 1];
+		const uint32_t cp = skb_text_get_codepoint(paragraph_text, cur_offset - 1);
 		cur_offset--;
 		switch (state) {
 		case BACKSPACE_STATE_START:
@@ -2266,6 +2738,16 @@ void skb_editor_process_key_pressed(skb_editor_t* editor, skb_temp_alloc_t* temp
 {
 	assert(editor);
 
+	skb__input_args_key_t args;
+	SKB_ZERO_STRUCT(&args);
+	args.key = (uint32_t)key;
+	args.mods = mods;
+	skb__record_input(editor, SKB_EDITOR_INPUT_KEY_PRESSED, &args, sizeof(args), NULL, 0);
+
+	// Caret navigation, and the grapheme and line boundaries used by the edit keys rely on the layout, make sure it is up to date.
+	if (editor->batch_depth == 0)
+		skb__update_deferred_layout(editor, temp_alloc);
+
 	if (key == SKB_KEY_RIGHT) {
 		if (editor->params.editor_behavior == SKB_BEHAVIOR_MACOS) {
 			if (mods & SKB_MOD_SHIFT) {
@@ -2494,7 +2976,9 @@ void skb_editor_process_key_pressed(skb_editor_t* editor, skb_temp_alloc_t* temp
 				.end = editor->selection.end,
 			};
 			int32_t transaction_id = skb__capture_undo_text_begin(editor, remove_range, NULL, false);
+			const int64_t text_profile_start = skb__profile_begin(editor);
 			skb_rich_text_change_t change = skb_rich_text_remove(&editor->rich_text, remove_range);
+			skb__profile_end(editor, SKB__PROFILE_TEXT, text_profile_start);
 			skb__update_selection_from_change(editor, change);
 			skb__capture_undo_text_end(editor, transaction_id);
 
@@ -2520,7 +3004,9 @@ void skb_editor_process_key_pressed(skb_editor_t* editor, skb_temp_alloc_t* temp
 				.end = skb_rich_text_get_next_grapheme_pos(&editor->rich_text, editor->selection.end),
 			};
 			int32_t transaction_id = skb__capture_undo_text_begin(editor, remove_range, NULL, false);
+			const int64_t text_profile_start = skb__profile_begin(editor);
 			skb_rich_text_change_t change = skb_rich_text_remove(&editor->rich_text, remove_range);
+			skb__profile_end(editor, SKB__PROFILE_TEXT, text_profile_start);
 			skb__update_selection_from_change(editor, change);
 			skb__capture_undo_text_end(editor, transaction_id);
 
@@ -2593,7 +3079,7 @@ static skb_text_range_t skb__adjust_text_selection(const skb_editor_t* editor, s
 	};
 }
 
-static void skb__insert_rich_text(
+static skb_rich_text_change_t skb__insert_rich_text(
 	skb_editor_t* editor, skb_temp_alloc_t* temp_alloc, skb_text_range_t text_range,
 	const skb_rich_text_t* rich_text, bool allow_amend_undo, bool external)
 {
@@ -2611,17 +3097,32 @@ static void skb__insert_rich_text(
 		rich_text = rich_text_copy;
 	}
 
+	// Offset range of the removed text before the change, used to adjust the secondary selections.
+	const skb_range_t removed_range = skb_rich_text_get_offset_range_from_text_range(&editor->rich_text, text_range);
+	const int32_t inserted_text_length = skb_rich_text_get_utf32_count(rich_text);
+
 	int32_t transaction_id = skb__capture_undo_text_begin(editor, text_range, rich_text, allow_amend_undo);
+	const int64_t text_profile_start = skb__profile_begin(editor);
 	skb_rich_text_change_t change = skb_rich_text_insert(&editor->rich_text, text_range, rich_text);
+	skb__profile_end(editor, SKB__PROFILE_TEXT, text_profile_start);
 
 	if (is_current_selection) {
 		skb__update_selection_from_change(editor, change);
 	} else {
 		// Adjust selection
-		const int32_t inserted_text_length = skb_rich_text_get_utf32_count(rich_text);
 		editor->selection = skb__adjust_text_selection(editor, editor->selection, text_range, inserted_text_length);
 	}
 
+	if (!editor->is_inserting_at_selections) {
+		for (int32_t i = 0; i < editor->secondary_selections_count; i++) {
+			skb_text_range_t* selection = &editor->secondary_selections[i];
+			selection->start = skb__adjust_text_position(selection->start, removed_range, inserted_text_length);
+			selection->end = skb__adjust_text_position(selection->end, removed_range, inserted_text_length);
+		}
+		// The edit may have collapsed selections together.
+		skb__merge_secondary_selections(editor);
+	}
+
 	skb__capture_undo_text_end(editor, transaction_id);
 
 	skb__update_layout(editor, temp_alloc, change);
@@ -2629,11 +3130,15 @@ static void skb__insert_rich_text(
 	skb__emit_on_text_change(editor, external ? SKB_EDITOR_TEXT_EXTERNAL : SKB_EDITOR_TEXT_EDIT);
 	skb__emit_on_selection_change(editor, SKB_EDITOR_SELECTION_EDIT);
 	skb__ensure_caret_visible(editor);
+
+	return change;
 }
 
 
 void skb_editor_insert_paragraph(skb_editor_t* editor, skb_temp_alloc_t* temp_alloc, skb_text_range_t text_range, skb_attribute_t paragraph_attribute)
 {
+	skb__record_input_attribute(editor, SKB_EDITOR_INPUT_INSERT_PARAGRAPH, text_range, paragraph_attribute);
+
 	uint32_t cp = SKB_CHAR_LINE_FEED;
 	skb_rich_text_t* input_text = skb__make_scratch_text_input_utf32(editor, temp_alloc, &cp, 1);
 
@@ -2648,6 +3153,12 @@ void skb_editor_insert_codepoint(skb_editor_t* editor, skb_temp_alloc_t* temp_al
 {
 	assert(editor);
 
+	skb__input_args_codepoint_t args;
+	SKB_ZERO_STRUCT(&args);
+	args.text_range = text_range;
+	args.codepoint = codepoint;
+	skb__record_input(editor, SKB_EDITOR_INPUT_INSERT_CODEPOINT, &args, sizeof(args), NULL, 0);
+
 	skb_rich_text_t* input_text = skb__make_scratch_text_input_utf32(editor, temp_alloc, &codepoint, 1);
 	skb__insert_rich_text(editor, temp_alloc, text_range, input_text, true, false);
 }
@@ -2661,6 +3172,11 @@ void skb_editor_insert_text_utf8(skb_editor_t* editor, skb_temp_alloc_t* temp_al
 	uint32_t* utf32 = SKB_TEMP_ALLOC(temp_alloc, uint32_t, utf32_count);
 	skb_utf8_to_utf32(utf8, utf8_len, utf32, utf32_count);
 
+	skb__input_args_range_t args;
+	SKB_ZERO_STRUCT(&args);
+	args.text_range = text_range;
+	skb__record_input(editor, SKB_EDITOR_INPUT_INSERT_TEXT, &args, sizeof(args), utf32, utf32_count * (int32_t)sizeof(uint32_t));
+
 	skb_rich_text_t* input_text = skb__make_scratch_text_input_utf32(editor, temp_alloc, utf32, utf32_count);
 
 	SKB_TEMP_FREE(temp_alloc, utf32);
@@ -2671,6 +3187,15 @@ void skb_editor_insert_text_utf8(skb_editor_t* editor, skb_temp_alloc_t* temp_al
 void skb_editor_insert_text_utf32(skb_editor_t* editor, skb_temp_alloc_t* temp_alloc, skb_text_range_t text_range, const uint32_t* utf32, int32_t utf32_len)
 {
 	assert(editor);
+
+	if (editor->is_recording_input) {
+		if (utf32 && utf32_len < 0) utf32_len = skb_utf32_strlen(utf32);
+		skb__input_args_range_t args;
+		SKB_ZERO_STRUCT(&args);
+		args.text_range = text_range;
+		skb__record_input(editor, SKB_EDITOR_INPUT_INSERT_TEXT, &args, sizeof(args), utf32, skb_maxi(0, utf32_len) * (int32_t)sizeof(uint32_t));
+	}
+
 	skb_rich_text_t* input_text = skb__make_scratch_text_input_utf32(editor, temp_alloc, utf32, utf32_len);
 	skb__insert_rich_text(editor, temp_alloc, text_range, input_text, false, true);
 }
@@ -2684,11 +3209,91 @@ void skb_editor_insert_rich_text(skb_editor_t* editor, skb_temp_alloc_t* temp_al
 void skb_editor_remove(skb_editor_t* editor, skb_temp_alloc_t* temp_alloc, skb_text_range_t text_range)
 {
 	assert(editor);
+
+	skb__input_args_range_t args;
+	SKB_ZERO_STRUCT(&args);
+	args.text_range = text_range;
+	skb__record_input(editor, SKB_EDITOR_INPUT_REMOVE, &args, sizeof(args), NULL, 0);
+
 	skb__insert_rich_text(editor, temp_alloc, text_range, NULL, false, true);
 }
 
+void skb_editor_insert_text_utf8_at_selections(skb_editor_t* editor, skb_temp_alloc_t* temp_alloc, const char* utf8, int32_t utf8_len)
+{
+	assert(editor);
+	if (utf8 && utf8_len < 0) utf8_len = (int32_t)strlen(utf8);
+
+	const int32_t utf32_count = skb_utf8_to_utf32(utf8, utf8_len, NULL, 0);
+	uint32_t* utf32 = SKB_TEMP_ALLOC(temp_alloc, uint32_t, utf32_count);
+	skb_utf8_to_utf32(utf8, utf8_len, utf32, utf32_count);
+
+	skb_editor_insert_text_utf32_at_selections(editor, temp_alloc, utf32, utf32_count);
+
+	SKB_TEMP_FREE(temp_alloc, utf32);
+}
+
+void skb_editor_insert_text_utf32_at_selections(skb_editor_t* editor, skb_temp_alloc_t* temp_alloc, const uint32_t* utf32, int32_t utf32_len)
+{
+	assert(editor);
+
+	if (editor->is_recording_input) {
+		if (utf32 && utf32_len < 0) utf32_len = skb_utf32_strlen(utf32);
+		skb__record_input(editor, SKB_EDITOR_INPUT_INSERT_TEXT_AT_SELECTIONS, NULL, 0, utf32, skb_maxi(0, utf32_len) * (int32_t)sizeof(uint32_t));
+	}
+
+	// Make a copy of the input, the scratch text is reused by the input filter on each insert.
+	skb_rich_text_t input_text = skb_rich_text_make_empty();
+	skb_rich_text_append(&input_text, skb__make_scratch_text_input_utf32(editor, temp_alloc, utf32, utf32_len));
+
+	skb_editor_begin_batch(editor);
+	const int32_t transaction_id = skb_editor_undo_transaction_begin(editor);
+
+	// Overlapping and touching selections are merged, so that the text is inserted only once at each location.
+	// After that the selections are separate and in text order.
+	skb__merge_secondary_selections(editor);
+
+	// Insert in text order. Each insert moves only the selections after it, which are offset by the accumulated change in text length
+	// just before their insert. The current selection is adjusted by each insert before it.
+	const int32_t main_offset = skb__get_selection_offset(editor, editor->selection.start);
+	int32_t main_idx = 0;
+	while (main_idx < editor->secondary_selections_count && skb__get_selection_offset(editor, editor->secondary_selections[main_idx].start) < main_offset)
+		main_idx++;
+
+	int32_t offset_delta = 0;
+	editor->is_inserting_at_selections = true;
+	for (int32_t i = 0; i <= editor->secondary_selections_count; i++) {
+		if (i == main_idx) {
+			const int32_t text_count = skb_rich_text_get_utf32_count(&editor->rich_text);
+			skb__insert_rich_text(editor, temp_alloc, SKB_CURRENT_SELECTION, &input_text, false, false);
+			offset_delta += skb_rich_text_get_utf32_count(&editor->rich_text) - text_count;
+		}
+		if (i == editor->secondary_selections_count)
+			break;
+
+		skb_text_range_t* selection = &editor->secondary_selections[i];
+		selection->start.offset += offset_delta;
+		selection->end.offset += offset_delta;
+		const int32_t text_count = skb_rich_text_get_utf32_count(&editor->rich_text);
+		const skb_rich_text_change_t change = skb__insert_rich_text(editor, temp_alloc, *selection, &input_text, false, false);
+		offset_delta += skb_rich_text_get_utf32_count(&editor->rich_text) - text_count;
+		// Place caret after the inserted text.
+		selection->start = change.edit_end_position;
+		selection->end = change.edit_end_position;
+	}
+	editor->is_inserting_at_selections = false;
+
+	// The inserts may have collapsed selections together, e.g. if the input filter removed the text.
+	skb__merge_secondary_selections(editor);
+
+	skb_editor_undo_transaction_end(editor, transaction_id);
+	skb_editor_end_batch(editor, temp_alloc);
+
+	skb_rich_text_destroy(&input_text);
+}
+
 void skb_editor_toggle_attribute(skb_editor_t* editor, skb_temp_alloc_t* temp_alloc, skb_text_range_t text_range, skb_attribute_t attribute)
 {
+	skb__record_input_attribute(editor, SKB_EDITOR_INPUT_TOGGLE_ATTRIBUTE, text_range, attribute);
 	skb_editor_toggle_attribute_with_payload(editor, temp_alloc, text_range, attribute, 0, NULL);
 }
 
@@ -2760,7 +3365,9 @@ void skb_editor_set_attribute_with_payload(skb_editor_t* editor, skb_temp_alloc_
 		// Apply to selection
 		int32_t transaction_id = skb__capture_undo_attributes_begin(editor, text_range);
 
+		const int64_t text_profile_start = skb__profile_begin(editor);
 		skb_rich_text_set_attribute_with_payload(&editor->rich_text, text_range, attribute, span_flags, payload);
+		skb__profile_end(editor, SKB__PROFILE_TEXT, text_profile_start);
 
 		skb__capture_undo_attributes_end(editor, transaction_id);
 
@@ -2796,7 +3403,9 @@ void skb_editor_clear_attribute(skb_editor_t* editor, skb_temp_alloc_t* temp_all
 	} else {
 		int32_t transaction_id = skb__capture_undo_attributes_begin(editor, text_range);
 
+		const int64_t text_profile_start = skb__profile_begin(editor);
 		skb_rich_text_clear_attribute(&editor->rich_text, text_range, attribute);
+		skb__profile_end(editor, SKB__PROFILE_TEXT, text_profile_start);
 
 		skb__capture_undo_attributes_end(editor, transaction_id);
 
@@ -2815,7 +3424,9 @@ void skb_editor_clear_all_attributes(skb_editor_t* editor, skb_temp_alloc_t* tem
 
 	int32_t transaction_id = skb__capture_undo_attributes_begin(editor, text_range);
 
+	const int64_t text_profile_start = skb__profile_begin(editor);
 	skb_rich_text_clear_all_attributes(&editor->rich_text, text_range);
+	skb__profile_end(editor, SKB__PROFILE_TEXT, text_profile_start);
 
 	skb__capture_undo_attributes_end(editor, transaction_id);
 
@@ -2833,7 +3444,9 @@ void skb_editor_set_paragraph_attribute(skb_editor_t* editor, skb_temp_alloc_t*
 
 	int32_t transaction_id = skb__capture_undo_attributes_begin(editor, text_range);
 
+	const int64_t text_profile_start = skb__profile_begin(editor);
 	skb_rich_text_set_paragraph_attribute(&editor->rich_text, text_range, attribute);
+	skb__profile_end(editor, SKB__PROFILE_TEXT, text_profile_start);
 
 	skb__capture_undo_attributes_end(editor, transaction_id);
 
@@ -2851,7 +3464,9 @@ void skb_editor_set_paragraph_attribute_delta(skb_editor_t* editor, skb_temp_all
 
 	int32_t transaction_id = skb__capture_undo_attributes_begin(editor, text_range);
 
+	const int64_t text_profile_start = skb__profile_begin(editor);
 	skb_rich_text_set_paragraph_attribute_delta(&editor->rich_text, text_range, attribute);
+	skb__profile_end(editor, SKB__PROFILE_TEXT, text_profile_start);
 
 	skb__capture_undo_attributes_end(editor, transaction_id);
 
@@ -2969,6 +3584,11 @@ void skb_editor_set_composition_utf32(skb_editor_t* editor, skb_temp_alloc_t* te
 	if (utf32_len == -1)
 		utf32_len = skb_utf32_strlen(utf32);
 
+	skb__input_args_composition_t args;
+	SKB_ZERO_STRUCT(&args);
+	args.caret_position = caret_position;
+	skb__record_input(editor, SKB_EDITOR_INPUT_SET_COMPOSITION, &args, sizeof(args), utf32, skb_maxi(0, utf32_len) * (int32_t)sizeof(uint32_t));
+
 	const bool had_ime_text = skb_text_get_utf32_count(&editor->composition_text) > 0;
 
 	skb_text_reset(&editor->composition_text);
@@ -3003,6 +3623,14 @@ void skb_editor_commit_composition_utf32(skb_editor_t* editor, skb_temp_alloc_t*
 {
 	assert(editor);
 
+	if (editor->is_recording_input) {
+		if (utf32 && utf32_len < 0) utf32_len = skb_utf32_strlen(utf32);
+		skb__input_args_commit_t args;
+		SKB_ZERO_STRUCT(&args);
+		args.use_composition_text = utf32 == NULL;
+		skb__record_input(editor, SKB_EDITOR_INPUT_COMMIT_COMPOSITION, &args, sizeof(args), utf32, utf32 ? skb_maxi(0, utf32_len) * (int32_t)sizeof(uint32_t) : 0);
+	}
+
 	if (utf32 == NULL) {
 		utf32 = skb_text_get_utf32(&editor->composition_text);
 		utf32_len = skb_text_get_utf32_count(&editor->composition_text);
@@ -3024,6 +3652,7 @@ void skb_editor_commit_composition_utf32(skb_editor_t* editor, skb_temp_alloc_t*
 void skb_editor_clear_composition(skb_editor_t* editor, skb_temp_alloc_t* temp_alloc)
 {
 	assert(editor);
+	skb__record_input(editor, SKB_EDITOR_INPUT_CLEAR_COMPOSITION, NULL, 0, NULL, 0);
 
 	if (skb_text_get_utf32_count(&editor->composition_text)) {
 
@@ -3097,3 +3726,290 @@ skb_caret_info_t skb_editor_get_caret_info_at(const skb_editor_t* editor, skb_te
 
 	return caret;
 }
+
+//
+// Input recording
+//
+
+#define SKB__INPUT_RECORDING_MAGIC SKB_TAG('S','K','B','I')
+#define SKB__INPUT_RECORDING_VERSION 1
+
+// Header of the input recording, followed by the events.
+typedef struct skb__input_recording_header_t {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t abi_hash;		// Hash of the sizes of the recorded structs, recordings from different builds are rejected.
+} skb__input_recording_header_t;
+
+static uint64_t skb__input_recording_abi_hash(void)
+{
+	const uint32_t sizes[] = {
+		(uint32_t)sizeof(skb__input_event_header_t),
+		(uint32_t)sizeof(skb__input_args_key_t),
+		(uint32_t)sizeof(skb__input_args_mouse_t),
+		(uint32_t)sizeof(skb__input_args_range_t),
+		(uint32_t)sizeof(skb__input_args_codepoint_t),
+		(uint32_t)sizeof(skb__input_args_attribute_t),
+		(uint32_t)sizeof(skb__input_args_composition_t),
+		(uint32_t)sizeof(skb__input_args_commit_t),
+		0x01020304, // Byte order
+	};
+	return skb_hash64_append(skb_hash64_empty(), sizes, sizeof(sizes));
+}
+
+static void skb__append_input_recording(skb_editor_t* editor, const void* src, int32_t size)
+{
+	if (size <= 0)
+		return;
+	SKB_ARRAY_RESERVE(editor->input_recording, editor->input_recording_count + size);
+	memcpy(editor->input_recording + editor->input_recording_count, src, size);
+	editor->input_recording_count += size;
+}
+
+static void skb__record_input(skb_editor_t* editor, skb_editor_input_type_t type, const void* args, int32_t args_size, const void* data, int32_t data_size)
+{
+	if (!editor->is_recording_input)
+		return;
+
+	skb__input_event_header_t header;
+	SKB_ZERO_STRUCT(&header); // Clear padding to keep the recording deterministic.
+	header.type = (uint8_t)type;
+	header.args_size = args_size;
+	header.data_size = data_size;
+
+	skb__append_input_recording(editor, &header, sizeof(header));
+	skb__append_input_recording(editor, args, args_size);
+	skb__append_input_recording(editor, data, data_size);
+}
+
+static void skb__record_input_attribute(skb_editor_t* editor, skb_editor_input_type_t type, skb_text_range_t text_range, skb_attribute_t attribute)
+{
+	if (!editor->is_recording_input)
+		return;
+
+	skb__input_args_attribute_t args;
+	SKB_ZERO_STRUCT(&args);
+	args.text_range = text_range;
+	args.attribute = attribute;
+
+	// The language tag pointer is not valid across runs, store the tag instead.
+	const char* lang = NULL;
+	int32_t lang_size = 0;
+	if (attribute.kind == SKB_ATTRIBUTE_LANG) {
+		lang = attribute.lang.lang;
+		lang_size = lang ? (int32_t)strlen(lang) + 1 : 0;
+		args.attribute.lang.lang = NULL;
+	}
+
+	skb__record_input(editor, type, &args, sizeof(args), lang, lang_size);
+}
+
+void skb_editor_begin_input_recording(skb_editor_t* editor)
+{
+	assert(editor);
+
+	editor->input_recording_count = 0;
+	editor->is_recording_input = true;
+
+	const skb__input_recording_header_t header = {
+		.magic = SKB__INPUT_RECORDING_MAGIC,
+		.version = SKB__INPUT_RECORDING_VERSION,
+		.abi_hash = skb__input_recording_abi_hash(),
+	};
+	skb__append_input_recording(editor, &header, sizeof(header));
+}
+
+void skb_editor_end_input_recording(skb_editor_t* editor)
+{
+	assert(editor);
+	editor->is_recording_input = false;
+}
+
+bool skb_editor_is_recording_input(const skb_editor_t* editor)
+{
+	assert(editor);
+	return editor->is_recording_input;
+}
+
+const uint8_t* skb_editor_get_input_recording(const skb_editor_t* editor, int32_t* data_count)
+{
+	assert(editor);
+	assert(data_count);
+	*data_count = editor->input_recording_count;
+	return editor->input_recording;
+}
+
+static int32_t skb__input_args_size(skb_editor_input_type_t type)
+{
+	switch (type) {
+	case SKB_EDITOR_INPUT_KEY_PRESSED: return (int32_t)sizeof(skb__input_args_key_t);
+	case SKB_EDITOR_INPUT_MOUSE_CLICK: return (int32_t)sizeof(skb__input_args_mouse_t);
+	case SKB_EDITOR_INPUT_MOUSE_DRAG: return (int32_t)sizeof(skb__input_args_mouse_t);
+	case SKB_EDITOR_INPUT_INSERT_PARAGRAPH: return (int32_t)sizeof(skb__input_args_attribute_t);
+	case SKB_EDITOR_INPUT_INSERT_CODEPOINT: return (int32_t)sizeof(skb__input_args_codepoint_t);
+	case SKB_EDITOR_INPUT_INSERT_TEXT: return (int32_t)sizeof(skb__input_args_range_t);
+	case SKB_EDITOR_INPUT_INSERT_TEXT_AT_SELECTIONS: return 0;
+	case SKB_EDITOR_INPUT_REMOVE: return (int32_t)sizeof(skb__input_args_range_t);
+	case SKB_EDITOR_INPUT_SET_COMPOSITION: return (int32_t)sizeof(skb__input_args_composition_t);
+	case SKB_EDITOR_INPUT_COMMIT_COMPOSITION: return (int32_t)sizeof(skb__input_args_commit_t);
+	case SKB_EDITOR_INPUT_CLEAR_COMPOSITION: return 0;
+	case SKB_EDITOR_INPUT_TOGGLE_ATTRIBUTE: return (int32_t)sizeof(skb__input_args_attribute_t);
+	case SKB_EDITOR_INPUT_UNDO: return 0;
+	case SKB_EDITOR_INPUT_REDO: return 0;
+	case SKB_EDITOR_INPUT_UPDATE_LAYOUT: return 0;
+	}
+	return -1;
+}
+
+static skb_attribute_t skb__replay_attribute(const skb__input_args_attribute_t* args, const uint8_t* data, int32_t data_size)
+{
+	skb_attribute_t attribute = args->attribute;
+	if (attribute.kind == SKB_ATTRIBUTE_LANG && data_size > 0 && data[data_size - 1] == 0)
+		attribute = skb_attribute_make_lang((const char*)data);
+	return attribute;
+}
+
+int32_t skb_editor_replay_input(skb_editor_t* editor, skb_temp_alloc_t* temp_alloc, const uint8_t* data, int32_t data_count, skb_editor_replay_event_func_t* callback, void* context)
+{
+	assert(editor);
+
+	if (!data || data_count < (int32_t)sizeof(skb__input_recording_header_t))
+		return -1;
+
+	skb__input_recording_header_t header;
+	memcpy(&header, data, sizeof(header));
+	if (header.magic != SKB__INPUT_RECORDING_MAGIC || header.version != SKB__INPUT_RECORDING_VERSION || header.abi_hash != skb__input_recording_abi_hash())
+		return -1;
+
+	// Validate the events before replaying anything.
+	int32_t offset = (int32_t)sizeof(header);
+	while (offset < data_count) {
+		if (data_count - offset < (int32_t)sizeof(skb__input_event_header_t))
+			return -1;
+		skb__input_event_header_t event_header;
+		memcpy(&event_header, data + offset, sizeof(event_header));
+		offset += (int32_t)sizeof(event_header);
+		if (event_header.args_size != skb__input_args_size((skb_editor_input_type_t)event_header.type) || event_header.data_size < 0)
+			return -1;
+		if (event_header.args_size > data_count - offset || event_header.data_size > data_count - offset - event_header.args_size)
+			return -1;
+		offset += event_header.args_size + event_header.data_size;
+	}
+
+	const bool was_profiling = editor->is_profiling;
+	editor->is_profiling = true;
+
+	int32_t event_count = 0;
+	offset = (int32_t)sizeof(header);
+	while (offset < data_count) {
+		skb__input_event_header_t event_header;
+		memcpy(&event_header, data + offset, sizeof(event_header));
+		offset += (int32_t)sizeof(event_header);
+
+		// The args are copied to make sure they are aligned.
+		union {
+			skb__input_args_key_t key;
+			skb__input_args_mouse_t mouse;
+			skb__input_args_range_t range;
+			skb__input_args_codepoint_t codepoint;
+			skb__input_args_attribute_t attribute;
+			skb__input_args_composition_t composition;
+			skb__input_args_commit_t commit;
+		} args;
+		memset(&args, 0, sizeof(args));
+		memcpy(&args, data + offset, event_header.args_size);
+		offset += event_header.args_size;
+
+		const uint8_t* event_data = data + offset;
+		const int32_t event_data_size = event_header.data_size;
+		offset += event_header.data_size;
+
+		// Text data is copied for alignment too.
+		const int32_t utf32_count = event_data_size / (int32_t)sizeof(uint32_t);
+		uint32_t* utf32 = NULL;
+		if (utf32_count > 0) {
+			utf32 = SKB_TEMP_ALLOC(temp_alloc, uint32_t, utf32_count);
+			memcpy(utf32, event_data, utf32_count * sizeof(uint32_t));
+		}
+
+		memset(editor->profile_ticks, 0, sizeof(editor->profile_ticks));
+		const int64_t start = skb_perf_timer_get();
+
+		const skb_editor_input_type_t type = (skb_editor_input_type_t)event_header.type;
+		switch (type) {
+		case SKB_EDITOR_INPUT_KEY_PRESSED:
+			skb_editor_process_key_pressed(editor, temp_alloc, (skb_editor_key_t)args.key.key, args.key.mods);
+			break;
+		case SKB_EDITOR_INPUT_MOUSE_CLICK:
+			skb_editor_process_mouse_click(editor, args.mouse.x, args.mouse.y, args.mouse.mods, args.mouse.time);
+			break;
+		case SKB_EDITOR_INPUT_MOUSE_DRAG:
+			skb_editor_process_mouse_drag(editor, args.mouse.x, args.mouse.y);
+			break;
+		case SKB_EDITOR_INPUT_INSERT_PARAGRAPH:
+			skb_editor_insert_paragraph(editor, temp_alloc, args.attribute.text_range, skb__replay_attribute(&args.attribute, event_data, event_data_size));
+			break;
+		case SKB_EDITOR_INPUT_INSERT_CODEPOINT:
+			skb_editor_insert_codepoint(editor, temp_alloc, args.codepoint.text_range, args.codepoint.codepoint);
+			break;
+		case SKB_EDITOR_INPUT_INSERT_TEXT:
+			skb_editor_insert_text_utf32(editor, temp_alloc, args.range.text_range, utf32, utf32_count);
+			break;
+		case SKB_EDITOR_INPUT_INSERT_TEXT_AT_SELECTIONS:
+			skb_editor_insert_text_utf32_at_selections(editor, temp_alloc, utf32, utf32_count);
+			break;
+		case SKB_EDITOR_INPUT_REMOVE:
+			skb_editor_remove(editor, temp_alloc, args.range.text_range);
+			break;
+		case SKB_EDITOR_INPUT_SET_COMPOSITION:
+			skb_editor_set_composition_utf32(editor, temp_alloc, utf32, utf32_count, args.composition.caret_position);
+			break;
+		case SKB_EDITOR_INPUT_COMMIT_COMPOSITION:
+			if (args.commit.use_composition_text)
+				skb_editor_commit_composition_utf32(editor, temp_alloc, NULL, 0);
+			else {
+				const uint32_t empty_text = 0;
+				skb_editor_commit_composition_utf32(editor, temp_alloc, utf32 ? utf32 : &empty_text, utf32_count);
+			}
+			break;
+		case SKB_EDITOR_INPUT_CLEAR_COMPOSITION:
+			skb_editor_clear_composition(editor, temp_alloc);
+			break;
+		case SKB_EDITOR_INPUT_TOGGLE_ATTRIBUTE:
+			skb_editor_toggle_attribute(editor, temp_alloc, args.attribute.text_range, skb__replay_attribute(&args.attribute, event_data, event_data_size));
+			break;
+		case SKB_EDITOR_INPUT_UNDO:
+			skb_editor_undo(editor, temp_alloc);
+			break;
+		case SKB_EDITOR_INPUT_REDO:
+			skb_editor_redo(editor, temp_alloc);
+			break;
+		case SKB_EDITOR_INPUT_UPDATE_LAYOUT:
+			skb_editor_update_layout(editor, temp_alloc);
+			break;
+		}
+
+		const int64_t end = skb_perf_timer_get();
+
+		if (utf32)
+			SKB_TEMP_FREE(temp_alloc, utf32);
+
+		if (callback) {
+			const skb_editor_replay_event_t event = {
+				.index = event_count,
+				.type = type,
+				.total_us = skb_perf_timer_elapsed_us(start, end),
+				.text_us = skb_perf_timer_elapsed_us(0, editor->profile_ticks[SKB__PROFILE_TEXT]),
+				.layout_us = skb_perf_timer_elapsed_us(0, editor->profile_ticks[SKB__PROFILE_LAYOUT]),
+				.undo_us = skb_perf_timer_elapsed_us(0, editor->profile_ticks[SKB__PROFILE_UNDO]),
+			};
+			callback(editor, &event, context);
+		}
+
+		event_count++;
+	}
+
+	editor->is_profiling = was_profiling;
+
+	return event_count;
+}
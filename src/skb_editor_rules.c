@@ -24,7 +24,6 @@ static bool skb__match_prefix(const skb_editor_t* editor, const skb_paragraph_po
 		return false;
 
 	const int32_t paragraph_utf32_count = skb_text_get_utf32_count(paragraph_text);
-	const uint32_t* paragraph_utf32 = skb_text_get_utf32(paragraph_text);
 
 	const int32_t value_utf8_count = (int32_t)strlen(value_utf8);
 	uint32_t value_utf32[8];
@@ -42,7 +41,7 @@ static bool skb__match_prefix(const skb_editor_t* editor, const skb_paragraph_po
 	int32_t paragraph_offset = paragraph_pos.text_offset - 1;
 	int32_t value_offset = value_utf32_count - 1;
 	while (paragraph_offset >= 0 && value_offset >= 0) {
-		if (value_utf32[value_offset] != paragraph_utf32[paragraph_offset])
+		if (value_utf32[value_offset] != skb_text_get_codepoint(paragraph_text, paragraph_offset))
 			break;
 		paragraph_offset--;
 		value_offset--;
@@ -130,7 +129,11 @@ bool skb_editor_rule_set_process(const skb_editor_rule_set_t* rule_set, skb_edit
 		}
 
 		assert(rule->apply);
-		if (rule->apply(rule, &rule_context, context))
+		// Rules may do multiple edits, relayout once after the rule is applied.
+		skb_editor_begin_batch(editor);
+		const bool applied = rule->apply(rule, &rule_context, context);
+		skb_editor_end_batch(editor, temp_alloc);
+		if (applied)
 			return true;
 	}
 
@@ -228,9 +231,8 @@ static int32_t notes__get_paragraph_start_tab_count(const skb_editor_t* editor,
 	int32_t tab_count = 0;
 	const skb_text_t* text = skb_editor_get_paragraph_text(editor, paragraph_idx);
 	if (text) {
-		const uint32_t* utf32 = skb_text_get_utf32(text);
 		const int32_t utf32_count = skb_text_get_utf32_count(text);
-		while (tab_count < utf32_count && utf32[tab_count] == '\t')
+		while (tab_count < utf32_count && skb_text_get_codepoint(text, tab_count) == '\t')
 			tab_count++;
 	}
 	return tab_count;
@@ -13,6 +13,16 @@
 #include "hb-ot.h"
 #include "skb_layout.h"
 
+#if !defined(SKB_NO_OPEN)
+#include <stdio.h>
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(SKB_PLATFORM_POSIX)
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+#endif // !defined(SKB_NO_OPEN)
+
 //
 // Fonts
 //
@@ -91,6 +101,208 @@ static void skb__append_tags_from_unicodes(hb_set_t* unicodes, skb__sb_tag_array
 	hb_set_destroy(unicodes);
 }
 
+//
+// Font funcs
+//
+
+// Glyph lookups for a font, which are filled lazily on first lookup.
+// The cache is layered on top of the Harfbuzz font using font funcs, so that shaping does not need to go through the cmap and hmtx/HVAR/CFF lookups.
+// The cmap and advances are filled in pages, so that adding a font with lots of glyphs is fast, and only the used parts of the font are cached.
+// Each page is filled completely before its pointer is published with a release store, and readers load the pointer with acquire,
+// so that the same font can be used for shaping from multiple threads. If two threads fill the same page, the first one wins.
+enum {
+	SKB__GLYPH_CACHE_PAGE_SIZE = 256,
+	SKB__GLYPH_CACHE_CMAP_PAGES = 0x10000 / SKB__GLYPH_CACHE_PAGE_SIZE,
+};
+
+// Marks cmap page which has been filled, but has no glyphs.
+static const uint16_t skb__empty_cmap_page[SKB__GLYPH_CACHE_PAGE_SIZE] = {0};
+
+typedef struct skb__font_glyph_cache_t {
+	void* volatile cmap_pages[SKB__GLYPH_CACHE_CMAP_PAGES];	// Direct mapped glyph ids for BMP codepoints. NULL if the page is not filled yet, skb__empty_cmap_page if it has no glyphs.
+	void* volatile* h_advance_pages;	// Horizontal advances of the glyphs, in the units of the font. NULL if the page is not filled yet.
+	int32_t glyphs_count;				// Number of glyphs in the font.
+} skb__font_glyph_cache_t;
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+static inline void* skb__atomic_load_ptr_acquire(void* volatile* ptr)
+{
+#if defined(_M_ARM64)
+	return (void*)__ldar64((unsigned __int64 volatile*)ptr);
+#else
+	// Loads are not reordered with other loads on x86/x64, only prevent compiler reordering.
+	void* value = *ptr;
+	_ReadWriteBarrier();
+	return value;
+#endif
+}
+// Stores desired if ptr is NULL, and returns the value of ptr before the store. Interlocked functions are full barriers.
+static inline void* skb__atomic_publish_ptr(void* volatile* ptr, void* desired)
+{
+	return _InterlockedCompareExchangePointer(ptr, desired, NULL);
+}
+#else
+static inline void* skb__atomic_load_ptr_acquire(void* volatile* ptr)
+{
+	return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+// Stores desired if ptr is NULL, and returns the value of ptr before the store.
+static inline void* skb__atomic_publish_ptr(void* volatile* ptr, void* desired)
+{
+	void* expected = NULL;
+	__atomic_compare_exchange_n(ptr, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+	return expected;
+}
+#endif
+
+static skb__font_glyph_cache_t* skb__font_glyph_cache_create(hb_font_t* hb_font)
+{
+	skb__font_glyph_cache_t* cache = skb_malloc(sizeof(skb__font_glyph_cache_t));
+	memset(cache, 0, sizeof(skb__font_glyph_cache_t));
+
+	// The font variation is fixed per font, so the advances are valid for the lifetime of the font.
+	cache->glyphs_count = (int32_t)hb_face_get_glyph_count(hb_font_get_face(hb_font));
+	if (cache->glyphs_count > 0) {
+		const int32_t pages_count = (cache->glyphs_count + SKB__GLYPH_CACHE_PAGE_SIZE - 1) / SKB__GLYPH_CACHE_PAGE_SIZE;
+		cache->h_advance_pages = skb_malloc(sizeof(void*) * pages_count);
+		memset((void*)cache->h_advance_pages, 0, sizeof(void*) * pages_count);
+	}
+
+	return cache;
+}
+
+static void skb__font_glyph_cache_destroy(void* data)
+{
+	skb__font_glyph_cache_t* cache = data;
+	if (!cache) return;
+	for (int32_t i = 0; i < SKB__GLYPH_CACHE_CMAP_PAGES; i++) {
+		if (cache->cmap_pages[i] != skb__empty_cmap_page)
+			skb_free(cache->cmap_pages[i]);
+	}
+	const int32_t pages_count = (cache->glyphs_count + SKB__GLYPH_CACHE_PAGE_SIZE - 1) / SKB__GLYPH_CACHE_PAGE_SIZE;
+	for (int32_t i = 0; i < pages_count; i++)
+		skb_free(cache->h_advance_pages[i]);
+	skb_free((void*)cache->h_advance_pages);
+	skb_free(cache);
+}
+
+static const uint16_t* skb__font_glyph_cache_get_cmap_page(skb__font_glyph_cache_t* cache, hb_font_t* parent_font, int32_t page_idx)
+{
+	const uint16_t* filled_page = skb__atomic_load_ptr_acquire(&cache->cmap_pages[page_idx]);
+	if (filled_page)
+		return filled_page;
+
+	// Fill the page from the parent font, the page is allocated only if it has glyphs.
+	const hb_codepoint_t first_unicode = (hb_codepoint_t)page_idx * SKB__GLYPH_CACHE_PAGE_SIZE;
+	uint16_t* page = NULL;
+	for (int32_t i = 0; i < SKB__GLYPH_CACHE_PAGE_SIZE; i++) {
+		hb_codepoint_t gid = 0;
+		if (!hb_font_get_nominal_glyph(parent_font, first_unicode + i, &gid) || gid > 0xffff)
+			continue;
+		if (!page) {
+			page = skb_malloc(sizeof(uint16_t) * SKB__GLYPH_CACHE_PAGE_SIZE);
+			memset(page, 0, sizeof(uint16_t) * SKB__GLYPH_CACHE_PAGE_SIZE);
+		}
+		page[i] = (uint16_t)gid;
+	}
+
+	// Publish the page, or use the page filled by another thread.
+	void* new_page = page ? page : (void*)skb__empty_cmap_page;
+	const uint16_t* prev_page = skb__atomic_publish_ptr(&cache->cmap_pages[page_idx], new_page);
+	if (prev_page) {
+		skb_free(page);
+		return prev_page;
+	}
+
+	return new_page;
+}
+
+static const hb_position_t* skb__font_glyph_cache_get_h_advance_page(skb__font_glyph_cache_t* cache, hb_font_t* parent_font, int32_t page_idx)
+{
+	const hb_position_t* filled_page = skb__atomic_load_ptr_acquire(&cache->h_advance_pages[page_idx]);
+	if (filled_page)
+		return filled_page;
+
+	// Fill the page from the parent font.
+	hb_position_t* page = skb_malloc(sizeof(hb_position_t) * SKB__GLYPH_CACHE_PAGE_SIZE);
+	hb_codepoint_t glyphs[SKB__GLYPH_CACHE_PAGE_SIZE];
+	const int32_t first_gid = page_idx * SKB__GLYPH_CACHE_PAGE_SIZE;
+	const int32_t count = skb_mini(SKB__GLYPH_CACHE_PAGE_SIZE, cache->glyphs_count - first_gid);
+	for (int32_t i = 0; i < count; i++)
+		glyphs[i] = (hb_codepoint_t)(first_gid + i);
+	hb_font_get_glyph_h_advances(parent_font, (unsigned int)count, glyphs, sizeof(hb_codepoint_t), page, sizeof(hb_position_t));
+
+	// Publish the page, or use the page filled by another thread.
+	const hb_position_t* prev_page = skb__atomic_publish_ptr(&cache->h_advance_pages[page_idx], page);
+	if (prev_page) {
+		skb_free(page);
+		return prev_page;
+	}
+
+	return page;
+}
+
+static hb_bool_t skb__hb_get_nominal_glyph(hb_font_t* font, void* font_data, hb_codepoint_t unicode, hb_codepoint_t* glyph, void* user_data)
+{
+	skb__font_glyph_cache_t* cache = font_data;
+	if (unicode <= 0xffff) {
+		const uint16_t* page = skb__font_glyph_cache_get_cmap_page(cache, hb_font_get_parent(font), (int32_t)(unicode / SKB__GLYPH_CACHE_PAGE_SIZE));
+		*glyph = page ? page[unicode % SKB__GLYPH_CACHE_PAGE_SIZE] : 0;
+		return *glyph != 0;
+	}
+	return hb_font_get_nominal_glyph(hb_font_get_parent(font), unicode, glyph);
+}
+
+static unsigned int skb__hb_get_nominal_glyphs(
+	hb_font_t* font, void* font_data, unsigned int count,
+	const hb_codepoint_t* first_unicode, unsigned int unicode_stride,
+	hb_codepoint_t* first_glyph, unsigned int glyph_stride, void* user_data)
+{
+	// Returns the number of glyphs found before first missing glyph.
+	for (unsigned int i = 0; i < count; i++) {
+		const hb_codepoint_t unicode = *(const hb_codepoint_t*)((const uint8_t*)first_unicode + i * unicode_stride);
+		hb_codepoint_t* glyph = (hb_codepoint_t*)((uint8_t*)first_glyph + i * glyph_stride);
+		if (!skb__hb_get_nominal_glyph(font, font_data, unicode, glyph, user_data))
+			return i;
+	}
+	return count;
+}
+
+static hb_position_t skb__hb_get_glyph_h_advance(hb_font_t* font, void* font_data, hb_codepoint_t glyph, void* user_data)
+{
+	skb__font_glyph_cache_t* cache = font_data;
+	if (glyph < (hb_codepoint_t)cache->glyphs_count) {
+		const hb_position_t* page = skb__font_glyph_cache_get_h_advance_page(cache, hb_font_get_parent(font), (int32_t)(glyph / SKB__GLYPH_CACHE_PAGE_SIZE));
+		return page[glyph % SKB__GLYPH_CACHE_PAGE_SIZE];
+	}
+	return hb_font_get_glyph_h_advance(hb_font_get_parent(font), glyph);
+}
+
+static void skb__hb_get_glyph_h_advances(
+	hb_font_t* font, void* font_data, unsigned int count,
+	const hb_codepoint_t* first_glyph, unsigned int glyph_stride,
+	hb_position_t* first_advance, unsigned int advance_stride, void* user_data)
+{
+	for (unsigned int i = 0; i < count; i++) {
+		const hb_codepoint_t glyph = *(const hb_codepoint_t*)((const uint8_t*)first_glyph + i * glyph_stride);
+		hb_position_t* advance = (hb_position_t*)((uint8_t*)first_advance + i * advance_stride);
+		*advance = skb__hb_get_glyph_h_advance(font, font_data, glyph, user_data);
+	}
+}
+
+static hb_font_funcs_t* skb__create_font_funcs(void)
+{
+	// The functions not set here fall through to the parent font.
+	hb_font_funcs_t* font_funcs = hb_font_funcs_create();
+	hb_font_funcs_set_nominal_glyph_func(font_funcs, skb__hb_get_nominal_glyph, NULL, NULL);
+	hb_font_funcs_set_nominal_glyphs_func(font_funcs, skb__hb_get_nominal_glyphs, NULL, NULL);
+	hb_font_funcs_set_glyph_h_advance_func(font_funcs, skb__hb_get_glyph_h_advance, NULL, NULL);
+	hb_font_funcs_set_glyph_h_advances_func(font_funcs, skb__hb_get_glyph_h_advances, NULL, NULL);
+	hb_font_funcs_make_immutable(font_funcs);
+	return font_funcs;
+}
+
 static skb_font_handle_t skb__make_font_handle(int32_t index, uint32_t generation)
 {
 	assert(index >= 0 && index <= 0xffff);
@@ -138,6 +350,11 @@ static void skb__font_destroy(skb_font_collection_t* font_collection, skb_font_t
 }
 
 
+static inline uint32_t skb__read_be32(const uint8_t* data)
+{
+	return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | (uint32_t)data[3];
+}
+
 static skb_font_t* skb__font_create(skb_font_collection_t* font_collection, hb_font_t* hb_font, const char* name, uint8_t font_family)
 {
 	assert(hb_font);
@@ -162,10 +379,6 @@ static skb_font_t* skb__font_create(skb_font_collection_t* font_collection, hb_f
 	font->next_free = SKB_INVALID_INDEX;
 	font->handle = skb__make_font_handle(font_idx, generation);
 
-	// Keep reference to the HB font
-	font->hb_font = hb_font;
-	hb_font_reference(font->hb_font);
-
 	hb_face_t* face = hb_font_get_face(hb_font);
 	assert(face);
 
@@ -183,6 +396,10 @@ static skb_font_t* skb__font_create(skb_font_collection_t* font_collection, hb_f
 	hb_face_collect_unicodes(face, font->unicodes);
 	skb__append_tags_from_unicodes(font->unicodes, &scripts);
 
+	// Layer cached glyph lookups on top of the HB font. The sub font keeps reference to the HB font.
+	font->hb_font = hb_font_create_sub_font(hb_font);
+	hb_font_set_funcs(font->hb_font, font_collection->font_funcs, skb__font_glyph_cache_create(hb_font), skb__font_glyph_cache_destroy);
+
 	// Check synthetic properties.
 	float synthetic_weight = 0.f;
 	float synthetic_embolden_x = 0.f;
@@ -210,6 +427,14 @@ static skb_font_t* skb__font_create(skb_font_collection_t* font_collection, hb_f
 	const float width = hb_style_get_value(hb_font, HB_STYLE_TAG_WIDTH);
 	font->stretch = width / 100.f;
 
+	// Code pages, used to prefer fonts of the requested language.
+	hb_blob_t* os2_blob = hb_face_reference_table(face, HB_TAG('O','S','/','2'));
+	unsigned int os2_size = 0;
+	const uint8_t* os2 = (const uint8_t*)hb_blob_get_data(os2_blob, &os2_size);
+	if (os2 && os2_size >= 82)
+		font->code_page_range = skb__read_be32(os2 + 78);
+	hb_blob_destroy(os2_blob);
+
 	font->font_family = font_family;
 
 	// Store name
@@ -218,18 +443,32 @@ static skb_font_t* skb__font_create(skb_font_collection_t* font_collection, hb_f
 	memcpy(font->name, name, name_len);
 
 	// Append synthetic markers.
-	if (skb_absf(synthetic_embolden_x) > 1e-6f || skb_absf(synthetic_embolden_y) > 1e-6f) {
+	const bool has_synthetic_bold = skb_absf(synthetic_embolden_x) > 1e-6f || skb_absf(synthetic_embolden_y) > 1e-6f;
+	const bool has_synthetic_slant = skb_absf(synthetic_slant) > 1e-6f;
+	if (has_synthetic_bold) {
 		font->name[name_len++] = '_';
 		font->name[name_len++] = 'B';
 	}
-	if (skb_absf(synthetic_slant) > 1e-6f) {
+	if (has_synthetic_slant) {
 		font->name[name_len++] = '_';
 		font->name[name_len++] = 'I';
 	}
 	font->name[name_len] = '\0';
 
-	// Hash name for ID
-	font->hash = skb_hash64_append_str(skb_hash64_empty(), font->name);
+	// Hash font data and face index for ID, so that different fonts with same name get different ID.
+	// If the face has no blob (e.g. created from tables), fall back to the name.
+	hb_blob_t* face_blob = hb_face_reference_blob(face);
+	unsigned int face_data_length = 0;
+	const char* face_data = hb_blob_get_data(face_blob, &face_data_length);
+	uint64_t hash = skb_hash64_empty();
+	if (face_data && face_data_length > 0)
+		hash = skb_hash64_append(hash, face_data, face_data_length);
+	else
+		hash = skb_hash64_append_str(hash, name);
+	hash = skb_hash64_append_uint32(hash, hb_face_get_index(face));
+	hash = skb_hash64_append_uint8(hash, (uint8_t)((has_synthetic_bold ? 1 : 0) | (has_synthetic_slant ? 2 : 0)));
+	font->hash = hash;
+	hb_blob_destroy(face_blob);
 
 	// Store supported scripts
 	font->scripts = scripts.tags;
@@ -300,6 +539,33 @@ static skb_font_t* skb__font_create(skb_font_collection_t* font_collection, hb_f
 	font->caret_metrics.offset = (float)caret_offset * font->upem_scale;
 	font->caret_metrics.slope = -(float)caret_run / (float)caret_rise;
 
+	// Space glyph, used in place of control characters.
+	hb_codepoint_t space_gid = 0;
+	hb_font_get_nominal_glyph(font->hb_font, 0x20 /*space*/, &space_gid);
+	font->space_gid = space_gid;
+	font->space_advance = (float)hb_font_get_glyph_h_advance(font->hb_font, space_gid) * font->upem_scale;
+
+	// Ellipsis glyph. Try to use the actual ellipsis character, but fall back to 3 periods.
+	hb_codepoint_t ellipsis_gid = 0;
+	font->ellipsis_glyph_count = 1;
+	if (hb_font_get_glyph(font->hb_font, 0x2026 /*ellipsis*/, 0, &ellipsis_gid))
+		font->ellipsis_glyph_count = 1;
+	else if (hb_font_get_glyph(font->hb_font, 0x2e /*period*/, 0, &ellipsis_gid))
+		font->ellipsis_glyph_count = 3;
+	font->ellipsis_gid = ellipsis_gid;
+	font->ellipsis_advance = (float)hb_font_get_glyph_h_advance(font->hb_font, ellipsis_gid) * font->upem_scale;
+	hb_position_t ellipsis_origin_x, ellipsis_origin_y;
+	if (hb_font_get_glyph_h_origin(font->hb_font, ellipsis_gid, &ellipsis_origin_x, &ellipsis_origin_y)) {
+		font->ellipsis_offset.x = (float)ellipsis_origin_x * font->upem_scale;
+		font->ellipsis_offset.y = (float)ellipsis_origin_y * font->upem_scale;
+	}
+
+	// Tracking and optical size can change the shaping results depending on font size.
+	hb_blob_t* trak_blob = hb_face_reference_table(face, HB_TAG('t','r','a','k'));
+	hb_ot_var_axis_info_t opsz_axis_info;
+	font->has_size_dependent_shaping = hb_blob_get_length(trak_blob) > 0 || hb_ot_var_find_axis_info(face, HB_OT_TAG_VAR_AXIS_OPTICAL_SIZE, &opsz_axis_info);
+	hb_blob_destroy(trak_blob);
+
 	// Cache glyph bounds
 	font->glyph_bounds_count = (int32_t)hb_face_get_glyph_count(face);
 	if (font->glyph_bounds_count > 0) {
@@ -331,6 +597,7 @@ skb_font_collection_t* skb_font_collection_create(void)
 
 	result->id = ++id;
 	result->fonts_free_list = SKB_INVALID_INDEX;
+	result->font_funcs = skb__create_font_funcs();
 
 	return result;
 }
@@ -341,6 +608,7 @@ void skb_font_collection_destroy(skb_font_collection_t* font_collection)
 	for (int32_t i = 0; i < font_collection->fonts_count; i++)
 		skb__font_destroy(font_collection, &font_collection->fonts[i]);
 	skb_free(font_collection->fonts);
+	hb_font_funcs_destroy(font_collection->font_funcs);
 	skb_free(font_collection);
 }
 
@@ -525,9 +793,36 @@ static bool skb__supports_script(const skb_font_t* font, uint8_t script)
 	return false;
 }
 
-int32_t skb__match_fonts(
+uint32_t skb__lang_to_font_code_pages(const char* lang)
+{
+	if (!lang || !*lang)
+		return 0;
+
+	hb_language_t hb_lang = hb_language_from_string(lang, -1);
+	if (hb_language_matches(hb_language_from_string("ja", 2), hb_lang))
+		return 1u << 17; // JIS/Japan
+	if (hb_language_matches(hb_language_from_string("ko", 2), hb_lang))
+		return (1u << 19) | (1u << 21); // Korean Wansung, Korean Johab
+	if (hb_language_matches(hb_language_from_string("zh-hant", 7), hb_lang)
+		|| hb_language_matches(hb_language_from_string("zh-tw", 5), hb_lang)
+		|| hb_language_matches(hb_language_from_string("zh-hk", 5), hb_lang))
+		return 1u << 20; // Chinese Traditional
+	if (hb_language_matches(hb_language_from_string("zh", 2), hb_lang))
+		return 1u << 18; // Chinese Simplified
+
+	return 0;
+}
+
+static bool skb__font_matches_script_and_family(const skb_font_t* font, uint8_t requested_script, uint8_t requested_font_family)
+{
+	// Ignore script for emoji fonts, as emojis are the same on each writing system.
+	return font->font_family == requested_font_family
+		&& (requested_font_family == SKB_FONT_FAMILY_EMOJI || skb__supports_script(font, requested_script));
+}
+
+static int32_t skb__match_fonts(
 	const skb_font_collection_t* font_collection,
-	const char* requested_lang, const uint8_t requested_script, uint8_t requested_font_family,
+	uint32_t requested_code_pages, const uint8_t requested_script, uint8_t requested_font_family,
 	skb_weight_t requested_weight, skb_style_t requested_style, skb_stretch_t requested_stretch,
 	skb_font_handle_t* results, int32_t results_cap)
 {
@@ -539,11 +834,23 @@ int32_t skb__match_fonts(
 	bool multiple_styles = false;
 	bool multiple_weights = false;
 
+	// Prefer fonts made for the requested language (e.g. Japanese over Chinese Han fonts), if there are any.
+	bool match_code_pages = false;
+	if (requested_code_pages) {
+		for (int32_t font_idx = 0; font_idx < font_collection->fonts_count; font_idx++) {
+			const skb_font_t* font = &font_collection->fonts[font_idx];
+			if (skb__font_matches_script_and_family(font, requested_script, requested_font_family) && (font->code_page_range & requested_code_pages)) {
+				match_code_pages = true;
+				break;
+			}
+		}
+	}
+
 	// Match script and font family.
 	for (int32_t font_idx = 0; font_idx < font_collection->fonts_count; font_idx++) {
 		const skb_font_t* font = &font_collection->fonts[font_idx];
-		if (font->font_family == requested_font_family
-			&& (requested_font_family == SKB_FONT_FAMILY_EMOJI || skb__supports_script(font, requested_script))) { // Ignore script for emoji fonts, as emojis are the same on each writing system.
+		if (skb__font_matches_script_and_family(font, requested_script, requested_font_family)
+			&& (!match_code_pages || (font->code_page_range & requested_code_pages))) {
 			if (results_count < results_cap) {
 				if (results_count > 0) {
 					const skb_font_t* prev_font = skb__get_font_unchecked(font_collection, results[results_count - 1]);
@@ -756,14 +1063,14 @@ int32_t skb__match_fonts(
 	return results_count;
 }
 
-int32_t skb_font_collection_match_fonts(
+int32_t skb__font_collection_match_fonts(
 	skb_font_collection_t* font_collection,
-	const char* requested_lang, const uint8_t requested_script, uint8_t requested_font_family,
+	const char* requested_lang, uint32_t requested_code_pages, const uint8_t requested_script, uint8_t requested_font_family,
 	skb_weight_t requested_weight, skb_style_t requested_style, skb_stretch_t requested_stretch,
 	skb_font_handle_t* results, int32_t results_cap)
 {
 	int32_t results_count =  skb__match_fonts(
-		font_collection, requested_lang, requested_script, requested_font_family,
+		font_collection, requested_code_pages, requested_script, requested_font_family,
 		requested_weight, requested_style, requested_stretch, results, results_cap);
 
 	if (results_count != 0)
@@ -773,7 +1080,7 @@ int32_t skb_font_collection_match_fonts(
 	if (font_collection->fallback_func) {
 		if (font_collection->fallback_func(font_collection, requested_lang, requested_script, requested_font_family, font_collection->fallback_context)) {
 			results_count =  skb__match_fonts(
-				font_collection, requested_lang, requested_script, requested_font_family,
+				font_collection, requested_code_pages, requested_script, requested_font_family,
 				requested_weight, requested_style, requested_stretch, results, results_cap);
 		}
 	}
@@ -781,6 +1088,18 @@ int32_t skb_font_collection_match_fonts(
 	return results_count;
 }
 
+int32_t skb_font_collection_match_fonts(
+	skb_font_collection_t* font_collection,
+	const char* requested_lang, const uint8_t requested_script, uint8_t requested_font_family,
+	skb_weight_t requested_weight, skb_style_t requested_style, skb_stretch_t requested_stretch,
+	skb_font_handle_t* results, int32_t results_cap)
+{
+	// Only the layout language profiles opt in to the language based font preference.
+	return skb__font_collection_match_fonts(
+		font_collection, requested_lang, 0, requested_script, requested_font_family,
+		requested_weight, requested_style, requested_stretch, results, results_cap);
+}
+
 bool skb_font_collection_font_has_codepoint(const skb_font_collection_t* font_collection, skb_font_handle_t font_handle, uint32_t codepoint)
 {
 	const skb_font_t* font = skb__get_font_by_handle(font_collection, font_handle);
@@ -808,6 +1127,24 @@ uint32_t skb_font_collection_get_id(const skb_font_collection_t* font_collection
 	return font_collection->id;
 }
 
+skb_font_handle_t skb_font_collection_find_font_by_hash(const skb_font_collection_t* font_collection, uint64_t font_hash)
+{
+	assert(font_collection);
+	for (int32_t i = 0; i < font_collection->fonts_count; i++) {
+		const skb_font_t* font = &font_collection->fonts[i];
+		if (font->hb_font && font->hash == font_hash)
+			return font->handle;
+	}
+	return 0;
+}
+
+uint64_t skb_font_get_hash(const skb_font_collection_t* font_collection, skb_font_handle_t font_handle)
+{
+	const skb_font_t* font = skb__get_font_by_handle(font_collection, font_handle);
+	if (!font) return 0;
+	return font->hash;
+}
+
 skb_rect2_t skb_font_get_glyph_bounds(const skb_font_collection_t* font_collection, const skb_font_handle_t font_handle, uint32_t glyph_id, float font_size)
 {
 	const skb_font_t* font = skb__get_font_by_handle(font_collection, font_handle);
@@ -926,3 +1263,795 @@ float skb_font_get_baseline(const skb_font_collection_t* font_collection, const
 	if (!baseline_set) return 0.f;
 	return baseline_set->baselines[baseline] * font_size;
 }
+
+//
+// Font index
+//
+
+#if !defined(SKB_NO_OPEN)
+
+#define SKB__FONT_INDEX_MAGIC SKB_TAG('S','K','B','F')
+#define SKB__FONT_INDEX_VERSION 1
+#define SKB__FONT_INDEX_COVERAGE_PAGES 768		// Number of 256 codepoint pages in Unicode planes 0-2.
+#define SKB__FONT_INDEX_MAX_SCRIPTS 192			// Size of the script bitset, larger than the highest SBScript value.
+#define SKB__FONT_INDEX_MAX_DEPTH 16			// Maximum depth of subdirectories to scan.
+#define SKB__FONT_INDEX_MAX_PATH 1024
+
+// Font face stored in the font index. The faces are stored as is in the serialized index.
+typedef struct skb__font_index_face_t {
+	int64_t mtime;						// Modification time of the font file, used to detect changed files.
+	int64_t file_size;					// Size of the font file, used to detect changed files.
+	int32_t path_offset;				// Offset of the zero terminated path in the index strings. Faces of the same file are stored consecutively.
+	int32_t family_name_offset;			// Offset of the zero terminated family name in the index strings.
+	int32_t face_index;					// Index of the face in the font file.
+	uint32_t code_page_range;			// OS/2 ulCodePageRange1, used to match the language of CJK fonts.
+	uint16_t weight;					// Weight of the default instance.
+	uint16_t weight_min;				// Weight range of a variable font, same as weight for static fonts.
+	uint16_t weight_max;
+	uint8_t style;						// See skb_style_t.
+	uint8_t font_family;				// Generic family of the font, see skb_font_family_t.
+	float stretch;
+	uint64_t scripts[SKB__FONT_INDEX_MAX_SCRIPTS / 64];			// Bitset of the supported scripts.
+	uint64_t coverage[SKB__FONT_INDEX_COVERAGE_PAGES / 64];		// Bitset of the codepoint pages the font has glyphs for.
+} skb__font_index_face_t;
+
+typedef struct skb_font_index_t {
+	skb__font_index_face_t* faces;
+	int32_t faces_count;
+	int32_t faces_cap;
+
+	char* strings;						// Zero terminated paths and family names of the faces.
+	int32_t strings_count;
+	int32_t strings_cap;
+} skb_font_index_t;
+
+// Header of the serialized font index, followed by the faces, and the strings.
+typedef struct skb__font_index_header_t {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t abi_hash;					// Hash of the sizes of the stored structs, indices from different builds are rejected.
+	int32_t size;						// Total size of the data in bytes.
+	int32_t faces_count;
+	int32_t strings_count;
+} skb__font_index_header_t;
+
+// Face read from a font file during scanning.
+typedef struct skb__font_index_scanned_face_t {
+	skb__font_index_face_t face;
+	char family_name[128];
+} skb__font_index_scanned_face_t;
+
+// Font file found during scanning.
+typedef struct skb__font_index_file_t {
+	int32_t path_offset;				// Offset of the path in the scan paths.
+	int64_t mtime;
+	int64_t file_size;
+	int32_t existing_face_idx;			// Index of the first face of an unchanged file in the index, or SKB_INVALID_INDEX if the file needs to be scanned.
+	skb__font_index_scanned_face_t* scanned_faces;
+	int32_t scanned_faces_count;
+} skb__font_index_file_t;
+
+typedef struct skb__font_index_scan_t {
+	skb__font_index_file_t* files;
+	int32_t files_count;
+	int32_t files_cap;
+
+	int32_t* changed_files;				// Indices of the files to scan.
+	int32_t changed_files_count;
+	int32_t changed_files_cap;
+
+	char* paths;
+	int32_t paths_count;
+	int32_t paths_cap;
+} skb__font_index_scan_t;
+
+static inline void skb__font_index_set_bit(uint64_t* bits, int32_t idx)
+{
+	bits[idx >> 6] |= 1ull << (idx & 63);
+}
+
+static inline bool skb__font_index_has_bit(const uint64_t* bits, int32_t idx)
+{
+	return (bits[idx >> 6] & (1ull << (idx & 63))) != 0;
+}
+
+static int32_t skb__font_index_count_bits(const uint64_t* bits, int32_t count)
+{
+	int32_t result = 0;
+	for (int32_t i = 0; i < count; i++) {
+		uint64_t v = bits[i];
+		while (v) {
+			v &= v - 1;
+			result++;
+		}
+	}
+	return result;
+}
+
+static bool skb__is_font_file_name(const char* name)
+{
+	const char* ext = strrchr(name, '.');
+	if (!ext || strlen(ext) != 4)
+		return false;
+	char lower_ext[5] = {0};
+	for (int32_t i = 0; i < 4; i++)
+		lower_ext[i] = (ext[i] >= 'A' && ext[i] <= 'Z') ? (char)(ext[i] - 'A' + 'a') : ext[i];
+	return strcmp(lower_ext, ".ttf") == 0 || strcmp(lower_ext, ".otf") == 0 || strcmp(lower_ext, ".ttc") == 0 || strcmp(lower_ext, ".otc") == 0;
+}
+
+static void skb__font_index_add_file(skb__font_index_scan_t* scan, const char* path, int64_t mtime, int64_t file_size)
+{
+	const int32_t path_len = (int32_t)strlen(path);
+	SKB_ARRAY_RESERVE(scan->paths, scan->paths_count + path_len + 1);
+	const int32_t path_offset = scan->paths_count;
+	memcpy(scan->paths + path_offset, path, path_len + 1);
+	scan->paths_count += path_len + 1;
+
+	SKB_ARRAY_RESERVE(scan->files, scan->files_count + 1);
+	skb__font_index_file_t* file = &scan->files[scan->files_count++];
+	SKB_ZERO_STRUCT(file);
+	file->path_offset = path_offset;
+	file->mtime = mtime;
+	file->file_size = file_size;
+	file->existing_face_idx = SKB_INVALID_INDEX;
+}
+
+static void skb__font_index_walk_directory(skb__font_index_scan_t* scan, const char* path, int32_t depth)
+{
+	char child_path[SKB__FONT_INDEX_MAX_PATH];
+
+#if defined(_WIN32)
+	char pattern[SKB__FONT_INDEX_MAX_PATH];
+	if (snprintf(pattern, SKB_COUNTOF(pattern), "%s/*", path) >= (int)SKB_COUNTOF(pattern))
+		return;
+
+	WIN32_FIND_DATAA find_data;
+	HANDLE find = FindFirstFileA(pattern, &find_data);
+	if (find == INVALID_HANDLE_VALUE)
+		return;
+
+	do {
+		const char* name = find_data.cFileName;
+		if (name[0] == '.')
+			continue;
+		if (snprintf(child_path, SKB_COUNTOF(child_path), "%s/%s", path, name) >= (int)SKB_COUNTOF(child_path))
+			continue;
+		if (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+			// Do not follow directory junctions and symlinks to avoid loops.
+			if ((find_data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) == 0 && depth < SKB__FONT_INDEX_MAX_DEPTH)
+				skb__font_index_walk_directory(scan, child_path, depth + 1);
+		} else if (skb__is_font_file_name(name)) {
+			const int64_t mtime = ((int64_t)find_data.ftLastWriteTime.dwHighDateTime << 32) | (int64_t)find_data.ftLastWriteTime.dwLowDateTime;
+			const int64_t file_size = ((int64_t)find_data.nFileSizeHigh << 32) | (int64_t)find_data.nFileSizeLow;
+			skb__font_index_add_file(scan, child_path, mtime, file_size);
+		}
+	} while (FindNextFileA(find, &find_data));
+
+	FindClose(find);
+
+#elif defined(SKB_PLATFORM_POSIX)
+	DIR* dir = opendir(path);
+	if (!dir)
+		return;
+
+	struct dirent* entry = NULL;
+	while ((entry = readdir(dir)) != NULL) {
+		const char* name = entry->d_name;
+		if (name[0] == '.')
+			continue;
+		if (snprintf(child_path, SKB_COUNTOF(child_path), "%s/%s", path, name) >= (int)SKB_COUNTOF(child_path))
+			continue;
+		// Do not follow symlinked directories to avoid loops, symlinked font files are followed.
+		struct stat st;
+		if (lstat(child_path, &st) != 0)
+			continue;
+		if (S_ISLNK(st.st_mode)) {
+			if (stat(child_path, &st) != 0 || S_ISDIR(st.st_mode))
+				continue;
+		}
+		if (S_ISDIR(st.st_mode)) {
+			if (depth < SKB__FONT_INDEX_MAX_DEPTH)
+				skb__font_index_walk_directory(scan, child_path, depth + 1);
+		} else if (S_ISREG(st.st_mode) && skb__is_font_file_name(name)) {
+			skb__font_index_add_file(scan, child_path, (int64_t)st.st_mtime, (int64_t)st.st_size);
+		}
+	}
+
+	closedir(dir);
+#else
+	// Directory scanning is not supported on this platform.
+	(void)scan;
+	(void)path;
+	(void)depth;
+	(void)child_path;
+#endif
+}
+
+static uint8_t skb__font_index_classify_family(hb_face_t* face, bool has_emoji, bool has_latin)
+{
+	const bool has_color = hb_ot_color_has_layers(face) || hb_ot_color_has_paint(face) || hb_ot_color_has_png(face) || hb_ot_color_has_svg(face);
+	if (has_emoji && (has_color || !has_latin))
+		return SKB_FONT_FAMILY_EMOJI;
+
+	if (hb_ot_math_has_data(face))
+		return SKB_FONT_FAMILY_MATH;
+
+	// post.isFixedPitch
+	bool is_fixed_pitch = false;
+	hb_blob_t* post_blob = hb_face_reference_table(face, HB_TAG('p','o','s','t'));
+	unsigned int post_size = 0;
+	const uint8_t* post = (const uint8_t*)hb_blob_get_data(post_blob, &post_size);
+	if (post && post_size >= 16)
+		is_fixed_pitch = skb__read_be32(post + 12) != 0;
+	hb_blob_destroy(post_blob);
+
+	// OS/2.sFamilyClass and OS/2.panose
+	uint8_t family_class = 0;
+	uint8_t panose_family = 0;
+	uint8_t panose_serif = 0;
+	uint8_t panose_proportion = 0;
+	hb_blob_t* os2_blob = hb_face_reference_table(face, HB_TAG('O','S','/','2'));
+	unsigned int os2_size = 0;
+	const uint8_t* os2 = (const uint8_t*)hb_blob_get_data(os2_blob, &os2_size);
+	if (os2 && os2_size >= 42) {
+		family_class = os2[30];
+		panose_family = os2[32];
+		panose_serif = os2[33];
+		panose_proportion = os2[35];
+	}
+	hb_blob_destroy(os2_blob);
+
+	const bool is_latin_text = panose_family == 2;
+	if (is_fixed_pitch || (is_latin_text && panose_proportion == 9))
+		return SKB_FONT_FAMILY_MONOSPACE;
+	if (family_class == 8 || (is_latin_text && panose_serif >= 11 && panose_serif <= 13))
+		return SKB_FONT_FAMILY_SANS_SERIF;
+	if ((family_class >= 1 && family_class <= 7 && family_class != 6) || (is_latin_text && panose_serif >= 2 && panose_serif <= 10))
+		return SKB_FONT_FAMILY_SERIF;
+
+	return SKB_FONT_FAMILY_DEFAULT;
+}
+
+static void skb__font_index_read_face(hb_face_t* face, skb__font_index_scanned_face_t* scanned_face)
+{
+	skb__font_index_face_t* index_face = &scanned_face->face;
+
+	// Style, the values come from OS/2, STAT and fvar tables.
+	hb_font_t* font = hb_font_create(face);
+	const float weight = hb_style_get_value(font, HB_STYLE_TAG_WEIGHT);
+	const float italic = hb_style_get_value(font, HB_STYLE_TAG_ITALIC);
+	const float slant = hb_style_get_value(font, HB_STYLE_TAG_SLANT_RATIO);
+	const float width = hb_style_get_value(font, HB_STYLE_TAG_WIDTH);
+	hb_font_destroy(font);
+
+	index_face->weight = (uint16_t)skb_clampf(weight, 1.f, 1000.f);
+	index_face->weight_min = index_face->weight;
+	index_face->weight_max = index_face->weight;
+	hb_ot_var_axis_info_t weight_axis;
+	if (hb_ot_var_find_axis_info(face, HB_OT_TAG_VAR_AXIS_WEIGHT, &weight_axis)) {
+		index_face->weight_min = (uint16_t)skb_clampf(weight_axis.min_value, 1.f, 1000.f);
+		index_face->weight_max = (uint16_t)skb_clampf(weight_axis.max_value, 1.f, 1000.f);
+	}
+
+	if (italic > 0.1f)
+		index_face->style = SKB_STYLE_ITALIC;
+	else if (slant > 0.01f)
+		index_face->style = SKB_STYLE_OBLIQUE;
+	else
+		index_face->style = SKB_STYLE_NORMAL;
+	index_face->stretch = width / 100.f;
+
+	// Family name
+	unsigned int name_size = SKB_COUNTOF(scanned_face->family_name);
+	if (hb_ot_name_get_utf8(face, HB_OT_NAME_ID_TYPOGRAPHIC_FAMILY, HB_LANGUAGE_INVALID, &name_size, scanned_face->family_name) == 0) {
+		name_size = SKB_COUNTOF(scanned_face->family_name);
+		hb_ot_name_get_utf8(face, HB_OT_NAME_ID_FONT_FAMILY, HB_LANGUAGE_INVALID, &name_size, scanned_face->family_name);
+	}
+
+	// Code pages, used to match CJK languages.
+	hb_blob_t* os2_blob = hb_face_reference_table(face, HB_TAG('O','S','/','2'));
+	unsigned int os2_size = 0;
+	const uint8_t* os2 = (const uint8_t*)hb_blob_get_data(os2_blob, &os2_size);
+	if (os2 && os2_size >= 82)
+		index_face->code_page_range = skb__read_be32(os2 + 78);
+	hb_blob_destroy(os2_blob);
+
+	// Coverage and scripts from cmap.
+	hb_set_t* unicodes = hb_set_create();
+	hb_face_collect_unicodes(face, unicodes);
+
+	hb_codepoint_t first = HB_SET_VALUE_INVALID;
+	hb_codepoint_t last = HB_SET_VALUE_INVALID;
+	while (hb_set_next_range(unicodes, &first, &last)) {
+		const int32_t last_page = skb_mini((int32_t)(last >> 8), SKB__FONT_INDEX_COVERAGE_PAGES - 1);
+		for (int32_t page = (int32_t)(first >> 8); page <= last_page; page++)
+			skb__font_index_set_bit(index_face->coverage, page);
+	}
+
+	const bool has_emoji = hb_set_has(unicodes, 0x1f600); // grinning face
+	const bool has_latin = hb_set_has(unicodes, 0x41); // A
+
+	skb__sb_tag_array_t scripts = {0};
+	skb__append_tags_from_unicodes(unicodes, &scripts); // Destroys unicodes.
+	for (int32_t i = 0; i < scripts.tags_count; i++) {
+		if (scripts.tags[i] < SKB__FONT_INDEX_MAX_SCRIPTS)
+			skb__font_index_set_bit(index_face->scripts, scripts.tags[i]);
+	}
+	skb_free(scripts.tags);
+
+	index_face->font_family = skb__font_index_classify_family(face, has_emoji, has_latin);
+}
+
+static void skb__font_index_scan_file(int32_t task_idx, void* task_context)
+{
+	skb__font_index_scan_t* scan = (skb__font_index_scan_t*)task_context;
+	skb__font_index_file_t* file = &scan->files[scan->changed_files[task_idx]];
+
+	hb_blob_t* blob = hb_blob_create_from_file_or_fail(scan->paths + file->path_offset);
+	if (!blob)
+		return;
+
+	const int32_t faces_count = (int32_t)hb_face_count(blob);
+	if (faces_count > 0) {
+		file->scanned_faces = skb_malloc(sizeof(skb__font_index_scanned_face_t) * faces_count);
+		for (int32_t face_idx = 0; face_idx < faces_count; face_idx++) {
+			hb_face_t* face = hb_face_create_or_fail(blob, face_idx);
+			if (!face)
+				continue;
+			if (hb_face_get_glyph_count(face) > 0) {
+				skb__font_index_scanned_face_t* scanned_face = &file->scanned_faces[file->scanned_faces_count++];
+				memset(scanned_face, 0, sizeof(skb__font_index_scanned_face_t));
+				scanned_face->face.mtime = file->mtime;
+				scanned_face->face.file_size = file->file_size;
+				scanned_face->face.face_index = face_idx;
+				skb__font_index_read_face(face, scanned_face);
+			}
+			hb_face_destroy(face);
+		}
+	}
+
+	hb_blob_destroy(blob);
+}
+
+static int32_t skb__font_index_add_string(skb_font_index_t* font_index, const char* str)
+{
+	const int32_t len = (int32_t)strlen(str);
+	SKB_ARRAY_RESERVE(font_index->strings, font_index->strings_count + len + 1);
+	const int32_t offset = font_index->strings_count;
+	memcpy(font_index->strings + offset, str, len + 1);
+	font_index->strings_count += len + 1;
+	return offset;
+}
+
+static void skb__font_index_add_face(skb_font_index_t* font_index, const skb__font_index_face_t* face, const char* path, const char* family_name)
+{
+	SKB_ARRAY_RESERVE(font_index->faces, font_index->faces_count + 1);
+	skb__font_index_face_t* new_face = &font_index->faces[font_index->faces_count];
+	*new_face = *face;
+
+	// Faces of the same file share the path.
+	if (font_index->faces_count > 0 && strcmp(font_index->strings + font_index->faces[font_index->faces_count - 1].path_offset, path) == 0)
+		new_face->path_offset = font_index->faces[font_index->faces_count - 1].path_offset;
+	else
+		new_face->path_offset = skb__font_index_add_string(font_index, path);
+	new_face->family_name_offset = skb__font_index_add_string(font_index, family_name);
+
+	font_index->faces_count++;
+}
+
+static bool skb__is_path_in_directory(const char* path, const char* dir, int32_t dir_len)
+{
+	return strncmp(path, dir, dir_len) == 0 && path[dir_len] == '/';
+}
+
+skb_font_index_t* skb_font_index_create(void)
+{
+	skb_font_index_t* font_index = skb_malloc(sizeof(skb_font_index_t));
+	SKB_ZERO_STRUCT(font_index);
+	return font_index;
+}
+
+static void skb__font_index_clear(skb_font_index_t* font_index)
+{
+	skb_free(font_index->faces);
+	skb_free(font_index->strings);
+	SKB_ZERO_STRUCT(font_index);
+}
+
+void skb_font_index_destroy(skb_font_index_t* font_index)
+{
+	if (!font_index) return;
+	skb__font_index_clear(font_index);
+	skb_free(font_index);
+}
+
+int32_t skb_font_index_scan_directory(skb_font_index_t* font_index, const char* path, skb_parallel_for_func_t* parallel_for, void* parallel_for_context)
+{
+	assert(font_index);
+	assert(path);
+
+	// Strip trailing separators, so that the paths of the files are consistent between scans.
+	char dir[SKB__FONT_INDEX_MAX_PATH];
+	int32_t dir_len = (int32_t)strlen(path);
+	if (dir_len <= 0 || dir_len >= (int32_t)SKB_COUNTOF(dir))
+		return 0;
+	memcpy(dir, path, dir_len + 1);
+	while (dir_len > 1 && (dir[dir_len - 1] == '/' || dir[dir_len - 1] == '\\'))
+		dir[--dir_len] = '\0';
+
+	skb__font_index_scan_t scan = {0};
+	skb__font_index_walk_directory(&scan, dir, 0);
+
+	// Find the files that have not changed since the last scan.
+	skb_hash_table_t* files_lookup = skb_hash_table_create();
+	for (int32_t i = 0; i < font_index->faces_count; i++) {
+		if (i == 0 || font_index->faces[i].path_offset != font_index->faces[i - 1].path_offset)
+			skb_hash_table_add(files_lookup, skb_hash64_append_str(skb_hash64_empty(), font_index->strings + font_index->faces[i].path_offset), i);
+	}
+
+	for (int32_t i = 0; i < scan.files_count; i++) {
+		skb__font_index_file_t* file = &scan.files[i];
+		const char* file_path = scan.paths + file->path_offset;
+		int32_t face_idx = SKB_INVALID_INDEX;
+		if (skb_hash_table_find(files_lookup, skb_hash64_append_str(skb_hash64_empty(), file_path), &face_idx)) {
+			const skb__font_index_face_t* face = &font_index->faces[face_idx];
+			if (face->mtime == file->mtime && face->file_size == file->file_size && strcmp(font_index->strings + face->path_offset, file_path) == 0)
+				file->existing_face_idx = face_idx;
+		}
+		if (file->existing_face_idx == SKB_INVALID_INDEX) {
+			SKB_ARRAY_RESERVE(scan.changed_files, scan.changed_files_count + 1);
+			scan.changed_files[scan.changed_files_count++] = i;
+		}
+	}
+
+	skb_hash_table_destroy(files_lookup);
+
+	// Scan the new and changed files.
+	if (scan.changed_files_count > 0) {
+		if (parallel_for) {
+			parallel_for(scan.changed_files_count, skb__font_index_scan_file, &scan, parallel_for_context);
+		} else {
+			for (int32_t i = 0; i < scan.changed_files_count; i++)
+				skb__font_index_scan_file(i, &scan);
+		}
+	}
+
+	// Rebuild the index. The faces outside the directory are kept, and the faces of the directory are replaced with the scan results.
+	skb_font_index_t new_index = {0};
+	for (int32_t i = 0; i < font_index->faces_count; i++) {
+		const skb__font_index_face_t* face = &font_index->faces[i];
+		const char* face_path = font_index->strings + face->path_offset;
+		if (!skb__is_path_in_directory(face_path, dir, dir_len))
+			skb__font_index_add_face(&new_index, face, face_path, font_index->strings + face->family_name_offset);
+	}
+
+	for (int32_t i = 0; i < scan.files_count; i++) {
+		skb__font_index_file_t* file = &scan.files[i];
+		const char* file_path = scan.paths + file->path_offset;
+		if (file->existing_face_idx != SKB_INVALID_INDEX) {
+			const int32_t path_offset = font_index->faces[file->existing_face_idx].path_offset;
+			for (int32_t j = file->existing_face_idx; j < font_index->faces_count && font_index->faces[j].path_offset == path_offset; j++)
+				skb__font_index_add_face(&new_index, &font_index->faces[j], file_path, font_index->strings + font_index->faces[j].family_name_offset);
+		} else {
+			for (int32_t j = 0; j < file->scanned_faces_count; j++)
+				skb__font_index_add_face(&new_index, &file->scanned_faces[j].face, file_path, file->scanned_faces[j].family_name);
+		}
+		skb_free(file->scanned_faces);
+	}
+
+	skb__font_index_clear(font_index);
+	*font_index = new_index;
+
+	skb_free(scan.files);
+	skb_free(scan.changed_files);
+	skb_free(scan.paths);
+
+	return scan.changed_files_count;
+}
+
+int32_t skb_font_index_get_faces_count(const skb_font_index_t* font_index)
+{
+	assert(font_index);
+	return font_index->faces_count;
+}
+
+skb_font_index_face_t skb_font_index_get_face(const skb_font_index_t* font_index, int32_t face_idx)
+{
+	assert(font_index);
+	assert(face_idx >= 0 && face_idx < font_index->faces_count);
+
+	const skb__font_index_face_t* face = &font_index->faces[face_idx];
+	return (skb_font_index_face_t) {
+		.path = font_index->strings + face->path_offset,
+		.family_name = font_index->strings + face->family_name_offset,
+		.face_index = face->face_index,
+		.font_family = face->font_family,
+		.weight = face->weight,
+		.weight_min = face->weight_min,
+		.weight_max = face->weight_max,
+		.style = face->style,
+		.stretch = face->stretch,
+	};
+}
+
+static void skb__font_index_get_font_name(const skb_font_index_t* font_index, const skb__font_index_face_t* face, char* name, int32_t name_cap)
+{
+	// The first face uses the file name as name, like skb_font_collection_add_font().
+	const char* path = font_index->strings + face->path_offset;
+	if (face->face_index == 0)
+		snprintf(name, name_cap, "%s", path);
+	else
+		snprintf(name, name_cap, "%s#%d", path, face->face_index);
+}
+
+static bool skb__font_index_is_face_in_collection(const skb_font_index_t* font_index, const skb__font_index_face_t* face, const skb_font_collection_t* font_collection, uint8_t font_family)
+{
+	char name[SKB__FONT_INDEX_MAX_PATH + 16];
+	skb__font_index_get_font_name(font_index, face, name, SKB_COUNTOF(name));
+
+	for (int32_t i = 0; i < font_collection->fonts_count; i++) {
+		const skb_font_t* font = &font_collection->fonts[i];
+		if (font->hb_font && font->font_family == font_family && strcmp(font->name, name) == 0)
+			return true;
+	}
+	return false;
+}
+
+static int32_t skb__font_index_find_face(
+	const skb_font_index_t* font_index, const char* lang, uint8_t script, uint8_t font_family,
+	const skb_font_collection_t* exclude_collection)
+{
+	const uint32_t requested_code_pages = skb__lang_to_font_code_pages(lang);
+	const bool is_generic_family = font_family == SKB_FONT_FAMILY_SANS_SERIF || font_family == SKB_FONT_FAMILY_SERIF
+		|| font_family == SKB_FONT_FAMILY_MONOSPACE || font_family == SKB_FONT_FAMILY_MATH;
+
+	int32_t best_face_idx = SKB_INVALID_INDEX;
+	float best_score = -FLT_MAX;
+
+	for (int32_t i = 0; i < font_index->faces_count; i++) {
+		const skb__font_index_face_t* face = &font_index->faces[i];
+
+		// Script and emoji are hard constraints.
+		if (font_family == SKB_FONT_FAMILY_EMOJI) {
+			if (face->font_family != SKB_FONT_FAMILY_EMOJI)
+				continue;
+		} else {
+			if (face->font_family == SKB_FONT_FAMILY_EMOJI)
+				continue;
+			if (script >= SKB__FONT_INDEX_MAX_SCRIPTS || !skb__font_index_has_bit(face->scripts, script))
+				continue;
+		}
+
+		float score = 0.f;
+
+		// Prefer matching language and generic family.
+		if (requested_code_pages && (face->code_page_range & requested_code_pages))
+			score += 2000.f;
+		if (is_generic_family) {
+			if (face->font_family == font_family)
+				score += 1000.f;
+		} else if (font_family == SKB_FONT_FAMILY_DEFAULT) {
+			if (face->font_family == SKB_FONT_FAMILY_SANS_SERIF)
+				score += 100.f;
+			else if (face->font_family == SKB_FONT_FAMILY_MONOSPACE || face->font_family == SKB_FONT_FAMILY_MATH)
+				score -= 100.f;
+		}
+
+		// Prefer regular style.
+		if (face->style == SKB_STYLE_NORMAL)
+			score += 200.f;
+		score -= skb_absf(face->stretch - 1.f) * 200.f;
+		const int32_t weight = skb_clampi(400, face->weight_min, face->weight_max);
+		score -= (float)skb_absi(weight - 400) * 0.5f;
+
+		// Prefer fonts with larger coverage.
+		score += (float)skb__font_index_count_bits(face->coverage, SKB_COUNTOF(face->coverage)) * 0.1f;
+
+		if (score > best_score) {
+			if (exclude_collection && skb__font_index_is_face_in_collection(font_index, face, exclude_collection, font_family))
+				continue;
+			best_score = score;
+			best_face_idx = i;
+		}
+	}
+
+	return best_face_idx;
+}
+
+int32_t skb_font_index_find_face(const skb_font_index_t* font_index, const char* lang, uint8_t script, uint8_t font_family)
+{
+	assert(font_index);
+	return skb__font_index_find_face(font_index, lang, script, font_family, NULL);
+}
+
+skb_font_handle_t skb_font_index_add_font(const skb_font_index_t* font_index, int32_t face_idx, skb_font_collection_t* font_collection, uint8_t font_family)
+{
+	assert(font_index);
+	assert(font_collection);
+
+	if (face_idx < 0 || face_idx >= font_index->faces_count)
+		return 0;
+
+	const skb__font_index_face_t* index_face = &font_index->faces[face_idx];
+
+	char name[SKB__FONT_INDEX_MAX_PATH + 16];
+	skb__font_index_get_font_name(font_index, index_face, name, SKB_COUNTOF(name));
+
+	hb_blob_t* blob = NULL;
+	hb_face_t* face = NULL;
+	hb_font_t* hb_font = NULL;
+	skb_font_handle_t result = 0;
+
+	blob = hb_blob_create_from_file_or_fail(font_index->strings + index_face->path_offset);
+	if (!blob) goto cleanup;
+
+	face = hb_face_create_or_fail(blob, index_face->face_index);
+	if (!face) goto cleanup;
+
+	hb_font = hb_font_create(face);
+	if (!hb_font) goto cleanup;
+
+	result = skb_font_collection_add_hb_font(font_collection, name, hb_font, font_family, NULL);
+
+cleanup:
+	hb_blob_destroy(blob);
+	hb_face_destroy(face);
+	hb_font_destroy(hb_font);
+
+	return result;
+}
+
+bool skb_font_index_font_fallback(skb_font_collection_t* font_collection, const char* lang, uint8_t script, uint8_t font_family, void* context)
+{
+	const skb_font_index_t* font_index = (const skb_font_index_t*)context;
+	assert(font_index);
+
+	// Skip the fonts that are already in the collection, they did not match.
+	const int32_t face_idx = skb__font_index_find_face(font_index, lang, script, font_family, font_collection);
+	if (face_idx == SKB_INVALID_INDEX)
+		return false;
+
+	return skb_font_index_add_font(font_index, face_idx, font_collection, font_family) != 0;
+}
+
+static uint64_t skb__font_index_abi_hash(void)
+{
+	const uint32_t sizes[] = {
+		(uint32_t)sizeof(skb__font_index_header_t),
+		(uint32_t)sizeof(skb__font_index_face_t),
+		SKB__FONT_INDEX_MAX_SCRIPTS,
+		SKB__FONT_INDEX_COVERAGE_PAGES,
+		0x01020304, // Byte order
+	};
+	return skb_hash64_append(skb_hash64_empty(), sizes, sizeof(sizes));
+}
+
+int32_t skb_font_index_serialize(const skb_font_index_t* font_index, uint8_t* data, int32_t data_cap)
+{
+	assert(font_index);
+
+	// The header and faces sizes are multiples of 8, the faces stay aligned.
+	const int32_t faces_size = font_index->faces_count * (int32_t)sizeof(skb__font_index_face_t);
+	const int32_t total_size = (int32_t)sizeof(skb__font_index_header_t) + faces_size + font_index->strings_count;
+
+	if (data && data_cap >= total_size) {
+		const skb__font_index_header_t header = {
+			.magic = SKB__FONT_INDEX_MAGIC,
+			.version = SKB__FONT_INDEX_VERSION,
+			.abi_hash = skb__font_index_abi_hash(),
+			.size = total_size,
+			.faces_count = font_index->faces_count,
+			.strings_count = font_index->strings_count,
+		};
+		uint8_t* dst = data;
+		memcpy(dst, &header, sizeof(header));
+		dst += sizeof(header);
+		if (faces_size > 0)
+			memcpy(dst, font_index->faces, faces_size);
+		dst += faces_size;
+		if (font_index->strings_count > 0)
+			memcpy(dst, font_index->strings, font_index->strings_count);
+	}
+
+	return total_size;
+}
+
+bool skb_font_index_deserialize(skb_font_index_t* font_index, const uint8_t* data, int32_t data_count)
+{
+	assert(font_index);
+
+	skb__font_index_clear(font_index);
+
+	if (!data || data_count < (int32_t)sizeof(skb__font_index_header_t))
+		return false;
+
+	skb__font_index_header_t header;
+	memcpy(&header, data, sizeof(header));
+	if (header.magic != SKB__FONT_INDEX_MAGIC || header.version != SKB__FONT_INDEX_VERSION || header.abi_hash != skb__font_index_abi_hash())
+		return false;
+	if (header.size != data_count || header.faces_count < 0 || header.strings_count < 0)
+		return false;
+	if (header.faces_count > (data_count - (int32_t)sizeof(header)) / (int32_t)sizeof(skb__font_index_face_t))
+		return false;
+	const int32_t faces_size = header.faces_count * (int32_t)sizeof(skb__font_index_face_t);
+	if ((int32_t)sizeof(header) + faces_size + header.strings_count != data_count)
+		return false;
+
+	const uint8_t* faces_data = data + sizeof(header);
+	const char* strings = (const char*)(faces_data + faces_size);
+	if (header.strings_count > 0 && strings[header.strings_count - 1] != '\0')
+		return false;
+
+	// Validate the string offsets.
+	for (int32_t i = 0; i < header.faces_count; i++) {
+		skb__font_index_face_t face;
+		memcpy(&face, faces_data + i * sizeof(skb__font_index_face_t), sizeof(face));
+		if (face.path_offset < 0 || face.path_offset >= header.strings_count
+			|| face.family_name_offset < 0 || face.family_name_offset >= header.strings_count)
+			return false;
+	}
+
+	SKB_ARRAY_RESERVE(font_index->faces, header.faces_count);
+	if (faces_size > 0)
+		memcpy(font_index->faces, faces_data, faces_size);
+	font_index->faces_count = header.faces_count;
+
+	SKB_ARRAY_RESERVE(font_index->strings, header.strings_count);
+	if (header.strings_count > 0)
+		memcpy(font_index->strings, strings, header.strings_count);
+	font_index->strings_count = header.strings_count;
+
+	return true;
+}
+
+bool skb_font_index_save(const skb_font_index_t* font_index, const char* file_name)
+{
+	assert(font_index);
+	assert(file_name);
+
+	const int32_t data_count = skb_font_index_serialize(font_index, NULL, 0);
+	uint8_t* data = skb_malloc(data_count);
+	skb_font_index_serialize(font_index, data, data_count);
+
+	bool result = false;
+	FILE* file = fopen(file_name, "wb");
+	if (file) {
+		result = fwrite(data, 1, data_count, file) == (size_t)data_count;
+		fclose(file);
+	}
+
+	skb_free(data);
+
+	return result;
+}
+
+bool skb_font_index_load(skb_font_index_t* font_index, const char* file_name)
+{
+	assert(font_index);
+	assert(file_name);
+
+	FILE* file = fopen(file_name, "rb");
+	if (!file) {
+		skb__font_index_clear(font_index);
+		return false;
+	}
+
+	// Get file size
+	fseek(file, 0, SEEK_END);
+	const long data_count = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	bool result = false;
+	uint8_t* data = data_count > 0 ? skb_malloc(data_count) : NULL;
+	if (data && fread(data, 1, data_count, file) == (size_t)data_count)
+		result = skb_font_index_deserialize(font_index, data, (int32_t)data_count);
+	else
+		skb__font_index_clear(font_index);
+
+	fclose(file);
+	skb_free(data);
+
+	return result;
+}
+
+#endif // !defined(SKB_NO_OPEN)
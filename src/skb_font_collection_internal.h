@@ -11,6 +11,7 @@
 // harfbuzz forward declarations
 typedef struct hb_font_t hb_font_t;
 typedef struct hb_set_t hb_set_t;
+typedef struct hb_font_funcs_t hb_font_funcs_t;
 
 typedef struct skb_font_collection_t {
 	uint32_t id;				// ID of the font collection.
@@ -24,13 +25,15 @@ typedef struct skb_font_collection_t {
 	skb_font_fallback_func_t* fallback_func;	// Function to call when no fonts are found.
 	void* fallback_context;						// Context passed to the fallback function.
 
+	hb_font_funcs_t* font_funcs;				// Font funcs used to layer cached glyph lookups on top of the fonts.
+
 } skb_font_collection_t;
 
 typedef struct skb_font_t {
 	int32_t next_free;
 	uint32_t generation;		// Generation index used to identify stale handles.
 	skb_font_handle_t handle;	// Unique identifier of the font.
-	uint64_t hash;				// Hash of the name, used as unique identifier.
+	uint64_t hash;				// Hash of the font data, face index, and synthetic style, used as unique identifier.
 	char* name;					// Name of the font (file name)
 
 	hb_font_t* hb_font;			// Associate harfbuzz font.
@@ -42,6 +45,15 @@ typedef struct skb_font_t {
 	skb_font_metrics_t metrics;			// Font metrics (ascender, etc).
 	skb_caret_metrics_t caret_metrics;	// Caret metrics (offset, slope)
 
+	uint32_t space_gid;					// Glyph used for space, and in place of control characters.
+	float space_advance;				// Advance of the space glyph, normalized to font size 1.
+
+	uint32_t ellipsis_gid;				// Glyph used for ellipsis, either ellipsis character, or period.
+	int32_t ellipsis_glyph_count;		// Number of ellipsis glyphs to use (1 for ellipsis, 3 for period).
+	float ellipsis_advance;				// Advance of single ellipsis glyph, normalized to font size 1.
+	skb_vec2_t ellipsis_offset;			// Offset of the ellipsis glyph, normalized to font size 1.
+	bool has_size_dependent_shaping;	// True if the font has tracking or optical size axis, and the shaped glyphs do not scale linearly with font size.
+
 	uint8_t* scripts;			// Supported scripts
 	int32_t scripts_count;		// Number of supported scripts
 
@@ -49,6 +61,7 @@ typedef struct skb_font_t {
 	uint8_t style;				// Normal, italic, oblique (skb_font_style_t)
 	float stretch;				// From 0.5 (ultra condensed) -> 1.0 (normal) -> 2.0 (ultra wide).
 	int32_t weight;				// weight of the font (400 = regular).
+	uint32_t code_page_range;	// OS/2 ulCodePageRange1, used to prefer fonts of the requested language (e.g. between CJK fonts).
 
 	skb_baseline_set_t* baseline_sets;	// Baseline sets (one for each requested script/direction combo).
 	int32_t baseline_sets_count;		// Number of baseline sets
@@ -58,4 +71,15 @@ typedef struct skb_font_t {
 	int32_t glyph_bounds_count;
 } skb_font_t;
 
+// Returns OS/2 code page bits of the fonts preferred for specific language, or 0 if there is no preference.
+uint32_t skb__lang_to_font_code_pages(const char* lang);
+
+// Same as skb_font_collection_match_fonts(), but prefers fonts made for the language when requested_code_pages is not 0.
+// If some of the matching fonts have any of the code pages (see skb__lang_to_font_code_pages()), only those are returned.
+int32_t skb__font_collection_match_fonts(
+	skb_font_collection_t* font_collection,
+	const char* requested_lang, uint32_t requested_code_pages, const uint8_t requested_script, uint8_t requested_font_family,
+	skb_weight_t requested_weight, skb_style_t requested_style, skb_stretch_t requested_stretch,
+	skb_font_handle_t* results, int32_t results_cap);
+
 #endif // SKB_FONT_COLLECTION_INTERNAL_H
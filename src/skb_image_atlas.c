@@ -104,6 +104,7 @@ typedef struct skb__item_glyph_t {
 	const skb_font_t* font;
 	uint32_t gid;
 	float clamped_font_size;
+	skb_glyph_effect_t effect;	// Effect applied to the glyph, radius and spread in pixels.
 } skb__item_glyph_t;
 
 typedef struct skb__item_icon_t {
@@ -124,8 +125,8 @@ typedef struct skb__atlas_item_t {
 	};
 	uint64_t hash_id;
 	skb__shelf_packer_handle_t packer_handle;
-	int32_t last_access_stamp;
-	skb_list_item_t lru;
+	int32_t last_access_stamp;	// Stamp of the last access, used to evict unused items.
+	int32_t next_free;			// Next item in the freelist.
 	int16_t width;
 	int16_t height;
 	int16_t geom_offset_x;
@@ -161,11 +162,10 @@ typedef struct skb_image_atlas_t {
 	int32_t items_count;
 	int32_t items_cap;
 	int32_t items_freelist;
-	skb_list_t items_lru;
 	bool has_new_items;
 
 	int32_t now_stamp;
-	int32_t last_evicted_stamp;
+	int32_t oldest_access_stamp;	// Lower bound of the access stamps of the items, updated when the items are scanned for eviction.
 
 	skb_image_atlas_config_t config;
 	skb_create_texture_func_t* create_texture_callback;
@@ -173,12 +173,6 @@ typedef struct skb_image_atlas_t {
 
 } skb_image_atlas_t;
 
-static skb_list_item_t* skb__get_item(int32_t item_idx, void* context)
-{
-	skb_image_atlas_t* atlas = (skb_image_atlas_t*)context;
-	return &atlas->items[item_idx].lru;
-}
-
 static void skb__image_resize(skb_image_t* image, int32_t new_width, int32_t new_height, uint8_t new_bpp)
 {
 	uint8_t* new_buffer = skb_malloc(new_width * new_height * new_bpp);
@@ -238,7 +232,6 @@ skb_image_atlas_t* skb_image_atlas_create(const skb_image_atlas_config_t* config
 
 	atlas->items_lookup = skb_hash_table_create();
 	atlas->items_freelist = SKB_INVALID_INDEX;
-	atlas->items_lru = skb_list_make();
 
 	if (config)
 		atlas->config = *config;
@@ -990,20 +983,77 @@ static int32_t skb__add_rect_or_grow(skb_image_atlas_t* atlas, int32_t requested
 }
 
 
-static uint64_t skb__get_glyph_hash(uint32_t gid, const skb_font_t* font, float font_size, skb_rasterize_alpha_mode_t alpha_mode)
+static uint64_t skb__get_glyph_hash(uint32_t gid, const skb_font_t* font, float font_size, skb_rasterize_alpha_mode_t alpha_mode, skb_glyph_effect_t effect)
 {
 	uint64_t hash = skb_hash64_append_uint8(skb_hash64_empty(), SKB__ITEM_TYPE_GLYPH);
 	hash = skb_hash64_append_uint64(hash, font->hash);
 	hash = skb_hash64_append_uint32(hash, gid);
 	hash = skb_hash64_append_float(hash, font_size);
 	hash = skb_hash64_append_uint8(hash, (uint8_t)alpha_mode);
+	if (effect.type != SKB_GLYPH_EFFECT_NONE) {
+		hash = skb_hash64_append_uint8(hash, effect.type);
+		hash = skb_hash64_append_float(hash, effect.radius);
+		hash = skb_hash64_append_float(hash, effect.spread);
+	}
 	return hash;
 }
 
-skb_quad_t skb_image_atlas_get_glyph_quad(
+// Calculates the size the glyph is rasterized at, and the hash used to look up the glyph.
+static uint64_t skb__get_glyph_key(
+	const skb_image_atlas_t* atlas, const skb_font_t* font, uint32_t glyph_id, float font_size, float pixel_scale,
+	skb_rasterize_alpha_mode_t alpha_mode, skb_glyph_effect_t* effect, float* clamped_font_size)
+{
+	const skb_image_item_config_t* img_config = alpha_mode == SKB_RASTERIZE_ALPHA_SDF ? &atlas->config.glyph_sdf : &atlas->config.glyph_alpha;
+
+	const float rounded_font_size = ceilf(font_size * pixel_scale / img_config->rounding) * img_config->rounding;
+	*clamped_font_size = skb_clampf(rounded_font_size, img_config->min_size, img_config->max_size);
+
+	// Convert the effect to whole pixels at the rasterized size, so that similar effects share the same image.
+	if (effect->type != SKB_GLYPH_EFFECT_NONE) {
+		const float effect_scale = font_size > 0.f ? *clamped_font_size / font_size : 0.f;
+		effect->radius = skb_maxf(0.f, roundf(effect->radius * effect_scale));
+		effect->spread = skb_maxf(0.f, roundf(effect->spread * effect_scale));
+	}
+
+	return skb__get_glyph_hash(glyph_id, font, *clamped_font_size, alpha_mode, *effect);
+}
+
+static skb_quad_t skb__make_glyph_quad(const skb__atlas_item_t* item, float x, float y, float pixel_scale, float font_size, skb_color_t tint_color)
+{
+	const float render_scale = (font_size / item->glyph.clamped_font_size);
+
+	static const int32_t inset = 1; // Inset the rectangle by one texel, so that interpolation will not try to use data outside the atlas rect.
+
+	skb_quad_t quad = {0};
+	quad.texture.x = (float)(item->texture_offset_x + inset);
+	quad.texture.y = (float)(item->texture_offset_y + inset);
+	quad.texture.width = (float)(item->width - inset*2);
+	quad.texture.height = (float)(item->height - inset*2);
+
+	// Map the whole texture region to geom.
+	quad.pattern.x = 0.f;
+	quad.pattern.y = 0.f;
+	quad.pattern.width = 1.f;
+	quad.pattern.height = 1.f;
+
+	quad.geom.x = x + (float)(item->geom_offset_x + inset) * render_scale;
+	quad.geom.y = y + (float)(item->geom_offset_y + inset) * render_scale;
+	quad.geom.width = (float)(item->width - inset*2) * render_scale;
+	quad.geom.height = (float)(item->height - inset*2) * render_scale;
+
+	quad.scale = render_scale * pixel_scale;
+	quad.texture_idx = item->texture_idx;
+	SKB_SET_FLAG(quad.flags, SKB_QUAD_IS_COLOR, item->flags & SKB__ITEM_IS_COLOR);
+	SKB_SET_FLAG(quad.flags, SKB_QUAD_IS_SDF, item->flags & SKB__ITEM_IS_SDF);
+	quad.color = (item->flags & SKB__ITEM_IS_COLOR) ? skb_rgba(255,255,255, tint_color.a) : tint_color;
+
+	return quad;
+}
+
+static skb_quad_t skb__get_glyph_quad(
 	skb_image_atlas_t* atlas, float x, float y, float pixel_scale,
 	skb_font_collection_t* font_collection, skb_font_handle_t font_handle, uint32_t glyph_id, float font_size,
-	skb_color_t tint_color, skb_rasterize_alpha_mode_t alpha_mode)
+	skb_color_t tint_color, skb_rasterize_alpha_mode_t alpha_mode, skb_glyph_effect_t effect)
 {
 	assert(atlas);
 
@@ -1012,10 +1062,8 @@ skb_quad_t skb_image_atlas_get_glyph_quad(
 
 	const skb_image_item_config_t* img_config = alpha_mode == SKB_RASTERIZE_ALPHA_SDF ? &atlas->config.glyph_sdf : &atlas->config.glyph_alpha;
 
-	const float rounded_font_size = ceilf(font_size * pixel_scale / img_config->rounding) * img_config->rounding;
-	const float clamped_font_size = skb_clampf(rounded_font_size, img_config->min_size, img_config->max_size);
-
-	const uint64_t hash_id = skb__get_glyph_hash(glyph_id, font, clamped_font_size, alpha_mode);
+	float clamped_font_size = 0.f;
+	const uint64_t hash_id = skb__get_glyph_key(atlas, font, glyph_id, font_size, pixel_scale, alpha_mode, &effect, &clamped_font_size);
 
 	skb__atlas_item_t* item = NULL;
 	int32_t item_idx = SKB_INVALID_INDEX;
@@ -1026,16 +1074,18 @@ skb_quad_t skb_image_atlas_get_glyph_quad(
 		assert(item->type == SKB__ITEM_TYPE_GLYPH);
 	} else {
 
-		// Calc size
-		const skb_rect2i_t bounds = skb_rasterizer_get_glyph_dimensions(glyph_id, font, clamped_font_size, img_config->padding);
+		// Calc size, the padding is extended to fit the effect.
+		const int32_t padding = img_config->padding + skb_rasterizer_get_glyph_effect_padding(effect);
+		const skb_rect2i_t bounds = skb_rasterizer_get_glyph_dimensions(glyph_id, font, clamped_font_size, padding);
 
 		// Add to atlas
 		int32_t texture_offset_x = 0;
 		int32_t texture_offset_y = 0;
 		skb__shelf_packer_handle_t packer_handle = {0};
 
+		// Effects are always rendered from the glyph coverage.
 		hb_face_t* face = hb_font_get_face(font->hb_font);
-		const bool is_color = hb_ot_color_glyph_has_paint(face, glyph_id);
+		const bool is_color = effect.type == SKB_GLYPH_EFFECT_NONE && hb_ot_color_glyph_has_paint(face, glyph_id);
 		const uint8_t requested_bpp = is_color ? 4 : 1;
 
 		const int32_t texture_idx = skb__add_rect_or_grow(atlas, bounds.width, bounds.height, requested_bpp, &texture_offset_x, &texture_offset_y, &packer_handle);
@@ -1045,7 +1095,7 @@ skb_quad_t skb_image_atlas_get_glyph_quad(
 		// Alloc and init the new glyph
 		if (atlas->items_freelist != SKB_INVALID_INDEX) {
 			item_idx = atlas->items_freelist;
-			atlas->items_freelist = atlas->items[item_idx].lru.next;
+			atlas->items_freelist = atlas->items[item_idx].next_free;
 		} else {
 			SKB_ARRAY_RESERVE(atlas->items, atlas->items_count + 1);
 			item_idx = atlas->items_count++;
@@ -1057,6 +1107,7 @@ skb_quad_t skb_image_atlas_get_glyph_quad(
 		item->glyph.font = font;
 		item->glyph.gid = glyph_id;
 		item->glyph.clamped_font_size = clamped_font_size;
+		item->glyph.effect = effect;
 		item->width = (int16_t)bounds.width;
 		item->height = (int16_t)bounds.height;
 		item->texture_offset_x = (int16_t)texture_offset_x;
@@ -1069,7 +1120,7 @@ skb_quad_t skb_image_atlas_get_glyph_quad(
 		item->state = SKB__ITEM_STATE_INITIALIZED;
 		item->texture_idx = (uint8_t)texture_idx;
 		item->hash_id = hash_id;
-		item->lru = skb_list_item_make();
+		item->next_free = SKB_INVALID_INDEX;
 
 		atlas->has_new_items = true;
 	}
@@ -1077,38 +1128,144 @@ skb_quad_t skb_image_atlas_get_glyph_quad(
 	assert(item);
 	assert(item_idx != SKB_INVALID_INDEX);
 
-	// Move glyph to front of the LRU list.
-	skb_list_move_to_front(&atlas->items_lru, item_idx, skb__get_item, atlas);
+	// Mark the item used, the items are evicted based on the stamp.
 	item->last_access_stamp = atlas->now_stamp;
 
-	const float render_scale = (font_size / item->glyph.clamped_font_size);
+	return skb__make_glyph_quad(item, x, y, pixel_scale, font_size, tint_color);
+}
 
-	static const int32_t inset = 1; // Inset the rectangle by one texel, so that interpolation will not try to use data outside the atlas rect.
+skb_quad_t skb_image_atlas_get_glyph_quad(
+	skb_image_atlas_t* atlas, float x, float y, float pixel_scale,
+	skb_font_collection_t* font_collection, skb_font_handle_t font_handle, uint32_t glyph_id, float font_size,
+	skb_color_t tint_color, skb_rasterize_alpha_mode_t alpha_mode)
+{
+	const skb_glyph_effect_t no_effect = { .type = SKB_GLYPH_EFFECT_NONE };
+	return skb__get_glyph_quad(atlas, x, y, pixel_scale, font_collection, font_handle, glyph_id, font_size, tint_color, alpha_mode, no_effect);
+}
 
-	skb_quad_t quad = {0};
-	quad.texture.x = (float)(item->texture_offset_x + inset);
-	quad.texture.y = (float)(item->texture_offset_y + inset);
-	quad.texture.width = (float)(item->width - inset*2);
-	quad.texture.height = (float)(item->height - inset*2);
+skb_quad_t skb_image_atlas_get_glyph_effect_quad(
+	skb_image_atlas_t* atlas, float x, float y, float pixel_scale,
+	skb_font_collection_t* font_collection, skb_font_handle_t font_handle, uint32_t glyph_id, float font_size,
+	skb_glyph_effect_t effect, skb_color_t tint_color)
+{
+	return skb__get_glyph_quad(atlas, x, y, pixel_scale, font_collection, font_handle, glyph_id, font_size, tint_color, SKB_RASTERIZE_ALPHA_MASK, effect);
+}
 
-	// Map the whole texture region to geom.
-	quad.pattern.x = 0.f;
-	quad.pattern.y = 0.f;
-	quad.pattern.width = 1.f;
-	quad.pattern.height = 1.f;
 
-	quad.geom.x = x + (float)(item->geom_offset_x + inset) * render_scale;
-	quad.geom.y = y + (float)(item->geom_offset_y + inset) * render_scale;
-	quad.geom.width = (float)(item->width - inset*2) * render_scale;
-	quad.geom.height = (float)(item->height - inset*2) * render_scale;
+//
+// Staging
+//
 
-	quad.scale = render_scale * pixel_scale;
-	quad.texture_idx = item->texture_idx;
-	SKB_SET_FLAG(quad.flags, SKB_QUAD_IS_COLOR, item->flags & SKB__ITEM_IS_COLOR);
-	SKB_SET_FLAG(quad.flags, SKB_QUAD_IS_SDF, item->flags & SKB__ITEM_IS_SDF);
-	quad.color = (item->flags & SKB__ITEM_IS_COLOR) ? skb_rgba(255,255,255, tint_color.a) : tint_color;
+// Glyph request recorded during concurrent lookup, added to the atlas on commit.
+typedef struct skb__staged_glyph_t {
+	skb_font_collection_t* font_collection;
+	skb_font_handle_t font_handle;
+	uint32_t glyph_id;
+	float font_size;
+	float pixel_scale;
+	uint8_t alpha_mode;
+} skb__staged_glyph_t;
+
+typedef struct skb_image_atlas_staging_t {
+	// Items found during lookup, their access stamp is updated on commit.
+	int32_t* accessed_items;
+	int32_t accessed_items_count;
+	int32_t accessed_items_cap;
+	// Glyphs that were not found during lookup.
+	skb__staged_glyph_t* glyphs;
+	int32_t glyphs_count;
+	int32_t glyphs_cap;
+} skb_image_atlas_staging_t;
+
+skb_image_atlas_staging_t* skb_image_atlas_staging_create(void)
+{
+	skb_image_atlas_staging_t* staging = skb_malloc(sizeof(skb_image_atlas_staging_t));
+	memset(staging, 0, sizeof(skb_image_atlas_staging_t));
+	return staging;
+}
 
-	return quad;
+void skb_image_atlas_staging_destroy(skb_image_atlas_staging_t* staging)
+{
+	if (!staging) return;
+	skb_free(staging->accessed_items);
+	skb_free(staging->glyphs);
+	skb_free(staging);
+}
+
+bool skb_image_atlas_find_glyph_quad(
+	const skb_image_atlas_t* atlas, skb_image_atlas_staging_t* staging, float x, float y, float pixel_scale,
+	skb_font_collection_t* font_collection, skb_font_handle_t font_handle, uint32_t glyph_id, float font_size,
+	skb_color_t tint_color, skb_rasterize_alpha_mode_t alpha_mode, skb_quad_t* quad)
+{
+	assert(atlas);
+	assert(staging);
+	assert(quad);
+
+	*quad = (skb_quad_t){0};
+
+	// Note: This function must only read the atlas and the font collection, it is called from multiple threads.
+	const skb_font_t* font = skb_font_collection_get_font(font_collection, font_handle);
+	if (!font) return false;
+
+	skb_glyph_effect_t effect = { .type = SKB_GLYPH_EFFECT_NONE };
+	float clamped_font_size = 0.f;
+	const uint64_t hash_id = skb__get_glyph_key(atlas, font, glyph_id, font_size, pixel_scale, alpha_mode, &effect, &clamped_font_size);
+
+	int32_t item_idx = SKB_INVALID_INDEX;
+	if (skb_hash_table_find(atlas->items_lookup, hash_id, &item_idx)) {
+		const skb__atlas_item_t* item = &atlas->items[item_idx];
+		assert(item->type == SKB__ITEM_TYPE_GLYPH);
+
+		SKB_ARRAY_RESERVE(staging->accessed_items, staging->accessed_items_count + 1);
+		staging->accessed_items[staging->accessed_items_count++] = item_idx;
+
+		*quad = skb__make_glyph_quad(item, x, y, pixel_scale, font_size, tint_color);
+		return true;
+	}
+
+	SKB_ARRAY_RESERVE(staging->glyphs, staging->glyphs_count + 1);
+	staging->glyphs[staging->glyphs_count++] = (skb__staged_glyph_t) {
+		.font_collection = font_collection,
+		.font_handle = font_handle,
+		.glyph_id = glyph_id,
+		.font_size = font_size,
+		.pixel_scale = pixel_scale,
+		.alpha_mode = (uint8_t)alpha_mode,
+	};
+
+	return false;
+}
+
+int32_t skb_image_atlas_commit_staging(skb_image_atlas_t* atlas, skb_image_atlas_staging_t** stagings, int32_t stagings_count)
+{
+	assert(atlas);
+
+	// Mark all accessed items first, so that adding new items will not evict them.
+	for (int32_t i = 0; i < stagings_count; i++) {
+		skb_image_atlas_staging_t* staging = stagings[i];
+		for (int32_t j = 0; j < staging->accessed_items_count; j++) {
+			skb__atlas_item_t* item = &atlas->items[staging->accessed_items[j]];
+			if (item->state != SKB__ITEM_STATE_REMOVED)
+				item->last_access_stamp = atlas->now_stamp;
+		}
+		staging->accessed_items_count = 0;
+	}
+
+	// Add missing glyphs, duplicates are resolved by the lookup.
+	int32_t requested_count = 0;
+	const skb_glyph_effect_t no_effect = { .type = SKB_GLYPH_EFFECT_NONE };
+	for (int32_t i = 0; i < stagings_count; i++) {
+		skb_image_atlas_staging_t* staging = stagings[i];
+		for (int32_t j = 0; j < staging->glyphs_count; j++) {
+			const skb__staged_glyph_t* glyph = &staging->glyphs[j];
+			skb__get_glyph_quad(atlas, 0.f, 0.f, glyph->pixel_scale, glyph->font_collection, glyph->font_handle, glyph->glyph_id, glyph->font_size,
+				(skb_color_t){0}, (skb_rasterize_alpha_mode_t)glyph->alpha_mode, no_effect);
+		}
+		requested_count += staging->glyphs_count;
+		staging->glyphs_count = 0;
+	}
+
+	return requested_count;
 }
 
 
@@ -1181,7 +1338,7 @@ skb_quad_t skb_image_atlas_get_icon_quad(
 		// Alloc and init the new icon
 		if (atlas->items_freelist != SKB_INVALID_INDEX) {
 			item_idx = atlas->items_freelist;
-			atlas->items_freelist = atlas->items[item_idx].lru.next;
+			atlas->items_freelist = atlas->items[item_idx].next_free;
 		} else {
 			SKB_ARRAY_RESERVE(atlas->items, atlas->items_count + 1);
 			item_idx = atlas->items_count++;
@@ -1204,7 +1361,7 @@ skb_quad_t skb_image_atlas_get_icon_quad(
 		item->state = SKB__ITEM_STATE_INITIALIZED;
 		item->texture_idx = (uint8_t)image_idx;
 		item->hash_id = hash_id;
-		item->lru = skb_list_item_make();
+		item->next_free = SKB_INVALID_INDEX;
 
 		atlas->has_new_items = true;
 	}
@@ -1212,9 +1369,7 @@ skb_quad_t skb_image_atlas_get_icon_quad(
 	assert(item);
 	assert(item_idx != SKB_INVALID_INDEX);
 
-	// Move glyph to front of the LRU list.
-	skb_list_move_to_front(&atlas->items_lru, item_idx, skb__get_item, atlas);
-
+	// Mark the item used, the items are evicted based on the stamp.
 	item->last_access_stamp = atlas->now_stamp;
 
 	const float render_scale_x = requested_width / clamped_width;
@@ -1306,7 +1461,7 @@ skb_quad_t skb_image_atlas_get_decoration_quad(
 		// Alloc and init the new icon
 		if (atlas->items_freelist != SKB_INVALID_INDEX) {
 			item_idx = atlas->items_freelist;
-			atlas->items_freelist = atlas->items[item_idx].lru.next;
+			atlas->items_freelist = atlas->items[item_idx].next_free;
 		} else {
 			SKB_ARRAY_RESERVE(atlas->items, atlas->items_count + 1);
 			item_idx = atlas->items_count++;
@@ -1328,7 +1483,7 @@ skb_quad_t skb_image_atlas_get_decoration_quad(
 		item->state = SKB__ITEM_STATE_INITIALIZED;
 		item->texture_idx = (uint8_t)texture_idx;
 		item->hash_id = hash_id;
-		item->lru = skb_list_item_make();
+		item->next_free = SKB_INVALID_INDEX;
 
 		atlas->has_new_items = true;
 	}
@@ -1336,9 +1491,7 @@ skb_quad_t skb_image_atlas_get_decoration_quad(
 	assert(item);
 	assert(item_idx != SKB_INVALID_INDEX);
 
-	// Move glyph to front of the LRU list.
-	skb_list_move_to_front(&atlas->items_lru, item_idx, skb__get_item, atlas);
-
+	// Mark the item used, the items are evicted based on the stamp.
 	item->last_access_stamp = atlas->now_stamp;
 
 	const float render_scale = thickness / item->pattern.thickness;
@@ -1387,57 +1540,56 @@ static bool skb__try_evict_items(skb_image_atlas_t* atlas, int32_t evict_after_d
 {
 	assert(atlas);
 
-	int32_t evicted_count = 0;
+	// The access stamps only grow, if even the oldest item is recent enough, there's nothing to evict.
+	if (atlas->now_stamp - atlas->oldest_access_stamp <= evict_after_duration)
+		return false;
 
-	// Try to evict unused glyphs.
+	int32_t evicted_count = 0;
+	int32_t oldest_access_stamp = atlas->now_stamp;
 
-	int32_t item_idx = atlas->items_lru.tail; // Tail has least used items.
-	while (item_idx != SKB_INVALID_INDEX) {
+	// Try to evict unused glyphs. The items are not kept in access order, so all the items are scanned.
+	for (int32_t item_idx = 0; item_idx < atlas->items_count; item_idx++) {
 		skb__atlas_item_t* item = &atlas->items[item_idx];
+		if (item->state == SKB__ITEM_STATE_REMOVED)
+			continue;
 
 		const int32_t inactive_duration = atlas->now_stamp - item->last_access_stamp;
-		if (inactive_duration <= evict_after_duration)
-			break;
-
-		int32_t prev_item_idx = item->lru.prev;
-
-		if (item->state == SKB__ITEM_STATE_RASTERIZED) {
-
-			skb_atlas_texture_t* texture = &atlas->textures[item->texture_idx];
-			skb__shelf_packer_t* packer = &texture->packer;
+		if (inactive_duration <= evict_after_duration || item->state != SKB__ITEM_STATE_RASTERIZED) {
+			oldest_access_stamp = skb_mini(oldest_access_stamp, item->last_access_stamp);
+			continue;
+		}
 
-			// Remove from lookup.
-			skb_hash_table_remove(atlas->items_lookup, item->hash_id);
+		skb_atlas_texture_t* texture = &atlas->textures[item->texture_idx];
+		skb__shelf_packer_t* packer = &texture->packer;
 
-			// Remove from atlas
-			skb__shelf_packer_free_rect(packer, item->packer_handle);
+		// Remove from lookup.
+		skb_hash_table_remove(atlas->items_lookup, item->hash_id);
 
-			// Remove from LRU
-			skb_list_remove(&atlas->items_lru, item_idx, skb__get_item, atlas);
+		// Remove from atlas
+		skb__shelf_packer_free_rect(packer, item->packer_handle);
 
-			if (atlas->config.flags & SKB_IMAGE_ATLAS_DEBUG_CLEAR_REMOVED) {
-				const skb_rect2i_t dirty = {
-					.x = item->texture_offset_x,
-					.y = item->texture_offset_y,
-					.width = item->width,
-					.height = item->height,
-				};
-				texture->dirty_bounds = skb_rect2i_union(texture->dirty_bounds, dirty);
-				skb__image_clear(&texture->image, item->texture_offset_x, item->texture_offset_y, item->width, item->height);
-			}
-
-			// Returns glyph to freelist.
-			memset(item, 0, sizeof(skb__atlas_item_t));
-			item->state = SKB__ITEM_STATE_REMOVED;
-			item->lru.next = atlas->items_freelist;
-			atlas->items_freelist = item_idx;
-
-			evicted_count++;
+		if (atlas->config.flags & SKB_IMAGE_ATLAS_DEBUG_CLEAR_REMOVED) {
+			const skb_rect2i_t dirty = {
+				.x = item->texture_offset_x,
+				.y = item->texture_offset_y,
+				.width = item->width,
+				.height = item->height,
+			};
+			texture->dirty_bounds = skb_rect2i_union(texture->dirty_bounds, dirty);
+			skb__image_clear(&texture->image, item->texture_offset_x, item->texture_offset_y, item->width, item->height);
 		}
 
-		item_idx = prev_item_idx;
+		// Returns glyph to freelist.
+		memset(item, 0, sizeof(skb__atlas_item_t));
+		item->state = SKB__ITEM_STATE_REMOVED;
+		item->next_free = atlas->items_freelist;
+		atlas->items_freelist = item_idx;
+
+		evicted_count++;
 	}
 
+	atlas->oldest_access_stamp = oldest_access_stamp;
+
 	return evicted_count > 0;
 }
 
@@ -1449,7 +1601,7 @@ bool skb_image_atlas_compact(skb_image_atlas_t* atlas)
 
 	// TODO: smarted eviction strategy.
 	// This tries to evict more items from the atlas the higher the max usage is.
-	// Maybe better option would be to do this per image. In which case the LRU lists should be per image.
+	// Maybe better option would be to do this per image. In which case the eviction scan should be per image.
 
 	float max_occupancy = 0.f;
 	for (int32_t i = 0; i < atlas->textures_count; i++) {
@@ -1491,6 +1643,8 @@ bool skb_image_atlas_rasterize_missing_items(skb_image_atlas_t* atlas, skb_temp_
 
 	// Glyphs
 	if (atlas->has_new_items) {
+		// Glyphs are rasterized in a session to reuse the canvas buffers between the glyphs.
+		skb_rasterizer_session_t* session = skb_rasterizer_begin_session(rasterizer, temp_alloc);
 		for (int32_t i = 0; i < atlas->items_count; i++) {
 			skb__atlas_item_t* item = &atlas->items[i];
 			if (item->state == SKB__ITEM_STATE_INITIALIZED) {
@@ -1516,13 +1670,17 @@ bool skb_image_atlas_rasterize_missing_items(skb_image_atlas_t* atlas, skb_temp_
 
 				if (item->type == SKB__ITEM_TYPE_GLYPH) {
 					// Rasterize glyph
-					if (item->flags & SKB__ITEM_IS_COLOR) {
-						skb_rasterizer_draw_color_glyph(
-							rasterizer, temp_alloc, item->glyph.gid, item->glyph.font, item->glyph.clamped_font_size, alpha_mode,
+					if (item->glyph.effect.type != SKB_GLYPH_EFFECT_NONE) {
+						skb_rasterizer_session_draw_glyph_effect(
+							session, item->glyph.gid, item->glyph.font, item->glyph.clamped_font_size, item->glyph.effect,
+							-item->geom_offset_x, -item->geom_offset_y, &target);
+					} else if (item->flags & SKB__ITEM_IS_COLOR) {
+						skb_rasterizer_session_draw_color_glyph(
+							session, item->glyph.gid, item->glyph.font, item->glyph.clamped_font_size, alpha_mode,
 							-item->geom_offset_x, -item->geom_offset_y, &target);
 					} else {
-						skb_rasterizer_draw_alpha_glyph(
-							rasterizer, temp_alloc, item->glyph.gid, item->glyph.font, item->glyph.clamped_font_size, alpha_mode,
+						skb_rasterizer_session_draw_alpha_glyph(
+							session, item->glyph.gid, item->glyph.font, item->glyph.clamped_font_size, alpha_mode,
 							-item->geom_offset_x, -item->geom_offset_y, &target);
 					}
 				} else if (item->type == SKB__ITEM_TYPE_ICON) {
@@ -1543,6 +1701,7 @@ bool skb_image_atlas_rasterize_missing_items(skb_image_atlas_t* atlas, skb_temp_
 				updated = true;
 			}
 		}
+		skb_rasterizer_end_session(session);
 		atlas->has_new_items = false;
 	}
 
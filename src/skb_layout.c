@@ -9,6 +9,7 @@
 #include "skb_layout.h"
 #include "skb_layout_internal.h"
 #include "skb_font_collection_internal.h"
+#include "skb_text_internal.h"
 #include "skb_icon_collection.h"
 
 #include "hb.h"
@@ -30,6 +31,7 @@
 typedef struct skb__layout_build_context_t {
 	uint8_t* emoji_types_buffer;
 	skb_temp_alloc_t* temp_alloc;
+	bool max_height_reached_before_last_line; // Set by line layout, when lines overflow the layout height before the end of the text.
 } skb__layout_build_context_t;
 
 
@@ -185,6 +187,90 @@ static skb_attribute_set_t skb__get_run_attributes(const skb_layout_t* layout, s
 	};
 }
 
+// Returns font size from the attributes, scaled by the layout font scale.
+static float skb__get_font_size(const skb_layout_t* layout, const skb_attribute_set_t attributes)
+{
+	return skb_attributes_get_font_size(attributes, layout->params.attribute_collection) * layout->font_scale;
+}
+
+enum {
+	SKB_MAX_FEATURES = 32,
+};
+
+static bool skb__equals_inline_padding(const skb_attribute_inline_padding_t* a, const skb_attribute_inline_padding_t* b)
+{
+	return skb_equalsf(a->start, b->start, 1e-6f)
+		&& skb_equalsf(a->end, b->end, 1e-6f)
+		&& skb_equalsf(a->top, b->top, 1e-6f)
+		&& skb_equalsf(a->bottom, b->bottom, 1e-6f);
+}
+
+static bool skb__equals_font_features(const skb_attribute_set_t attributes_a, const skb_attribute_set_t attributes_b, const skb_attribute_collection_t* collection)
+{
+	const skb_attribute_t* features_a[SKB_MAX_FEATURES];
+	const skb_attribute_t* features_b[SKB_MAX_FEATURES];
+	const int32_t features_a_count = skb_attributes_get_by_kind(SKB_ATTRIBUTE_FONT_FEATURE, attributes_a, collection, features_a, SKB_MAX_FEATURES);
+	const int32_t features_b_count = skb_attributes_get_by_kind(SKB_ATTRIBUTE_FONT_FEATURE, attributes_b, collection, features_b, SKB_MAX_FEATURES);
+	if (features_a_count != features_b_count)
+		return false;
+	for (int32_t i = 0; i < features_a_count; i++) {
+		if (features_a[i]->font_feature.tag != features_b[i]->font_feature.tag || features_a[i]->font_feature.value != features_b[i]->font_feature.value)
+			return false;
+	}
+	return true;
+}
+
+// Returns true if the content runs differ only by attributes that do not affect shaping (e.g. paint or decorations), and can be shaped as one run.
+static bool skb__content_runs_share_shaping(const skb_layout_t* layout, const skb__content_run_t* content_run_a, const skb__content_run_t* content_run_b)
+{
+	if (content_run_a->type == SKB_CONTENT_RUN_OBJECT || content_run_a->type == SKB_CONTENT_RUN_ICON)
+		return false;
+	if (content_run_b->type == SKB_CONTENT_RUN_OBJECT || content_run_b->type == SKB_CONTENT_RUN_ICON)
+		return false;
+
+	const skb_attribute_collection_t* collection = layout->params.attribute_collection;
+	const skb_attribute_set_t attributes_a = skb__get_run_attributes(layout, content_run_a->attributes_range);
+	const skb_attribute_set_t attributes_b = skb__get_run_attributes(layout, content_run_b->attributes_range);
+
+	// Font selection
+	if (skb_attributes_get_font_family(attributes_a, collection) != skb_attributes_get_font_family(attributes_b, collection)
+		|| skb_attributes_get_font_weight(attributes_a, collection) != skb_attributes_get_font_weight(attributes_b, collection)
+		|| skb_attributes_get_font_style(attributes_a, collection) != skb_attributes_get_font_style(attributes_b, collection)
+		|| skb_attributes_get_font_stretch(attributes_a, collection) != skb_attributes_get_font_stretch(attributes_b, collection))
+		return false;
+
+	// Font size
+	if (!skb_equalsf(skb_attributes_get_font_size(attributes_a, collection), skb_attributes_get_font_size(attributes_b, collection), 1e-6f))
+		return false;
+	const skb_attribute_font_size_scaling_t font_size_scaling_a = skb_attributes_get_font_size_scaling(attributes_a, collection);
+	const skb_attribute_font_size_scaling_t font_size_scaling_b = skb_attributes_get_font_size_scaling(attributes_b, collection);
+	if (font_size_scaling_a.type != font_size_scaling_b.type || !skb_equalsf(font_size_scaling_a.scale, font_size_scaling_b.scale, 1e-6f))
+		return false;
+
+	// Baseline shift is baked into the glyph offsets.
+	const skb_attribute_baseline_shift_t baseline_shift_a = skb_attributes_get_baseline_shift(attributes_a, collection);
+	const skb_attribute_baseline_shift_t baseline_shift_b = skb_attributes_get_baseline_shift(attributes_b, collection);
+	if (baseline_shift_a.type != baseline_shift_b.type || !skb_equalsf(baseline_shift_a.offset, baseline_shift_b.offset, 1e-6f))
+		return false;
+
+	// Letter spacing changes the features used for shaping.
+	if (!skb_equalsf(skb_attributes_get_letter_spacing(attributes_a, collection), skb_attributes_get_letter_spacing(attributes_b, collection), 1e-6f))
+		return false;
+
+	// Language
+	if (layout->lang_profiles[content_run_a->lang_profile_idx].hb_lang != layout->lang_profiles[content_run_b->lang_profile_idx].hb_lang)
+		return false;
+
+	// Inline padding is applied at the shaping run extrema, do not merge runs which have it.
+	const skb_attribute_inline_padding_t no_padding = {0};
+	const skb_attribute_inline_padding_t inline_padding_a = skb_attributes_get_inline_padding(attributes_a, collection);
+	const skb_attribute_inline_padding_t inline_padding_b = skb_attributes_get_inline_padding(attributes_b, collection);
+	if (!skb__equals_inline_padding(&inline_padding_a, &no_padding) || !skb__equals_inline_padding(&inline_padding_b, &no_padding))
+		return false;
+
+	return skb__equals_font_features(attributes_a, attributes_b, collection);
+}
+
 //
 // Itemization
 //
@@ -233,18 +319,16 @@ typedef struct skb__text_style_run_iter_t {
 	skb_range_t range;
 	int32_t content_run_idx;
 	int32_t content_runs_end;
-	const skb__content_run_t* content_runs;
-	int32_t content_runs_count;
+	const skb_layout_t* layout;
 } skb__text_style_run_iter_t;
 
-static skb__text_style_run_iter_t skb__text_style_run_iter_make(skb_range_t range, const skb__content_run_t* content_runs, int32_t content_runs_count)
+static skb__text_style_run_iter_t skb__text_style_run_iter_make(skb_range_t range, const skb_layout_t* layout)
 {
 	return (skb__text_style_run_iter_t) {
 		.range = range,
 		.content_run_idx = 0,
-		.content_runs_end = content_runs_count,
-		.content_runs = content_runs,
-		.content_runs_count = content_runs_count,
+		.content_runs_end = layout->content_runs_count,
+		.layout = layout,
 	};
 }
 
@@ -254,19 +338,28 @@ static bool skb__text_style_run_iter_next(skb__text_style_run_iter_t* iter, skb_
 		return false;
 
 	while (iter->content_run_idx < iter->content_runs_end) {
-		const skb__content_run_t* attributes = &iter->content_runs[iter->content_run_idx];
-		if (attributes->text_range.start > iter->range.end) {
+		const skb__content_run_t* content_run = &iter->layout->content_runs[iter->content_run_idx];
+		if (content_run->text_range.start > iter->range.end) {
 			iter->content_run_idx = iter->content_runs_end;
 			return false;
 		}
-		const skb_range_t shaping_range = {
-			.start = skb_maxi(iter->range.start, attributes->text_range.start),
-			.end = skb_mini(iter->range.end, attributes->text_range.end),
+		skb_range_t shaping_range = {
+			.start = skb_maxi(iter->range.start, content_run->text_range.start),
+			.end = skb_mini(iter->range.end, content_run->text_range.end),
 		};
-		iter->content_run_idx++;
+		const int32_t content_run_idx = iter->content_run_idx++;
 		if (shaping_range.start < shaping_range.end) {
+			// Extend the range over the following content runs which can be shaped together with this one.
+			// The shaping runs are split back to content runs when the layout runs are created.
+			while (iter->content_run_idx < iter->content_runs_end && shaping_range.end < iter->range.end) {
+				const skb__content_run_t* next_content_run = &iter->layout->content_runs[iter->content_run_idx];
+				if (!skb__content_runs_share_shaping(iter->layout, content_run, next_content_run))
+					break;
+				shaping_range.end = skb_mini(iter->range.end, next_content_run->text_range.end);
+				iter->content_run_idx++;
+			}
 			*range = shaping_range;
-			*range_content_run_idx = iter->content_run_idx - 1;
+			*range_content_run_idx = content_run_idx;
 			return true;
 		}
 	}
@@ -275,6 +368,18 @@ static bool skb__text_style_run_iter_next(skb__text_style_run_iter_t* iter, skb_
 }
 
 
+// Finds the range of content runs, starting from 'content_run_idx', which overlap the shaping run's text range.
+static void skb__set_shaping_run_content_runs(const skb_layout_t* layout, skb__shaping_run_t* shaping_run, int32_t content_run_idx)
+{
+	while ((content_run_idx + 1) < layout->content_runs_count && layout->content_runs[content_run_idx].text_range.end <= shaping_run->text_range.start)
+		content_run_idx++;
+	int32_t content_run_end = content_run_idx + 1;
+	while (content_run_end < layout->content_runs_count && layout->content_runs[content_run_end].text_range.start < shaping_run->text_range.end)
+		content_run_end++;
+	shaping_run->content_run_idx = content_run_idx;
+	shaping_run->content_run_count = content_run_end - content_run_idx;
+}
+
 static int skb__bidi_run_cmp(const void* a, const void* b)
 {
 	const SBRun* run_a = a;
@@ -298,7 +403,7 @@ static void skb__itemize(skb__layout_build_context_t* build_context, skb_layout_
 	else if (base_direction == SKB_DIRECTION_LTR)
 		base_level = 0;
 
-	SBCodepointSequence codepoint_seq = { SBStringEncodingUTF32, layout->text, layout->text_count };
+	SBCodepointSequence codepoint_seq = { SBStringEncodingUTF32, (void*)layout->text, layout->text_count }; // Only read by SheenBidi.
 
 	// Resolve scripts for codepoints.
 	SBScriptLocatorRef script_locator = SBScriptLocatorCreate();
@@ -360,7 +465,7 @@ static void skb__itemize(skb__layout_build_context_t* build_context, skb_layout_
 			const skb_text_direction_t bidi_direction = (bidi_run->level & 1) ? SKB_DIRECTION_RTL : SKB_DIRECTION_LTR;
 
 			// Split bidi runs at shaping style span boundaries.
-			skb__text_style_run_iter_t style_iter = skb__text_style_run_iter_make(bidi_range, layout->content_runs, layout->content_runs_count);
+			skb__text_style_run_iter_t style_iter = skb__text_style_run_iter_make(bidi_range, layout);
 
 			skb_range_t style_range = {0};
 			int32_t content_run_idx = 0;
@@ -378,6 +483,7 @@ static void skb__itemize(skb__layout_build_context_t* build_context, skb_layout_
 					shaping_run->direction = (uint8_t)bidi_direction;
 					shaping_run->is_emoji = false;
 					shaping_run->content_run_idx = content_run_idx;
+					shaping_run->content_run_count = 1;
 					shaping_run->font_handle = 0;
 					shaping_run->bidi_level = bidi_run->level;
 				} else {
@@ -400,12 +506,11 @@ static void skb__itemize(skb__layout_build_context_t* build_context, skb_layout_
 							const skb_weight_t font_weight = skb_attributes_get_font_weight(content_run_attributes, layout->params.attribute_collection);
 							const skb_style_t font_style = skb_attributes_get_font_style(content_run_attributes, layout->params.attribute_collection);
 							const skb_stretch_t font_stretch = skb_attributes_get_font_stretch(content_run_attributes, layout->params.attribute_collection);
-							const char* lang = skb_attributes_get_lang(content_run_attributes, layout->params.attribute_collection);
-							const hb_language_t run_lang = hb_language_from_string(lang, -1);
+							const skb__lang_profile_t* lang_profile = &layout->lang_profiles[content_run->lang_profile_idx];
 
 							skb_font_handle_t fonts[32];
-							int32_t fonts_count = skb_font_collection_match_fonts(
-								layout->params.font_collection, hb_language_to_string(run_lang), script, font_family,
+							int32_t fonts_count = skb__font_collection_match_fonts(
+								layout->params.font_collection, lang_profile->canonical_lang, lang_profile->font_code_pages, script, font_family,
 								font_weight, font_style, font_stretch,
 								fonts, SKB_COUNTOF(fonts));
 
@@ -451,7 +556,7 @@ static void skb__itemize(skb__layout_build_context_t* build_context, skb_layout_
 										shaping_run->text_range.end = j;
 										shaping_run->direction = (uint8_t)bidi_direction;
 										shaping_run->is_emoji = has_emoji;
-										shaping_run->content_run_idx = content_run_idx;
+										skb__set_shaping_run_content_runs(layout, shaping_run, content_run_idx);
 										shaping_run->font_handle = cur_font_handle;
 										shaping_run->bidi_level = bidi_run->level;
 									}
@@ -472,7 +577,7 @@ static void skb__itemize(skb__layout_build_context_t* build_context, skb_layout_
 									shaping_run->text_range.end = text_range.end;
 									shaping_run->direction = (uint8_t)bidi_direction;
 									shaping_run->is_emoji = has_emoji;
-									shaping_run->content_run_idx = content_run_idx;
+									skb__set_shaping_run_content_runs(layout, shaping_run, content_run_idx);
 									shaping_run->font_handle = cur_font_handle;
 									shaping_run->bidi_level = bidi_run->level;
 								}
@@ -497,10 +602,6 @@ static void skb__itemize(skb__layout_build_context_t* build_context, skb_layout_
 // Shaping
 //
 
-enum {
-	SKB_MAX_FEATURES = 32,
-};
-
 static void skb__add_font_feature(hb_feature_t* features, int32_t* features_count, hb_tag_t tag, uint32_t value)
 {
 	if (*features_count >= SKB_MAX_FEATURES)
@@ -538,7 +639,7 @@ static void skb__shape_run(
 
 	const skb_attribute_set_t content_run_attributes = skb__get_run_attributes(layout, content_run->attributes_range);
 
-	const char* lang = skb_attributes_get_lang(content_run_attributes, layout->params.attribute_collection);
+	const skb__lang_profile_t* lang_profile = &layout->lang_profiles[content_run->lang_profile_idx];
 	const float letter_spacing = skb_attributes_get_letter_spacing(content_run_attributes, layout->params.attribute_collection);
 
 	const skb_font_t* font = skb_font_collection_get_font(layout->params.font_collection, fonts[font_idx]);
@@ -546,7 +647,7 @@ static void skb__shape_run(
 		return;
 
 	// Cache font size as it is used a lot.
-	const float initial_font_size = skb_attributes_get_font_size(content_run_attributes, layout->params.attribute_collection);
+	const float initial_font_size = skb__get_font_size(layout, content_run_attributes);
 	float font_size = initial_font_size;
 	skb_attribute_font_size_scaling_t font_size_scaling = skb_attributes_get_font_size_scaling(content_run_attributes, layout->params.attribute_collection);
 	if (font_size_scaling.type == SKB_FONT_SIZE_SCALING_NORMAL) {
@@ -572,11 +673,9 @@ static void skb__shape_run(
 
 	hb_buffer_add_utf32(buffer, layout->text, layout->text_count, shaping_run->text_range.start, shaping_run->text_range.end - shaping_run->text_range.start);
 
-	const hb_language_t hb_lang = hb_language_from_string(lang, -1);
-
 	hb_buffer_set_direction(buffer, skb_is_rtl(shaping_run->direction) ? HB_DIRECTION_RTL : HB_DIRECTION_LTR);
 	hb_buffer_set_script(buffer, skb__sb_script_to_hb(shaping_run->script));
-	hb_buffer_set_language(buffer, hb_lang);
+	hb_buffer_set_language(buffer, lang_profile->hb_lang);
 
 	hb_feature_t features[SKB_MAX_FEATURES];
 	int32_t features_count = 0;
@@ -606,11 +705,6 @@ static void skb__shape_run(
 	const hb_glyph_info_t* glyph_info = hb_buffer_get_glyph_infos(buffer, NULL);
 	const hb_glyph_position_t* glyph_pos = hb_buffer_get_glyph_positions(buffer, NULL);
 
-	// Get info about regular space character, we'll use it for control characters.
-	hb_codepoint_t space_gid = 0;
-	hb_font_get_glyph (font->hb_font, 0x20 /*space*/, 0, &space_gid);
-	hb_position_t space_x_advance = hb_font_get_glyph_h_advance(font->hb_font, space_gid);
-
 	const float scale = font_size * font->upem_scale;
 
 	// Reserve space for the glyphs.
@@ -668,10 +762,10 @@ static void skb__shape_run(
 
 			if (is_control) {
 				// Replace with space character to avoid showing invalid glyph.
-				glyph->gid = (uint16_t)space_gid;
+				glyph->gid = (uint16_t)font->space_gid;
 				glyph->offset_x = 0.f;
 				glyph->offset_y = 0.f;
-				glyph->advance_x = (float)space_x_advance * scale;
+				glyph->advance_x = font->space_advance * font_size;
 			} else {
 				assert(glyph_info[j].codepoint <= 0xffff);
 				glyph->gid = (uint16_t)glyph_info[j].codepoint;
@@ -1019,7 +1113,9 @@ static void skb__shaping_run_cluster_iter_next(skb__shaping_run_cluster_iter_t*
 	}
 }
 
-static skb_layout_run_t* skb__line_append_shaping_run(skb_layout_t* layout, skb_layout_line_t* line, skb_layout_run_t* cur_layout_run, const skb__shaping_run_t* shaping_run, skb_range_t cluster_range)
+static skb_layout_run_t* skb__line_append_content_run_clusters(
+	skb_layout_t* layout, skb_layout_line_t* line, skb_layout_run_t* cur_layout_run, const skb__shaping_run_t* shaping_run,
+	int32_t content_run_idx, skb_range_t cluster_range, bool has_start, bool has_end)
 {
 	assert(!skb_range_is_empty(cluster_range));
 
@@ -1027,12 +1123,14 @@ static skb_layout_run_t* skb__line_append_shaping_run(skb_layout_t* layout, skb_
 	if (cur_layout_run) {
 		// Note: we're not using script here as might cause too many splits e.g. for Hira/Hani sequences, which come from same font, but different script.
 		// Text direction is important due to how cluster vs glyphs are arranged.
-		if (shaping_run->direction == cur_layout_run->direction && shaping_run->font_handle == cur_layout_run->font_handle && shaping_run->content_run_idx == cur_layout_run->content_run_idx) {
-			// Must be adjacent to the current run
-			if (cluster_range.start == cur_layout_run->cluster_range.end) {
+		if (shaping_run->direction == cur_layout_run->direction && shaping_run->font_handle == cur_layout_run->font_handle && content_run_idx == cur_layout_run->content_run_idx) {
+			// Must be adjacent to the current run.
+			// The glyphs of RTL runs are in visual order within each shaping run, a layout run cannot span over a shaping run split.
+			const bool crosses_rtl_split = skb_is_rtl(shaping_run->direction) && shaping_run->is_split_continuation && cluster_range.start == shaping_run->cluster_range.start;
+			if (cluster_range.start == cur_layout_run->cluster_range.end && !crosses_rtl_split) {
 				cur_layout_run->cluster_range.end = cluster_range.end;
 				skb__update_glyph_range(layout, cur_layout_run);
-				SKB_SET_FLAG(cur_layout_run->flags, SKB_LAYOUT_RUN_HAS_END, cluster_range.end == shaping_run->cluster_range.end);
+				SKB_SET_FLAG(cur_layout_run->flags, SKB_LAYOUT_RUN_HAS_END, has_end);
 				return cur_layout_run;
 			}
 		}
@@ -1050,13 +1148,13 @@ static skb_layout_run_t* skb__line_append_shaping_run(skb_layout_t* layout, skb_
 	}
 	assert(line->layout_run_range.end == layout->layout_runs_count);
 
-	const skb__content_run_t* content_run = &layout->content_runs[shaping_run->content_run_idx];
+	const skb__content_run_t* content_run = &layout->content_runs[content_run_idx];
 
 	layout_run->type = content_run->type;
 	layout_run->direction = shaping_run->direction;
 	layout_run->bidi_level = shaping_run->bidi_level;
 	layout_run->script = shaping_run->script;
-	layout_run->content_run_idx = shaping_run->content_run_idx;
+	layout_run->content_run_idx = content_run_idx;
 	layout_run->font_size = shaping_run->font_size;
 
 	layout_run->attributes_range = content_run->attributes_range;
@@ -1065,8 +1163,8 @@ static skb_layout_run_t* skb__line_append_shaping_run(skb_layout_t* layout, skb_
 	layout_run->cluster_range = cluster_range;
 	skb__update_glyph_range(layout, layout_run);
 
-	SKB_SET_FLAG(layout_run->flags, SKB_LAYOUT_RUN_HAS_START, cluster_range.start == shaping_run->cluster_range.start);
-	SKB_SET_FLAG(layout_run->flags, SKB_LAYOUT_RUN_HAS_END, cluster_range.end == shaping_run->cluster_range.end);
+	SKB_SET_FLAG(layout_run->flags, SKB_LAYOUT_RUN_HAS_START, has_start);
+	SKB_SET_FLAG(layout_run->flags, SKB_LAYOUT_RUN_HAS_END, has_end);
 	SKB_SET_FLAG(layout_run->flags, SKB_LAYOUT_RUN_HAS_BASELINE_SHIFT, shaping_run->has_baseline_shift);
 
 	if (layout_run->type == SKB_CONTENT_RUN_OBJECT || layout_run->type == SKB_CONTENT_RUN_ICON) {
@@ -1081,6 +1179,41 @@ static skb_layout_run_t* skb__line_append_shaping_run(skb_layout_t* layout, skb_
 	return layout_run;
 }
 
+static skb_layout_run_t* skb__line_append_shaping_run(skb_layout_t* layout, skb_layout_line_t* line, skb_layout_run_t* cur_layout_run, const skb__shaping_run_t* shaping_run, skb_range_t cluster_range)
+{
+	assert(!skb_range_is_empty(cluster_range));
+
+	if (shaping_run->content_run_count <= 1) {
+		return skb__line_append_content_run_clusters(layout, line, cur_layout_run, shaping_run, shaping_run->content_run_idx, cluster_range,
+			cluster_range.start == shaping_run->cluster_range.start, cluster_range.end == shaping_run->cluster_range.end);
+	}
+
+	// The shaping run spans over multiple content runs, split the layout runs at content run boundaries.
+	// Clusters are in logical order, so we can find the boundaries by comparing text offsets.
+	// A cluster spanning over content run boundary (e.g. a ligature) is assigned to the content run where it starts.
+	const int32_t content_run_end = shaping_run->content_run_idx + shaping_run->content_run_count;
+	int32_t content_run_idx = shaping_run->content_run_idx;
+	int32_t start = cluster_range.start;
+	while (start < cluster_range.end) {
+		const skb_cluster_t* start_cluster = &layout->clusters[start];
+		while ((content_run_idx + 1) < content_run_end && layout->content_runs[content_run_idx].text_range.end <= start_cluster->text_offset)
+			content_run_idx++;
+		const skb_range_t content_text_range = layout->content_runs[content_run_idx].text_range;
+
+		int32_t end = start + 1;
+		while (end < cluster_range.end && layout->clusters[end].text_offset < content_text_range.end)
+			end++;
+
+		const bool has_start = start == shaping_run->cluster_range.start || layout->clusters[start - 1].text_offset < content_text_range.start;
+		const bool has_end = end == shaping_run->cluster_range.end || layout->clusters[end].text_offset >= content_text_range.end;
+		cur_layout_run = skb__line_append_content_run_clusters(layout, line, cur_layout_run, shaping_run, content_run_idx, (skb_range_t){ .start = start, .end = end }, has_start, has_end);
+
+		start = end;
+	}
+
+	return cur_layout_run;
+}
+
 static skb_layout_run_t* skb__line_append_shaping_run_range(skb_layout_t* layout, skb_layout_line_t* line, skb_layout_run_t* cur_layout_run, skb__shaping_run_cluster_iter_t start_it, skb__shaping_run_cluster_iter_t end_it)
 {
 	const int32_t shaping_runs_count = end_it.shaping_run_idx - start_it.shaping_run_idx + 1;
@@ -1194,7 +1327,7 @@ static void skb__line_append_list_marker_run(skb_layout_t* layout, skb_layout_li
 
 	// Get the font to use from the layout/paragraph attributes.
 	const uint8_t font_family = skb_attributes_get_font_family(layout->params.layout_attributes, layout->params.attribute_collection);
-	const float font_size = skb_attributes_get_font_size(layout->params.layout_attributes, layout->params.attribute_collection);
+	const float font_size = skb__get_font_size(layout, layout->params.layout_attributes);
 	const skb_font_handle_t font_handle = skb_font_collection_get_default_font(layout->params.font_collection, font_family);
 	if (!font_handle)
 		return;
@@ -1423,7 +1556,7 @@ static bool skb__truncate_line(skb_layout_t* layout, int32_t line_idx, bool is_l
 			// Could not find text run on the line, use the defaults from layout instead.
 			const uint8_t font_family = skb_attributes_get_font_family(layout->params.layout_attributes, layout->params.attribute_collection);
 			pruned_run_info.font_handle = skb_font_collection_get_default_font(layout->params.font_collection, font_family);
-			pruned_run_info.font_size = skb_attributes_get_font_size(layout->params.layout_attributes, layout->params.attribute_collection);
+			pruned_run_info.font_size = skb__get_font_size(layout, layout->params.layout_attributes);
 			pruned_run_info.attributes_range = (skb_range_t){0}; // Inherit from layout
 		}
 
@@ -1437,25 +1570,13 @@ static bool skb__truncate_line(skb_layout_t* layout, int32_t line_idx, bool is_l
 			const float baseline = -baseline_set.baselines[baseline_align];
 			const float ref_baseline = baseline_set.alphabetic - baseline_set.baselines[baseline_align];
 
-			// Try to use the actual ellipsis character, but fall back to 3 periods.
-			int32_t ellipsis_glyph_count = 1;
-			hb_codepoint_t ellipsis_gid = 0;
-			if (hb_font_get_glyph(font->hb_font, 0x2026 /*ellipsis*/, 0, &ellipsis_gid))
-				ellipsis_glyph_count = 1;
-			else if (hb_font_get_glyph(font->hb_font, 0x2e /*period*/, 0, &ellipsis_gid))
-				ellipsis_glyph_count = 3;
-
-			const float scale = pruned_run_info.font_size * font->upem_scale;
-			const float ellipsis_x_advance = (float)hb_font_get_glyph_h_advance(font->hb_font, ellipsis_gid) * scale;
+			// The ellipsis glyph is cached in the font, normalized to font size 1.
+			const int32_t ellipsis_glyph_count = font->ellipsis_glyph_count;
+			const uint32_t ellipsis_gid = font->ellipsis_gid;
+			const float ellipsis_x_advance = font->ellipsis_advance * pruned_run_info.font_size;
 			const float ellipsis_width = ellipsis_x_advance * (float)ellipsis_glyph_count;
-			float offset_x = 0.f;
-			float offset_y = 0.f;
-			hb_position_t x, y;
-			if (hb_font_get_glyph_h_origin (font->hb_font, ellipsis_gid, &x, &y)) {
-				offset_x = (float)x * scale;
-				offset_y = (float)y * scale;
-			}
-			offset_y -= baseline;
+			const float offset_x = font->ellipsis_offset.x * pruned_run_info.font_size;
+			const float offset_y = font->ellipsis_offset.y * pruned_run_info.font_size - baseline;
 
 			// Prune the line further until the ellipsis fits.
 			const float max_line_width = line_truncate_width - ellipsis_width;
@@ -1677,7 +1798,7 @@ static bool skb__finalize_line(skb_layout_t* layout, skb_layout_line_t* line, bo
 
 				float baseline_offset = 0.f;
 				if (layout_run->flags & SKB_LAYOUT_RUN_HAS_BASELINE_SHIFT) {
-					const float unscaled_font_size = skb_attributes_get_font_size(layout_run_attributes, layout->params.attribute_collection);
+					const float unscaled_font_size = skb__get_font_size(layout, layout_run_attributes);
 					skb_attribute_baseline_shift_t baseline_shift = skb_attributes_get_baseline_shift(layout_run_attributes, layout->params.attribute_collection);
 					if (baseline_shift.type == SKB_BASELINE_SHIFT_ABSOLUTE)
 						baseline_offset = baseline_shift.offset;
@@ -1735,7 +1856,7 @@ static bool skb__finalize_line(skb_layout_t* layout, skb_layout_line_t* line, bo
 		} else {
 			attributes = layout->params.layout_attributes;
 		}
-		font_size = skb_attributes_get_font_size(attributes, layout->params.attribute_collection);
+		font_size = skb__get_font_size(layout, attributes);
 
 		const uint8_t font_family = skb_attributes_get_font_family(attributes, layout->params.attribute_collection);
 		const skb_attribute_line_height_t attr_line_height = skb_attributes_get_line_height(attributes, layout->params.attribute_collection);
@@ -1808,14 +1929,6 @@ static bool skb__finalize_line(skb_layout_t* layout, skb_layout_line_t* line, bo
 	return false;
 }
 
-static bool skb__equals_inline_padding(const skb_attribute_inline_padding_t* a, const skb_attribute_inline_padding_t* b)
-{
-	return skb_equalsf(a->start, b->start, 1e-6f)
-		&& skb_equalsf(a->end, b->end, 1e-6f)
-		&& skb_equalsf(a->top, b->top, 1e-6f)
-		&& skb_equalsf(a->bottom, b->bottom, 1e-6f);
-}
-
 static void skb__update_line_culling_bounds(skb_layout_t* layout, skb_layout_line_t* line)
 {
 	if (line->layout_run_range.start != line->layout_run_range.end) {
@@ -2042,7 +2155,7 @@ static void skb__build_decorations_for_line(skb_layout_t* layout, int32_t line_i
 				const skb_attribute_t* decorations[SKB__MAX_ACTIVE_DECORATIONS];
 				int32_t decorations_count = skb_attributes_get_by_kind(SKB_ATTRIBUTE_DECORATION, layout_run_attributes, layout->params.attribute_collection, decorations, SKB_COUNTOF(decorations));
 				// We need use the unscale font size for decorations, so that super/subscript text is treated as normal.
-				const float font_size = (decorations_count > 0) ? skb_attributes_get_font_size(layout_run_attributes, layout->params.attribute_collection) : 0.f;
+				const float font_size = (decorations_count > 0) ? skb__get_font_size(layout, layout_run_attributes) : 0.f;
 
 				// Keep track of the run range of decorations that share the same style.
 				for (int32_t ai = 0; ai < active_decorations_count; ai++) {
@@ -2109,6 +2222,7 @@ void skb__layout_lines(skb__layout_build_context_t* build_context, skb_layout_t*
 	layout->advance_y = 0.f;
 	layout->flags = 0;
 
+	layout->lines_count = 0;
 	layout->layout_runs_count = 0;
 
 	skb__calculated_layout_size_t calculated_size = {0};
@@ -2284,6 +2398,8 @@ void skb__layout_lines(skb__layout_build_context_t* build_context, skb_layout_t*
 		// We have consumed the clusters up to end_it-1, continue new word from end_t.
 		it = end_it;
 	}
+	build_context->max_height_reached_before_last_line = max_heigh_reached;
+
 	// Finalize last line
 	if (cur_line)
 		max_heigh_reached = skb__finalize_line(layout, cur_line, true, list_marker, line_break_width, &calculated_size);
@@ -2566,20 +2682,12 @@ static void skb__override_line_breaks(skb_layout_t* layout, int32_t start_offset
 static void skb__apply_lang_based_word_breaks(const skb__layout_build_context_t* build_context, skb_layout_t* layout)
 {
 	// Language based word breaks. These are applied only to specific sections of script.
-	const hb_language_t lang_ja = hb_language_from_string("ja", 2);
-	const hb_language_t lang_zh_hant = hb_language_from_string("zh-hant", 7);
-	const hb_language_t lang_zh_hans = hb_language_from_string("zh-hans", 7);
-	const hb_language_t lang_th = hb_language_from_string("th", 2);
-
 	for (int32_t i = 0; i < layout->shaping_runs_count; ++i) {
 		const skb__shaping_run_t* shaping_run = &layout->shaping_runs[i];
 		const skb__content_run_t* content_run = &layout->content_runs[shaping_run->content_run_idx];
-		const skb_attribute_set_t run_attributes = skb__get_run_attributes(layout, content_run->attributes_range);
+		const uint8_t word_break_model = layout->lang_profiles[content_run->lang_profile_idx].word_break_model;
 
-		const char* lang = skb_attributes_get_lang(run_attributes, layout->params.attribute_collection);
-		const hb_language_t hb_lang = hb_language_from_string(lang, -1);
-
-		if (skb__is_japanese_script(shaping_run->script) && hb_language_matches(lang_ja, hb_lang)) {
+		if (word_break_model == SKB__WORD_BREAK_JA && skb__is_japanese_script(shaping_run->script)) {
 			// Merge supported runs into one longer one.
 			const int32_t start = shaping_run->text_range.start;
 			while ((i+1) < layout->shaping_runs_count && skb__is_japanese_script(layout->shaping_runs[i+1].script))
@@ -2587,16 +2695,16 @@ static void skb__apply_lang_based_word_breaks(const skb__layout_build_context_t*
 			const int32_t end = layout->shaping_runs[i].text_range.end;
 			boundary_iterator_t iter = boundary_iterator_init_ja_utf32(layout->text + start, end - start);
 			skb__override_line_breaks(layout, start, end, iter);
-		} else if (shaping_run->script == SBScriptHANI && (hb_language_matches(lang_zh_hant, hb_lang) || hb_language_matches(lang_zh_hans, hb_lang))) {
+		} else if ((word_break_model == SKB__WORD_BREAK_ZH_HANS || word_break_model == SKB__WORD_BREAK_ZH_HANT) && shaping_run->script == SBScriptHANI) {
 			const int32_t start = shaping_run->text_range.start;
 			const int32_t end = shaping_run->text_range.end;
 			boundary_iterator_t iter = {0};
-			if (hb_language_matches(hb_lang, lang_zh_hans))
+			if (word_break_model == SKB__WORD_BREAK_ZH_HANS)
 				iter = boundary_iterator_init_zh_hans_utf32(layout->text + start, end - start);
 			else
 				iter = boundary_iterator_init_zh_hant_utf32(layout->text + start, end - start);
 			skb__override_line_breaks(layout, start, end, iter);
-		} else if (shaping_run->script == SBScriptTHAI && hb_language_matches(lang_th, hb_lang)) {
+		} else if (word_break_model == SKB__WORD_BREAK_TH && shaping_run->script == SBScriptTHAI) {
 			const int32_t start = shaping_run->text_range.start;
 			const int32_t end = shaping_run->text_range.end;
 			boundary_iterator_t iter = boundary_iterator_init_th_utf32(layout->text + start, end - start);
@@ -2629,12 +2737,241 @@ static bool skb__allow_letter_spacing(uint8_t script)
 	return true;
 }
 
-static void skb__build_layout(skb__layout_build_context_t* build_context, skb_layout_t* layout)
+static void skb__add_object_glyph(skb_layout_t* layout, skb__shaping_run_t* shaping_run, const skb__content_run_t* content_run)
 {
-	// Itemize text into runs of same direction and script. A run of emojis is treated the same as script.
-	skb__itemize(build_context, layout);
+	// Add the replacement object as a glyph.
+	SKB_ARRAY_RESERVE(layout->glyphs, layout->glyphs_count + 1);
+	skb_glyph_t* glyph = &layout->glyphs[layout->glyphs_count++];
+	glyph->gid = 0;
+	glyph->offset_x = 0.f;
+	glyph->offset_y = 0.f;
+	glyph->advance_x = content_run->content_width;
+	shaping_run->glyph_range.start = layout->glyphs_count-1;
+	shaping_run->glyph_range.end = layout->glyphs_count;
 
-	// Apply run attribs to text properties
+	SKB_ARRAY_RESERVE(layout->clusters, layout->clusters_count + 1);
+	skb_cluster_t* cluster = &layout->clusters[layout->clusters_count++];
+	cluster->text_offset = shaping_run->text_range.start;
+	cluster->text_count = (uint8_t)(shaping_run->text_range.end - shaping_run->text_range.start);
+	cluster->glyphs_offset = layout->glyphs_count - 1;
+	cluster->glyphs_count = 1;
+	shaping_run->cluster_range.start = layout->clusters_count-1;
+	shaping_run->cluster_range.end = layout->clusters_count;
+
+	if (layout->retain_unscaled_glyphs) {
+		// Objects do not scale with font size.
+		SKB_ARRAY_RESERVE(layout->unscaled_glyphs, layout->glyphs_count);
+		layout->unscaled_glyphs[layout->glyphs_count - 1] = *glyph;
+	}
+}
+
+static void skb__apply_spacing(skb_layout_t* layout, const skb__shaping_run_t* shaping_run, const skb_attribute_set_t content_run_attributes)
+{
+	// Apply letter and word spacing. Letter spacing is the same for all merged content runs, word spacing is applied per content run.
+	const float letter_spacing = skb_attributes_get_letter_spacing(content_run_attributes, layout->params.attribute_collection);
+	float word_spacing = skb_attributes_get_word_spacing(content_run_attributes, layout->params.attribute_collection);
+	int32_t spacing_content_run_idx = shaping_run->content_run_idx;
+	const int32_t content_run_end = shaping_run->content_run_idx + shaping_run->content_run_count;
+
+	for (int32_t ci = shaping_run->cluster_range.start; ci < shaping_run->cluster_range.end; ci++) {
+		const skb_cluster_t* cluster = &layout->clusters[ci];
+
+		if ((spacing_content_run_idx + 1) < content_run_end && layout->content_runs[spacing_content_run_idx].text_range.end <= cluster->text_offset) {
+			while ((spacing_content_run_idx + 1) < content_run_end && layout->content_runs[spacing_content_run_idx].text_range.end <= cluster->text_offset)
+				spacing_content_run_idx++;
+			const skb_attribute_set_t spacing_attributes = skb__get_run_attributes(layout, layout->content_runs[spacing_content_run_idx].attributes_range);
+			word_spacing = skb_attributes_get_word_spacing(spacing_attributes, layout->params.attribute_collection);
+		}
+
+		// Apply spacing at the end of a glyph cluster.
+		skb_glyph_t* glyph = &layout->glyphs[cluster->glyphs_offset + cluster->glyphs_count - 1];
+		const skb_text_property_t text_props = layout->text_props[cluster->text_offset + cluster->text_count - 1];
+
+		// Apply letter spacing for each grapheme.
+		if (text_props.flags & SKB_TEXT_PROP_GRAPHEME_BREAK) {
+			if ((text_props.flags & SKB_TEXT_PROP_WHITESPACE) || skb__allow_letter_spacing(text_props.script))
+				glyph->advance_x += letter_spacing;
+		}
+
+		// Apply word spacing for each white space.
+		if (text_props.flags & SKB_TEXT_PROP_WHITESPACE)
+			glyph->advance_x += word_spacing;
+	}
+}
+
+static void skb__update_shaping_run_padding(skb_layout_t* layout, int32_t shaping_run_idx, const skb_attribute_set_t content_run_attributes, skb_attribute_inline_padding_t* prev_inline_padding)
+{
+	skb__shaping_run_t* shaping_run = &layout->shaping_runs[shaping_run_idx];
+	const skb__content_run_t* content_run = &layout->content_runs[shaping_run->content_run_idx];
+
+	// Update inline padding for shaping run.
+	skb_attribute_inline_padding_t inline_padding = skb_attributes_get_inline_padding(content_run_attributes, layout->params.attribute_collection);
+
+	skb__shaping_run_t* prev_shaping_run = (shaping_run_idx > 0) ? &layout->shaping_runs[shaping_run_idx-1] : NULL;
+	const skb__content_run_t* prev_content_run = prev_shaping_run ? &layout->content_runs[prev_shaping_run->content_run_idx] : NULL;
+
+	const bool are_same_run = prev_content_run
+		&& prev_content_run->content_id == content_run->content_id
+		&& skb__equals_inline_padding(prev_inline_padding, &inline_padding);
+
+	if (!are_same_run) {
+		if (prev_shaping_run)
+			prev_shaping_run->padding_start = prev_inline_padding->start;
+		shaping_run->padding_end = inline_padding.end;
+	}
+	if (shaping_run_idx+1 >= layout->shaping_runs_count) {
+		shaping_run->padding_start = inline_padding.start;
+	}
+
+	*prev_inline_padding = inline_padding;
+}
+
+static void skb__retain_unscaled_glyphs(skb_layout_t* layout, const skb__shaping_run_t* shaping_run, const skb_attribute_set_t content_run_attributes)
+{
+	// Glyph geometry scales linearly with font size, unless the font has size dependent shaping, or the baseline shift is not relative to font size.
+	const skb_font_t* font = skb_font_collection_get_font(layout->params.font_collection, shaping_run->font_handle);
+	const skb_attribute_baseline_shift_t baseline_shift = skb_attributes_get_baseline_shift(content_run_attributes, layout->params.attribute_collection);
+	if (!font || font->has_size_dependent_shaping || baseline_shift.type == SKB_BASELINE_SHIFT_ABSOLUTE)
+		layout->can_scale_glyphs = false;
+
+	SKB_ARRAY_RESERVE(layout->unscaled_glyphs, shaping_run->glyph_range.end);
+	const float inv_scale = 1.f / layout->font_scale;
+	for (int32_t gi = shaping_run->glyph_range.start; gi < shaping_run->glyph_range.end; gi++) {
+		skb_glyph_t* glyph = &layout->unscaled_glyphs[gi];
+		*glyph = layout->glyphs[gi];
+		glyph->offset_x *= inv_scale;
+		glyph->offset_y *= inv_scale;
+		glyph->advance_x *= inv_scale;
+	}
+}
+
+// Shapes the specified shaping run, and returns the total advance of the shaped glyphs.
+static float skb__shape_shaping_run(skb__layout_build_context_t* build_context, skb_layout_t* layout, hb_buffer_t* buffer, int32_t shaping_run_idx, skb_attribute_inline_padding_t* prev_inline_padding)
+{
+	skb__shaping_run_t* shaping_run = &layout->shaping_runs[shaping_run_idx];
+	const skb__content_run_t* content_run = &layout->content_runs[shaping_run->content_run_idx];
+	const skb_attribute_set_t content_run_attributes = skb__get_run_attributes(layout, content_run->attributes_range);
+
+	// Check if this run is a replacement object.
+	if (content_run->type == SKB_CONTENT_RUN_OBJECT || content_run->type == SKB_CONTENT_RUN_ICON) {
+		skb__add_object_glyph(layout, shaping_run, content_run);
+	} else {
+		hb_buffer_clear_contents(buffer);
+		skb__shape_run(build_context, layout, shaping_run, content_run, buffer, &shaping_run->font_handle, 1, 0);
+		if (layout->retain_unscaled_glyphs)
+			skb__retain_unscaled_glyphs(layout, shaping_run, content_run_attributes);
+		skb__apply_spacing(layout, shaping_run, content_run_attributes);
+	}
+
+	skb__update_shaping_run_padding(layout, shaping_run_idx, content_run_attributes, prev_inline_padding);
+
+	float advance = 0.f;
+	for (int32_t gi = shaping_run->glyph_range.start; gi < shaping_run->glyph_range.end; gi++)
+		advance += layout->glyphs[gi].advance_x;
+
+	return advance;
+}
+
+// Returns the total advance of glyphs after which to check if rest of the text can be left unshaped, or FLT_MAX if the whole text needs to be shaped.
+static float skb__get_shaping_advance_limit(const skb_layout_t* layout)
+{
+	// Shaping can be stopped early only if the text is clipped by the layout box.
+	if (layout->params.flags & SKB_LAYOUT_PARAMS_IGNORE_OVERFLOW)
+		return FLT_MAX;
+	// Relayout at different scale may reveal more text, shape all of it.
+	if (layout->retain_unscaled_glyphs)
+		return FLT_MAX;
+	const skb_text_overflow_t text_overflow = skb_attributes_get_text_overflow(layout->params.layout_attributes, layout->params.attribute_collection);
+	if (text_overflow == SKB_OVERFLOW_NONE || text_overflow == SKB_OVERFLOW_SCROLL)
+		return FLT_MAX;
+
+	const bool has_width_constraint = layout->params.layout_width >= 0.f;
+	const bool has_height_constraint = layout->params.layout_height >= 0.f;
+	if (!has_width_constraint)
+		return FLT_MAX;
+
+	const skb_text_wrap_t text_wrap = skb_attributes_get_text_wrap(layout->params.layout_attributes, layout->params.attribute_collection);
+	if (text_wrap != SKB_WRAP_NONE && !has_height_constraint)
+		return FLT_MAX;
+
+	// Estimate how many lines fit in the layout box, the estimate is adjusted later if more text is needed.
+	static const float safety_margin = 1.5f;
+	const float font_size = skb__get_font_size(layout, layout->params.layout_attributes);
+	float visible_lines = 1.f;
+	if (has_height_constraint && font_size > 0.f)
+		visible_lines = skb_maxf(1.f, ceilf(layout->params.layout_height / font_size));
+
+	return skb_maxf(font_size, layout->params.layout_width) * visible_lines * safety_margin;
+}
+
+// Splits long shaping runs into smaller chunks at line break opportunities, so that the shaping can be stopped early.
+static void skb__split_long_shaping_runs(skb_layout_t* layout)
+{
+	enum { SKB_SHAPING_CHUNK_SIZE = 256 };
+
+	for (int32_t i = 0; i < layout->shaping_runs_count; i++) {
+		skb__shaping_run_t* shaping_run = &layout->shaping_runs[i];
+		if ((shaping_run->text_range.end - shaping_run->text_range.start) <= SKB_SHAPING_CHUNK_SIZE)
+			continue;
+
+		// Inline padding is applied at the start and end of the shaping runs, do not split runs which have it.
+		const skb__content_run_t* content_run = &layout->content_runs[shaping_run->content_run_idx];
+		if (content_run->type == SKB_CONTENT_RUN_OBJECT || content_run->type == SKB_CONTENT_RUN_ICON)
+			continue;
+		const skb_attribute_set_t content_run_attributes = skb__get_run_attributes(layout, content_run->attributes_range);
+		const skb_attribute_inline_padding_t inline_padding = skb_attributes_get_inline_padding(content_run_attributes, layout->params.attribute_collection);
+		const skb_attribute_inline_padding_t no_padding = {0};
+		if (!skb__equals_inline_padding(&inline_padding, &no_padding))
+			continue;
+
+		// Find next line break opportunity after the chunk size.
+		int32_t split_offset = shaping_run->text_range.start + SKB_SHAPING_CHUNK_SIZE;
+		while (split_offset < shaping_run->text_range.end && (layout->text_props[split_offset - 1].flags & (SKB_TEXT_PROP_ALLOW_LINE_BREAK | SKB_TEXT_PROP_MUST_LINE_BREAK)) == 0)
+			split_offset++;
+		if (split_offset >= shaping_run->text_range.end)
+			continue;
+
+		// Split the run, the remainder is processed on next iteration.
+		SKB_ARRAY_RESERVE(layout->shaping_runs, layout->shaping_runs_count + 1);
+		shaping_run = &layout->shaping_runs[i];
+		memmove(&layout->shaping_runs[i + 2], &layout->shaping_runs[i + 1], sizeof(skb__shaping_run_t) * (layout->shaping_runs_count - (i + 1)));
+		layout->shaping_runs_count++;
+
+		skb__shaping_run_t* next_shaping_run = &layout->shaping_runs[i + 1];
+		*next_shaping_run = *shaping_run;
+		shaping_run->text_range.end = split_offset;
+		next_shaping_run->text_range.start = split_offset;
+		next_shaping_run->is_split_continuation = true;
+		skb__set_shaping_run_content_runs(layout, shaping_run, shaping_run->content_run_idx);
+		skb__set_shaping_run_content_runs(layout, next_shaping_run, shaping_run->content_run_idx);
+	}
+}
+
+// Returns true if laying out more text after the shaped runs would not change the visible layout.
+static bool skb__can_stop_shaping(const skb__layout_build_context_t* build_context, const skb_layout_t* layout, int32_t shaped_runs_count, int32_t last_must_break_offset)
+{
+	// If the lines reached the layout height before the last line, the following text will not be visible.
+	if (build_context->max_height_reached_before_last_line)
+		return true;
+
+	// With no wrapping, the rest of the text is clipped if the last line is already truncated,
+	// there are no more line breaks, and the following text will not be reordered before the visible text.
+	const skb_text_wrap_t text_wrap = skb_attributes_get_text_wrap(layout->params.layout_attributes, layout->params.attribute_collection);
+	if (text_wrap == SKB_WRAP_NONE && layout->lines_count > 0) {
+		const skb_layout_line_t* last_line = &layout->lines[layout->lines_count - 1];
+		const skb__shaping_run_t* next_shaping_run = &layout->shaping_runs[shaped_runs_count];
+		const bool ignore_must_breaks = layout->params.flags & SKB_LAYOUT_PARAMS_IGNORE_MUST_LINE_BREAKS;
+		const uint8_t base_level = skb_is_rtl(layout->resolved_direction) ? 1 : 0;
+		return (last_line->flags & SKB_LAYOUT_LINE_IS_TRUNCATED)
+			&& (ignore_must_breaks || last_must_break_offset < next_shaping_run->text_range.start)
+			&& next_shaping_run->bidi_level == base_level;
+	}
+
+	return false;
+}
+
+static void skb__apply_shaping_run_text_props(skb_layout_t* layout)
+{
 	for (int32_t i = 0; i < layout->shaping_runs_count; ++i) {
 		const skb__shaping_run_t* shaping_run = &layout->shaping_runs[i];
 		for (int32_t j = shaping_run->text_range.start; j < shaping_run->text_range.end; j++) {
@@ -2642,6 +2979,15 @@ static void skb__build_layout(skb__layout_build_context_t* build_context, skb_la
 			layout->text_props[j].script = shaping_run->script;
 		}
 	}
+}
+
+static void skb__build_layout(skb__layout_build_context_t* build_context, skb_layout_t* layout)
+{
+	// Itemize text into runs of same direction and script. A run of emojis is treated the same as script.
+	skb__itemize(build_context, layout);
+
+	// Apply run attribs to text properties
+	skb__apply_shaping_run_text_props(layout);
 
 	// Handle word breaks for languages what do not have word break characters.
 	skb__apply_lang_based_word_breaks(build_context, layout);
@@ -2649,93 +2995,210 @@ static void skb__build_layout(skb__layout_build_context_t* build_context, skb_la
 	// Shape runs
 	layout->clusters_count = 0;
 	layout->glyphs_count = 0;
+	layout->unscaled_glyphs_count = 0;
+	layout->can_scale_glyphs = layout->retain_unscaled_glyphs;
 
 	hb_buffer_t* buffer = hb_buffer_create();
 
 	skb_attribute_inline_padding_t prev_inline_padding = {0};
 
-	for (int32_t i = 0; i < layout->shaping_runs_count; ++i) {
-		skb__shaping_run_t* shaping_run = &layout->shaping_runs[i];
-		const skb__content_run_t* content_run = &layout->content_runs[shaping_run->content_run_idx];
-		const skb_attribute_set_t content_run_attributes = skb__get_run_attributes(layout, content_run->attributes_range);
+	// When the text is clipped to the layout box, shape the text incrementally, and stop when the rest of the text would not be visible.
+	float shaping_advance_limit = skb__get_shaping_advance_limit(layout);
+	int32_t last_must_break_offset = -1;
+	if (shaping_advance_limit < FLT_MAX) {
+		skb__split_long_shaping_runs(layout);
+		for (int32_t i = layout->text_count - 1; i >= 0; i--) {
+			if (layout->text_props[i].flags & SKB_TEXT_PROP_MUST_LINE_BREAK) {
+				last_must_break_offset = i;
+				break;
+			}
+		}
+	}
 
-		// Check if this run is a replacement object.
-		if (content_run->type == SKB_CONTENT_RUN_OBJECT || content_run->type == SKB_CONTENT_RUN_ICON) {
-			// Add the replacement object as a glyph.
+	const int32_t shaping_runs_count = layout->shaping_runs_count;
+	int32_t shaped_runs_count = 0;
+	float shaped_advance = 0.f;
+	bool is_partially_shaped = false;
 
-			SKB_ARRAY_RESERVE(layout->glyphs, layout->glyphs_count + 1);
-			skb_glyph_t* glyph = &layout->glyphs[layout->glyphs_count++];
-			glyph->gid = 0;
-			glyph->offset_x = 0.f;
-			glyph->offset_y = 0.f;
-			glyph->advance_x = content_run->content_width;
-			shaping_run->glyph_range.start = layout->glyphs_count-1;
-			shaping_run->glyph_range.end = layout->glyphs_count;
+	while (shaped_runs_count < shaping_runs_count) {
+		while (shaped_runs_count < shaping_runs_count && shaped_advance < shaping_advance_limit) {
+			shaped_advance += skb__shape_shaping_run(build_context, layout, buffer, shaped_runs_count, &prev_inline_padding);
+			shaped_runs_count++;
+		}
+		if (shaped_runs_count == shaping_runs_count)
+			break;
 
-			SKB_ARRAY_RESERVE(layout->clusters, layout->clusters_count + 1);
-			skb_cluster_t* cluster = &layout->clusters[layout->clusters_count++];
-			cluster->text_offset = shaping_run->text_range.start;
-			cluster->text_count = (uint8_t)(shaping_run->text_range.end - shaping_run->text_range.start);
-			cluster->glyphs_offset = layout->glyphs_count - 1;
-			cluster->glyphs_count = 1;
-			shaping_run->cluster_range.start = layout->clusters_count-1;
-			shaping_run->cluster_range.end = layout->clusters_count;
+		// Layout the text shaped so far, and check if the rest of the text is needed.
+		// Line layout modifies the glyphs, keep copy of the shaped glyphs so that we can continue shaping if needed.
+		const int32_t shaped_glyphs_count = layout->glyphs_count;
+		const int32_t shaped_clusters_count = layout->clusters_count;
+		skb_glyph_t* shaped_glyphs = SKB_TEMP_ALLOC(build_context->temp_alloc, skb_glyph_t, shaped_glyphs_count);
+		memcpy(shaped_glyphs, layout->glyphs, sizeof(skb_glyph_t) * shaped_glyphs_count);
+
+		// The start padding of the last shaped run is resolved when the next run is shaped, assume it is the last run for now.
+		skb__shaping_run_t* last_shaped_run = &layout->shaping_runs[shaped_runs_count - 1];
+		const float last_shaped_run_padding_start = last_shaped_run->padding_start;
+		last_shaped_run->padding_start = prev_inline_padding.start;
+
+		layout->shaping_runs_count = shaped_runs_count;
+		skb__layout_lines(build_context, layout);
+		is_partially_shaped = skb__can_stop_shaping(build_context, layout, shaped_runs_count, last_must_break_offset);
+
+		if (!is_partially_shaped) {
+			last_shaped_run->padding_start = last_shaped_run_padding_start;
+			memcpy(layout->glyphs, shaped_glyphs, sizeof(skb_glyph_t) * shaped_glyphs_count);
+			layout->glyphs_count = shaped_glyphs_count;
+			layout->clusters_count = shaped_clusters_count;
+			layout->shaping_runs_count = shaping_runs_count;
+			shaping_advance_limit *= 2.f;
+		}
+		SKB_TEMP_FREE(build_context->temp_alloc, shaped_glyphs);
 
-		} else {
-			hb_buffer_clear_contents(buffer);
-			skb__shape_run(build_context, layout, shaping_run, content_run, buffer, &shaping_run->font_handle, 1, 0);
+		if (is_partially_shaped)
+			break;
+	}
+	hb_buffer_destroy(buffer);
+
+	if (is_partially_shaped) {
+		// The lines are already laid out, leave the rest of the runs unshaped.
+		layout->flags |= SKB_LAYOUT_IS_PARTIALLY_SHAPED;
+		layout->shaped_text_range.start = 0;
+		layout->shaped_text_range.end = layout->shaping_runs[shaped_runs_count - 1].text_range.end;
+	} else {
+		if (layout->retain_unscaled_glyphs) {
+			layout->unscaled_glyphs_count = layout->glyphs_count;
+			layout->shaped_clusters_count = layout->clusters_count;
+		}
+		// Break layout to lines.
+		skb__layout_lines(build_context, layout);
+		layout->shaped_text_range.start = 0;
+		layout->shaped_text_range.end = layout->text_count;
+	}
+
+	// There are freed in the order they are allocated so that the allocations get unwound.
+	SKB_TEMP_FREE(build_context->temp_alloc, build_context->emoji_types_buffer);
+}
 
-			// Apply letter and word spacing
-			const float letter_spacing = skb_attributes_get_letter_spacing(content_run_attributes, layout->params.attribute_collection);
-			const float word_spacing = skb_attributes_get_word_spacing(content_run_attributes, layout->params.attribute_collection);
+// The shaped runs may come from outside (e.g. over network), all ranges and indices are checked before use. Returns false if the runs are not valid.
+static bool skb__build_layout_from_shaped_runs(skb__layout_build_context_t* build_context, skb_layout_t* layout, const skb_shaped_run_t* shaped_runs, int32_t shaped_runs_count)
+{
+	if (shaped_runs_count < 0 || (shaped_runs_count > 0 && !shaped_runs))
+		return false;
 
-			for (int32_t ci = shaping_run->cluster_range.start; ci < shaping_run->cluster_range.end; ci++) {
-				const skb_cluster_t* cluster = &layout->clusters[ci];
+	// Resolve direction, the paragraph level is the lowest bidi level of the runs.
+	const skb_text_direction_t base_direction = skb_attributes_get_text_base_direction(layout->params.layout_attributes, layout->params.attribute_collection);
+	if (base_direction == SKB_DIRECTION_RTL || base_direction == SKB_DIRECTION_LTR) {
+		layout->resolved_direction = (uint8_t)base_direction;
+	} else {
+		uint8_t min_bidi_level = 0xff;
+		for (int32_t i = 0; i < shaped_runs_count; i++)
+			min_bidi_level = (uint8_t)skb_mini(min_bidi_level, shaped_runs[i].bidi_level);
+		layout->resolved_direction = (min_bidi_level != 0xff && (min_bidi_level & 1)) ? SKB_DIRECTION_RTL : SKB_DIRECTION_LTR;
+	}
 
-				// Apply spacing at the end of a glyph cluster.
-				skb_glyph_t* glyph = &layout->glyphs[cluster->glyphs_offset + cluster->glyphs_count - 1];
-				const skb_text_property_t text_props = layout->text_props[cluster->text_offset + cluster->text_count - 1];
+	// Create shaping runs and glyphs from the shaped runs.
+	layout->shaping_runs_count = 0;
+	layout->clusters_count = 0;
+	layout->glyphs_count = 0;
 
-				// Apply letter spacing for each grapheme.
-				if (text_props.flags & SKB_TEXT_PROP_GRAPHEME_BREAK) {
-					if ((text_props.flags & SKB_TEXT_PROP_WHITESPACE) || skb__allow_letter_spacing(text_props.script))
-						glyph->advance_x += letter_spacing;
-				}
+	SKB_ARRAY_RESERVE(layout->shaping_runs, shaped_runs_count);
 
-				// Apply word spacing for each white space.
-				if (text_props.flags & SKB_TEXT_PROP_WHITESPACE)
-					glyph->advance_x += word_spacing;
-			}
-		}
+	int32_t content_run_idx = 0;
+	int32_t prev_text_end = 0;
+	skb_attribute_inline_padding_t prev_inline_padding = {0};
 
-		// Update inline padding for shaping run.
-		skb_attribute_inline_padding_t inline_padding = skb_attributes_get_inline_padding(content_run_attributes, layout->params.attribute_collection);
+	for (int32_t i = 0; i < shaped_runs_count; i++) {
+		const skb_shaped_run_t* shaped_run = &shaped_runs[i];
+		if (shaped_run->text_range.start != prev_text_end || shaped_run->text_range.end <= shaped_run->text_range.start || shaped_run->text_range.end > layout->text_count)
+			return false;
+		prev_text_end = shaped_run->text_range.end;
+
+		skb__shaping_run_t* shaping_run = &layout->shaping_runs[layout->shaping_runs_count++];
+		SKB_ZERO_STRUCT(shaping_run);
+		shaping_run->text_range = shaped_run->text_range;
+		shaping_run->script = shaped_run->script;
+		shaping_run->bidi_level = shaped_run->bidi_level;
+		shaping_run->direction = (shaped_run->bidi_level & 1) ? SKB_DIRECTION_RTL : SKB_DIRECTION_LTR;
+		shaping_run->is_emoji = shaped_run->is_emoji;
+		shaping_run->font_handle = shaped_run->font_handle;
+		shaping_run->font_size = shaped_run->font_size;
+		skb__set_shaping_run_content_runs(layout, shaping_run, content_run_idx);
+		content_run_idx = shaping_run->content_run_idx;
 
-		skb__shaping_run_t* prev_shaping_run = (i > 0) ? &layout->shaping_runs[i-1] : NULL;
-		const skb__content_run_t* prev_content_run = prev_shaping_run ? &layout->content_runs[prev_shaping_run->content_run_idx] : NULL;
+		const skb__content_run_t* content_run = &layout->content_runs[shaping_run->content_run_idx];
+		const skb_attribute_set_t content_run_attributes = skb__get_run_attributes(layout, content_run->attributes_range);
 
-		const bool are_same_run = prev_content_run
-			&& prev_content_run->content_id == content_run->content_id
-			&& skb__equals_inline_padding(&prev_inline_padding, &inline_padding);
+		if (content_run->type == SKB_CONTENT_RUN_OBJECT || content_run->type == SKB_CONTENT_RUN_ICON) {
+			skb__add_object_glyph(layout, shaping_run, content_run);
+		} else {
+			if (shaped_run->glyphs_count < 0 || shaped_run->clusters_count < 0)
+				return false;
+			if ((shaped_run->glyphs_count > 0 && !shaped_run->glyphs) || (shaped_run->clusters_count > 0 && !shaped_run->clusters))
+				return false;
+			if (shaped_run->glyphs_count > 0 && shaped_run->clusters_count == 0)
+				return false;
+			if (!layout->params.font_collection || !skb_font_collection_get_font(layout->params.font_collection, shaped_run->font_handle))
+				return false;
+
+			// The baseline shift is already applied to the glyph offsets, we just need to know if the run has it.
+			const skb_attribute_baseline_shift_t baseline_shift = skb_attributes_get_baseline_shift(content_run_attributes, layout->params.attribute_collection);
+			shaping_run->has_baseline_shift = baseline_shift.type != SKB_BASELINE_SHIFT_NONE;
+
+			SKB_ARRAY_RESERVE(layout->glyphs, layout->glyphs_count + shaped_run->glyphs_count);
+			SKB_ARRAY_RESERVE(layout->clusters, layout->clusters_count + shaped_run->clusters_count);
+
+			shaping_run->glyph_range.start = layout->glyphs_count;
+			shaping_run->cluster_range.start = layout->clusters_count;
+
+			memcpy(layout->glyphs + layout->glyphs_count, shaped_run->glyphs, sizeof(skb_glyph_t) * shaped_run->glyphs_count);
+			memcpy(layout->clusters + layout->clusters_count, shaped_run->clusters, sizeof(skb_cluster_t) * shaped_run->clusters_count);
+
+			// Set cluster idx for each glyph, and make glyph offsets relative to the layout glyphs.
+			// Glyphs which are not covered by any cluster are assigned to the first cluster of the run.
+			for (int32_t j = 0; j < shaped_run->glyphs_count; j++)
+				layout->glyphs[layout->glyphs_count + j].cluster_idx = layout->clusters_count;
+			for (int32_t ci = 0; ci < shaped_run->clusters_count; ci++) {
+				skb_cluster_t* cluster = &layout->clusters[layout->clusters_count + ci];
+				if (cluster->text_offset < shaped_run->text_range.start || cluster->text_count == 0 || cluster->text_offset + (int32_t)cluster->text_count > shaped_run->text_range.end)
+					return false;
+				if (cluster->glyphs_offset < 0 || cluster->glyphs_count == 0 || cluster->glyphs_offset + (int32_t)cluster->glyphs_count > shaped_run->glyphs_count)
+					return false;
+				cluster->glyphs_offset += layout->glyphs_count;
+				for (int32_t j = 0; j < cluster->glyphs_count; j++)
+					layout->glyphs[cluster->glyphs_offset + j].cluster_idx = layout->clusters_count + ci;
+			}
 
-		if (!are_same_run) {
-			if (prev_shaping_run)
-				prev_shaping_run->padding_start = prev_inline_padding.start;
-			shaping_run->padding_end = inline_padding.end;
-		}
-		if (i+1 >= layout->shaping_runs_count) {
-			shaping_run->padding_start = inline_padding.start;
+			layout->glyphs_count += shaped_run->glyphs_count;
+			layout->clusters_count += shaped_run->clusters_count;
+			shaping_run->glyph_range.end = layout->glyphs_count;
+			shaping_run->cluster_range.end = layout->clusters_count;
 		}
+	}
+	if (prev_text_end != layout->text_count)
+		return false;
 
-		prev_inline_padding = inline_padding;
+	// Apply run attribs to text properties
+	skb__apply_shaping_run_text_props(layout);
+
+	// Handle word breaks for languages what do not have word break characters.
+	skb__apply_lang_based_word_breaks(build_context, layout);
+
+	// Spacing uses the text properties, apply it after they are complete.
+	for (int32_t i = 0; i < layout->shaping_runs_count; i++) {
+		const skb__shaping_run_t* shaping_run = &layout->shaping_runs[i];
+		const skb__content_run_t* content_run = &layout->content_runs[shaping_run->content_run_idx];
+		const skb_attribute_set_t content_run_attributes = skb__get_run_attributes(layout, content_run->attributes_range);
+		if (content_run->type != SKB_CONTENT_RUN_OBJECT && content_run->type != SKB_CONTENT_RUN_ICON)
+			skb__apply_spacing(layout, shaping_run, content_run_attributes);
+		skb__update_shaping_run_padding(layout, i, content_run_attributes, &prev_inline_padding);
 	}
-	hb_buffer_destroy(buffer);
 
 	// Break layout to lines.
 	skb__layout_lines(build_context, layout);
+	layout->shaped_text_range.start = 0;
+	layout->shaped_text_range.end = layout->text_count;
 
-	// There are freed in the order they are allocated so that the allocations get unwound.
-	SKB_TEMP_FREE(build_context->temp_alloc, build_context->emoji_types_buffer);
+	return true;
 }
 
 
@@ -2760,7 +3223,7 @@ static void skb__copy_params_attributes(skb_layout_t* layout, const skb_layout_p
 
 skb_layout_t skb_layout_make_empty(void)
 {
-	return (skb_layout_t) { .should_free_instance = false, };
+	return (skb_layout_t) { .should_free_instance = false, .font_scale = 1.f, };
 }
 
 skb_layout_t* skb_layout_create(const skb_layout_params_t* params)
@@ -2774,7 +3237,85 @@ skb_layout_t* skb_layout_create(const skb_layout_params_t* params)
 		skb__copy_params_attributes(layout, params);
 	}
 
+	layout->font_scale = 1.f;
+	layout->should_free_instance = true;
+
+	return layout;
+}
+
+static void* skb__copy_layout_array(const void* src, int32_t count, int32_t item_size)
+{
+	if (count <= 0)
+		return NULL;
+	void* dst = skb_malloc((size_t)count * item_size);
+	memcpy(dst, src, (size_t)count * item_size);
+	return dst;
+}
+
+skb_layout_t* skb_layout_create_copy(const skb_layout_t* src_layout)
+{
+	assert(src_layout);
+
+	skb_layout_t* layout = skb_malloc(sizeof(skb_layout_t));
+	*layout = *src_layout;
+	layout->should_free_instance = true;
+	layout->paint_base = NULL;
+
+	// Copy arrays, the capacity of the copy is the count. Shared text is referenced by the copy too.
+	if (src_layout->text_is_shared) {
+		skb_text_retain_shared_utf32(src_layout->text);
+		layout->text_buffer = NULL;
+		layout->text_buffer_cap = 0;
+	} else {
+		layout->text_buffer = skb__copy_layout_array(src_layout->text, src_layout->text_count, sizeof(uint32_t));
+		layout->text_buffer_cap = src_layout->text_count;
+		layout->text = layout->text_buffer;
+	}
+	layout->text_props = skb__copy_layout_array(src_layout->text_props, src_layout->text_count, sizeof(skb_text_property_t));
+	layout->text_cap = src_layout->text_count;
+	layout->content_runs = skb__copy_layout_array(src_layout->content_runs, src_layout->content_runs_count, sizeof(skb__content_run_t));
+	layout->content_runs_cap = src_layout->content_runs_count;
+	layout->attributes = skb__copy_layout_array(src_layout->attributes, src_layout->attributes_count, sizeof(skb_attribute_t));
+	layout->attributes_cap = src_layout->attributes_count;
+	layout->lang_profiles = skb__copy_layout_array(src_layout->lang_profiles, src_layout->lang_profiles_count, sizeof(skb__lang_profile_t));
+	layout->lang_profiles_cap = src_layout->lang_profiles_count;
+	layout->shaping_runs = skb__copy_layout_array(src_layout->shaping_runs, src_layout->shaping_runs_count, sizeof(skb__shaping_run_t));
+	layout->shaping_runs_cap = src_layout->shaping_runs_count;
+	layout->glyphs = skb__copy_layout_array(src_layout->glyphs, src_layout->glyphs_count, sizeof(skb_glyph_t));
+	layout->glyphs_cap = src_layout->glyphs_count;
+	layout->clusters = skb__copy_layout_array(src_layout->clusters, src_layout->clusters_count, sizeof(skb_cluster_t));
+	layout->clusters_cap = src_layout->clusters_count;
+	layout->unscaled_glyphs = skb__copy_layout_array(src_layout->unscaled_glyphs, src_layout->unscaled_glyphs_count, sizeof(skb_glyph_t));
+	layout->unscaled_glyphs_cap = src_layout->unscaled_glyphs_count;
+	layout->lines = skb__copy_layout_array(src_layout->lines, src_layout->lines_count, sizeof(skb_layout_line_t));
+	layout->lines_cap = src_layout->lines_count;
+	layout->layout_runs = skb__copy_layout_array(src_layout->layout_runs, src_layout->layout_runs_count, sizeof(skb_layout_run_t));
+	layout->layout_runs_cap = src_layout->layout_runs_count;
+	layout->decorations = skb__copy_layout_array(src_layout->decorations, src_layout->decorations_count, sizeof(skb_decoration_t));
+	layout->decorations_cap = src_layout->decorations_count;
+
+	// The layout attributes point to the attributes array.
+	if (src_layout->params.layout_attributes.attributes_count > 0)
+		layout->params.layout_attributes.attributes = layout->attributes + (src_layout->params.layout_attributes.attributes - src_layout->attributes);
+
+	return layout;
+}
+
+skb_layout_t* skb_layout_create_paint_variant(const skb_layout_t* base_layout)
+{
+	assert(base_layout);
+	assert(!base_layout->paint_base);
+
+	skb_layout_t* layout = skb_malloc(sizeof(skb_layout_t));
+	*layout = *base_layout;
 	layout->should_free_instance = true;
+	layout->paint_base = base_layout;
+
+	// The paints are stored in the attributes, everything else is referenced from the base layout.
+	layout->attributes = skb__copy_layout_array(base_layout->attributes, base_layout->attributes_count, sizeof(skb_attribute_t));
+	layout->attributes_cap = base_layout->attributes_count;
+	if (base_layout->params.layout_attributes.attributes_count > 0)
+		layout->params.layout_attributes.attributes = layout->attributes + (base_layout->params.layout_attributes.attributes - base_layout->attributes);
 
 	return layout;
 }
@@ -2798,14 +3339,27 @@ skb_layout_t* skb_layout_create_from_runs(skb_temp_alloc_t* temp_alloc, const sk
 	return layout;
 }
 
-skb_layout_t* skb_layout_create_from_text(skb_temp_alloc_t* temp_alloc, const skb_layout_params_t* params, const skb_text_t* text, skb_attribute_set_t attributes)
+skb_layout_t* skb_layout_create_from_shaped_runs(
+	skb_temp_alloc_t* temp_alloc, const skb_layout_params_t* params,
+	const skb_content_run_t* runs, int32_t runs_count,
+	const skb_shaped_run_t* shaped_runs, int32_t shaped_runs_count)
 {
 	skb_layout_t* layout = skb_layout_create(params);
-	skb_layout_set_from_text(layout, temp_alloc, params, text, attributes);
+	if (!skb_layout_set_from_shaped_runs(layout, temp_alloc, params, runs, runs_count, shaped_runs, shaped_runs_count)) {
+		skb_layout_destroy(layout);
+		return NULL;
+	}
 	return layout;
 }
 
-void skb_layout_set_utf8(skb_layout_t* layout, skb_temp_alloc_t* temp_alloc, const skb_layout_params_t* params, const char* text, int32_t text_count, skb_attribute_set_t attributes)
+skb_layout_t* skb_layout_create_from_text(skb_temp_alloc_t* temp_alloc, const skb_layout_params_t* params, const skb_text_t* text, skb_attribute_set_t attributes)
+{
+	skb_layout_t* layout = skb_layout_create(params);
+	skb_layout_set_from_text(layout, temp_alloc, params, text, attributes);
+	return layout;
+}
+
+void skb_layout_set_utf8(skb_layout_t* layout, skb_temp_alloc_t* temp_alloc, const skb_layout_params_t* params, const char* text, int32_t text_count, skb_attribute_set_t attributes)
 {
 	const skb_content_run_t run = skb_content_run_make_utf8(text, text_count, attributes, 0);
 	skb_layout_set_from_runs(layout, temp_alloc, params, &run, 1);
@@ -2817,23 +3371,42 @@ void skb_layout_set_utf32(skb_layout_t* layout, skb_temp_alloc_t* temp_alloc, co
 	skb_layout_set_from_runs(layout, temp_alloc, params, &run, 1);
 }
 
+// Makes the layout reference the shared codepoints of a source text, or its own text buffer if shared_text is NULL.
+static void skb__set_shared_text(skb_layout_t* layout, const uint32_t* shared_text)
+{
+	if (layout->text_is_shared)
+		skb_text_release_shared_utf32(layout->text);
+	layout->text_is_shared = shared_text != NULL;
+	layout->text = shared_text ? shared_text : layout->text_buffer;
+}
+
 void skb_layout_reset(skb_layout_t* layout)
 {
 	assert(layout);
+	assert(!layout->paint_base); // Paint variants cannot be changed, except their paints.
+
+	skb__set_shared_text(layout, NULL);
 
 	layout->params = (skb_layout_params_t){0};
 	layout->bounds = (skb_rect2_t){0};
 	layout->padding = (skb_padding2_t){0};
 	layout->advance_y = 0.f;
 	layout->resolved_direction = SKB_DIRECTION_AUTO;
+	layout->shaped_text_range = (skb_range_t){0};
+	layout->font_scale = 1.f;
+	layout->retain_unscaled_glyphs = false;
+	layout->can_scale_glyphs = false;
 
 	// Reset without freeing memory.
 	layout->text_count = 0;
 	layout->content_runs_count = 0;
 	layout->attributes_count = 0;
+	layout->lang_profiles_count = 0;
 	layout->shaping_runs_count = 0;
 	layout->glyphs_count = 0;
 	layout->clusters_count = 0;
+	layout->unscaled_glyphs_count = 0;
+	layout->shaped_clusters_count = 0;
 	layout->lines_count = 0;
 	layout->layout_runs_count = 0;
 	layout->decorations_count = 0;
@@ -2844,11 +3417,33 @@ static void skb__reserve_text(skb_layout_t* layout, int32_t text_count)
 {
 	if (text_count > layout->text_cap) {
 		layout->text_cap = text_count;
-		layout->text = skb_realloc(layout->text, layout->text_cap * sizeof(uint32_t));
-		assert(layout->text);
 		layout->text_props = skb_realloc(layout->text_props, layout->text_cap * sizeof(skb_text_property_t));
 		assert(layout->text_props);
 	}
+	if (!layout->text_is_shared) {
+		if (text_count > layout->text_buffer_cap) {
+			layout->text_buffer_cap = text_count;
+			layout->text_buffer = skb_realloc(layout->text_buffer, layout->text_buffer_cap * sizeof(uint32_t));
+			assert(layout->text_buffer);
+		}
+		layout->text = layout->text_buffer;
+	}
+}
+
+// Copies the first text_count codepoints of the shared text to the layout's own buffer, when the content does not match the shared text.
+static void skb__unshare_text(skb_layout_t* layout, int32_t text_count)
+{
+	if (!layout->text_is_shared)
+		return;
+	const uint32_t* shared_text = layout->text;
+	if (text_count > layout->text_buffer_cap) {
+		layout->text_buffer_cap = text_count;
+		layout->text_buffer = skb_realloc(layout->text_buffer, layout->text_buffer_cap * sizeof(uint32_t));
+		assert(layout->text_buffer);
+	}
+	if (text_count > 0)
+		memcpy(layout->text_buffer, shared_text, text_count * sizeof(uint32_t));
+	skb__set_shared_text(layout, NULL);
 }
 
 static int32_t skb__append_text_utf8(skb_layout_t* layout, const char* utf8, int32_t utf8_len)
@@ -2859,11 +3454,12 @@ static int32_t skb__append_text_utf8(skb_layout_t* layout, const char* utf8, int
 	if (!new_text_count)
 		return new_text_count;
 
+	skb__unshare_text(layout, new_text_offset);
 	layout->text_count += new_text_count;
 	skb__reserve_text(layout, layout->text_count);
 
 	// Convert utf-8 to utf-32 codepoints.
-	skb_utf8_to_utf32(utf8, utf8_len, layout->text + new_text_offset, new_text_count);
+	skb_utf8_to_utf32(utf8, utf8_len, layout->text_buffer + new_text_offset, new_text_count);
 
 	memset(layout->text_props + new_text_offset, 0, new_text_count * sizeof(skb_text_property_t));
 
@@ -2878,26 +3474,34 @@ static int32_t skb__append_text_utf32(skb_layout_t* layout, const uint32_t* utf3
 	if (!new_text_count)
 		return new_text_count;
 
+	// Runs of shared text are consecutive ranges of the shared codepoints, anything else is copied.
+	if (utf32 != layout->text + new_text_offset)
+		skb__unshare_text(layout, new_text_offset);
 	layout->text_count += new_text_count;
 	skb__reserve_text(layout, layout->text_count);
 
-	memcpy(layout->text + new_text_offset, utf32, new_text_count * sizeof(uint32_t));
+	if (!layout->text_is_shared)
+		memcpy(layout->text_buffer + new_text_offset, utf32, new_text_count * sizeof(uint32_t));
 	memset(layout->text_props + new_text_offset, 0, new_text_count * sizeof(skb_text_property_t));
 
 	return utf32_len;
 }
 
-static void skb__init_text_props(skb_temp_alloc_t* temp_alloc, const char* lang, const uint32_t* text, skb_text_property_t* text_props, int32_t text_count)
+// Analyzes grapheme, word, and line breaks, and character categories of the text. Breaks is scratch space of text_count items.
+static void skb__analyze_text_props(const char* lang, const uint32_t* text, const uint8_t* grapheme_props, skb_text_property_t* text_props, int32_t text_count, char* breaks)
 {
-	if (!text_count)
-		return;
-
-	char* breaks = SKB_TEMP_ALLOC(temp_alloc, char, text_count);
-
-	set_graphemebreaks_utf32(text, text_count, lang, breaks);
-	for (int i = 0; i < text_count; i++) {
-		if (breaks[i] == GRAPHEMEBREAK_BREAK)
-			text_props[i].flags |= SKB_TEXT_PROP_GRAPHEME_BREAK;
+	if (grapheme_props) {
+		// Reuse the grapheme breaks of the source text.
+		for (int i = 0; i < text_count; i++) {
+			if (grapheme_props[i] & SKB_TEXT_PROP_GRAPHEME_BREAK)
+				text_props[i].flags |= SKB_TEXT_PROP_GRAPHEME_BREAK;
+		}
+	} else {
+		set_graphemebreaks_utf32(text, text_count, lang, breaks);
+		for (int i = 0; i < text_count; i++) {
+			if (breaks[i] == GRAPHEMEBREAK_BREAK)
+				text_props[i].flags |= SKB_TEXT_PROP_GRAPHEME_BREAK;
+		}
 	}
 
 	set_wordbreaks_utf32(text, text_count, lang, breaks);
@@ -2923,32 +3527,170 @@ static void skb__init_text_props(skb_temp_alloc_t* temp_alloc, const char* lang,
 		SKB_SET_FLAG(text_props[i].flags, SKB_TEXT_PROP_WHITESPACE, SBGeneralCategoryIsSeparator(category));
 		SKB_SET_FLAG(text_props[i].flags, SKB_TEXT_PROP_PUNCTUATION, SBGeneralCategoryIsPunctuation(category));
 	}
+}
+
+// Target number of codepoints per chunk when the text analysis is run in parallel.
+#define SKB__TEXT_ANALYSIS_CHUNK_SIZE 8192
+// Number of codepoints analyzed on each side of a chunk seam when the seam is fixed up.
+#define SKB__TEXT_ANALYSIS_SEAM_CONTEXT 16
+
+static bool skb__is_ascii_alnum(uint32_t codepoint)
+{
+	return (codepoint >= '0' && codepoint <= '9') || (codepoint >= 'A' && codepoint <= 'Z') || (codepoint >= 'a' && codepoint <= 'z');
+}
+
+// Chunks are split at a space between two alphanumeric characters, "a |b". None of the grapheme, word, or line break rules
+// carry state over such seam, only the breaks right before the seam depend on the next chunk, and are fixed up after the chunks are analyzed.
+static bool skb__is_text_analysis_seam(const uint32_t* text, int32_t offset)
+{
+	return skb__is_ascii_alnum(text[offset - 2]) && text[offset - 1] == ' ' && skb__is_ascii_alnum(text[offset]);
+}
+
+typedef struct skb__text_analysis_context_t {
+	const char* lang;
+	const uint32_t* text;
+	const uint8_t* grapheme_props;
+	skb_text_property_t* text_props;
+	char* breaks;
+	const int32_t* chunk_offsets;	// Start offset of each chunk, and end of the last chunk.
+} skb__text_analysis_context_t;
+
+static void skb__analyze_text_props_chunk(int32_t chunk_idx, void* task_context)
+{
+	const skb__text_analysis_context_t* ctx = task_context;
+	const int32_t start = ctx->chunk_offsets[chunk_idx];
+	const int32_t end = ctx->chunk_offsets[chunk_idx + 1];
+	skb__analyze_text_props(ctx->lang, ctx->text + start, ctx->grapheme_props ? ctx->grapheme_props + start : NULL, ctx->text_props + start, end - start, ctx->breaks + start);
+}
+
+static void skb__init_text_props(skb_temp_alloc_t* temp_alloc, const skb_layout_params_t* params, const char* lang, const uint32_t* text, const uint8_t* grapheme_props, skb_text_property_t* text_props, int32_t text_count)
+{
+	if (!text_count)
+		return;
+
+	char* breaks = SKB_TEMP_ALLOC(temp_alloc, char, text_count);
+
+	// Split long text into chunks at safe seams.
+	int32_t* chunk_offsets = NULL;
+	int32_t chunks_count = 1;
+	if (params->parallel_for && text_count >= SKB__TEXT_ANALYSIS_CHUNK_SIZE * 2) {
+		const int32_t chunk_offsets_cap = text_count / SKB__TEXT_ANALYSIS_CHUNK_SIZE + 1;
+		chunk_offsets = SKB_TEMP_ALLOC(temp_alloc, int32_t, chunk_offsets_cap);
+		chunks_count = 0;
+		chunk_offsets[chunks_count] = 0;
+		int32_t offset = SKB__TEXT_ANALYSIS_CHUNK_SIZE;
+		while (offset < text_count - SKB__TEXT_ANALYSIS_CHUNK_SIZE / 2) {
+			if (skb__is_text_analysis_seam(text, offset)) {
+				chunk_offsets[++chunks_count] = offset;
+				offset += SKB__TEXT_ANALYSIS_CHUNK_SIZE;
+			} else {
+				offset++;
+			}
+		}
+		chunk_offsets[++chunks_count] = text_count;
+		assert(chunks_count < chunk_offsets_cap);
+	}
+
+	if (chunks_count > 1) {
+		skb__text_analysis_context_t ctx = {
+			.lang = lang,
+			.text = text,
+			.grapheme_props = grapheme_props,
+			.text_props = text_props,
+			.breaks = breaks,
+			.chunk_offsets = chunk_offsets,
+		};
+		params->parallel_for(chunks_count, skb__analyze_text_props_chunk, &ctx, params->parallel_for_context);
+
+		// Fix up the breaks around the seams by analyzing a small window around each seam.
+		const uint8_t break_flags = SKB_TEXT_PROP_GRAPHEME_BREAK | SKB_TEXT_PROP_WORD_BREAK | SKB_TEXT_PROP_MUST_LINE_BREAK | SKB_TEXT_PROP_ALLOW_LINE_BREAK;
+		skb_text_property_t window_props[SKB__TEXT_ANALYSIS_SEAM_CONTEXT * 2];
+		char window_breaks[SKB__TEXT_ANALYSIS_SEAM_CONTEXT * 2];
+		for (int32_t i = 1; i < chunks_count; i++) {
+			const int32_t seam = chunk_offsets[i];
+			const int32_t window_start = seam - SKB__TEXT_ANALYSIS_SEAM_CONTEXT;
+			const int32_t window_end = skb_mini(seam + SKB__TEXT_ANALYSIS_SEAM_CONTEXT, text_count);
+			memset(window_props, 0, sizeof(window_props));
+			skb__analyze_text_props(lang, text + window_start, grapheme_props ? grapheme_props + window_start : NULL, window_props, window_end - window_start, window_breaks);
+			for (int32_t j = seam - 2; j < seam + 2; j++) {
+				text_props[j].flags &= ~break_flags;
+				text_props[j].flags |= window_props[j - window_start].flags & break_flags;
+			}
+		}
+	} else {
+		skb__analyze_text_props(lang, text, grapheme_props, text_props, text_count, breaks);
+	}
 
+	SKB_TEMP_FREE(temp_alloc, chunk_offsets);
 	SKB_TEMP_FREE(temp_alloc, breaks);
 }
 
-static void skb__init_text_props_from_attributes(skb_temp_alloc_t* temp_alloc, skb_layout_t* layout)
+static int32_t skb__resolve_lang_profile(skb_layout_t* layout, const char* lang)
 {
+	// The language tags are interned, so we can find existing profile by pointer.
+	for (int32_t i = 0; i < layout->lang_profiles_count; i++) {
+		if (layout->lang_profiles[i].lang == lang)
+			return i;
+	}
+
+	SKB_ARRAY_RESERVE(layout->lang_profiles, layout->lang_profiles_count + 1);
+	skb__lang_profile_t* lang_profile = &layout->lang_profiles[layout->lang_profiles_count];
+	SKB_ZERO_STRUCT(lang_profile);
+
+	lang_profile->lang = lang;
+	lang_profile->hb_lang = hb_language_from_string(lang, -1);
+	lang_profile->canonical_lang = hb_language_to_string(lang_profile->hb_lang);
+	lang_profile->font_code_pages = skb__lang_to_font_code_pages(lang_profile->canonical_lang);
+
+	// Select the word break model.
+	if (lang_profile->hb_lang != HB_LANGUAGE_INVALID) {
+		if (hb_language_matches(hb_language_from_string("ja", 2), lang_profile->hb_lang))
+			lang_profile->word_break_model = SKB__WORD_BREAK_JA;
+		else if (hb_language_matches(hb_language_from_string("zh-hans", 7), lang_profile->hb_lang))
+			lang_profile->word_break_model = SKB__WORD_BREAK_ZH_HANS;
+		else if (hb_language_matches(hb_language_from_string("zh-hant", 7), lang_profile->hb_lang))
+			lang_profile->word_break_model = SKB__WORD_BREAK_ZH_HANT;
+		else if (hb_language_matches(hb_language_from_string("th", 2), lang_profile->hb_lang))
+			lang_profile->word_break_model = SKB__WORD_BREAK_TH;
+	}
+
+	return layout->lang_profiles_count++;
+}
+
+static void skb__resolve_content_run_lang_profiles(skb_layout_t* layout)
+{
+	layout->lang_profiles_count = 0;
+	for (int32_t i = 0; i < layout->content_runs_count; i++) {
+		skb__content_run_t* content_run = &layout->content_runs[i];
+		const skb_attribute_set_t content_run_attributes = skb__get_run_attributes(layout, content_run->attributes_range);
+		const char* run_lang = skb_attributes_get_lang(content_run_attributes, layout->params.attribute_collection);
+		content_run->lang_profile_idx = skb__resolve_lang_profile(layout, run_lang);
+	}
+}
+
+// If grapheme_props is not null, the grapheme breaks are copied from it instead of being computed, see skb_layout_set_from_text().
+static void skb__init_text_props_from_attributes(skb_temp_alloc_t* temp_alloc, skb_layout_t* layout, const uint8_t* grapheme_props)
+{
+	// Resolve language profiles for the content runs.
+	skb__resolve_content_run_lang_profiles(layout);
+
 	// Init text props for contiguous runs of same language.
 	int32_t start_offset = 0;
 	int32_t cur_offset = 0;
-	const char* prev_lang = NULL;
+	int32_t prev_lang_profile_idx = -1;
 	for (int32_t i = 0; i < layout->content_runs_count; i++) {
 		const skb__content_run_t* content_run = &layout->content_runs[i];
-		const skb_attribute_set_t content_run_attributes = skb__get_run_attributes(layout, content_run->attributes_range);
-
-		const char* run_lang = skb_attributes_get_lang(content_run_attributes, layout->params.attribute_collection);
 
-		if (run_lang != prev_lang) {
+		if (content_run->lang_profile_idx != prev_lang_profile_idx) {
 			if (cur_offset > start_offset)
-				skb__init_text_props(temp_alloc, prev_lang, layout->text + start_offset, layout->text_props + start_offset, cur_offset - start_offset);
-			prev_lang = run_lang;
+				skb__init_text_props(temp_alloc, &layout->params, layout->lang_profiles[prev_lang_profile_idx].canonical_lang, layout->text + start_offset, grapheme_props ? grapheme_props + start_offset : NULL, layout->text_props + start_offset, cur_offset - start_offset);
+			prev_lang_profile_idx = content_run->lang_profile_idx;
 			start_offset = cur_offset;
 		}
 		cur_offset = content_run->text_range.end;
 	}
 	if (cur_offset > start_offset)
-		skb__init_text_props(temp_alloc, prev_lang, layout->text + start_offset, layout->text_props + start_offset, cur_offset - start_offset);
+		skb__init_text_props(temp_alloc, &layout->params, layout->lang_profiles[prev_lang_profile_idx].canonical_lang, layout->text + start_offset, grapheme_props ? grapheme_props + start_offset : NULL, layout->text_props + start_offset, cur_offset - start_offset);
 }
 
 typedef struct skb__text_to_runs_context_t {
@@ -2958,13 +3700,14 @@ typedef struct skb__text_to_runs_context_t {
 	skb_attribute_set_t attributes;
 	skb_temp_alloc_t* temp_alloc;
 	int32_t base_content_id;
+	const uint32_t* utf32;
 } skb__text_to_runs_context_t;
 
 static void skb__iter_text_run(const skb_text_t* text, skb_text_range_t range, skb_attribute_span_t** active_spans, int32_t active_spans_count, void* context)
 {
 	skb__text_to_runs_context_t* ctx = context;
 
-	const uint32_t* utf32 = skb_text_get_utf32(text);
+	const uint32_t* utf32 = ctx->utf32;
 
 	SKB_TEMP_RESERVE(ctx->temp_alloc, ctx->content_runs, ctx->content_runs_count + 1);
 	skb_content_run_t* run = &ctx->content_runs[ctx->content_runs_count++];
@@ -3023,33 +3766,126 @@ static void skb__iter_text_run(const skb_text_t* text, skb_text_range_t range, s
 	*run = skb_content_run_make_utf32(utf32 + range.start.offset, range.end.offset - range.start.offset, run_attributes, content_id);
 }
 
-void skb_layout_set_from_text(skb_layout_t* layout, skb_temp_alloc_t* temp_alloc, const skb_layout_params_t* params, const skb_text_t* text, skb_attribute_set_t attributes)
+static void skb__rebuild_layout(skb__layout_build_context_t* build_context, skb_layout_t* layout)
 {
-	assert(layout);
-	assert(params);
+	// Building the layout modifies the text properties, initialize them again from the content runs.
+	memset(layout->text_props, 0, layout->text_count * sizeof(skb_text_property_t));
+	layout->lang_profiles_count = 0;
+	layout->shaping_runs_count = 0;
+	skb__init_text_props_from_attributes(build_context->temp_alloc, layout, NULL);
 
-	skb_temp_alloc_mark_t mark = skb_temp_alloc_save(temp_alloc);
+	skb__build_layout(build_context, layout);
+}
 
-	skb__text_to_runs_context_t ctx = {
-		.temp_alloc = temp_alloc,
-		.attributes = attributes,
-		.base_content_id = layout->params.text_content_id_base,
-	};
-	SKB_TEMP_RESERVE(temp_alloc, ctx.content_runs, 16);
+static void skb__relayout_scaled_glyphs(skb__layout_build_context_t* build_context, skb_layout_t* layout, float prev_font_scale)
+{
+	// Restore the shaped glyphs at the new scale, this also removes the glyphs and clusters added by line layout.
+	layout->glyphs_count = layout->unscaled_glyphs_count;
+	layout->clusters_count = layout->shaped_clusters_count;
 
-	skb_text_iterate_attribute_runs(text, skb__iter_text_run, &ctx);
+	const float font_size_scale = layout->font_scale / prev_font_scale;
 
-	skb_layout_set_from_runs(layout, temp_alloc, params, ctx.content_runs, ctx.content_runs_count);
+	for (int32_t i = 0; i < layout->shaping_runs_count; i++) {
+		skb__shaping_run_t* shaping_run = &layout->shaping_runs[i];
+		const skb__content_run_t* content_run = &layout->content_runs[shaping_run->content_run_idx];
 
-	skb_temp_alloc_restore(temp_alloc, mark);
+		if (content_run->type == SKB_CONTENT_RUN_OBJECT || content_run->type == SKB_CONTENT_RUN_ICON) {
+			for (int32_t gi = shaping_run->glyph_range.start; gi < shaping_run->glyph_range.end; gi++)
+				layout->glyphs[gi] = layout->unscaled_glyphs[gi];
+			continue;
+		}
+
+		shaping_run->font_size *= font_size_scale;
+		for (int32_t gi = shaping_run->glyph_range.start; gi < shaping_run->glyph_range.end; gi++) {
+			skb_glyph_t* glyph = &layout->glyphs[gi];
+			*glyph = layout->unscaled_glyphs[gi];
+			glyph->offset_x *= layout->font_scale;
+			glyph->offset_y *= layout->font_scale;
+			glyph->advance_x *= layout->font_scale;
+		}
+
+		const skb_attribute_set_t content_run_attributes = skb__get_run_attributes(layout, content_run->attributes_range);
+		skb__apply_spacing(layout, shaping_run, content_run_attributes);
+	}
+
+	skb__layout_lines(build_context, layout);
 }
 
-void skb_layout_set_from_runs(skb_layout_t* layout, skb_temp_alloc_t* temp_alloc, const skb_layout_params_t* params, const skb_content_run_t* runs, int32_t runs_count)
+static bool skb__layout_fits(const skb_layout_t* layout)
+{
+	// All text must be visible.
+	if (layout->lines_count > 0 && layout->lines[layout->lines_count - 1].text_range.end < layout->text_count)
+		return false;
+	for (int32_t i = 0; i < layout->lines_count; i++) {
+		if (layout->lines[i].flags & SKB_LAYOUT_LINE_IS_TRUNCATED)
+			return false;
+	}
+
+	// The text must fit the layout box.
+	static const float eps = 0.01f;
+	if (layout->params.layout_width >= 0.f && layout->bounds.width > layout->params.layout_width + eps)
+		return false;
+	if (layout->params.layout_height >= 0.f && layout->bounds.height > layout->params.layout_height + eps)
+		return false;
+
+	return true;
+}
+
+void skb_layout_relayout_at_scale(skb_layout_t* layout, skb_temp_alloc_t* temp_alloc, float font_scale)
 {
 	assert(layout);
-	assert(params);
+	assert(font_scale > 0.f);
+
+	const float prev_font_scale = layout->font_scale;
+	layout->font_scale = font_scale;
 
+	skb__layout_build_context_t build_context = {0};
+	build_context.temp_alloc = temp_alloc;
+
+	if (layout->retain_unscaled_glyphs && layout->can_scale_glyphs && !(layout->flags & SKB_LAYOUT_IS_PARTIALLY_SHAPED)) {
+		skb__relayout_scaled_glyphs(&build_context, layout, prev_font_scale);
+	} else {
+		// Shape the text at the new scale, and retain the shaped glyphs for rescaling.
+		layout->retain_unscaled_glyphs = true;
+		skb__rebuild_layout(&build_context, layout);
+	}
+}
+
+float skb_layout_fit_font_size(skb_layout_t* layout, skb_temp_alloc_t* temp_alloc, float min_scale, float max_scale)
+{
+	assert(layout);
+	assert(min_scale > 0.f && min_scale <= max_scale);
+
+	enum { SKB_FIT_FONT_SIZE_ITERATIONS = 12 };
+
+	skb_layout_relayout_at_scale(layout, temp_alloc, max_scale);
+	if (skb__layout_fits(layout))
+		return max_scale;
+
+	// Binary search the largest scale that fits.
+	float fit_scale = min_scale;
+	float max_fail_scale = max_scale;
+	for (int32_t i = 0; i < SKB_FIT_FONT_SIZE_ITERATIONS; i++) {
+		const float scale = (fit_scale + max_fail_scale) * 0.5f;
+		skb_layout_relayout_at_scale(layout, temp_alloc, scale);
+		if (skb__layout_fits(layout))
+			fit_scale = scale;
+		else
+			max_fail_scale = scale;
+	}
+
+	if (!skb_equalsf(layout->font_scale, fit_scale, 1e-6f))
+		skb_layout_relayout_at_scale(layout, temp_alloc, fit_scale);
+
+	return fit_scale;
+}
+
+// If shared_text is not null, the layout takes the reference and uses the codepoints for runs which reference them, see skb_layout_set_from_text().
+static void skb__set_content_runs(skb_layout_t* layout, skb_temp_alloc_t* temp_alloc, const skb_layout_params_t* params, const skb_content_run_t* runs, int32_t runs_count, const uint8_t* grapheme_props, const uint32_t* shared_text)
+{
 	skb_layout_reset(layout);
+	if (shared_text)
+		skb__set_shared_text(layout, shared_text);
 
 	layout->params = *params;
 	layout->params.layout_attributes = (skb_attribute_set_t){0};
@@ -3057,9 +3893,6 @@ void skb_layout_set_from_runs(skb_layout_t* layout, skb_temp_alloc_t* temp_alloc
 
 	int32_t* text_counts = SKB_TEMP_ALLOC(temp_alloc, int32_t, runs_count);
 
-	skb__layout_build_context_t build_context = {0};
-	build_context.temp_alloc = temp_alloc;
-
 	// Reserve memory for the text and attributes
 	int32_t total_text_count = 0;
 	int32_t total_attribs_count = 0;
@@ -3146,11 +3979,141 @@ void skb_layout_set_from_runs(skb_layout_t* layout, skb_temp_alloc_t* temp_alloc
 	// Patch layout attributes pointer in case we ended up reallocating attributes above.
 	layout->params.layout_attributes.attributes = &layout->attributes[0];
 
-	skb__init_text_props_from_attributes(temp_alloc, layout);
+	skb__init_text_props_from_attributes(temp_alloc, layout, grapheme_props);
+
+	SKB_TEMP_FREE(temp_alloc, text_counts);
+}
+
+void skb_layout_set_from_runs(skb_layout_t* layout, skb_temp_alloc_t* temp_alloc, const skb_layout_params_t* params, const skb_content_run_t* runs, int32_t runs_count)
+{
+	assert(layout);
+	assert(params);
+
+	skb__set_content_runs(layout, temp_alloc, params, runs, runs_count, NULL, NULL);
+
+	skb__layout_build_context_t build_context = {0};
+	build_context.temp_alloc = temp_alloc;
 
 	skb__build_layout(&build_context, layout);
+}
+
+void skb_layout_set_from_text(skb_layout_t* layout, skb_temp_alloc_t* temp_alloc, const skb_layout_params_t* params, const skb_text_t* text, skb_attribute_set_t attributes)
+{
+	assert(layout);
+	assert(params);
+
+	skb_temp_alloc_mark_t mark = skb_temp_alloc_save(temp_alloc);
+
+	skb__text_to_runs_context_t ctx = {
+		.temp_alloc = temp_alloc,
+		.attributes = attributes,
+		.base_content_id = layout->params.text_content_id_base,
+	};
+	SKB_TEMP_RESERVE(temp_alloc, ctx.content_runs, 16);
+
+	if (skb_text_is_compact(text)) {
+		// Decode compact text to temp buffer, so that the text stays compact.
+		const int32_t text_count = skb_text_get_utf32_count(text);
+		uint32_t* utf32 = SKB_TEMP_ALLOC(temp_alloc, uint32_t, skb_maxi(1, text_count));
+		skb_text_get_utf32_in_range(text, (skb_range_t){ .start = 0, .end = text_count }, utf32, text_count);
+		ctx.utf32 = utf32;
+	} else {
+		ctx.utf32 = skb_text_get_utf32(text);
+	}
+
+	skb_text_iterate_attribute_runs(text, skb__iter_text_run, &ctx);
 
-	SKB_TEMP_FREE(build_context.temp_alloc, text_counts);
+	// The layout shares the codepoints of the source text instead of copying them, the text copies them on write.
+	// The grapheme breaks of the source text are reused while building.
+	const uint8_t* grapheme_props = !skb_text_is_compact(text) && skb_text_get_utf32_count(text) > 0 ? skb_text_get_props(text) : NULL;
+	const uint32_t* shared_text = skb_text_get_utf32_count(text) > 0 ? skb_text_acquire_shared_utf32(text) : NULL;
+
+	skb__set_content_runs(layout, temp_alloc, params, ctx.content_runs, ctx.content_runs_count, grapheme_props, shared_text);
+
+	skb__layout_build_context_t build_context = {0};
+	build_context.temp_alloc = temp_alloc;
+
+	skb__build_layout(&build_context, layout);
+
+	skb_temp_alloc_restore(temp_alloc, mark);
+}
+
+// Copies paints from the attribute set to the flattened layout attributes, in same order as skb_attributes_copy_flat().
+// Returns number of attributes visited, or -1 if the attributes do not match.
+static int32_t skb__update_paints_from_set(skb_attribute_t* dest, int32_t dest_count, skb_attribute_set_t attributes)
+{
+	int32_t visited = 0;
+
+	if (attributes.parent_set) {
+		const int32_t parent_count = skb__update_paints_from_set(dest, dest_count, *attributes.parent_set);
+		if (parent_count < 0)
+			return -1;
+		visited += parent_count;
+	}
+
+	if (attributes.set_handle) {
+		if (visited >= dest_count || dest[visited].kind != SKB_ATTRIBUTE_REFERENCE)
+			return -1;
+		visited++;
+	}
+
+	for (int32_t i = 0; i < attributes.attributes_count; i++) {
+		if (visited >= dest_count || dest[visited].kind != attributes.attributes[i].kind)
+			return -1;
+		if (attributes.attributes[i].kind == SKB_ATTRIBUTE_PAINT)
+			dest[visited] = attributes.attributes[i];
+		visited++;
+	}
+
+	return visited;
+}
+
+static bool skb__update_paints_in_range(skb_layout_t* layout, skb_range_t range, skb_attribute_set_t attributes)
+{
+	const int32_t count = range.end - range.start;
+	return skb__update_paints_from_set(layout->attributes + range.start, count, attributes) == count;
+}
+
+bool skb_layout_update_paints(skb_layout_t* layout, const skb_layout_params_t* params, const skb_content_run_t* runs, int32_t runs_count)
+{
+	assert(layout);
+	assert(params);
+
+	if (runs_count != layout->content_runs_count)
+		return false;
+
+	// The layout attributes are stored first in the attributes array.
+	const skb_range_t layout_attributes_range = { .start = 0, .end = layout->params.layout_attributes.attributes_count };
+	if (!skb__update_paints_in_range(layout, layout_attributes_range, params->layout_attributes))
+		return false;
+
+	for (int32_t i = 0; i < runs_count; i++) {
+		if (!skb__update_paints_in_range(layout, layout->content_runs[i].attributes_range, runs[i].attributes))
+			return false;
+	}
+
+	return true;
+}
+
+bool skb_layout_set_from_shaped_runs(
+	skb_layout_t* layout, skb_temp_alloc_t* temp_alloc, const skb_layout_params_t* params,
+	const skb_content_run_t* runs, int32_t runs_count,
+	const skb_shaped_run_t* shaped_runs, int32_t shaped_runs_count)
+{
+	assert(layout);
+	assert(params);
+
+	skb__set_content_runs(layout, temp_alloc, params, runs, runs_count, NULL, NULL);
+
+	skb__layout_build_context_t build_context = {0};
+	build_context.temp_alloc = temp_alloc;
+
+	if (!skb__build_layout_from_shaped_runs(&build_context, layout, shaped_runs, shaped_runs_count)) {
+		skb_layout_reset(layout);
+		return false;
+	}
+
+	return true;
 }
 
 void skb_layout_destroy(skb_layout_t* layout)
@@ -3158,15 +4121,21 @@ void skb_layout_destroy(skb_layout_t* layout)
 	if (!layout) return;
 
 	skb_free(layout->attributes);
-	skb_free(layout->content_runs);
-	skb_free(layout->shaping_runs);
-	skb_free(layout->glyphs);
-	skb_free(layout->clusters);
-	skb_free(layout->layout_runs);
-	skb_free(layout->decorations);
-	skb_free(layout->text);
-	skb_free(layout->text_props);
-	skb_free(layout->lines);
+	// Paint variant owns only the attributes.
+	if (!layout->paint_base) {
+		skb_free(layout->lang_profiles);
+		skb_free(layout->content_runs);
+		skb_free(layout->shaping_runs);
+		skb_free(layout->glyphs);
+		skb_free(layout->clusters);
+		skb_free(layout->unscaled_glyphs);
+		skb_free(layout->layout_runs);
+		skb_free(layout->decorations);
+		skb__set_shared_text(layout, NULL);
+		skb_free(layout->text_buffer);
+		skb_free(layout->text_props);
+		skb_free(layout->lines);
+	}
 
 	bool should_free_instance = layout->should_free_instance;
 	SKB_ZERO_STRUCT(layout);
@@ -3175,6 +4144,515 @@ void skb_layout_destroy(skb_layout_t* layout)
 		skb_free(layout);
 }
 
+//
+// Layout snapshot
+//
+
+#define SKB__LAYOUT_SNAPSHOT_MAGIC SKB_TAG('S','K','B','L')
+#define SKB__LAYOUT_SNAPSHOT_VERSION 2
+
+// Header of the layout snapshot. The arrays follow the header in the order of the counts, each aligned to 8 bytes.
+typedef struct skb__layout_snapshot_header_t {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t abi_hash;					// Hash of the sizes of the stored structs, snapshots from different builds are rejected.
+	int32_t size;						// Total size of the snapshot in bytes.
+
+	// Layout params, the collection pointers are not stored.
+	float layout_width;
+	float layout_height;
+	int32_t list_marker_counter;
+	int32_t text_content_id_base;
+	int32_t layout_attributes_count;	// Layout attributes are stored at the beginning of the attributes array.
+	uint8_t params_flags;
+
+	// Layout results.
+	uint8_t resolved_direction;
+	bool retain_unscaled_glyphs;
+	bool can_scale_glyphs;
+	uint32_t flags;
+	skb_rect2_t bounds;
+	skb_padding2_t padding;
+	float advance_y;
+	skb_range_t shaped_text_range;
+	float font_scale;
+	int32_t shaped_clusters_count;
+
+	// Array counts
+	int32_t text_count;
+	int32_t content_runs_count;
+	int32_t attributes_count;
+	int32_t shaping_runs_count;
+	int32_t glyphs_count;
+	int32_t clusters_count;
+	int32_t unscaled_glyphs_count;
+	int32_t lines_count;
+	int32_t layout_runs_count;
+	int32_t decorations_count;
+	int32_t fonts_count;				// Number of font hashes, font handles in the snapshot are stored as index + 1 to the font hashes.
+	int32_t lang_data_count;			// Size of the language tag strings in bytes. Each lang attribute has a zero terminated tag in the order of the attributes.
+} skb__layout_snapshot_header_t;
+
+static uint64_t skb__layout_snapshot_abi_hash(void)
+{
+	const uint32_t sizes[] = {
+		(uint32_t)sizeof(void*),
+		(uint32_t)sizeof(skb__layout_snapshot_header_t),
+		(uint32_t)sizeof(skb_text_property_t),
+		(uint32_t)sizeof(skb__content_run_t),
+		(uint32_t)sizeof(skb_attribute_t),
+		(uint32_t)sizeof(skb__shaping_run_t),
+		(uint32_t)sizeof(skb_glyph_t),
+		(uint32_t)sizeof(skb_cluster_t),
+		(uint32_t)sizeof(skb_layout_line_t),
+		(uint32_t)sizeof(skb_layout_run_t),
+		(uint32_t)sizeof(skb_decoration_t),
+		0x01020304, // Byte order
+	};
+	return skb_hash64_append(skb_hash64_empty(), sizes, sizeof(sizes));
+}
+
+typedef struct skb__snapshot_writer_t {
+	uint8_t* data;
+	int32_t data_cap;
+	int32_t offset;
+} skb__snapshot_writer_t;
+
+static int32_t skb__snapshot_align(int32_t offset)
+{
+	return (offset + 7) & ~7;
+}
+
+static void* skb__snapshot_write(skb__snapshot_writer_t* writer, const void* src, int32_t size)
+{
+	// The total size is always accumulated, but the data is written only if it fits.
+	void* dst = NULL;
+	if (writer->data && writer->offset + size <= writer->data_cap) {
+		dst = writer->data + writer->offset;
+		if (src)
+			memcpy(dst, src, size);
+	}
+	writer->offset += size;
+	return dst;
+}
+
+static void* skb__snapshot_write_array(skb__snapshot_writer_t* writer, const void* src, int32_t count, int32_t item_size)
+{
+	const int32_t aligned_offset = skb__snapshot_align(writer->offset);
+	if (aligned_offset > writer->offset)
+		skb__snapshot_write(writer, NULL, aligned_offset - writer->offset);
+	return skb__snapshot_write(writer, src, count * item_size);
+}
+
+typedef struct skb__snapshot_reader_t {
+	const uint8_t* data;
+	int32_t data_count;
+	int32_t offset;
+} skb__snapshot_reader_t;
+
+static const void* skb__snapshot_read_array(skb__snapshot_reader_t* reader, int32_t count, int32_t item_size)
+{
+	const int32_t aligned_offset = skb__snapshot_align(reader->offset);
+	if (count < 0 || aligned_offset > reader->data_count || count > (reader->data_count - aligned_offset) / item_size)
+		return NULL;
+	reader->offset = aligned_offset + count * item_size;
+	return reader->data + aligned_offset;
+}
+
+static int32_t skb__snapshot_find_font_index(uint64_t* font_hashes, int32_t* font_hashes_count, uint64_t font_hash)
+{
+	for (int32_t i = 0; i < *font_hashes_count; i++) {
+		if (font_hashes[i] == font_hash)
+			return i;
+	}
+	font_hashes[(*font_hashes_count)++] = font_hash;
+	return *font_hashes_count - 1;
+}
+
+static bool skb__is_text_layout_run(const skb_layout_run_t* layout_run)
+{
+	return layout_run->type == SKB_CONTENT_RUN_UTF8 || layout_run->type == SKB_CONTENT_RUN_UTF32;
+}
+
+int32_t skb_layout_serialize(const skb_layout_t* layout, uint8_t* data, int32_t data_cap)
+{
+	assert(layout);
+
+	// Collect fonts used by the layout, and map them to indices. There are at most as many fonts as there are runs.
+	const int32_t max_fonts_count = layout->shaping_runs_count + layout->layout_runs_count;
+	uint64_t* font_hashes = skb_malloc(sizeof(uint64_t) * skb_maxi(1, max_fonts_count));
+	int32_t fonts_count = 0;
+	for (int32_t i = 0; i < layout->shaping_runs_count; i++) {
+		if (layout->shaping_runs[i].font_handle)
+			skb__snapshot_find_font_index(font_hashes, &fonts_count, skb_font_get_hash(layout->params.font_collection, layout->shaping_runs[i].font_handle));
+	}
+	for (int32_t i = 0; i < layout->layout_runs_count; i++) {
+		if (skb__is_text_layout_run(&layout->layout_runs[i]) && layout->layout_runs[i].font_handle)
+			skb__snapshot_find_font_index(font_hashes, &fonts_count, skb_font_get_hash(layout->params.font_collection, layout->layout_runs[i].font_handle));
+	}
+
+	int32_t lang_data_count = 0;
+	for (int32_t i = 0; i < layout->attributes_count; i++) {
+		if (layout->attributes[i].kind == SKB_ATTRIBUTE_LANG)
+			lang_data_count += (layout->attributes[i].lang.lang ? (int32_t)strlen(layout->attributes[i].lang.lang) : 0) + 1;
+	}
+
+	// First pass calculates the size, and the second writes the data if it fits.
+	skb__snapshot_writer_t writer = { .data = NULL, .data_cap = 0 };
+	for (int32_t pass = 0; pass < 2; pass++) {
+		if (pass == 1) {
+			if (!data || writer.offset > data_cap)
+				break;
+			writer = (skb__snapshot_writer_t) { .data = data, .data_cap = data_cap };
+		}
+
+		const skb__layout_snapshot_header_t header = {
+			.magic = SKB__LAYOUT_SNAPSHOT_MAGIC,
+			.version = SKB__LAYOUT_SNAPSHOT_VERSION,
+			.abi_hash = skb__layout_snapshot_abi_hash(),
+			.size = 0, // Patched below.
+			.layout_width = layout->params.layout_width,
+			.layout_height = layout->params.layout_height,
+			.list_marker_counter = layout->params.list_marker_counter,
+			.text_content_id_base = layout->params.text_content_id_base,
+			.layout_attributes_count = layout->params.layout_attributes.attributes_count,
+			.params_flags = layout->params.flags,
+			.resolved_direction = layout->resolved_direction,
+			.retain_unscaled_glyphs = layout->retain_unscaled_glyphs,
+			.can_scale_glyphs = layout->can_scale_glyphs,
+			.flags = layout->flags,
+			.bounds = layout->bounds,
+			.padding = layout->padding,
+			.advance_y = layout->advance_y,
+			.shaped_text_range = layout->shaped_text_range,
+			.font_scale = layout->font_scale,
+			.shaped_clusters_count = layout->shaped_clusters_count,
+			.text_count = layout->text_count,
+			.content_runs_count = layout->content_runs_count,
+			.attributes_count = layout->attributes_count,
+			.shaping_runs_count = layout->shaping_runs_count,
+			.glyphs_count = layout->glyphs_count,
+			.clusters_count = layout->clusters_count,
+			.unscaled_glyphs_count = layout->unscaled_glyphs_count,
+			.lines_count = layout->lines_count,
+			.layout_runs_count = layout->layout_runs_count,
+			.decorations_count = layout->decorations_count,
+			.fonts_count = fonts_count,
+			.lang_data_count = lang_data_count,
+		};
+		writer.offset = 0;
+		skb__snapshot_write(&writer, &header, sizeof(header));
+
+		skb__snapshot_write_array(&writer, layout->text, layout->text_count, sizeof(uint32_t));
+		skb__snapshot_write_array(&writer, layout->text_props, layout->text_count, sizeof(skb_text_property_t));
+		skb__snapshot_write_array(&writer, layout->content_runs, layout->content_runs_count, sizeof(skb__content_run_t));
+
+		// The language tags are stored separately, the pointers are cleared to make the snapshot deterministic.
+		skb_attribute_t* attributes = skb__snapshot_write_array(&writer, layout->attributes, layout->attributes_count, sizeof(skb_attribute_t));
+		if (attributes) {
+			for (int32_t i = 0; i < layout->attributes_count; i++) {
+				if (attributes[i].kind == SKB_ATTRIBUTE_LANG)
+					attributes[i].lang.lang = NULL;
+			}
+		}
+
+		// Font handles are replaced with font indices.
+		skb__shaping_run_t* shaping_runs = skb__snapshot_write_array(&writer, layout->shaping_runs, layout->shaping_runs_count, sizeof(skb__shaping_run_t));
+		if (shaping_runs) {
+			for (int32_t i = 0; i < layout->shaping_runs_count; i++) {
+				if (shaping_runs[i].font_handle)
+					shaping_runs[i].font_handle = 1 + skb__snapshot_find_font_index(font_hashes, &fonts_count, skb_font_get_hash(layout->params.font_collection, shaping_runs[i].font_handle));
+			}
+		}
+
+		skb__snapshot_write_array(&writer, layout->glyphs, layout->glyphs_count, sizeof(skb_glyph_t));
+		skb__snapshot_write_array(&writer, layout->clusters, layout->clusters_count, sizeof(skb_cluster_t));
+		skb__snapshot_write_array(&writer, layout->unscaled_glyphs, layout->unscaled_glyphs_count, sizeof(skb_glyph_t));
+		skb__snapshot_write_array(&writer, layout->lines, layout->lines_count, sizeof(skb_layout_line_t));
+
+		skb_layout_run_t* layout_runs = skb__snapshot_write_array(&writer, layout->layout_runs, layout->layout_runs_count, sizeof(skb_layout_run_t));
+		if (layout_runs) {
+			for (int32_t i = 0; i < layout->layout_runs_count; i++) {
+				if (skb__is_text_layout_run(&layout_runs[i]) && layout_runs[i].font_handle)
+					layout_runs[i].font_handle = 1 + skb__snapshot_find_font_index(font_hashes, &fonts_count, skb_font_get_hash(layout->params.font_collection, layout_runs[i].font_handle));
+			}
+		}
+
+		skb__snapshot_write_array(&writer, layout->decorations, layout->decorations_count, sizeof(skb_decoration_t));
+		skb__snapshot_write_array(&writer, font_hashes, fonts_count, sizeof(uint64_t));
+
+		char* lang_data = skb__snapshot_write_array(&writer, NULL, lang_data_count, 1);
+		if (lang_data) {
+			for (int32_t i = 0; i < layout->attributes_count; i++) {
+				if (layout->attributes[i].kind == SKB_ATTRIBUTE_LANG) {
+					const char* lang = layout->attributes[i].lang.lang ? layout->attributes[i].lang.lang : "";
+					const int32_t lang_len = (int32_t)strlen(lang) + 1;
+					memcpy(lang_data, lang, lang_len);
+					lang_data += lang_len;
+				}
+			}
+		}
+
+		// Patch in the total size.
+		if (writer.data) {
+			skb__layout_snapshot_header_t* written_header = (skb__layout_snapshot_header_t*)writer.data;
+			written_header->size = writer.offset;
+		}
+	}
+
+	skb_free(font_hashes);
+
+	return writer.offset;
+}
+
+static bool skb__is_valid_snapshot_range(skb_range_t range, int32_t count)
+{
+	return range.start >= 0 && range.start <= range.end && range.end <= count;
+}
+
+static bool skb__is_valid_snapshot_index(int32_t idx, int32_t count)
+{
+	return idx >= 0 && idx < count;
+}
+
+// Checks that all indices and ranges in the snapshot point inside the loaded arrays, so that a corrupt snapshot cannot cause out of bounds access later.
+static bool skb__validate_snapshot(const skb__layout_snapshot_header_t* header,
+	const skb__content_run_t* content_runs, const skb__shaping_run_t* shaping_runs, const skb_glyph_t* glyphs, const skb_cluster_t* clusters,
+	const skb_glyph_t* unscaled_glyphs, const skb_layout_line_t* lines, const skb_layout_run_t* layout_runs, const skb_decoration_t* decorations)
+{
+	if (!skb__is_valid_snapshot_range(header->shaped_text_range, header->text_count))
+		return false;
+	if (header->shaped_clusters_count < 0 || header->shaped_clusters_count > header->clusters_count)
+		return false;
+
+	for (int32_t i = 0; i < header->content_runs_count; i++) {
+		const skb__content_run_t* content_run = &content_runs[i];
+		if (content_run->type > SKB_CONTENT_RUN_ICON)
+			return false;
+		if (!skb__is_valid_snapshot_range(content_run->text_range, header->text_count)
+			|| !skb__is_valid_snapshot_range(content_run->attributes_range, header->attributes_count))
+			return false;
+	}
+
+	for (int32_t i = 0; i < header->shaping_runs_count; i++) {
+		const skb__shaping_run_t* shaping_run = &shaping_runs[i];
+		if (!skb__is_valid_snapshot_range(shaping_run->text_range, header->text_count)
+			|| !skb__is_valid_snapshot_range(shaping_run->glyph_range, header->glyphs_count)
+			|| !skb__is_valid_snapshot_range(shaping_run->cluster_range, header->clusters_count))
+			return false;
+		if (!skb__is_valid_snapshot_index(shaping_run->content_run_idx, header->content_runs_count)
+			|| shaping_run->content_run_count < 0 || shaping_run->content_run_count > header->content_runs_count - shaping_run->content_run_idx)
+			return false;
+		if (shaping_run->font_handle > (uint32_t)header->fonts_count)
+			return false;
+	}
+
+	for (int32_t i = 0; i < header->glyphs_count; i++) {
+		if (!skb__is_valid_snapshot_index(glyphs[i].cluster_idx, header->clusters_count))
+			return false;
+	}
+	for (int32_t i = 0; i < header->unscaled_glyphs_count; i++) {
+		if (!skb__is_valid_snapshot_index(unscaled_glyphs[i].cluster_idx, header->clusters_count))
+			return false;
+	}
+
+	for (int32_t i = 0; i < header->clusters_count; i++) {
+		const skb_cluster_t* cluster = &clusters[i];
+		// Shaped clusters always cover text, list marker and ellipsis clusters after them have no text.
+		const int32_t min_text_count = i < header->shaped_clusters_count ? 1 : 0;
+		if (cluster->text_offset < 0 || cluster->text_count < min_text_count || cluster->text_count > header->text_count - cluster->text_offset)
+			return false;
+		if (cluster->glyphs_offset < 0 || cluster->glyphs_count < 1 || cluster->glyphs_count > header->glyphs_count - cluster->glyphs_offset)
+			return false;
+	}
+
+	for (int32_t i = 0; i < header->lines_count; i++) {
+		const skb_layout_line_t* line = &lines[i];
+		if (!skb__is_valid_snapshot_range(line->text_range, header->text_count)
+			|| !skb__is_valid_snapshot_range(line->layout_run_range, header->layout_runs_count)
+			|| !skb__is_valid_snapshot_range(line->decorations_range, header->decorations_count))
+			return false;
+		if (line->last_grapheme_offset < 0 || line->last_grapheme_offset > header->text_count)
+			return false;
+	}
+
+	for (int32_t i = 0; i < header->layout_runs_count; i++) {
+		const skb_layout_run_t* layout_run = &layout_runs[i];
+		if (layout_run->type > SKB_CONTENT_RUN_ICON)
+			return false;
+		// List markers do not have content run.
+		if (layout_run->content_run_idx != SKB_INVALID_INDEX && !skb__is_valid_snapshot_index(layout_run->content_run_idx, header->content_runs_count))
+			return false;
+		if (!skb__is_valid_snapshot_range(layout_run->glyph_range, header->glyphs_count)
+			|| !skb__is_valid_snapshot_range(layout_run->cluster_range, header->clusters_count)
+			|| !skb__is_valid_snapshot_range(layout_run->attributes_range, header->attributes_count))
+			return false;
+		if (skb__is_text_layout_run(layout_run) && layout_run->font_handle > (uint32_t)header->fonts_count)
+			return false;
+	}
+
+	for (int32_t i = 0; i < header->decorations_count; i++) {
+		const skb_decoration_t* decoration = &decorations[i];
+		if (decoration->type != SKB_DECORATION_LINE && decoration->type != SKB_DECORATION_RECT)
+			return false;
+		const int32_t layout_run_idx = decoration->type == SKB_DECORATION_LINE ? decoration->line.layout_run_idx : decoration->rect.layout_run_idx;
+		if (!skb__is_valid_snapshot_index(layout_run_idx, header->layout_runs_count))
+			return false;
+	}
+
+	return true;
+}
+
+bool skb_layout_deserialize(skb_layout_t* layout, const skb_layout_params_t* params, const uint8_t* data, int32_t data_count)
+{
+	assert(layout);
+	assert(params);
+
+	skb_layout_reset(layout);
+
+	skb__layout_snapshot_header_t header;
+	if (!data || data_count < (int32_t)sizeof(header))
+		return false;
+	memcpy(&header, data, sizeof(header));
+	if (header.magic != SKB__LAYOUT_SNAPSHOT_MAGIC || header.version != SKB__LAYOUT_SNAPSHOT_VERSION || header.abi_hash != skb__layout_snapshot_abi_hash() || header.size > data_count)
+		return false;
+	if (header.layout_attributes_count < 0 || header.layout_attributes_count > header.attributes_count)
+		return false;
+
+	skb__snapshot_reader_t reader = { .data = data, .data_count = header.size, .offset = sizeof(header) };
+
+	const uint32_t* text = skb__snapshot_read_array(&reader, header.text_count, sizeof(uint32_t));
+	const skb_text_property_t* text_props = skb__snapshot_read_array(&reader, header.text_count, sizeof(skb_text_property_t));
+	const skb__content_run_t* content_runs = skb__snapshot_read_array(&reader, header.content_runs_count, sizeof(skb__content_run_t));
+	const skb_attribute_t* attributes = skb__snapshot_read_array(&reader, header.attributes_count, sizeof(skb_attribute_t));
+	const skb__shaping_run_t* shaping_runs = skb__snapshot_read_array(&reader, header.shaping_runs_count, sizeof(skb__shaping_run_t));
+	const skb_glyph_t* glyphs = skb__snapshot_read_array(&reader, header.glyphs_count, sizeof(skb_glyph_t));
+	const skb_cluster_t* clusters = skb__snapshot_read_array(&reader, header.clusters_count, sizeof(skb_cluster_t));
+	const skb_glyph_t* unscaled_glyphs = skb__snapshot_read_array(&reader, header.unscaled_glyphs_count, sizeof(skb_glyph_t));
+	const skb_layout_line_t* lines = skb__snapshot_read_array(&reader, header.lines_count, sizeof(skb_layout_line_t));
+	const skb_layout_run_t* layout_runs = skb__snapshot_read_array(&reader, header.layout_runs_count, sizeof(skb_layout_run_t));
+	const skb_decoration_t* decorations = skb__snapshot_read_array(&reader, header.decorations_count, sizeof(skb_decoration_t));
+	const uint64_t* font_hashes = skb__snapshot_read_array(&reader, header.fonts_count, sizeof(uint64_t));
+	const char* lang_data = skb__snapshot_read_array(&reader, header.lang_data_count, 1);
+
+	if (!text || !text_props || !content_runs || !attributes || !shaping_runs || !glyphs || !clusters
+		|| !unscaled_glyphs || !lines || !layout_runs || !decorations || !font_hashes || !lang_data)
+		return false;
+	if (header.lang_data_count > 0 && lang_data[header.lang_data_count - 1] != '\0')
+		return false;
+	if (!skb__validate_snapshot(&header, content_runs, shaping_runs, glyphs, clusters, unscaled_glyphs, lines, layout_runs, decorations))
+		return false;
+
+	// Resolve fonts, all fonts must be present in the font collection.
+	if (header.fonts_count > 0 && !params->font_collection)
+		return false;
+	skb_font_handle_t* font_handles = skb_malloc(sizeof(skb_font_handle_t) * skb_maxi(1, header.fonts_count));
+	bool fonts_found = true;
+	for (int32_t i = 0; i < header.fonts_count; i++) {
+		font_handles[i] = skb_font_collection_find_font_by_hash(params->font_collection, font_hashes[i]);
+		if (!font_handles[i])
+			fonts_found = false;
+	}
+	if (!fonts_found) {
+		skb_free(font_handles);
+		return false;
+	}
+
+	layout->params = *params;
+	layout->params.layout_width = header.layout_width;
+	layout->params.layout_height = header.layout_height;
+	layout->params.flags = header.params_flags;
+	layout->params.list_marker_counter = header.list_marker_counter;
+	layout->params.text_content_id_base = header.text_content_id_base;
+
+	layout->bounds = header.bounds;
+	layout->padding = header.padding;
+	layout->advance_y = header.advance_y;
+	layout->resolved_direction = header.resolved_direction;
+	layout->flags = header.flags;
+	layout->shaped_text_range = header.shaped_text_range;
+	layout->font_scale = header.font_scale;
+	layout->shaped_clusters_count = header.shaped_clusters_count;
+	layout->retain_unscaled_glyphs = header.retain_unscaled_glyphs;
+	layout->can_scale_glyphs = header.can_scale_glyphs;
+
+	skb__set_shared_text(layout, NULL);
+	skb__reserve_text(layout, header.text_count);
+	memcpy(layout->text_buffer, text, sizeof(uint32_t) * header.text_count);
+	memcpy(layout->text_props, text_props, sizeof(skb_text_property_t) * header.text_count);
+	layout->text_count = header.text_count;
+
+	SKB_ARRAY_RESERVE(layout->content_runs, header.content_runs_count);
+	memcpy(layout->content_runs, content_runs, sizeof(skb__content_run_t) * header.content_runs_count);
+	layout->content_runs_count = header.content_runs_count;
+
+	// Restore language tags, the tags are interned again when the attribute is made.
+	SKB_ARRAY_RESERVE(layout->attributes, header.attributes_count);
+	memcpy(layout->attributes, attributes, sizeof(skb_attribute_t) * header.attributes_count);
+	layout->attributes_count = header.attributes_count;
+	const char* lang_data_end = lang_data + header.lang_data_count;
+	for (int32_t i = 0; i < layout->attributes_count; i++) {
+		if (layout->attributes[i].kind == SKB_ATTRIBUTE_LANG) {
+			if (lang_data >= lang_data_end) {
+				skb_free(font_handles);
+				skb_layout_reset(layout);
+				return false;
+			}
+			layout->attributes[i] = skb_attribute_make_lang(lang_data);
+			lang_data += strlen(lang_data) + 1;
+		}
+	}
+	layout->params.layout_attributes = (skb_attribute_set_t) {
+		.attributes = layout->attributes,
+		.attributes_count = header.layout_attributes_count,
+	};
+
+	SKB_ARRAY_RESERVE(layout->shaping_runs, header.shaping_runs_count);
+	memcpy(layout->shaping_runs, shaping_runs, sizeof(skb__shaping_run_t) * header.shaping_runs_count);
+	layout->shaping_runs_count = header.shaping_runs_count;
+	for (int32_t i = 0; i < layout->shaping_runs_count; i++) {
+		skb__shaping_run_t* shaping_run = &layout->shaping_runs[i];
+		if (shaping_run->font_handle)
+			shaping_run->font_handle = font_handles[shaping_run->font_handle - 1];
+	}
+
+	SKB_ARRAY_RESERVE(layout->glyphs, header.glyphs_count);
+	memcpy(layout->glyphs, glyphs, sizeof(skb_glyph_t) * header.glyphs_count);
+	layout->glyphs_count = header.glyphs_count;
+
+	SKB_ARRAY_RESERVE(layout->clusters, header.clusters_count);
+	memcpy(layout->clusters, clusters, sizeof(skb_cluster_t) * header.clusters_count);
+	layout->clusters_count = header.clusters_count;
+
+	SKB_ARRAY_RESERVE(layout->unscaled_glyphs, header.unscaled_glyphs_count);
+	memcpy(layout->unscaled_glyphs, unscaled_glyphs, sizeof(skb_glyph_t) * header.unscaled_glyphs_count);
+	layout->unscaled_glyphs_count = header.unscaled_glyphs_count;
+
+	SKB_ARRAY_RESERVE(layout->lines, header.lines_count);
+	memcpy(layout->lines, lines, sizeof(skb_layout_line_t) * header.lines_count);
+	layout->lines_count = header.lines_count;
+
+	SKB_ARRAY_RESERVE(layout->layout_runs, header.layout_runs_count);
+	memcpy(layout->layout_runs, layout_runs, sizeof(skb_layout_run_t) * header.layout_runs_count);
+	layout->layout_runs_count = header.layout_runs_count;
+	for (int32_t i = 0; i < layout->layout_runs_count; i++) {
+		skb_layout_run_t* layout_run = &layout->layout_runs[i];
+		if (skb__is_text_layout_run(layout_run) && layout_run->font_handle)
+			layout_run->font_handle = font_handles[layout_run->font_handle - 1];
+	}
+
+	SKB_ARRAY_RESERVE(layout->decorations, header.decorations_count);
+	memcpy(layout->decorations, decorations, sizeof(skb_decoration_t) * header.decorations_count);
+	layout->decorations_count = header.decorations_count;
+
+	skb_free(font_handles);
+
+	// Language profiles are resolved again, since they are pointers to the language data.
+	skb__resolve_content_run_lang_profiles(layout);
+
+	return true;
+}
+
 const skb_layout_params_t* skb_layout_get_params(const skb_layout_t* layout)
 {
 	assert(layout);
@@ -3307,6 +4785,18 @@ uint32_t skb_layout_get_flags(const skb_layout_t* layout)
 	return layout->flags;
 }
 
+skb_range_t skb_layout_get_shaped_text_range(const skb_layout_t* layout)
+{
+	assert(layout);
+	return layout->shaped_text_range;
+}
+
+float skb_layout_get_font_scale(const skb_layout_t* layout)
+{
+	assert(layout);
+	return layout->font_scale;
+}
+
 float skb_layout_get_advance_y(const skb_layout_t* layout)
 {
 	assert(layout);
@@ -3921,136 +5411,244 @@ void skb_layout_iterate_text_range_bounds(const skb_layout_t* layout, skb_text_r
 	skb_layout_iterate_text_range_bounds_with_offset(layout, (skb_vec2_t){0}, text_range, callback, context);
 }
 
-void skb_layout_iterate_text_range_bounds_with_offset(const skb_layout_t* layout, skb_vec2_t offset, skb_text_range_t text_range, skb_text_range_bounds_func_t* callback, void* context)
+// Iterates the text range bounds of a single line.
+static void skb__iterate_line_text_range_bounds(const skb_layout_t* layout, const skb_layout_line_t* line, skb_vec2_t offset, skb_range_t sel_range, skb_text_range_bounds_func_t* callback, void* context)
 {
-	assert(layout);
-	assert(callback);
+	skb_range_t rect_text_range = {0};
+	float rect_start_x = line->bounds.x;
+	float rect_end_x = line->bounds.x;
+	float x = line->bounds.x;
+	bool prev_is_right_adjacent = false;
 
-	skb_range_t sel_range = skb_layout_get_offset_range_from_text_range(layout, text_range);
+	for (int32_t ri = line->layout_run_range.start; ri < line->layout_run_range.end; ri++) {
+		const skb_layout_run_t* layout_run = &layout->layout_runs[ri];
+
+		skb_range_t cluster_range = layout_run->cluster_range;
+		int32_t cluster_range_delta = 1;
+		if (skb_is_rtl(layout_run->direction)) {
+			cluster_range.start = layout_run->cluster_range.end - 1;
+			cluster_range.end = layout_run->cluster_range.start - 1;
+			cluster_range_delta = -1;
+		}
 
-	for (int32_t li = 0; li < layout->lines_count; li++) {
-		const skb_layout_line_t* line = &layout->lines[li];
-		if (skb_range_overlap((skb_range_t){line->text_range.start, line->text_range.end}, sel_range)) {
+		const bool is_rtl = skb_is_rtl(layout_run->direction);
+
+		x += layout_run->padding.left;
+
+		for (int32_t ci = cluster_range.start; ci != cluster_range.end; ci += cluster_range_delta) {
+			const skb_cluster_t* cluster = &layout->clusters[ci];
+			const skb_range_t cluster_text_range = { .start = cluster->text_offset, .end = cluster->text_offset + cluster->text_count };
+			const skb_range_t cluster_glyph_range = { .start = cluster->glyphs_offset, .end = cluster->glyphs_offset + cluster->glyphs_count };
+
+			float cluster_width = 0.f;
+			for (int32_t gi = cluster_glyph_range.start; gi != cluster_glyph_range.end; gi++)
+				cluster_width += layout->glyphs[gi].advance_x;
+
+			skb_range_t selected_cluster_text_range = {
+				.start = skb_maxi(cluster_text_range.start, sel_range.start),
+				.end = skb_mini(cluster_text_range.end, sel_range.end)
+			};
 
-			skb_range_t rect_text_range = {0};
-			float rect_start_x = line->bounds.x;
-			float rect_end_x = line->bounds.x;
-			float x = line->bounds.x;
-			bool prev_is_right_adjacent = false;
-
-			for (int32_t ri = line->layout_run_range.start; ri < line->layout_run_range.end; ri++) {
-				const skb_layout_run_t* layout_run = &layout->layout_runs[ri];
-
-				skb_range_t cluster_range = layout_run->cluster_range;
-				int32_t cluster_range_delta = 1;
-				if (skb_is_rtl(layout_run->direction)) {
-					cluster_range.start = layout_run->cluster_range.end - 1;
-					cluster_range.end = layout_run->cluster_range.start - 1;
-					cluster_range_delta = -1;
+			if (selected_cluster_text_range.start < selected_cluster_text_range.end) {
+
+				// Code codepoint_idx is inside this run.
+				// Find number of graphemes and the grapheme index of the cp_offset
+				int32_t grapheme_start_idx = 0;
+				int32_t grapheme_end_idx = 0;
+				int32_t grapheme_count = 0;
+
+				for (int32_t cp_offset = cluster_text_range.start; cp_offset < cluster_text_range.end; cp_offset++) {
+					if (cp_offset == selected_cluster_text_range.start)
+						grapheme_start_idx = grapheme_count;
+					if (cp_offset == selected_cluster_text_range.end)
+						grapheme_end_idx = grapheme_count;
+					if (layout->text_props[cp_offset].flags & SKB_TEXT_PROP_GRAPHEME_BREAK)
+						grapheme_count++;
 				}
+				if (selected_cluster_text_range.end == cluster_text_range.end)
+					grapheme_end_idx = grapheme_count;
 
-				const bool is_rtl = skb_is_rtl(layout_run->direction);
+				// Interpolate caret location.
+				float start_u = (float)(grapheme_start_idx) / (float)grapheme_count;
+				float end_u = (float)(grapheme_end_idx) / (float)grapheme_count;
 
-				x += layout_run->padding.left;
+				if (is_rtl) {
+					float u = start_u;
+					start_u = 1.f - end_u;
+					end_u = 1.f - u;
+				}
 
-				for (int32_t ci = cluster_range.start; ci != cluster_range.end; ci += cluster_range_delta) {
-					const skb_cluster_t* cluster = &layout->clusters[ci];
-					const skb_range_t cluster_text_range = { .start = cluster->text_offset, .end = cluster->text_offset + cluster->text_count };
-					const skb_range_t cluster_glyph_range = { .start = cluster->glyphs_offset, .end = cluster->glyphs_offset + cluster->glyphs_count };
+				bool is_left_adjacent = false;
+				bool is_right_adjacent = false;
+				if (is_rtl) {
+					is_left_adjacent = selected_cluster_text_range.end == cluster_text_range.end;
+					is_right_adjacent = selected_cluster_text_range.start == cluster_text_range.start;
+				} else {
+					is_left_adjacent = selected_cluster_text_range.start == cluster_text_range.start;
+					is_right_adjacent = selected_cluster_text_range.end == cluster_text_range.end;
+				}
 
-					float cluster_width = 0.f;
-					for (int32_t gi = cluster_glyph_range.start; gi != cluster_glyph_range.end; gi++)
-						cluster_width += layout->glyphs[gi].advance_x;
+				if (prev_is_right_adjacent && is_left_adjacent) {
+					// Adjacent, merge with existing.
+					rect_text_range.start = skb_mini(rect_text_range.start, selected_cluster_text_range.start);
+					rect_text_range.end = skb_maxi(rect_text_range.end, selected_cluster_text_range.end);
+					rect_end_x = x + cluster_width * end_u;
+				} else {
+					// Start new rect
+					if (skb_absf(rect_end_x - rect_start_x) > 0.01f) {
+						skb_rect2_t rect = {
+							.x = offset.x + rect_start_x,
+							.y = offset.y + line->baseline + line->ascender,
+							.width = rect_end_x - rect_start_x,
+							.height = -line->ascender + line->descender,
+						};
+						callback(rect, context);
+					}
+					rect_text_range.start = selected_cluster_text_range.start;
+					rect_text_range.end = selected_cluster_text_range.end;
+					rect_start_x = x + cluster_width * start_u;
+					rect_end_x = x + cluster_width * end_u;
+				}
 
-					skb_range_t selected_cluster_text_range = {
-						.start = skb_maxi(cluster_text_range.start, sel_range.start),
-						.end = skb_mini(cluster_text_range.end, sel_range.end)
-					};
+				prev_is_right_adjacent = is_right_adjacent;
+			} else {
+				prev_is_right_adjacent = 0;
+			}
 
-					if (selected_cluster_text_range.start < selected_cluster_text_range.end) {
+			x += cluster_width;
+		}
 
-						// Code codepoint_idx is inside this run.
-						// Find number of graphemes and the grapheme index of the cp_offset
-						int32_t grapheme_start_idx = 0;
-						int32_t grapheme_end_idx = 0;
-						int32_t grapheme_count = 0;
+		if (skb_absf(rect_end_x - rect_start_x) > 0.01f) {
+			// Output rect.
+			skb_rect2_t rect = {
+				.x = offset.x + rect_start_x,
+				.y = offset.y + line->baseline + line->ascender,
+				.width = rect_end_x - rect_start_x,
+				.height = -line->ascender + line->descender,
+			};
+			callback(rect, context);
+		}
 
-						for (int32_t cp_offset = cluster_text_range.start; cp_offset < cluster_text_range.end; cp_offset++) {
-							if (cp_offset == selected_cluster_text_range.start)
-								grapheme_start_idx = grapheme_count;
-							if (cp_offset == selected_cluster_text_range.end)
-								grapheme_end_idx = grapheme_count;
-							if (layout->text_props[cp_offset].flags & SKB_TEXT_PROP_GRAPHEME_BREAK)
-								grapheme_count++;
-						}
-						if (selected_cluster_text_range.end == cluster_text_range.end)
-							grapheme_end_idx = grapheme_count;
+		x += layout_run->padding.right;
+	}
+}
 
-						// Interpolate caret location.
-						float start_u = (float)(grapheme_start_idx) / (float)grapheme_count;
-						float end_u = (float)(grapheme_end_idx) / (float)grapheme_count;
+void skb_layout_iterate_text_range_bounds_with_offset(const skb_layout_t* layout, skb_vec2_t offset, skb_text_range_t text_range, skb_text_range_bounds_func_t* callback, void* context)
+{
+	assert(layout);
+	assert(callback);
 
-						if (is_rtl) {
-							float u = start_u;
-							start_u = 1.f - end_u;
-							end_u = 1.f - u;
-						}
+	skb_range_t sel_range = skb_layout_get_offset_range_from_text_range(layout, text_range);
 
-						bool is_left_adjacent = false;
-						bool is_right_adjacent = false;
-						if (is_rtl) {
-							is_left_adjacent = selected_cluster_text_range.end == cluster_text_range.end;
-							is_right_adjacent = selected_cluster_text_range.start == cluster_text_range.start;
-						} else {
-							is_left_adjacent = selected_cluster_text_range.start == cluster_text_range.start;
-							is_right_adjacent = selected_cluster_text_range.end == cluster_text_range.end;
-						}
+	for (int32_t li = 0; li < layout->lines_count; li++) {
+		const skb_layout_line_t* line = &layout->lines[li];
+		if (skb_range_overlap((skb_range_t){line->text_range.start, line->text_range.end}, sel_range))
+			skb__iterate_line_text_range_bounds(layout, line, offset, sel_range, callback, context);
+	}
+}
 
-						if (prev_is_right_adjacent && is_left_adjacent) {
-							// Adjacent, merge with existing.
-							rect_text_range.start = skb_mini(rect_text_range.start, selected_cluster_text_range.start);
-							rect_text_range.end = skb_maxi(rect_text_range.end, selected_cluster_text_range.end);
-							rect_end_x = x + cluster_width * end_u;
-						} else {
-							// Start new rect
-							if (skb_absf(rect_end_x - rect_start_x) > 0.01f) {
-								skb_rect2_t rect = {
-									.x = offset.x + rect_start_x,
-									.y = offset.y + line->baseline + line->ascender,
-									.width = rect_end_x - rect_start_x,
-									.height = -line->ascender + line->descender,
-								};
-								callback(rect, context);
-							}
-							rect_text_range.start = selected_cluster_text_range.start;
-							rect_text_range.end = selected_cluster_text_range.end;
-							rect_start_x = x + cluster_width * start_u;
-							rect_end_x = x + cluster_width * end_u;
-						}
+// Returns index of the first line whose text range ends after the offset.
+static int32_t skb__lower_bound_line_by_text_end(const skb_layout_t* layout, int32_t text_offset)
+{
+	int32_t low = 0;
+	int32_t high = layout->lines_count;
+	while (low < high) {
+		const int32_t mid = low + (high - low) / 2;
+		if (layout->lines[mid].text_range.end <= text_offset)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
 
-						prev_is_right_adjacent = is_right_adjacent;
-					} else {
-						prev_is_right_adjacent = 0;
-					}
+// Returns index of the first line whose text range starts at or after the offset.
+static int32_t skb__lower_bound_line_by_text_start(const skb_layout_t* layout, int32_t text_offset)
+{
+	int32_t low = 0;
+	int32_t high = layout->lines_count;
+	while (low < high) {
+		const int32_t mid = low + (high - low) / 2;
+		if (layout->lines[mid].text_range.start < text_offset)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
 
-					x += cluster_width;
-				}
+// Returns index of the first line whose bottom is below y.
+static int32_t skb__lower_bound_line_by_bottom(const skb_layout_t* layout, float y)
+{
+	int32_t low = 0;
+	int32_t high = layout->lines_count;
+	while (low < high) {
+		const int32_t mid = low + (high - low) / 2;
+		const skb_layout_line_t* line = &layout->lines[mid];
+		if (line->baseline + line->descender <= y)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
 
-				if (skb_absf(rect_end_x - rect_start_x) > 0.01f) {
-					// Output rect.
-					skb_rect2_t rect = {
-						.x = offset.x + rect_start_x,
-						.y = offset.y + line->baseline + line->ascender,
-						.width = rect_end_x - rect_start_x,
-						.height = -line->ascender + line->descender,
-					};
-					callback(rect, context);
-				}
+// Returns index of the first line whose top is at or below y.
+static int32_t skb__lower_bound_line_by_top(const skb_layout_t* layout, float y)
+{
+	int32_t low = 0;
+	int32_t high = layout->lines_count;
+	while (low < high) {
+		const int32_t mid = low + (high - low) / 2;
+		const skb_layout_line_t* line = &layout->lines[mid];
+		if (line->baseline + line->ascender < y)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
 
-				x += layout_run->padding.right;
-			}
+skb_range_t skb_layout_get_visible_lines_range(const skb_layout_t* layout, skb_vec2_t offset, skb_rect2_t view_bounds)
+{
+	assert(layout);
+
+	// The lines are stacked from top to bottom, find the visible lines using binary search.
+	const int32_t start = skb__lower_bound_line_by_bottom(layout, view_bounds.y - offset.y);
+	const int32_t end = skb__lower_bound_line_by_top(layout, view_bounds.y + view_bounds.height - offset.y);
+	return (skb_range_t) { .start = start, .end = skb_maxi(start, end) };
+}
+
+skb_text_range_bounds_clip_info_t skb_layout_iterate_text_range_bounds_in_view(const skb_layout_t* layout, skb_vec2_t offset, skb_text_range_t text_range, skb_rect2_t view_bounds, skb_text_range_bounds_func_t* callback, void* context)
+{
+	assert(layout);
+	assert(callback);
+
+	skb_text_range_bounds_clip_info_t clip_info = {0};
+
+	skb_range_t sel_range = skb_layout_get_offset_range_from_text_range(layout, text_range);
+	if (sel_range.start >= sel_range.end)
+		return clip_info;
+
+	// Lines are in logical order, find the lines overlapping the selection.
+	const int32_t sel_lines_start = skb__lower_bound_line_by_text_end(layout, sel_range.start);
+	const int32_t sel_lines_end = skb_maxi(sel_lines_start, skb__lower_bound_line_by_text_start(layout, sel_range.end));
+
+	const skb_range_t visible_lines = skb_layout_get_visible_lines_range(layout, offset, view_bounds);
+	const int32_t start = skb_maxi(sel_lines_start, visible_lines.start);
+	const int32_t end = skb_mini(sel_lines_end, visible_lines.end);
+
+	for (int32_t li = start; li < end; li++) {
+		const skb_layout_line_t* line = &layout->lines[li];
+		if (skb_range_overlap((skb_range_t){line->text_range.start, line->text_range.end}, sel_range)) {
+			skb__iterate_line_text_range_bounds(layout, line, offset, sel_range, callback, context);
+			clip_info.visible_lines_count++;
 		}
 	}
+
+	clip_info.clipped_lines_count = (sel_lines_end - sel_lines_start) - skb_maxi(0, end - start);
+
+	return clip_info;
 }
 
 static int32_t render__get_indent_level(int32_t level, int32_t max_levels)
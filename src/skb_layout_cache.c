@@ -3,24 +3,44 @@
 
 #include "skb_layout_cache.h"
 #include "skb_common.h"
+#include "skb_layout_internal.h"
 
 #include <string.h>
 
+#if !defined(SKB_NO_OPEN)
+#include <stdio.h>
+#endif // !defined(SKB_NO_OPEN)
+
 typedef struct skb__cached_layout_t {
-	skb_layout_t* layout;
+	skb_layout_t* layout;	// Paint variant of the shape layout, see skb_layout_create_paint_variant().
 	skb_list_item_t lru;
 	int32_t last_access_stamp;
-	uint64_t hash;
+	uint64_t hash;			// Hash of the parameters, text, and attributes including paints.
+	int32_t shape_idx;		// Index of the shape the layout refers to.
 } skb__cached_layout_t;
 
+// Layout shared by all cached layouts which differ only by paint.
+typedef struct skb__cached_shape_t {
+	skb_layout_t* layout;
+	uint64_t shape_hash;	// Hash of the layout affecting parameters, text, and attributes.
+	int32_t ref_count;		// Number of cached layouts referring to the shape.
+	int32_t next_free;
+} skb__cached_shape_t;
+
 typedef struct skb_layout_cache_t {
 	skb_hash_table_t* layouts_lookup;
 	skb__cached_layout_t* layouts;
 	int32_t layouts_count;
 	int32_t layouts_cap;
 	int32_t layouts_freelist;
+	skb_hash_table_t* shapes_lookup;	// Maps shape hash to index in shapes.
+	skb__cached_shape_t* shapes;
+	int32_t shapes_count;
+	int32_t shapes_cap;
+	int32_t shapes_freelist;
 	skb_list_t lru;
 	int32_t now_stamp;
+	char* snapshot_path;
 } skb_layout_cache_t;
 
 skb_layout_cache_t* skb_layout_cache_create(void)
@@ -29,8 +49,10 @@ skb_layout_cache_t* skb_layout_cache_create(void)
 	memset(cache, 0, sizeof(skb_layout_cache_t));
 
 	cache->layouts_lookup = skb_hash_table_create();
+	cache->shapes_lookup = skb_hash_table_create();
 	cache->lru = skb_list_make();
 	cache->layouts_freelist = SKB_INVALID_INDEX;
+	cache->shapes_freelist = SKB_INVALID_INDEX;
 
 	return cache;
 }
@@ -39,17 +61,121 @@ void skb_layout_cache_destroy(skb_layout_cache_t* cache)
 {
 	if (!cache) return;
 
+	// The paint variants need to be destroyed before the shapes they refer to.
 	for (int32_t i = 0; i < cache->layouts_count; i++)
 		skb_layout_destroy(cache->layouts[i].layout);
 	skb_free(cache->layouts);
+	for (int32_t i = 0; i < cache->shapes_count; i++)
+		skb_layout_destroy(cache->shapes[i].layout);
+	skb_free(cache->shapes);
 
 	skb_hash_table_destroy(cache->layouts_lookup);
+	skb_hash_table_destroy(cache->shapes_lookup);
+	skb_free(cache->snapshot_path);
 
 	memset(cache, 0, sizeof(skb_layout_cache_t));
 
 	skb_free(cache);
 }
 
+#if !defined(SKB_NO_OPEN)
+void skb_layout_cache_set_snapshot_path(skb_layout_cache_t* cache, const char* path)
+{
+	assert(cache);
+
+	skb_free(cache->snapshot_path);
+	cache->snapshot_path = NULL;
+
+	if (path) {
+		const int32_t path_len = (int32_t)strlen(path);
+		cache->snapshot_path = skb_malloc(path_len + 1);
+		memcpy(cache->snapshot_path, path, path_len + 1);
+	}
+}
+
+static void skb__get_snapshot_file_name(const skb_layout_cache_t* cache, uint64_t hash, char* file_name, int32_t file_name_cap)
+{
+	snprintf(file_name, file_name_cap, "%s/%08x%08x.skbl", cache->snapshot_path, (uint32_t)(hash >> 32), (uint32_t)hash);
+}
+#endif // !defined(SKB_NO_OPEN)
+
+static skb_layout_t* skb__load_snapshot(const skb_layout_cache_t* cache, const skb_layout_params_t* params, uint64_t hash)
+{
+#if !defined(SKB_NO_OPEN)
+	if (!cache->snapshot_path)
+		return NULL;
+
+	char file_name[1024];
+	skb__get_snapshot_file_name(cache, hash, file_name, SKB_COUNTOF(file_name));
+
+	FILE* file = fopen(file_name, "rb");
+	if (!file)
+		return NULL;
+
+	// Get file size
+	fseek(file, 0, SEEK_END);
+	const long data_count = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	skb_layout_t* layout = NULL;
+	uint8_t* data = data_count > 0 ? skb_malloc(data_count) : NULL;
+	if (data && fread(data, 1, data_count, file) == (size_t)data_count) {
+		layout = skb_layout_create(NULL);
+		if (!skb_layout_deserialize(layout, params, data, (int32_t)data_count)) {
+			// Stale or invalid snapshot, the layout will be recreated.
+			skb_layout_destroy(layout);
+			layout = NULL;
+		}
+	}
+
+	fclose(file);
+	skb_free(data);
+
+	return layout;
+#else
+	return NULL;
+#endif // !defined(SKB_NO_OPEN)
+}
+
+static void skb__save_snapshot(const skb_layout_cache_t* cache, const skb_layout_t* layout, uint64_t hash)
+{
+#if !defined(SKB_NO_OPEN)
+	if (!cache->snapshot_path)
+		return;
+
+	const int32_t data_count = skb_layout_serialize(layout, NULL, 0);
+	uint8_t* data = skb_malloc(data_count);
+	skb_layout_serialize(layout, data, data_count);
+
+	char file_name[1024];
+	skb__get_snapshot_file_name(cache, hash, file_name, SKB_COUNTOF(file_name));
+
+	// Write to a temporary file first and move it in place only when fully written,
+	// so that a crash or a full disk does not leave a truncated snapshot behind.
+	char temp_file_name[1024 + 4];
+	snprintf(temp_file_name, SKB_COUNTOF(temp_file_name), "%s.tmp", file_name);
+
+	bool written = false;
+	FILE* file = fopen(temp_file_name, "wb");
+	if (file) {
+		written = fwrite(data, 1, data_count, file) == (size_t)data_count;
+		written = (fclose(file) == 0) && written;
+	}
+
+	if (written) {
+#if defined(_WIN32)
+		// Rename does not replace existing files on Windows.
+		remove(file_name);
+#endif
+		written = rename(temp_file_name, file_name) == 0;
+	}
+	if (!written)
+		remove(temp_file_name);
+
+	skb_free(data);
+#endif // !defined(SKB_NO_OPEN)
+}
+
 static skb_list_item_t* skb__get_lru_item(int32_t item_idx, void* context)
 {
 	skb_layout_cache_t* cache = (skb_layout_cache_t*)context;
@@ -94,6 +220,86 @@ skb__cached_layout_t* skb__layout_cache_get_or_insert(skb_layout_cache_t* cache,
 	return cached_layout;
 }
 
+static uint64_t skb__layout_params_hash_append_without_paint(uint64_t hash, const skb_layout_params_t* params)
+{
+	skb_layout_params_t layout_params = *params;
+	layout_params.layout_attributes = (skb_attribute_set_t){0};
+	hash = skb_layout_params_hash_append(hash, &layout_params);
+	hash = skb_attributes_hash_append_without_paint(hash, params->layout_attributes);
+	return hash;
+}
+
+// Returns index of the shape with the given hash, the shape is laid out or loaded from snapshot if not found. Adds reference to the shape.
+static int32_t skb__layout_cache_acquire_shape(
+	skb_layout_cache_t* cache, skb_temp_alloc_t* temp_alloc, const skb_layout_params_t* params,
+	const skb_content_run_t* runs, int32_t runs_count, uint64_t shape_hash)
+{
+	int32_t shape_idx = SKB_INVALID_INDEX;
+	if (!skb_hash_table_find(cache->shapes_lookup, shape_hash, &shape_idx)) {
+		if (cache->shapes_freelist != SKB_INVALID_INDEX) {
+			shape_idx = cache->shapes_freelist;
+			cache->shapes_freelist = cache->shapes[shape_idx].next_free;
+		} else {
+			SKB_ARRAY_RESERVE(cache->shapes, cache->shapes_count + 1);
+			shape_idx = cache->shapes_count++;
+		}
+		skb_hash_table_add(cache->shapes_lookup, shape_hash, shape_idx);
+
+		skb__cached_shape_t* shape = &cache->shapes[shape_idx];
+		memset(shape, 0, sizeof(skb__cached_shape_t));
+		shape->shape_hash = shape_hash;
+		shape->next_free = SKB_INVALID_INDEX;
+
+		// The snapshot may have been saved with different paints, the paints are set per cached layout.
+		shape->layout = skb__load_snapshot(cache, params, shape_hash);
+		if (!shape->layout) {
+			shape->layout = skb_layout_create_from_runs(temp_alloc, params, runs, runs_count);
+			skb__save_snapshot(cache, shape->layout, shape_hash);
+		}
+	}
+
+	cache->shapes[shape_idx].ref_count++;
+	return shape_idx;
+}
+
+static void skb__layout_cache_release_shape(skb_layout_cache_t* cache, int32_t shape_idx)
+{
+	skb__cached_shape_t* shape = &cache->shapes[shape_idx];
+	assert(shape->ref_count > 0);
+	if (--shape->ref_count > 0)
+		return;
+
+	skb_hash_table_remove(cache->shapes_lookup, shape->shape_hash);
+	skb_layout_destroy(shape->layout);
+	memset(shape, 0, sizeof(skb__cached_shape_t));
+	shape->next_free = cache->shapes_freelist;
+	cache->shapes_freelist = shape_idx;
+}
+
+static const skb_layout_t* skb__layout_cache_get(
+	skb_layout_cache_t* cache, skb_temp_alloc_t* temp_alloc, const skb_layout_params_t* params,
+	const skb_content_run_t* runs, int32_t runs_count, uint64_t shape_hash, uint64_t paint_hash)
+{
+	const uint64_t hash = skb_hash64_append_uint64(shape_hash, paint_hash);
+	skb__cached_layout_t* cached_layout = skb__layout_cache_get_or_insert(cache, hash);
+
+	if (!cached_layout->layout) {
+		// Layouts which differ only by paint share the shape layout, and own only the attributes with their paints.
+		cached_layout->shape_idx = skb__layout_cache_acquire_shape(cache, temp_alloc, params, runs, runs_count, shape_hash);
+		cached_layout->layout = skb_layout_create_paint_variant(cache->shapes[cached_layout->shape_idx].layout);
+		if (!skb_layout_update_paints(cached_layout->layout, params, runs, runs_count)) {
+			// The attributes do not match the shape (e.g. hash collision), create a separate layout.
+			skb_layout_destroy(cached_layout->layout);
+			cached_layout->layout = skb_layout_create_from_runs(temp_alloc, params, runs, runs_count);
+		}
+	}
+
+	assert(cached_layout);
+	assert(cached_layout->layout);
+
+	return cached_layout->layout;
+}
+
 const skb_layout_t* skb_layout_cache_get_utf8(
 	skb_layout_cache_t* cache, skb_temp_alloc_t* temp_alloc, const skb_layout_params_t* params,
 	const char* text, int32_t text_count, skb_attribute_set_t attributes)
@@ -104,18 +310,16 @@ const skb_layout_t* skb_layout_cache_get_utf8(
 		text_count = (int32_t)strlen(text);
 
 	uint64_t hash = skb_hash64_empty();
-	hash = skb_layout_params_hash_append(hash, params);
+	hash = skb__layout_params_hash_append_without_paint(hash, params);
 	hash = skb_hash64_append(hash, text, text_count);
-	hash = skb_attributes_hash_append(hash, attributes);
+	hash = skb_attributes_hash_append_without_paint(hash, attributes);
 
-	skb__cached_layout_t* cached_layout = skb__layout_cache_get_or_insert(cache, hash);
-	if (!cached_layout->layout) {
-		cached_layout->layout = skb_layout_create_utf8(temp_alloc, params, text, text_count, attributes);
-	}
-	assert(cached_layout);
-	assert(cached_layout->layout);
+	uint64_t paint_hash = skb_hash64_empty();
+	paint_hash = skb_attributes_hash_append(paint_hash, params->layout_attributes);
+	paint_hash = skb_attributes_hash_append(paint_hash, attributes);
 
-	return cached_layout->layout;
+	const skb_content_run_t run = skb_content_run_make_utf8(text, text_count, attributes, 0);
+	return skb__layout_cache_get(cache, temp_alloc, params, &run, 1, hash, paint_hash);
 }
 
 const skb_layout_t* skb_layout_cache_get_utf32(
@@ -128,18 +332,16 @@ const skb_layout_t* skb_layout_cache_get_utf32(
 		text_count = skb_utf32_strlen(text);
 
 	uint64_t hash = skb_hash64_empty();
-	hash = skb_layout_params_hash_append(hash, params);
+	hash = skb__layout_params_hash_append_without_paint(hash, params);
 	hash = skb_hash64_append(hash, text, text_count * sizeof(uint32_t));
-	hash = skb_attributes_hash_append(hash, attributes);
+	hash = skb_attributes_hash_append_without_paint(hash, attributes);
 
-	skb__cached_layout_t* cached_layout = skb__layout_cache_get_or_insert(cache, hash);
-	if (!cached_layout->layout) {
-		cached_layout->layout = skb_layout_create_utf32(temp_alloc, params, text, text_count, attributes);
-	}
-	assert(cached_layout);
-	assert(cached_layout->layout);
+	uint64_t paint_hash = skb_hash64_empty();
+	paint_hash = skb_attributes_hash_append(paint_hash, params->layout_attributes);
+	paint_hash = skb_attributes_hash_append(paint_hash, attributes);
 
-	return cached_layout->layout;
+	const skb_content_run_t run = skb_content_run_make_utf32(text, text_count, attributes, 0);
+	return skb__layout_cache_get(cache, temp_alloc, params, &run, 1, hash, paint_hash);
 }
 
 const skb_layout_t* skb_layout_cache_get_from_runs(
@@ -149,8 +351,10 @@ const skb_layout_t* skb_layout_cache_get_from_runs(
 	assert(cache);
 
 	uint64_t hash = skb_hash64_empty();
+	hash = skb__layout_params_hash_append_without_paint(hash, params);
 
-	hash = skb_layout_params_hash_append(hash, params);
+	uint64_t paint_hash = skb_hash64_empty();
+	paint_hash = skb_attributes_hash_append(paint_hash, params->layout_attributes);
 
 	skb_content_run_t* fixed_runs = SKB_TEMP_ALLOC(temp_alloc, skb_content_run_t, runs_count);
 	for (int32_t i = 0; i < runs_count; i++) {
@@ -172,19 +376,15 @@ const skb_layout_t* skb_layout_cache_get_from_runs(
 			hash = skb_hash64_append_float(hash, fixed_runs[i].icon.height);
 			hash = skb_hash64_append_uint32(hash, fixed_runs[i].icon.icon_handle);
 		}
-		hash = skb_attributes_hash_append(hash, fixed_runs[i].attributes);
+		hash = skb_attributes_hash_append_without_paint(hash, fixed_runs[i].attributes);
+		paint_hash = skb_attributes_hash_append(paint_hash, fixed_runs[i].attributes);
 	}
 
-	skb__cached_layout_t* cached_layout = skb__layout_cache_get_or_insert(cache, hash);
-	if (!cached_layout->layout)
-		cached_layout->layout = skb_layout_create_from_runs(temp_alloc, params, fixed_runs, runs_count);
-
-	assert(cached_layout);
-	assert(cached_layout->layout);
+	const skb_layout_t* layout = skb__layout_cache_get(cache, temp_alloc, params, fixed_runs, runs_count, hash, paint_hash);
 
 	SKB_TEMP_FREE(temp_alloc, fixed_runs);
 
-	return cached_layout->layout;
+	return layout;
 }
 
 bool skb_layout_cache_compact(skb_layout_cache_t* cache)
@@ -211,7 +411,9 @@ bool skb_layout_cache_compact(skb_layout_cache_t* cache)
 		skb_hash_table_remove(cache->layouts_lookup, cached_layout->hash);
 		skb_list_remove(&cache->lru, layout_idx, skb__get_lru_item, cache);
 
-		// Clear and return to freelist.
+		// Clear and return to freelist. The shape is destroyed when the last layout referring to it is evicted.
+		skb_layout_destroy(cached_layout->layout);
+		skb__layout_cache_release_shape(cache, cached_layout->shape_idx);
 		memset(cached_layout, 0, sizeof(skb__cached_layout_t));
 		cached_layout->lru.next = cache->layouts_freelist;
 		cache->layouts_freelist = layout_idx;
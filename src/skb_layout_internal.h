@@ -14,21 +14,42 @@ typedef struct skb__content_run_t {
 	intptr_t content_id;				// Custom identifier for a content run.
 	skb_range_t text_range;				// Range of text the attributes apply to.
 	skb_range_t attributes_range;		// The content attributes
+	int32_t lang_profile_idx;			// Index of the language profile of the run, see skb__lang_profile_t.
 	uint8_t type;						// Type of the content run which described the attributes. See skb_content_run_type_t.
 	bool has_text_background;
 } skb__content_run_t;
 
+// Language specific word break model, see skb__lang_profile_t.
+typedef enum {
+	SKB__WORD_BREAK_DEFAULT = 0,		// Use the word breaks from libunibreak.
+	SKB__WORD_BREAK_JA,					// Japanese budoux model.
+	SKB__WORD_BREAK_ZH_HANS,			// Simplified Chinese budoux model.
+	SKB__WORD_BREAK_ZH_HANT,			// Traditional Chinese budoux model.
+	SKB__WORD_BREAK_TH,					// Thai budoux model.
+} skb__word_break_model_t;
+
+// Language related data, resolved once for each distinct language of the content runs.
+typedef struct skb__lang_profile_t {
+	const char* lang;					// Language as stored in the attributes. Used as key, the tags are interned by skb_attribute_make_lang().
+	const char* canonical_lang;			// Canonical language tag, passed to libunibreak and font fallback.
+	hb_language_t hb_lang;				// Harfbuzz language used for shaping.
+	uint32_t font_code_pages;			// Font fallback preference, OS/2 code pages of the fonts preferred for the language, see skb__lang_to_font_code_pages().
+	uint8_t word_break_model;			// Word break model to use, see skb__word_break_model_t.
+} skb__lang_profile_t;
+
 // Represents run of text in same script, font and style, for shaping.
 typedef struct skb__shaping_run_t {
 	skb_range_t text_range;
 	skb_range_t glyph_range;			// Glyphs are in visual oder.
 	skb_range_t cluster_range;			// Clusters are in logical order.
 	int32_t content_run_idx;
+	int32_t content_run_count;			// Number of content runs shaped together. Content runs which differ only by attributes not affecting shaping are merged.
 	uint8_t script;
 	uint8_t direction;
 	uint8_t bidi_level;
 	bool is_emoji;
 	bool has_baseline_shift;
+	bool is_split_continuation;			// True if the run continues the previous run, which was split to shape the text in chunks.
 	float font_size;					// Cached font size for the run.
 	skb_font_handle_t font_handle;
 	float padding_start;
@@ -43,12 +64,17 @@ typedef struct skb_layout_t {
 	float advance_y;
 	uint8_t resolved_direction;
 	uint32_t flags; // See skb_layout_flags_t
+	skb_range_t shaped_text_range; // Range of text that has been shaped, see SKB_LAYOUT_IS_PARTIALLY_SHAPED.
+	float font_scale; // Scale applied to all font sizes, see skb_layout_relayout_at_scale().
 
 	// Text, text props, content_runs, and attributes are create based on the input text.
-	uint32_t* text;
+	const uint32_t* text;				// Points to text_buffer, or to the shared codepoints of the source text, see skb_layout_set_from_text().
 	skb_text_property_t* text_props;
 	int32_t text_count;
-	int32_t text_cap;
+	int32_t text_cap;					// Capacity of text_props.
+	uint32_t* text_buffer;				// Owned codepoints, not used while the text is shared.
+	int32_t text_buffer_cap;
+	bool text_is_shared;
 
 	skb__content_run_t* content_runs;
 	int32_t content_runs_count;
@@ -58,6 +84,11 @@ typedef struct skb_layout_t {
 	int32_t attributes_count;
 	int32_t attributes_cap;
 
+	// Language profiles referenced by the content runs.
+	skb__lang_profile_t* lang_profiles;
+	int32_t lang_profiles_count;
+	int32_t lang_profiles_cap;
+
 	// Shaping runs is the output if itemization. The shaping runs are in logical order.
 	skb__shaping_run_t* shaping_runs;
 	int32_t shaping_runs_count;
@@ -72,6 +103,14 @@ typedef struct skb_layout_t {
 	int32_t clusters_count;
 	int32_t clusters_cap;
 
+	// Shaped glyphs before spacing and line layout, normalized to font scale 1. Retained for skb_layout_relayout_at_scale().
+	skb_glyph_t* unscaled_glyphs;
+	int32_t unscaled_glyphs_count;
+	int32_t unscaled_glyphs_cap;
+	int32_t shaped_clusters_count;		// Number of clusters created by shaping, line layout may add more.
+	bool retain_unscaled_glyphs;		// If true, the shaped glyphs are retained in unscaled_glyphs during build.
+	bool can_scale_glyphs;				// True if the shaped glyphs scale linearly with font size.
+
 	// Lines, layout runs, and decorations are output of line layout.
 	skb_layout_line_t* lines;
 	int32_t lines_count;
@@ -86,10 +125,16 @@ typedef struct skb_layout_t {
 	int32_t decorations_count;
 	int32_t decorations_cap;
 
+	const struct skb_layout_t* paint_base;	// If set, only the attributes are owned, everything else is shared with the base layout, see skb_layout_create_paint_variant().
+
 	uint8_t should_free_instance;
 } skb_layout_t;
 
 skb_layout_t skb_layout_make_empty(void);
 bool skb_layout_add_ellipsis_to_last_line(skb_layout_t* layout);
 
+// Creates a layout which shares the glyphs, lines, text and other layout data with the base layout, and owns only a copy of the attributes.
+// The paints of the variant can be changed using skb_layout_update_paints(). The base layout must not be changed or destroyed while the variant is in use.
+skb_layout_t* skb_layout_create_paint_variant(const skb_layout_t* base_layout);
+
 #endif // SKB_LAYOUT_INTERNAL_H
@@ -0,0 +1,484 @@
+// SPDX-FileCopyrightText: 2025 Mikko Mononen
+// SPDX-License-Identifier: MIT
+
+#include "skb_mesh_cache.h"
+
+#include "skb_common.h"
+#include "skb_font_collection.h"
+#include "skb_font_collection_internal.h"
+
+#include <assert.h>
+#include <string.h>
+#include <math.h>
+
+#include "hb.h"
+
+#define SKB_MESH_DEFAULT_MEMORY_BUDGET	(4 * 1024 * 1024)
+#define SKB_MESH_MAX_POINTS				65536	// Indices are 16-bit.
+#define SKB_MESH_CUBIC_TOL				0.0001f	// Max distance in em units between a cubic and the quadratics approximating it.
+#define SKB_MESH_MAX_CUBIC_QUADS		16
+
+// Collects the points and triangles of a glyph outline while the glyph is drawn.
+typedef struct skb__mesh_builder_t {
+	skb_vec2_t* points;
+	int32_t points_count;
+	int32_t points_cap;
+
+	uint16_t* interior_indices;
+	int32_t interior_indices_count;
+	int32_t interior_indices_cap;
+
+	uint16_t* curve_indices;
+	int32_t curve_indices_count;
+	int32_t curve_indices_cap;
+
+	float scale;			// Scale from font units to em units.
+	int32_t contour_start;	// Index of the first point of the current contour, the interior triangles fan around it.
+	int32_t last_idx;		// Index of the last on-curve point of the current contour.
+	bool overflow;			// True if the mesh has too many points for 16-bit indices.
+} skb__mesh_builder_t;
+
+typedef struct skb__cached_mesh_t {
+	skb_glyph_mesh_t* mesh;	// Allocation holding the mesh, followed by its points and indices.
+	int32_t mesh_size;		// Size of the mesh allocation in bytes.
+	uint64_t hash;
+	skb_list_item_t lru;
+} skb__cached_mesh_t;
+
+typedef struct skb_mesh_cache_t {
+	skb_hash_table_t* meshes_lookup;
+	skb__cached_mesh_t* meshes;
+	int32_t meshes_count;
+	int32_t meshes_cap;
+	int32_t meshes_freelist;
+	skb_list_t lru;
+
+	int32_t memory_usage;
+	int32_t memory_budget;
+
+	hb_draw_funcs_t* draw_funcs;
+	skb__mesh_builder_t builder;	// Retained between the meshes to reuse the arrays.
+} skb_mesh_cache_t;
+
+
+//
+// Mesh building
+//
+
+static int32_t skb__mesh_add_point(skb__mesh_builder_t* b, skb_vec2_t pt)
+{
+	// Reuse the last and first point of the contour, so that the triangles share the indices and the mesh stays watertight.
+	if (b->last_idx != SKB_INVALID_INDEX && b->points[b->last_idx].x == pt.x && b->points[b->last_idx].y == pt.y)
+		return b->last_idx;
+	if (b->contour_start != SKB_INVALID_INDEX && b->points[b->contour_start].x == pt.x && b->points[b->contour_start].y == pt.y)
+		return b->contour_start;
+
+	if (b->points_count >= SKB_MESH_MAX_POINTS) {
+		b->overflow = true;
+		return 0;
+	}
+
+	SKB_ARRAY_RESERVE(b->points, b->points_count + 1);
+	b->points[b->points_count] = pt;
+	return b->points_count++;
+}
+
+static void skb__mesh_add_triangle(uint16_t** indices, int32_t* indices_count, int32_t* indices_cap, int32_t a, int32_t b, int32_t c)
+{
+	if (*indices_count + 3 > *indices_cap) {
+		*indices_cap = skb_maxi(*indices_count + 3, *indices_cap ? (*indices_cap + *indices_cap/2) : 48);
+		*indices = skb_realloc(*indices, sizeof(uint16_t) * (*indices_cap));
+		assert(*indices);
+	}
+	uint16_t* tri = *indices + *indices_count;
+	tri[0] = (uint16_t)a;
+	tri[1] = (uint16_t)b;
+	tri[2] = (uint16_t)c;
+	*indices_count += 3;
+}
+
+static void skb__mesh_add_fan_triangle(skb__mesh_builder_t* b, int32_t idx0, int32_t idx1)
+{
+	// Triangles touching the fan center are degenerate. This also closes the contour implicitly.
+	if (idx0 == idx1 || idx0 == b->contour_start || idx1 == b->contour_start)
+		return;
+	skb__mesh_add_triangle(&b->interior_indices, &b->interior_indices_count, &b->interior_indices_cap, b->contour_start, idx0, idx1);
+}
+
+static void skb__mesh_move_to(skb__mesh_builder_t* b, skb_vec2_t pt)
+{
+	b->contour_start = SKB_INVALID_INDEX;
+	b->last_idx = SKB_INVALID_INDEX;
+	b->contour_start = skb__mesh_add_point(b, pt);
+	b->last_idx = b->contour_start;
+}
+
+static void skb__mesh_line_to(skb__mesh_builder_t* b, skb_vec2_t pt)
+{
+	if (b->last_idx == SKB_INVALID_INDEX) {
+		skb__mesh_move_to(b, pt);
+		return;
+	}
+	const int32_t idx = skb__mesh_add_point(b, pt);
+	skb__mesh_add_fan_triangle(b, b->last_idx, idx);
+	b->last_idx = idx;
+}
+
+static void skb__mesh_quad_to(skb__mesh_builder_t* b, skb_vec2_t cp, skb_vec2_t pt)
+{
+	if (b->last_idx == SKB_INVALID_INDEX) {
+		skb__mesh_move_to(b, pt);
+		return;
+	}
+
+	const skb_vec2_t p0 = b->points[b->last_idx];
+	const float cross = (cp.x - p0.x) * (pt.y - p0.y) - (cp.y - p0.y) * (pt.x - p0.x);
+	if (cross == 0.f) {
+		// Flat curve
+		skb__mesh_line_to(b, pt);
+		return;
+	}
+
+	// The control point is not shared with other triangles, add it directly.
+	if (b->points_count >= SKB_MESH_MAX_POINTS) {
+		b->overflow = true;
+		return;
+	}
+	SKB_ARRAY_RESERVE(b->points, b->points_count + 1);
+	const int32_t cp_idx = b->points_count++;
+	b->points[cp_idx] = cp;
+
+	const int32_t idx = skb__mesh_add_point(b, pt);
+	skb__mesh_add_fan_triangle(b, b->last_idx, idx);
+	skb__mesh_add_triangle(&b->curve_indices, &b->curve_indices_count, &b->curve_indices_cap, b->last_idx, cp_idx, idx);
+	b->last_idx = idx;
+}
+
+static void skb__mesh_cubic_to(skb__mesh_builder_t* b, skb_vec2_t cp0, skb_vec2_t cp1, skb_vec2_t pt)
+{
+	if (b->last_idx == SKB_INVALID_INDEX) {
+		skb__mesh_move_to(b, pt);
+		return;
+	}
+
+	// Approximate the cubic with quadratics. The error of the approximation is sqrt(3)/36 * |p3 - 3*p2 + 3*p1 - p0|,
+	// and it drops with the cube of number of subdivisions.
+	const skb_vec2_t p0 = b->points[b->last_idx];
+	const float ddx = pt.x - 3.f * cp1.x + 3.f * cp0.x - p0.x;
+	const float ddy = pt.y - 3.f * cp1.y + 3.f * cp0.y - p0.y;
+	const float err = (sqrtf(3.f) / 36.f) * sqrtf(ddx*ddx + ddy*ddy);
+	const float quads = ceilf(cbrtf(err / SKB_MESH_CUBIC_TOL));
+	const int32_t n = quads < (float)SKB_MESH_MAX_CUBIC_QUADS ? skb_maxi((int32_t)quads, 1) : SKB_MESH_MAX_CUBIC_QUADS;
+	const float step = 1.f / (float)n;
+
+	skb_vec2_t q0 = p0;
+	skb_vec2_t d0 = skb_vec2_scale(skb_vec2_sub(cp0, p0), 3.f);
+	for (int32_t i = 1; i <= n; i++) {
+		const float t = (float)i * step;
+		const float mt = 1.f - t;
+		const skb_vec2_t q3 = i == n ? pt : (skb_vec2_t) {
+			.x = mt*mt*mt * p0.x + 3.f*mt*mt*t * cp0.x + 3.f*mt*t*t * cp1.x + t*t*t * pt.x,
+			.y = mt*mt*mt * p0.y + 3.f*mt*mt*t * cp0.y + 3.f*mt*t*t * cp1.y + t*t*t * pt.y,
+		};
+		const skb_vec2_t d3 = {
+			.x = 3.f*mt*mt * (cp0.x - p0.x) + 6.f*mt*t * (cp1.x - cp0.x) + 3.f*t*t * (pt.x - cp1.x),
+			.y = 3.f*mt*mt * (cp0.y - p0.y) + 6.f*mt*t * (cp1.y - cp0.y) + 3.f*t*t * (pt.y - cp1.y),
+		};
+		// Control points of the sub-curve, and quadratic control point which best matches them.
+		const skb_vec2_t c1 = skb_vec2_mad(q0, d0, step / 3.f);
+		const skb_vec2_t c2 = skb_vec2_mad(q3, d3, -step / 3.f);
+		const skb_vec2_t qc = {
+			.x = (3.f * (c1.x + c2.x) - q0.x - q3.x) * 0.25f,
+			.y = (3.f * (c1.y + c2.y) - q0.y - q3.y) * 0.25f,
+		};
+		skb__mesh_quad_to(b, qc, q3);
+		q0 = q3;
+		d0 = d3;
+	}
+}
+
+static void skb__mesh_close(skb__mesh_builder_t* b)
+{
+	b->contour_start = SKB_INVALID_INDEX;
+	b->last_idx = SKB_INVALID_INDEX;
+}
+
+static inline skb_vec2_t skb__mesh_to_em(const skb__mesh_builder_t* b, float x, float y)
+{
+	// Font units are y-up.
+	return skb_vec2_make(x * b->scale, -y * b->scale);
+}
+
+static void skb__hb_mesh_move_to(hb_draw_funcs_t* dfuncs, void* draw_data, hb_draw_state_t* st, float to_x, float to_y, void* user_data)
+{
+	SKB_UNUSED(dfuncs);
+	SKB_UNUSED(st);
+	SKB_UNUSED(user_data);
+	skb__mesh_builder_t* b = (skb__mesh_builder_t*)draw_data;
+	skb__mesh_move_to(b, skb__mesh_to_em(b, to_x, to_y));
+}
+
+static void skb__hb_mesh_line_to(hb_draw_funcs_t* dfuncs, void* draw_data, hb_draw_state_t* st, float to_x, float to_y, void* user_data)
+{
+	SKB_UNUSED(dfuncs);
+	SKB_UNUSED(st);
+	SKB_UNUSED(user_data);
+	skb__mesh_builder_t* b = (skb__mesh_builder_t*)draw_data;
+	skb__mesh_line_to(b, skb__mesh_to_em(b, to_x, to_y));
+}
+
+static void skb__hb_mesh_quadratic_to(
+	hb_draw_funcs_t* dfuncs, void* draw_data, hb_draw_state_t* st,
+	float control_x, float control_y, float to_x, float to_y, void* user_data)
+{
+	SKB_UNUSED(dfuncs);
+	SKB_UNUSED(st);
+	SKB_UNUSED(user_data);
+	skb__mesh_builder_t* b = (skb__mesh_builder_t*)draw_data;
+	skb__mesh_quad_to(b, skb__mesh_to_em(b, control_x, control_y), skb__mesh_to_em(b, to_x, to_y));
+}
+
+static void skb__hb_mesh_cubic_to(
+	hb_draw_funcs_t* dfuncs, void* draw_data, hb_draw_state_t* st,
+	float control1_x, float control1_y, float control2_x, float control2_y, float to_x, float to_y, void* user_data)
+{
+	SKB_UNUSED(dfuncs);
+	SKB_UNUSED(st);
+	SKB_UNUSED(user_data);
+	skb__mesh_builder_t* b = (skb__mesh_builder_t*)draw_data;
+	skb__mesh_cubic_to(b, skb__mesh_to_em(b, control1_x, control1_y), skb__mesh_to_em(b, control2_x, control2_y), skb__mesh_to_em(b, to_x, to_y));
+}
+
+static void skb__hb_mesh_close_path(hb_draw_funcs_t* dfuncs, void* draw_data, hb_draw_state_t* st, void* user_data)
+{
+	SKB_UNUSED(dfuncs);
+	SKB_UNUSED(st);
+	SKB_UNUSED(user_data);
+	skb__mesh_close((skb__mesh_builder_t*)draw_data);
+}
+
+static skb__cached_mesh_t skb__create_mesh(skb_mesh_cache_t* cache, const skb_font_t* font, uint32_t glyph_id)
+{
+	skb__mesh_builder_t* b = &cache->builder;
+	b->points_count = 0;
+	b->interior_indices_count = 0;
+	b->curve_indices_count = 0;
+	b->scale = font->upem_scale;
+	b->contour_start = SKB_INVALID_INDEX;
+	b->last_idx = SKB_INVALID_INDEX;
+	b->overflow = false;
+
+	hb_font_draw_glyph(font->hb_font, glyph_id, cache->draw_funcs, b);
+
+	if (b->overflow) {
+		// Too complex glyph, leave empty.
+		b->points_count = 0;
+		b->interior_indices_count = 0;
+		b->curve_indices_count = 0;
+	}
+
+	// Store the mesh and its data in one allocation, so that the mesh stays in place when the cache grows.
+	const int32_t points_size = b->points_count * (int32_t)sizeof(skb_vec2_t);
+	const int32_t interior_size = b->interior_indices_count * (int32_t)sizeof(uint16_t);
+	const int32_t curve_size = b->curve_indices_count * (int32_t)sizeof(uint16_t);
+	const int32_t mesh_size = (int32_t)sizeof(skb_glyph_mesh_t) + points_size + interior_size + curve_size;
+
+	uint8_t* data = skb_malloc(mesh_size);
+	skb_glyph_mesh_t* mesh = (skb_glyph_mesh_t*)data;
+	skb_vec2_t* points = (skb_vec2_t*)(data + sizeof(skb_glyph_mesh_t));
+	uint16_t* interior_indices = (uint16_t*)(data + sizeof(skb_glyph_mesh_t) + points_size);
+	uint16_t* curve_indices = (uint16_t*)(data + sizeof(skb_glyph_mesh_t) + points_size + interior_size);
+
+	if (points_size > 0)
+		memcpy(points, b->points, points_size);
+	if (interior_size > 0)
+		memcpy(interior_indices, b->interior_indices, interior_size);
+	if (curve_size > 0)
+		memcpy(curve_indices, b->curve_indices, curve_size);
+
+	skb_rect2_t bounds = skb_rect2_make_undefined();
+	for (int32_t i = 0; i < b->points_count; i++)
+		bounds = skb_rect2_union_point(bounds, b->points[i]);
+
+	mesh->points = points;
+	mesh->points_count = b->points_count;
+	mesh->interior_indices = interior_indices;
+	mesh->interior_indices_count = b->interior_indices_count;
+	mesh->curve_indices = curve_indices;
+	mesh->curve_indices_count = b->curve_indices_count;
+	mesh->bounds = b->points_count > 0 ? bounds : (skb_rect2_t){0};
+
+	return (skb__cached_mesh_t) {
+		.mesh = mesh,
+		.mesh_size = mesh_size,
+	};
+}
+
+
+//
+// Mesh cache
+//
+
+skb_mesh_cache_t* skb_mesh_cache_create(int32_t memory_budget)
+{
+	skb_mesh_cache_t* cache = skb_malloc(sizeof(skb_mesh_cache_t));
+	memset(cache, 0, sizeof(skb_mesh_cache_t));
+
+	cache->meshes_lookup = skb_hash_table_create();
+	cache->lru = skb_list_make();
+	cache->meshes_freelist = SKB_INVALID_INDEX;
+	cache->memory_budget = memory_budget > 0 ? memory_budget : SKB_MESH_DEFAULT_MEMORY_BUDGET;
+
+	cache->draw_funcs = hb_draw_funcs_create ();
+	hb_draw_funcs_set_move_to_func (cache->draw_funcs, skb__hb_mesh_move_to, cache, NULL);
+	hb_draw_funcs_set_line_to_func (cache->draw_funcs, skb__hb_mesh_line_to, cache, NULL);
+	hb_draw_funcs_set_quadratic_to_func (cache->draw_funcs, skb__hb_mesh_quadratic_to, cache, NULL);
+	hb_draw_funcs_set_cubic_to_func (cache->draw_funcs, skb__hb_mesh_cubic_to, cache, NULL);
+	hb_draw_funcs_set_close_path_func (cache->draw_funcs, skb__hb_mesh_close_path, cache, NULL);
+	hb_draw_funcs_make_immutable (cache->draw_funcs);
+
+	return cache;
+}
+
+void skb_mesh_cache_destroy(skb_mesh_cache_t* cache)
+{
+	if (!cache) return;
+
+	for (int32_t i = 0; i < cache->meshes_count; i++)
+		skb_free(cache->meshes[i].mesh);
+	skb_free(cache->meshes);
+
+	skb_free(cache->builder.points);
+	skb_free(cache->builder.interior_indices);
+	skb_free(cache->builder.curve_indices);
+
+	hb_draw_funcs_destroy(cache->draw_funcs);
+	skb_hash_table_destroy(cache->meshes_lookup);
+
+	memset(cache, 0, sizeof(skb_mesh_cache_t));
+
+	skb_free(cache);
+}
+
+static skb_list_item_t* skb__get_lru_item(int32_t item_idx, void* context)
+{
+	skb_mesh_cache_t* cache = (skb_mesh_cache_t*)context;
+	return &cache->meshes[item_idx].lru;
+}
+
+const skb_glyph_mesh_t* skb_mesh_cache_get_glyph_mesh(skb_mesh_cache_t* cache, skb_font_collection_t* font_collection, skb_font_handle_t font_handle, uint32_t glyph_id)
+{
+	assert(cache);
+	assert(font_collection);
+
+	uint64_t hash = skb_hash64_empty();
+	hash = skb_hash64_append_uint32(hash, skb_font_collection_get_id(font_collection));
+	hash = skb_hash64_append_uint32(hash, font_handle);
+	hash = skb_hash64_append_uint32(hash, glyph_id);
+
+	int32_t mesh_idx = SKB_INVALID_INDEX;
+	if (!skb_hash_table_find(cache->meshes_lookup, hash, &mesh_idx)) {
+		const skb_font_t* font = skb_font_collection_get_font(font_collection, font_handle);
+		if (!font)
+			return NULL;
+
+		if (cache->meshes_freelist != SKB_INVALID_INDEX) {
+			// Pop from freelist
+			mesh_idx = cache->meshes_freelist;
+			cache->meshes_freelist = cache->meshes[mesh_idx].lru.next;
+		} else {
+			SKB_ARRAY_RESERVE(cache->meshes, cache->meshes_count + 1);
+			mesh_idx = cache->meshes_count++;
+		}
+
+		skb__cached_mesh_t* cached_mesh = &cache->meshes[mesh_idx];
+		*cached_mesh = skb__create_mesh(cache, font, glyph_id);
+		cached_mesh->hash = hash;
+		cached_mesh->lru = skb_list_item_make();
+		cache->memory_usage += cached_mesh->mesh_size;
+
+		skb_hash_table_add(cache->meshes_lookup, hash, mesh_idx);
+	}
+
+	assert(mesh_idx != SKB_INVALID_INDEX);
+
+	// Add to the front of the LRU list.
+	skb_list_move_to_front(&cache->lru, mesh_idx, skb__get_lru_item, cache);
+
+	return cache->meshes[mesh_idx].mesh;
+}
+
+void skb_mesh_cache_iterate_layout_meshes(skb_mesh_cache_t* cache, const skb_layout_t* layout, skb_vec2_t offset, skb_glyph_mesh_instance_func_t* callback, void* context)
+{
+	assert(cache);
+	assert(layout);
+	assert(callback);
+
+	const skb_layout_params_t* params = skb_layout_get_params(layout);
+	const skb_layout_run_t* layout_runs = skb_layout_get_layout_runs(layout);
+	const int32_t layout_runs_count = skb_layout_get_layout_runs_count(layout);
+	const skb_glyph_t* glyphs = skb_layout_get_glyphs(layout);
+
+	for (int32_t ri = 0; ri < layout_runs_count; ri++) {
+		const skb_layout_run_t* run = &layout_runs[ri];
+		if (run->type == SKB_CONTENT_RUN_OBJECT || run->type == SKB_CONTENT_RUN_ICON)
+			continue;
+
+		for (int32_t gi = run->glyph_range.start; gi < run->glyph_range.end; gi++) {
+			const skb_glyph_t* glyph = &glyphs[gi];
+			const skb_glyph_mesh_t* mesh = skb_mesh_cache_get_glyph_mesh(cache, params->font_collection, run->font_handle, glyph->gid);
+			if (!mesh || (mesh->interior_indices_count == 0 && mesh->curve_indices_count == 0))
+				continue;
+
+			const skb_glyph_mesh_instance_t instance = {
+				.mesh = mesh,
+				.transform = {
+					.xx = run->font_size, .yx = 0.f,
+					.xy = 0.f, .yy = run->font_size,
+					.dx = offset.x + glyph->offset_x, .dy = offset.y + glyph->offset_y,
+				},
+				.layout_run_idx = ri,
+				.glyph_idx = gi,
+			};
+			callback(&instance, context);
+		}
+	}
+}
+
+int32_t skb_mesh_cache_get_memory_usage(const skb_mesh_cache_t* cache)
+{
+	assert(cache);
+	return cache->memory_usage;
+}
+
+bool skb_mesh_cache_compact(skb_mesh_cache_t* cache)
+{
+	assert(cache);
+
+	bool compacted = false;
+
+	int32_t mesh_idx = cache->lru.tail; // Tail has least used items.
+	while (mesh_idx != SKB_INVALID_INDEX && cache->memory_usage > cache->memory_budget) {
+		skb__cached_mesh_t* cached_mesh = &cache->meshes[mesh_idx];
+
+		int32_t prev_mesh_idx = cached_mesh->lru.prev;
+
+		// Remove from hash table and LRU
+		skb_hash_table_remove(cache->meshes_lookup, cached_mesh->hash);
+		skb_list_remove(&cache->lru, mesh_idx, skb__get_lru_item, cache);
+
+		cache->memory_usage -= cached_mesh->mesh_size;
+		skb_free(cached_mesh->mesh);
+
+		// Clear and return to freelist.
+		memset(cached_mesh, 0, sizeof(skb__cached_mesh_t));
+		cached_mesh->lru.next = cache->meshes_freelist;
+		cache->meshes_freelist = mesh_idx;
+
+		compacted = true;
+
+		mesh_idx = prev_mesh_idx;
+	}
+
+	return compacted;
+}
@@ -22,9 +22,16 @@ typedef struct skb_rasterizer_t {
 	skb_rasterizer_config_t config;
 } skb_rasterizer_t;
 
+typedef struct skb_rasterizer_session_t {
+	skb_rasterizer_t* rasterizer;
+	skb_temp_alloc_t* temp_alloc;
+	skb_canvas_t* canvas;	// Created on first draw, and reset for the following draws.
+} skb_rasterizer_session_t;
+
 
 static void skb__hb_move_to(hb_draw_funcs_t* dfuncs, void* draw_data, hb_draw_state_t* st, float to_x, float to_y, void* user_data);
 static void skb__hb_line_to(hb_draw_funcs_t* dfuncs, void* draw_data, hb_draw_state_t* st, float to_x, float to_y, void* user_data);
+static void skb__hb_quadratic_to(hb_draw_funcs_t* dfuncs, void* draw_data, hb_draw_state_t* st, float control_x, float control_y, float to_x, float to_y, void* user_data);
 static void skb__hb_cubic_to(hb_draw_funcs_t* dfuncs, void* draw_data, hb_draw_state_t* st, float control1_x, float control1_y, float control2_x, float control2_y, float to_x, float to_y, void* user_data);
 static void skb__hb_close_path(hb_draw_funcs_t* dfuncs, void* draw_data, hb_draw_state_t* st, void* user_data);
 
@@ -49,6 +56,7 @@ skb_rasterizer_t* skb_rasterizer_create(skb_rasterizer_config_t* config)
 	rasterizer->draw_funcs = hb_draw_funcs_create ();
 	hb_draw_funcs_set_move_to_func (rasterizer->draw_funcs, skb__hb_move_to, rasterizer, NULL);
 	hb_draw_funcs_set_line_to_func (rasterizer->draw_funcs, skb__hb_line_to, rasterizer, NULL);
+	hb_draw_funcs_set_quadratic_to_func (rasterizer->draw_funcs, skb__hb_quadratic_to, rasterizer, NULL);
 	hb_draw_funcs_set_cubic_to_func (rasterizer->draw_funcs, skb__hb_cubic_to, rasterizer, NULL);
 	hb_draw_funcs_set_close_path_func (rasterizer->draw_funcs, skb__hb_close_path, rasterizer, NULL);
 	hb_draw_funcs_make_immutable (rasterizer->draw_funcs);
@@ -579,6 +587,110 @@ static void skb__unpremultiply_and_dilate(skb_temp_alloc_t* temp_alloc, skb_imag
 }
 
 
+//
+// Glyph effects
+//
+
+// Max filter over a line of pixels, the pixels outside the line are considered transparent.
+// Uses van Herk/Gil-Werman algorithm, the cost does not grow with the radius: The line is padded by radius on both sides,
+// and split into blocks of the window size. Each window spans at most two blocks, and its max is the max of the suffix max
+// of the block where it starts, and the prefix max of the block where it ends.
+// The prefix and suffix max buffers must hold count + radius * 2 values.
+static void skb__dilate_line(uint8_t* data, int32_t count, int32_t stride, int32_t radius, uint8_t* prefix_max, uint8_t* suffix_max)
+{
+	const int32_t window = radius * 2 + 1;
+	const int32_t padded_count = count + radius * 2;
+
+	for (int32_t i = 0; i < padded_count; i++) {
+		const int32_t src = i - radius;
+		const uint8_t value = (src >= 0 && src < count) ? data[src * stride] : 0;
+		prefix_max[i] = (i % window == 0 || value > prefix_max[i - 1]) ? value : prefix_max[i - 1];
+	}
+	for (int32_t i = padded_count - 1; i >= 0; i--) {
+		const int32_t src = i - radius;
+		const uint8_t value = (src >= 0 && src < count) ? data[src * stride] : 0;
+		suffix_max[i] = ((i + 1) % window == 0 || i == padded_count - 1 || value > suffix_max[i + 1]) ? value : suffix_max[i + 1];
+	}
+
+	for (int32_t i = 0; i < count; i++) {
+		const uint8_t start_max = suffix_max[i];
+		const uint8_t end_max = prefix_max[i + window - 1];
+		data[i * stride] = start_max > end_max ? start_max : end_max;
+	}
+}
+
+// Box filter over a line of pixels using running sum, the pixels outside the line are considered transparent.
+static void skb__box_blur_line(uint8_t* data, int32_t count, int32_t stride, int32_t radius, uint8_t* line)
+{
+	for (int32_t i = 0; i < count; i++)
+		line[i] = data[i * stride];
+
+	const int32_t window = radius * 2 + 1;
+	int32_t sum = 0;
+	for (int32_t i = 0; i < skb_mini(radius, count); i++)
+		sum += line[i];
+
+	for (int32_t i = 0; i < count; i++) {
+		if (i + radius < count)
+			sum += line[i + radius];
+		if (i - radius - 1 >= 0)
+			sum -= line[i - radius - 1];
+		data[i * stride] = (uint8_t)((sum + window / 2) / window);
+	}
+}
+
+static void skb__apply_glyph_effect(skb_temp_alloc_t* temp_alloc, skb_image_t* mask, skb_glyph_effect_t effect)
+{
+	const int32_t width = mask->width;
+	const int32_t height = mask->height;
+	const int32_t stride = mask->stride_bytes;
+
+	uint8_t* line = SKB_TEMP_ALLOC(temp_alloc, uint8_t, skb_maxi(width, height));
+
+	uint8_t* coverage = NULL;
+	if (effect.type == SKB_GLYPH_EFFECT_OUTLINE) {
+		// Keep the glyph coverage to cut out the glyph from the outline.
+		coverage = SKB_TEMP_ALLOC(temp_alloc, uint8_t, width * height);
+		for (int32_t y = 0; y < height; y++)
+			memcpy(&coverage[y * width], &mask->buffer[y * stride], width);
+	}
+
+	// Expand the shape by spread, the separable max filter results a square kernel.
+	const int32_t spread = (int32_t)effect.spread;
+	if (spread > 0) {
+		const int32_t padded_count = skb_maxi(width, height) + spread * 2;
+		uint8_t* max_buffer = SKB_TEMP_ALLOC(temp_alloc, uint8_t, padded_count * 2);
+		for (int32_t y = 0; y < height; y++)
+			skb__dilate_line(&mask->buffer[y * stride], width, 1, spread, max_buffer, max_buffer + padded_count);
+		for (int32_t x = 0; x < width; x++)
+			skb__dilate_line(&mask->buffer[x], height, stride, spread, max_buffer, max_buffer + padded_count);
+		SKB_TEMP_FREE(temp_alloc, max_buffer);
+	}
+
+	// Approximate gaussian blur with three box blur passes, the combined kernel covers the radius.
+	const int32_t box_radius = ((int32_t)effect.radius + 2) / 3;
+	if (box_radius > 0) {
+		for (int32_t pass = 0; pass < 3; pass++) {
+			for (int32_t y = 0; y < height; y++)
+				skb__box_blur_line(&mask->buffer[y * stride], width, 1, box_radius, line);
+			for (int32_t x = 0; x < width; x++)
+				skb__box_blur_line(&mask->buffer[x], height, stride, box_radius, line);
+		}
+	}
+
+	if (coverage) {
+		for (int32_t y = 0; y < height; y++) {
+			uint8_t* row = &mask->buffer[y * stride];
+			const uint8_t* coverage_row = &coverage[y * width];
+			for (int32_t x = 0; x < width; x++)
+				row[x] = row[x] > coverage_row[x] ? row[x] - coverage_row[x] : 0;
+		}
+		SKB_TEMP_FREE(temp_alloc, coverage);
+	}
+
+	SKB_TEMP_FREE(temp_alloc, line);
+}
+
 
 //
 // Font
@@ -616,6 +728,23 @@ static void skb__hb_line_to (
 	skb_canvas_line_to(c, skb_vec2_make(to_x, to_y));
 }
 
+static void skb__hb_quadratic_to (
+	hb_draw_funcs_t* dfuncs,
+	void* draw_data,
+	hb_draw_state_t* st,
+	float control_x, float control_y,
+	float to_x, float to_y,
+	void* user_data)
+{
+	SKB_UNUSED(dfuncs);
+	SKB_UNUSED(st);
+	SKB_UNUSED(user_data);
+
+	skb_canvas_t* c = (skb_canvas_t*)draw_data;
+
+	skb_canvas_quad_to(c, skb_vec2_make(control_x, control_y), skb_vec2_make(to_x, to_y));
+}
+
 static void skb__hb_cubic_to (
 	hb_draw_funcs_t* dfuncs,
 	void* draw_data,
@@ -995,22 +1124,11 @@ skb_rect2i_t skb_rasterizer_get_glyph_dimensions(uint32_t glyph_id, const skb_fo
 }
 
 
-bool skb_rasterizer_draw_alpha_glyph(
-	skb_rasterizer_t* rasterizer, skb_temp_alloc_t* temp_alloc,
+static void skb__draw_alpha_glyph(
+	skb_rasterizer_t* rasterizer, skb_temp_alloc_t* temp_alloc, skb_canvas_t* canvas,
 	uint32_t glyph_id, const skb_font_t* font, float font_size, skb_rasterize_alpha_mode_t alpha_mode,
 	float offset_x, float offset_y, skb_image_t* target)
 {
-	assert(rasterizer);
-	assert(temp_alloc);
-	assert(target);
-
-	if (!target->buffer || target->width <= 0 || target->height <= 0 || target->bpp != 1)
-		return false;
-
-	int64_t t_start = skb_perf_timer_get();
-
-	skb_canvas_t* canvas = skb_canvas_create(temp_alloc, target);
-
 	// Create transform to convert from the font coordinates to the canvas.
 	const float scale = font_size * font->upem_scale;
 
@@ -1027,6 +1145,25 @@ bool skb_rasterizer_draw_alpha_glyph(
 		// SDF
 		skb__mask_to_sdf(temp_alloc, target, rasterizer->config.on_edge_value, rasterizer->config.pixel_dist_scale);
 	}
+}
+
+bool skb_rasterizer_draw_alpha_glyph(
+	skb_rasterizer_t* rasterizer, skb_temp_alloc_t* temp_alloc,
+	uint32_t glyph_id, const skb_font_t* font, float font_size, skb_rasterize_alpha_mode_t alpha_mode,
+	float offset_x, float offset_y, skb_image_t* target)
+{
+	assert(rasterizer);
+	assert(temp_alloc);
+	assert(target);
+
+	if (!target->buffer || target->width <= 0 || target->height <= 0 || target->bpp != 1)
+		return false;
+
+	int64_t t_start = skb_perf_timer_get();
+
+	skb_canvas_t* canvas = skb_canvas_create(temp_alloc, target);
+
+	skb__draw_alpha_glyph(rasterizer, temp_alloc, canvas, glyph_id, font, font_size, alpha_mode, offset_x, offset_y, target);
 
 	skb_canvas_destroy(canvas);
 
@@ -1038,21 +1175,34 @@ bool skb_rasterizer_draw_alpha_glyph(
 	return true;
 }
 
-bool skb_rasterizer_draw_color_glyph(
-	skb_rasterizer_t* rasterizer, skb_temp_alloc_t* temp_alloc,
-	uint32_t glyph_id, const skb_font_t* font, float font_size, skb_rasterize_alpha_mode_t alpha_mode,
-	int32_t offset_x, int32_t offset_y, skb_image_t* target)
+int32_t skb_rasterizer_get_glyph_effect_padding(skb_glyph_effect_t effect)
 {
-	assert(rasterizer);
-	assert(temp_alloc);
+	if (effect.type == SKB_GLYPH_EFFECT_NONE)
+		return 0;
+	// The three box blur passes cover at most the radius rounded up to the box size.
+	const int32_t box_radius = ((int32_t)effect.radius + 2) / 3;
+	return skb_maxi(0, (int32_t)effect.spread) + box_radius * 3;
+}
 
-	if (!target->buffer || target->width <= 0 || target->height <= 0 || target->bpp != 4)
+bool skb_rasterizer_draw_glyph_effect(
+	skb_rasterizer_t* rasterizer, skb_temp_alloc_t* temp_alloc,
+	uint32_t glyph_id, const skb_font_t* font, float font_size, skb_glyph_effect_t effect,
+	float offset_x, float offset_y, skb_image_t* target)
+{
+	if (!skb_rasterizer_draw_alpha_glyph(rasterizer, temp_alloc, glyph_id, font, font_size, SKB_RASTERIZE_ALPHA_MASK, offset_x, offset_y, target))
 		return false;
 
-	int64_t t_start = skb_perf_timer_get();
+	if (effect.type != SKB_GLYPH_EFFECT_NONE)
+		skb__apply_glyph_effect(temp_alloc, target, effect);
 
-	skb_canvas_t* canvas = skb_canvas_create(temp_alloc, target);
+	return true;
+}
 
+static void skb__draw_color_glyph(
+	skb_rasterizer_t* rasterizer, skb_temp_alloc_t* temp_alloc, skb_canvas_t* canvas,
+	uint32_t glyph_id, const skb_font_t* font, float font_size, skb_rasterize_alpha_mode_t alpha_mode,
+	int32_t offset_x, int32_t offset_y, skb_image_t* target)
+{
 	// Create transform to convert from the font coordinates to the canvas.
 	const float scale = font_size * font->upem_scale;
 
@@ -1103,6 +1253,24 @@ bool skb_rasterizer_draw_color_glyph(
 
 		SKB_TEMP_FREE(temp_alloc, mask_buffer);
 	}
+}
+
+bool skb_rasterizer_draw_color_glyph(
+	skb_rasterizer_t* rasterizer, skb_temp_alloc_t* temp_alloc,
+	uint32_t glyph_id, const skb_font_t* font, float font_size, skb_rasterize_alpha_mode_t alpha_mode,
+	int32_t offset_x, int32_t offset_y, skb_image_t* target)
+{
+	assert(rasterizer);
+	assert(temp_alloc);
+
+	if (!target->buffer || target->width <= 0 || target->height <= 0 || target->bpp != 4)
+		return false;
+
+	int64_t t_start = skb_perf_timer_get();
+
+	skb_canvas_t* canvas = skb_canvas_create(temp_alloc, target);
+
+	skb__draw_color_glyph(rasterizer, temp_alloc, canvas, glyph_id, font, font_size, alpha_mode, offset_x, offset_y, target);
 
 	skb_canvas_destroy(canvas);
 
@@ -1115,6 +1283,91 @@ bool skb_rasterizer_draw_color_glyph(
 }
 
 
+//
+// Session
+//
+
+skb_rasterizer_session_t* skb_rasterizer_begin_session(skb_rasterizer_t* rasterizer, skb_temp_alloc_t* temp_alloc)
+{
+	assert(rasterizer);
+	assert(temp_alloc);
+
+	skb_rasterizer_session_t* session = SKB_TEMP_ALLOC(temp_alloc, skb_rasterizer_session_t, 1);
+	session->rasterizer = rasterizer;
+	session->temp_alloc = temp_alloc;
+	session->canvas = NULL;
+
+	return session;
+}
+
+void skb_rasterizer_end_session(skb_rasterizer_session_t* session)
+{
+	if (!session) return;
+
+	skb_temp_alloc_t* temp_alloc = session->temp_alloc;
+	if (session->canvas)
+		skb_canvas_destroy(session->canvas);
+	SKB_TEMP_FREE(temp_alloc, session);
+}
+
+// Returns canvas drawing to the target, retaining the buffers from the previous draws of the session.
+static skb_canvas_t* skb__session_get_canvas(skb_rasterizer_session_t* session, skb_image_t* target)
+{
+	if (session->canvas)
+		skb_canvas_reset(session->canvas, target);
+	else
+		session->canvas = skb_canvas_create(session->temp_alloc, target);
+	return session->canvas;
+}
+
+bool skb_rasterizer_session_draw_alpha_glyph(
+	skb_rasterizer_session_t* session,
+	uint32_t glyph_id, const skb_font_t* font, float font_size, skb_rasterize_alpha_mode_t alpha_mode,
+	float offset_x, float offset_y, skb_image_t* target)
+{
+	assert(session);
+	assert(target);
+
+	if (!target->buffer || target->width <= 0 || target->height <= 0 || target->bpp != 1)
+		return false;
+
+	skb_canvas_t* canvas = skb__session_get_canvas(session, target);
+	skb__draw_alpha_glyph(session->rasterizer, session->temp_alloc, canvas, glyph_id, font, font_size, alpha_mode, offset_x, offset_y, target);
+
+	return true;
+}
+
+bool skb_rasterizer_session_draw_glyph_effect(
+	skb_rasterizer_session_t* session,
+	uint32_t glyph_id, const skb_font_t* font, float font_size, skb_glyph_effect_t effect,
+	float offset_x, float offset_y, skb_image_t* target)
+{
+	if (!skb_rasterizer_session_draw_alpha_glyph(session, glyph_id, font, font_size, SKB_RASTERIZE_ALPHA_MASK, offset_x, offset_y, target))
+		return false;
+
+	if (effect.type != SKB_GLYPH_EFFECT_NONE)
+		skb__apply_glyph_effect(session->temp_alloc, target, effect);
+
+	return true;
+}
+
+bool skb_rasterizer_session_draw_color_glyph(
+	skb_rasterizer_session_t* session,
+	uint32_t glyph_id, const skb_font_t* font, float font_size, skb_rasterize_alpha_mode_t alpha_mode,
+	int32_t offset_x, int32_t offset_y, skb_image_t* target)
+{
+	assert(session);
+	assert(target);
+
+	if (!target->buffer || target->width <= 0 || target->height <= 0 || target->bpp != 4)
+		return false;
+
+	skb_canvas_t* canvas = skb__session_get_canvas(session, target);
+	skb__draw_color_glyph(session->rasterizer, session->temp_alloc, canvas, glyph_id, font, font_size, alpha_mode, offset_x, offset_y, target);
+
+	return true;
+}
+
 //
 // Icon
 //
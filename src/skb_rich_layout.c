@@ -71,9 +71,151 @@ static void skb__layout_paragraph_clear(skb_layout_paragraph_t* layout_paragraph
 	SKB_ZERO_STRUCT(layout_paragraph);
 }
 
+//
+// Detached layouts
+//
+
+// Default memory budget for layouts of removed paragraphs.
+#define SKB__DEFAULT_DETACHED_LAYOUTS_BUDGET (1024 * 1024)
+
+static int32_t skb__layout_get_allocated_size(const skb_layout_t* layout)
+{
+	int32_t size = (int32_t)sizeof(skb_layout_t);
+	size += layout->text_cap * (int32_t)sizeof(skb_text_property_t);
+	size += layout->text_buffer_cap * (int32_t)sizeof(uint32_t);
+	// A detached layout may keep the shared text alive after the paragraph text has changed.
+	if (layout->text_is_shared)
+		size += layout->text_count * (int32_t)sizeof(uint32_t);
+	size += layout->content_runs_cap * (int32_t)sizeof(skb__content_run_t);
+	size += layout->attributes_cap * (int32_t)sizeof(skb_attribute_t);
+	size += layout->lang_profiles_cap * (int32_t)sizeof(skb__lang_profile_t);
+	size += layout->shaping_runs_cap * (int32_t)sizeof(skb__shaping_run_t);
+	size += layout->glyphs_cap * (int32_t)sizeof(skb_glyph_t);
+	size += layout->clusters_cap * (int32_t)sizeof(skb_cluster_t);
+	size += layout->unscaled_glyphs_cap * (int32_t)sizeof(skb_glyph_t);
+	size += layout->lines_cap * (int32_t)sizeof(skb_layout_line_t);
+	size += layout->layout_runs_cap * (int32_t)sizeof(skb_layout_run_t);
+	size += layout->decorations_cap * (int32_t)sizeof(skb_decoration_t);
+	return size;
+}
+
+static bool skb__layout_is_reusable(const skb_layout_t* layout)
+{
+	// Truncated layouts depend on the position of the paragraph, and may have been altered after build (see skb_layout_add_ellipsis_to_last_line()).
+	if (layout->flags & SKB_LAYOUT_IS_TRUNCATED)
+		return false;
+	if (layout->lines_count > 0 && (layout->lines[layout->lines_count - 1].flags & SKB_LAYOUT_LINE_IS_TRUNCATED))
+		return false;
+	return true;
+}
+
+static void skb__detached_layouts_erase(skb_rich_layout_t* rich_layout, int32_t idx)
+{
+	assert(idx >= 0 && idx < rich_layout->detached_layouts_count);
+	rich_layout->detached_layouts_size -= rich_layout->detached_layouts[idx].allocated_size;
+	const int32_t tail_count = rich_layout->detached_layouts_count - (idx + 1);
+	if (tail_count > 0)
+		memmove(rich_layout->detached_layouts + idx, rich_layout->detached_layouts + idx + 1, tail_count * sizeof(skb__detached_layout_t));
+	rich_layout->detached_layouts_count--;
+}
+
+static void skb__detached_layouts_clear(skb_rich_layout_t* rich_layout)
+{
+	for (int32_t i = 0; i < rich_layout->detached_layouts_count; i++)
+		skb_layout_destroy(&rich_layout->detached_layouts[i].layout);
+	rich_layout->detached_layouts_count = 0;
+	rich_layout->detached_layouts_size = 0;
+}
+
+static void skb__detached_layouts_trim(skb_rich_layout_t* rich_layout, int32_t budget)
+{
+	// Evict oldest first.
+	int32_t evict_count = 0;
+	int32_t size = rich_layout->detached_layouts_size;
+	while (evict_count < rich_layout->detached_layouts_count && size > budget) {
+		size -= rich_layout->detached_layouts[evict_count].allocated_size;
+		skb_layout_destroy(&rich_layout->detached_layouts[evict_count].layout);
+		evict_count++;
+	}
+	if (evict_count > 0) {
+		const int32_t tail_count = rich_layout->detached_layouts_count - evict_count;
+		if (tail_count > 0)
+			memmove(rich_layout->detached_layouts, rich_layout->detached_layouts + evict_count, tail_count * sizeof(skb__detached_layout_t));
+		rich_layout->detached_layouts_count = tail_count;
+		rich_layout->detached_layouts_size = size;
+	}
+}
+
+// Removes the paragraph, retaining its layout for reuse if possible.
+static void skb__layout_paragraph_detach(skb_rich_layout_t* rich_layout, skb_layout_paragraph_t* layout_paragraph)
+{
+	const int32_t budget = rich_layout->detached_layouts_budget;
+	if (layout_paragraph->content_hash && budget > 0 && skb__layout_is_reusable(&layout_paragraph->layout)) {
+		const int32_t allocated_size = skb__layout_get_allocated_size(&layout_paragraph->layout);
+		if (allocated_size <= budget) {
+			skb__detached_layouts_trim(rich_layout, budget - allocated_size);
+
+			SKB_ARRAY_RESERVE(rich_layout->detached_layouts, rich_layout->detached_layouts_count + 1);
+			skb__detached_layout_t* detached_layout = &rich_layout->detached_layouts[rich_layout->detached_layouts_count++];
+			detached_layout->layout = layout_paragraph->layout;
+			detached_layout->content_hash = layout_paragraph->content_hash;
+			detached_layout->allocated_size = allocated_size;
+			rich_layout->detached_layouts_size += allocated_size;
+
+			// The layout is now owned by the detached layout.
+			SKB_ZERO_STRUCT(layout_paragraph);
+			return;
+		}
+	}
+
+	skb__layout_paragraph_clear(layout_paragraph);
+}
+
+// Returns true if the layout was built from the same codepoints as the text.
+static bool skb__layout_text_equals(const skb_layout_t* layout, const skb_text_t* text)
+{
+	const int32_t text_count = skb_text_get_utf32_count(text);
+	if (skb_layout_get_text_count(layout) != text_count)
+		return false;
+	if (text_count == 0)
+		return true;
+
+	const uint32_t* layout_utf32 = skb_layout_get_text(layout);
+	const uint32_t* utf32 = skb_text_get_utf32(text);
+	if (utf32)
+		return memcmp(layout_utf32, utf32, text_count * sizeof(uint32_t)) == 0;
+
+	// Compact text, compare in chunks.
+	uint32_t chunk[64];
+	for (int32_t offset = 0; offset < text_count; offset += SKB_COUNTOF(chunk)) {
+		const skb_range_t range = { .start = offset, .end = skb_mini(offset + SKB_COUNTOF(chunk), text_count) };
+		const int32_t count = skb_text_get_utf32_in_range(text, range, chunk, SKB_COUNTOF(chunk));
+		if (count != range.end - range.start || memcmp(layout_utf32 + offset, chunk, count * sizeof(uint32_t)) != 0)
+			return false;
+	}
+	return true;
+}
+
+// Moves detached layout with matching content hash and text to the paragraph. Returns true if found.
+// The hash is used to find the candidates, the text is compared too so that a hash collision cannot adopt a layout of different text.
+static bool skb__layout_paragraph_adopt(skb_rich_layout_t* rich_layout, skb_layout_paragraph_t* layout_paragraph, uint64_t content_hash, const skb_text_t* paragraph_text)
+{
+	// Search the most recent first.
+	for (int32_t i = rich_layout->detached_layouts_count - 1; i >= 0; i--) {
+		if (rich_layout->detached_layouts[i].content_hash == content_hash && skb__layout_text_equals(&rich_layout->detached_layouts[i].layout, paragraph_text)) {
+			skb_layout_destroy(&layout_paragraph->layout);
+			layout_paragraph->layout = rich_layout->detached_layouts[i].layout;
+			skb__detached_layouts_erase(rich_layout, i);
+			return true;
+		}
+	}
+	return false;
+}
+
 skb_rich_layout_t skb_rich_layout_make_empty(void)
 {
 	return (skb_rich_layout_t) {
+		.detached_layouts_budget = SKB__DEFAULT_DETACHED_LAYOUTS_BUDGET,
 		.should_free_instance = false,
 	};
 }
@@ -82,6 +224,7 @@ skb_rich_layout_t* skb_rich_layout_create(void)
 {
 	skb_rich_layout_t* rich_layout = skb_malloc(sizeof(skb_rich_layout_t));
 	SKB_ZERO_STRUCT(rich_layout);
+	rich_layout->detached_layouts_budget = SKB__DEFAULT_DETACHED_LAYOUTS_BUDGET;
 	rich_layout->should_free_instance = true;
 	return rich_layout;
 }
@@ -94,6 +237,9 @@ void skb_rich_layout_destroy(skb_rich_layout_t* rich_layout)
 		skb__layout_paragraph_clear(&rich_layout->paragraphs[i]);
 	skb_free(rich_layout->paragraphs);
 
+	skb__detached_layouts_clear(rich_layout);
+	skb_free(rich_layout->detached_layouts);
+
 	skb_free(rich_layout->attributes);
 
 	bool should_free_instance = rich_layout->should_free_instance;
@@ -117,6 +263,21 @@ void skb_rich_layout_reset(skb_rich_layout_t* rich_layout)
 	for (int32_t i = 0; i < rich_layout->paragraphs_count; i++)
 		skb__layout_paragraph_clear(&rich_layout->paragraphs[i]);
 	rich_layout->paragraphs_count = 0;
+
+	skb__detached_layouts_clear(rich_layout);
+}
+
+void skb_rich_layout_set_detached_layouts_budget(skb_rich_layout_t* rich_layout, int32_t budget)
+{
+	assert(rich_layout);
+	rich_layout->detached_layouts_budget = skb_maxi(0, budget);
+	skb__detached_layouts_trim(rich_layout, rich_layout->detached_layouts_budget);
+}
+
+int32_t skb_rich_layout_get_detached_layouts_size(const skb_rich_layout_t* rich_layout)
+{
+	assert(rich_layout);
+	return rich_layout->detached_layouts_size;
 }
 
 int32_t skb_rich_layout_get_paragraphs_count(const skb_rich_layout_t* rich_layout)
@@ -184,7 +345,7 @@ void skb_rich_layout_set_from_rich_text(
 	const int32_t rich_text_paragraph_count =  skb_rich_text_get_paragraphs_count(rich_text);
 	if (rich_text_paragraph_count < rich_layout->paragraphs_count) {
 		for (int32_t i = rich_text_paragraph_count; i < rich_layout->paragraphs_count; i++)
-			skb__layout_paragraph_clear(&rich_layout->paragraphs[i]);
+			skb__layout_paragraph_detach(rich_layout, &rich_layout->paragraphs[i]);
 		rich_layout->paragraphs_count = rich_text_paragraph_count;
 	}
 	if (rich_text_paragraph_count > rich_layout->paragraphs_count) {
@@ -199,6 +360,10 @@ void skb_rich_layout_set_from_rich_text(
 	bool rebuild_all = params_hash != rich_layout->params_hash; // If parameters have changed, we'll rebuild all.
 	rich_layout->params_hash = params_hash;
 	rich_layout->params = *params;
+
+	// The detached layouts were created with different parameters, and cannot be reused.
+	if (rebuild_all)
+		skb__detached_layouts_clear(rich_layout);
 	rich_layout->params.layout_attributes = (skb_attribute_set_t){0};
 	rich_layout->params.flags |= SKB_LAYOUT_PARAMS_IGNORE_MUST_LINE_BREAKS | SKB_LAYOUT_PARAMS_IGNORE_VERTICAL_ALIGN;
 
@@ -313,6 +478,7 @@ void skb_rich_layout_set_from_rich_text(
 
 				// Reset ID so that when the IME state changes the paragraph will update.
 				layout_paragraph->version = 0;
+				layout_paragraph->content_hash = 0;
 			} else {
 				bool rebuild = rebuild_all;
 
@@ -328,7 +494,18 @@ void skb_rich_layout_set_from_rich_text(
 					rebuild = true;
 
 				if (rebuild) {
-					skb_layout_set_from_text(&layout_paragraph->layout, temp_alloc, &layout_params, paragraph_text, (skb_attribute_set_t){0});
+					// Hash everything that affects the paragraph layout, so that a detached layout with identical content can be reused.
+					// Note: text_content_id_base is not included, as with the paragraphs shifted by skb_rich_layout_apply_change().
+					uint64_t content_hash = params_hash;
+					content_hash = skb_text_hash_append(content_hash, paragraph_text);
+					content_hash = skb_attributes_hash_append(content_hash, skb_rich_text_get_paragraph_attributes(rich_text, i));
+					content_hash = skb_hash64_append_uint32(content_hash, layout_params.flags);
+					content_hash = skb_hash64_append_float(content_hash, layout_params.layout_height);
+					content_hash = skb_hash64_append_int32(content_hash, list_marker_counter);
+
+					if (!skb__layout_paragraph_adopt(rich_layout, layout_paragraph, content_hash, paragraph_text))
+						skb_layout_set_from_text(&layout_paragraph->layout, temp_alloc, &layout_params, paragraph_text, (skb_attribute_set_t){0});
+					layout_paragraph->content_hash = content_hash;
 					layout_paragraph->version = paragraph_id;
 					layout_paragraph->list_marker_counter = list_marker_counter;
 					layout_paragraph->group_flags = layout_params.flags;
@@ -336,6 +513,7 @@ void skb_rich_layout_set_from_rich_text(
 			}
 		} else {
 			layout_paragraph->version = 0;
+			layout_paragraph->content_hash = 0;
 			skb_layout_reset(&layout_paragraph->layout);
 		}
 
@@ -430,9 +608,9 @@ void skb_rich_layout_apply_change(skb_rich_layout_t* rich_layout, skb_rich_text_
 	SKB_ARRAY_RESERVE(rich_layout->paragraphs, new_paragraphs_count);
 	rich_layout->paragraphs_count = new_paragraphs_count;
 
-	// Free the paragraphs that will be removed
+	// Detach the paragraphs that will be removed, their layouts may be reused by the inserted paragraphs.
 	for (int32_t i = change.start_paragraph_idx + change.inserted_paragraph_count; i < change.start_paragraph_idx + change.removed_paragraph_count; i++)
-		skb__layout_paragraph_clear(&rich_layout->paragraphs[i]);
+		skb__layout_paragraph_detach(rich_layout, &rich_layout->paragraphs[i]);
 
 	// Move tail of the paragraphs to create space for the paragraphs to be inserted, accounting for the removed paragraphs.
 	const int32_t old_tail_idx = change.start_paragraph_idx + change.removed_paragraph_count; // range_end is the last one to remove.
@@ -446,6 +624,16 @@ void skb_rich_layout_apply_change(skb_rich_layout_t* rich_layout, skb_rich_text_
 		skb__layout_paragraph_init(&rich_layout->paragraphs[i]);
 }
 
+void skb_rich_layout_sync_text_offsets(skb_rich_layout_t* rich_layout, const skb_rich_text_t* rich_text)
+{
+	assert(rich_layout);
+	assert(rich_text);
+
+	const int32_t paragraphs_count = skb_mini(rich_layout->paragraphs_count, skb_rich_text_get_paragraphs_count(rich_text));
+	for (int32_t i = 0; i < paragraphs_count; i++)
+		rich_layout->paragraphs[i].global_text_offset = skb_rich_text_get_paragraph_text_offset(rich_text, i);
+}
+
 skb_caret_info_t skb_rich_layout_get_caret_info_at(const skb_rich_layout_t* rich_layout, skb_text_position_t text_pos)
 {
 	assert(rich_layout);
@@ -513,9 +701,86 @@ void skb_rich_layout_get_text_range_bounds(const skb_rich_layout_t* rich_layout,
 	skb_layout_iterate_text_range_bounds_with_offset(&last_paragraph->layout, last_paragraph->offset, last_paragraph_sel, callback, context);
 }
 
-skb_text_position_t skb_rich_layout_hit_test(const skb_rich_layout_t* rich_layout, skb_movement_type_t type, float hit_x, float hit_y)
+skb_range_t skb_rich_layout_get_visible_paragraphs_range(const skb_rich_layout_t* rich_layout, skb_rect2_t view_bounds)
 {
 	assert(rich_layout);
+
+	// The paragraphs are stacked from top to bottom, find the visible paragraphs using binary search.
+	const float view_top_y = view_bounds.y;
+	const float view_bot_y = view_bounds.y + view_bounds.height;
+
+	// First paragraph whose bottom is below the top of the view.
+	int32_t low = 0;
+	int32_t high = rich_layout->paragraphs_count;
+	while (low < high) {
+		const int32_t mid = low + (high - low) / 2;
+		const skb_layout_paragraph_t* paragraph = &rich_layout->paragraphs[mid];
+		const skb_rect2_t bounds = skb_layout_get_bounds(&paragraph->layout);
+		if (paragraph->offset.y + bounds.y + bounds.height <= view_top_y)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	const int32_t start = low;
+
+	// First paragraph whose top is below the bottom of the view.
+	high = rich_layout->paragraphs_count;
+	while (low < high) {
+		const int32_t mid = low + (high - low) / 2;
+		const skb_layout_paragraph_t* paragraph = &rich_layout->paragraphs[mid];
+		const skb_rect2_t bounds = skb_layout_get_bounds(&paragraph->layout);
+		if (paragraph->offset.y + bounds.y < view_bot_y)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return (skb_range_t) { .start = start, .end = low };
+}
+
+skb_text_range_bounds_clip_info_t skb_rich_layout_get_text_range_bounds_in_view(const skb_rich_layout_t* rich_layout, skb_text_range_t text_range, skb_rect2_t view_bounds, skb_text_range_bounds_func_t* callback, void* context)
+{
+	assert(rich_layout);
+
+	skb_text_range_bounds_clip_info_t clip_info = {0};
+	if (rich_layout->paragraphs_count == 0)
+		return clip_info;
+
+	skb_paragraph_position_t start_pos = skb__rich_layout_get_paragraph_position_from_text_position(rich_layout, text_range.start, SKB_AFFINITY_USE);
+	skb_paragraph_position_t end_pos = skb__rich_layout_get_paragraph_position_from_text_position(rich_layout, text_range.end, SKB_AFFINITY_USE);
+	if (start_pos.global_text_offset > end_pos.global_text_offset) {
+		skb_paragraph_position_t tmp = start_pos;
+		start_pos = end_pos;
+		end_pos = tmp;
+	}
+
+	const skb_range_t visible_paragraphs = skb_rich_layout_get_visible_paragraphs_range(rich_layout, view_bounds);
+	const int32_t start_idx = skb_maxi(start_pos.paragraph_idx, visible_paragraphs.start);
+	const int32_t end_idx = skb_mini(end_pos.paragraph_idx + 1, visible_paragraphs.end);
+
+	for (int32_t i = start_idx; i < end_idx; i++) {
+		const skb_layout_paragraph_t* paragraph = &rich_layout->paragraphs[i];
+		skb_text_range_t paragraph_sel = {
+			.start = { .offset = i == start_pos.paragraph_idx ? start_pos.text_offset : 0 },
+			.end = { .offset = i == end_pos.paragraph_idx ? end_pos.text_offset : skb_layout_get_text_count(&paragraph->layout) },
+		};
+		const skb_text_range_bounds_clip_info_t paragraph_clip_info = skb_layout_iterate_text_range_bounds_in_view(&paragraph->layout, paragraph->offset, paragraph_sel, view_bounds, callback, context);
+		clip_info.visible_lines_count += paragraph_clip_info.visible_lines_count;
+		clip_info.clipped_lines_count += paragraph_clip_info.clipped_lines_count;
+	}
+
+	const int32_t paragraphs_count = end_pos.paragraph_idx - start_pos.paragraph_idx + 1;
+	clip_info.visible_paragraphs_count = skb_maxi(0, end_idx - start_idx);
+	clip_info.clipped_paragraphs_count = paragraphs_count - clip_info.visible_paragraphs_count;
+
+	return clip_info;
+}
+
+skb_text_position_t skb_rich_layout_hit_test_paragraph(const skb_rich_layout_t* rich_layout, skb_movement_type_t type, float hit_x, float hit_y, int32_t* hit_paragraph_idx_out)
+{
+	assert(rich_layout);
+	assert(hit_paragraph_idx_out);
+	*hit_paragraph_idx_out = 0;
 	if (rich_layout->paragraphs_count == 0)
 		return (skb_text_position_t){0};
 
@@ -561,10 +826,25 @@ skb_text_position_t skb_rich_layout_hit_test(const skb_rich_layout_t* rich_layou
 	}
 
 	assert(hit_paragraph_idx != SKB_INVALID_INDEX);
+	*hit_paragraph_idx_out = hit_paragraph_idx;
 
+	// Paragraphs inserted by skb_rich_layout_apply_change() have no lines until they are laid out.
 	const skb_layout_paragraph_t* hit_paragraph = &rich_layout->paragraphs[hit_paragraph_idx];
-	skb_text_position_t pos = skb_layout_hit_test_at_line(&hit_paragraph->layout, type, hit_line_idx, hit_x - hit_paragraph->offset.x);
-	pos.offset += hit_paragraph->global_text_offset;
+	if (hit_line_idx < 0 || hit_line_idx >= skb_layout_get_lines_count(&hit_paragraph->layout))
+		return (skb_text_position_t){0};
+
+	return skb_layout_hit_test_at_line(&hit_paragraph->layout, type, hit_line_idx, hit_x - hit_paragraph->offset.x);
+}
+
+skb_text_position_t skb_rich_layout_hit_test(const skb_rich_layout_t* rich_layout, skb_movement_type_t type, float hit_x, float hit_y)
+{
+	assert(rich_layout);
+	if (rich_layout->paragraphs_count == 0)
+		return (skb_text_position_t){0};
+
+	int32_t hit_paragraph_idx = 0;
+	skb_text_position_t pos = skb_rich_layout_hit_test_paragraph(rich_layout, type, hit_x, hit_y, &hit_paragraph_idx);
+	pos.offset += rich_layout->paragraphs[hit_paragraph_idx].global_text_offset;
 
 	return pos;
 }
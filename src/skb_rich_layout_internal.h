@@ -8,6 +8,7 @@
 
 #include "skb_common.h"
 #include "skb_layout_internal.h"
+#include "skb_rich_text.h"
 
 typedef struct skb_layout_paragraph_t {
 	skb_layout_t layout;				// Layout for the paragraph, may contain multiple lines.
@@ -16,8 +17,16 @@ typedef struct skb_layout_paragraph_t {
 	uint32_t version;					// Version of the paragraph, if different from rich text paragraph, needs update.
 	int32_t list_marker_counter;
 	uint8_t group_flags;
+	uint64_t content_hash;				// Hash of everything that affects the layout, used to reuse detached layouts. Zero if the layout cannot be reused.
 } skb_layout_paragraph_t;
 
+// Layout of a removed paragraph, retained so that it can be adopted by a new paragraph with same content (e.g. cut and paste, undo).
+typedef struct skb__detached_layout_t {
+	skb_layout_t layout;
+	uint64_t content_hash;
+	int32_t allocated_size;				// Approximate memory used by the layout, in bytes.
+} skb__detached_layout_t;
+
 typedef struct skb_rich_layout_t {
 	skb_layout_paragraph_t* paragraphs;	// Paragraphs
 	int32_t paragraphs_count;
@@ -32,9 +41,22 @@ typedef struct skb_rich_layout_t {
 
 	skb_rect2_t bounds;					// Bounds of the whole layout.
 
+	// Recently detached layouts, oldest first.
+	skb__detached_layout_t* detached_layouts;
+	int32_t detached_layouts_count;
+	int32_t detached_layouts_cap;
+	int32_t detached_layouts_size;		// Total allocated size of the detached layouts, in bytes.
+	int32_t detached_layouts_budget;	// Max allocated size of the detached layouts, in bytes.
+
 	uint8_t should_free_instance;
 } skb_rich_layout_t;
 
 skb_rich_layout_t skb_rich_layout_make_empty(void);
 
+// Same as skb_rich_layout_hit_test(), but returns the position relative to the hit paragraph, and the index of the hit paragraph.
+skb_text_position_t skb_rich_layout_hit_test_paragraph(const skb_rich_layout_t* rich_layout, skb_movement_type_t type, float hit_x, float hit_y, int32_t* hit_paragraph_idx_out);
+
+// Updates the paragraph text offsets to match the rich text, used to keep a stale layout in sync after skb_rich_layout_apply_change().
+void skb_rich_layout_sync_text_offsets(skb_rich_layout_t* rich_layout, const skb_rich_text_t* rich_text);
+
 #endif // SKB_RICH_LAYOUT_INTERNAL_H
@@ -194,6 +194,33 @@ void skb_rich_text_reset(skb_rich_text_t* rich_text)
 	rich_text->paragraphs_count = 0;
 }
 
+static void skb__rich_text_compact_paragraphs(skb_rich_text_t* rich_text, int32_t start_paragraph_idx, int32_t end_paragraph_idx)
+{
+	if (!rich_text->compact_storage)
+		return;
+	for (int32_t i = skb_maxi(0, start_paragraph_idx); i < end_paragraph_idx; i++)
+		skb_text_compact(&rich_text->paragraphs[i].text);
+}
+
+void skb_rich_text_set_compact_storage(skb_rich_text_t* rich_text, bool compact)
+{
+	assert(rich_text);
+	rich_text->compact_storage = compact;
+	if (compact) {
+		skb__rich_text_compact_paragraphs(rich_text, 0, rich_text->paragraphs_count);
+	} else {
+		// Expand all paragraphs.
+		for (int32_t i = 0; i < rich_text->paragraphs_count; i++)
+			skb_text_expand(&rich_text->paragraphs[i].text);
+	}
+}
+
+bool skb_rich_text_get_compact_storage(const skb_rich_text_t* rich_text)
+{
+	assert(rich_text);
+	return rich_text->compact_storage;
+}
+
 int32_t skb_rich_text_get_utf32_count(const skb_rich_text_t* rich_text)
 {
 	if (!rich_text)
@@ -207,31 +234,7 @@ int32_t skb_rich_text_get_utf32_count(const skb_rich_text_t* rich_text)
 
 int32_t skb_rich_text_get_utf8_count_in_range(const skb_rich_text_t* rich_text, skb_text_range_t text_range)
 {
-	const skb_paragraph_position_t start_pos = skb_rich_text_get_paragraph_position_from_text_position(rich_text, text_range.start, SKB_AFFINITY_USE);
-	const skb_paragraph_position_t end_pos = skb_rich_text_get_paragraph_position_from_text_position(rich_text, text_range.end, SKB_AFFINITY_USE);
-
-	if (start_pos.paragraph_idx == end_pos.paragraph_idx) {
-		const skb_text_t* paragraph_text = &rich_text->paragraphs[start_pos.paragraph_idx].text;
-		const int32_t count = skb_maxi(0, end_pos.text_offset - start_pos.text_offset);
-		return skb_utf32_to_utf8_count(skb_text_get_utf32(paragraph_text) + start_pos.text_offset, count);
-	}
-
-	int32_t count = 0;
-	// First paragraph
-	const skb_text_t* first_paragraph_text = &rich_text->paragraphs[start_pos.paragraph_idx].text;
-	const int32_t first_count = skb_maxi(0, skb_text_get_utf32_count(first_paragraph_text) - start_pos.text_offset);
-	count += skb_utf32_to_utf8_count(skb_text_get_utf32(first_paragraph_text) + start_pos.text_offset, first_count);
-	// Middle paragraphs
-	for (int32_t i = start_pos.paragraph_idx + 1; i < end_pos.paragraph_idx; i++) {
-		const skb_text_t* paragraph_text = &rich_text->paragraphs[i].text;
-		count += skb_utf32_to_utf8_count(skb_text_get_utf32(paragraph_text), skb_text_get_utf32_count(paragraph_text));
-	}
-	// Last paragraph
-	const skb_text_t* last_paragraph_text = &rich_text->paragraphs[end_pos.paragraph_idx].text;
-	const int32_t last_count = skb_mini(end_pos.text_offset, skb_text_get_utf32_count(last_paragraph_text));
-	count += skb_utf32_to_utf8_count(skb_text_get_utf32(last_paragraph_text), last_count);
-
-	return count;
+	return skb_rich_text_get_utf8_in_range(rich_text, text_range, NULL, 0);
 }
 
 int32_t skb_rich_text_get_utf8_in_range(const skb_rich_text_t* rich_text, skb_text_range_t text_range, char* utf8, int32_t utf8_cap)
@@ -241,24 +244,25 @@ int32_t skb_rich_text_get_utf8_in_range(const skb_rich_text_t* rich_text, skb_te
 
 	if (start_pos.paragraph_idx == end_pos.paragraph_idx) {
 		const skb_text_t* paragraph_text = &rich_text->paragraphs[start_pos.paragraph_idx].text;
-		const int32_t count = skb_maxi(0, end_pos.text_offset - start_pos.text_offset);
-		return skb_utf32_to_utf8(skb_text_get_utf32(paragraph_text) + start_pos.text_offset, count, utf8, utf8_cap);
+		const skb_range_t range = { .start = start_pos.text_offset, .end = skb_maxi(start_pos.text_offset, end_pos.text_offset) };
+		return skb_text_get_utf8_in_range(paragraph_text, range, utf8, utf8_cap);
 	}
 
 	int32_t count = 0;
 	// First paragraph
 	const skb_text_t* first_paragraph_text = &rich_text->paragraphs[start_pos.paragraph_idx].text;
-	const int32_t first_count = skb_maxi(0, skb_text_get_utf32_count(first_paragraph_text) - start_pos.text_offset);
-	count += skb_utf32_to_utf8(skb_text_get_utf32(first_paragraph_text) + start_pos.text_offset, first_count, utf8 + count, utf8_cap - count);
+	const skb_range_t first_range = { .start = start_pos.text_offset, .end = skb_text_get_utf32_count(first_paragraph_text) };
+	count += skb_text_get_utf8_in_range(first_paragraph_text, first_range, utf8 ? utf8 + count : NULL, utf8_cap - count);
 	// Middle paragraphs
 	for (int32_t i = start_pos.paragraph_idx + 1; i < end_pos.paragraph_idx; i++) {
 		const skb_text_t* paragraph_text = &rich_text->paragraphs[i].text;
-		count += skb_utf32_to_utf8(skb_text_get_utf32(paragraph_text), skb_text_get_utf32_count(paragraph_text), utf8 + count, utf8_cap - count);
+		const skb_range_t range = { .start = 0, .end = skb_text_get_utf32_count(paragraph_text) };
+		count += skb_text_get_utf8_in_range(paragraph_text, range, utf8 ? utf8 + count : NULL, utf8_cap - count);
 	}
 	// Last paragraph
 	const skb_text_t* last_paragraph_text = &rich_text->paragraphs[end_pos.paragraph_idx].text;
-	const int32_t last_count = skb_mini(end_pos.text_offset, skb_text_get_utf32_count(last_paragraph_text));
-	count += skb_utf32_to_utf8(skb_text_get_utf32(last_paragraph_text), last_count, utf8 + count, utf8_cap - count);
+	const skb_range_t last_range = { .start = 0, .end = end_pos.text_offset };
+	count += skb_text_get_utf8_in_range(last_paragraph_text, last_range, utf8 ? utf8 + count : NULL, utf8_cap - count);
 
 	return count;
 }
@@ -296,24 +300,25 @@ int32_t skb_rich_text_get_utf32_in_range(const skb_rich_text_t* rich_text, skb_t
 
 	if (start_pos.paragraph_idx == end_pos.paragraph_idx) {
 		const skb_text_t* paragraph_text = &rich_text->paragraphs[start_pos.paragraph_idx].text;
-		const int32_t count = skb_maxi(0, end_pos.text_offset - start_pos.text_offset);
-		return skb_utf32_copy(skb_text_get_utf32(paragraph_text) + start_pos.text_offset, count, utf32, utf32_cap);
+		const skb_range_t range = { .start = start_pos.text_offset, .end = skb_maxi(start_pos.text_offset, end_pos.text_offset) };
+		return skb_text_get_utf32_in_range(paragraph_text, range, utf32, utf32_cap);
 	}
 
 	int32_t count = 0;
 	// First paragraph
 	const skb_text_t* first_paragraph_text = &rich_text->paragraphs[start_pos.paragraph_idx].text;
-	const int32_t first_count = skb_maxi(0, skb_text_get_utf32_count(first_paragraph_text) - start_pos.text_offset);
-	count += skb_utf32_copy(skb_text_get_utf32(first_paragraph_text) + start_pos.text_offset, first_count, utf32 + count, utf32_cap - count);
+	const skb_range_t first_range = { .start = start_pos.text_offset, .end = skb_text_get_utf32_count(first_paragraph_text) };
+	count += skb_text_get_utf32_in_range(first_paragraph_text, first_range, utf32 ? utf32 + count : NULL, utf32_cap - count);
 	// Middle paragraphs
 	for (int32_t i = start_pos.paragraph_idx + 1; i <= end_pos.paragraph_idx - 1; i++) {
 		const skb_text_t* paragraph_text = &rich_text->paragraphs[i].text;
-		count += skb_utf32_copy(skb_text_get_utf32(paragraph_text), skb_text_get_utf32_count(paragraph_text), utf32 + count, utf32_cap - count);
+		const skb_range_t range = { .start = 0, .end = skb_text_get_utf32_count(paragraph_text) };
+		count += skb_text_get_utf32_in_range(paragraph_text, range, utf32 ? utf32 + count : NULL, utf32_cap - count);
 	}
 	// Last paragraph
 	const skb_text_t* last_paragraph_text = &rich_text->paragraphs[end_pos.paragraph_idx].text;
-	const int32_t last_count = skb_mini(end_pos.text_offset, skb_text_get_utf32_count(last_paragraph_text));
-	count += skb_utf32_copy(skb_text_get_utf32(last_paragraph_text), last_count, utf32 + count, utf32_cap - count);
+	const skb_range_t last_range = { .start = 0, .end = end_pos.text_offset };
+	count += skb_text_get_utf32_in_range(last_paragraph_text, last_range, utf32 ? utf32 + count : NULL, utf32_cap - count);
 
 	return count;
 }
@@ -440,8 +445,17 @@ skb_rich_text_change_t skb_rich_text_append_text_range(skb_rich_text_t* rich_tex
 
 	skb_range_t source_range = skb_text_get_range_from_text_range(source_text, source_text_range);
 
-	const uint32_t* utf32 = skb_text_get_utf32(source_text) + source_range.start;
 	const int32_t utf32_count = source_range.end - source_range.start;
+	// Decode compact text to temp buffer, so that the source text stays compact.
+	uint32_t* decoded_utf32 = NULL;
+	const uint32_t* utf32 = NULL;
+	if (skb_text_is_compact(source_text)) {
+		decoded_utf32 = SKB_TEMP_ALLOC(temp_alloc, uint32_t, skb_maxi(1, utf32_count));
+		skb_text_get_utf32_in_range(source_text, source_range, decoded_utf32, utf32_count);
+		utf32 = decoded_utf32;
+	} else {
+		utf32 = skb_text_get_utf32(source_text) + source_range.start;
+	}
 
 	int32_t inserted_paragraph_count = 0;
 	skb_range_t* inserted_paragraph_ranges = skb__split_text_into_paragraphs(temp_alloc, utf32, utf32_count, &inserted_paragraph_count);
@@ -501,7 +515,10 @@ skb_rich_text_change_t skb_rich_text_append_text_range(skb_rich_text_t* rich_tex
 	change.inserted_paragraph_count = rich_text->paragraphs_count - old_paragraph_count;
 	change.edit_end_position = (skb_text_position_t){.offset = text_offset - 1};
 
+	skb__rich_text_compact_paragraphs(rich_text, old_paragraph_count - 1, rich_text->paragraphs_count);
+
 	SKB_TEMP_FREE(temp_alloc, inserted_paragraph_ranges);
+	SKB_TEMP_FREE(temp_alloc, decoded_utf32);
 
 	return change;
 }
@@ -593,12 +610,228 @@ skb_rich_text_change_t skb_rich_text_append_utf32_with_payload(skb_rich_text_t*
 	change.inserted_paragraph_count = rich_text->paragraphs_count - old_paragraph_count;
 	change.edit_end_position = (skb_text_position_t){.offset = text_offset - 1};
 
+	skb__rich_text_compact_paragraphs(rich_text, old_paragraph_count - 1, rich_text->paragraphs_count);
+
 	SKB_TEMP_FREE(temp_alloc, inserted_paragraph_ranges);
 
 	return change;
 }
 
 
+//
+// Rich text builder
+//
+
+skb_rich_text_builder_t skb_rich_text_builder_begin(skb_rich_text_t* rich_text, skb_temp_alloc_t* temp_alloc)
+{
+	assert(rich_text);
+
+	return (skb_rich_text_builder_t) {
+		.rich_text = rich_text,
+		.temp_alloc = temp_alloc,
+		.start_paragraphs_count = rich_text->paragraphs_count,
+	};
+}
+
+// Returns builder for the last paragraph, the builder is started lazily so that the existing last paragraph is changed only if text is appended to it.
+static skb_text_builder_t* skb__rich_text_builder_get_paragraph_builder(skb_rich_text_builder_t* builder)
+{
+	skb_rich_text_t* rich_text = builder->rich_text;
+
+	if (!builder->paragraph_builder.text) {
+		if (rich_text->paragraphs_count == 0) {
+			SKB_ARRAY_RESERVE(rich_text->paragraphs, rich_text->paragraphs_count + 1);
+			skb_text_paragraph_t* new_paragraph = &rich_text->paragraphs[rich_text->paragraphs_count++];
+			skb__text_paragraph_init(rich_text, new_paragraph, (skb_attribute_set_t){0});
+		}
+		skb_text_paragraph_t* last_paragraph = &rich_text->paragraphs[rich_text->paragraphs_count - 1];
+		// Mark as changed
+		last_paragraph->version = ++rich_text->version_counter;
+		builder->paragraph_builder = skb_text_builder_begin(&last_paragraph->text);
+	}
+
+	return &builder->paragraph_builder;
+}
+
+// Finishes the last paragraph and starts a new one.
+static void skb__rich_text_builder_add_paragraph(skb_rich_text_builder_t* builder, skb_attribute_set_t paragraph_attributes)
+{
+	skb_rich_text_t* rich_text = builder->rich_text;
+
+	// Finish before adding the paragraph, as the paragraphs may get reallocated.
+	skb_text_builder_finish(&builder->paragraph_builder);
+
+	int32_t text_offset = 0;
+	if (rich_text->paragraphs_count > 0) {
+		const skb_text_paragraph_t* last_paragraph = &rich_text->paragraphs[rich_text->paragraphs_count - 1];
+		text_offset = last_paragraph->global_text_offset + skb_text_get_utf32_count(&last_paragraph->text);
+	}
+
+	// Note: the attributes may point to the attributes of the last paragraph, which are not moved by the reserve.
+	SKB_ARRAY_RESERVE(rich_text->paragraphs, rich_text->paragraphs_count + 1);
+	skb_text_paragraph_t* new_paragraph = &rich_text->paragraphs[rich_text->paragraphs_count++];
+	skb__text_paragraph_init(rich_text, new_paragraph, paragraph_attributes);
+	new_paragraph->global_text_offset = text_offset;
+
+	builder->paragraph_builder = skb_text_builder_begin(&new_paragraph->text);
+}
+
+void skb_rich_text_builder_append_paragraph(skb_rich_text_builder_t* builder, skb_attribute_set_t paragraph_attributes)
+{
+	assert(builder && builder->rich_text);
+	skb__rich_text_builder_add_paragraph(builder, paragraph_attributes);
+}
+
+void skb_rich_text_builder_append_text(skb_rich_text_builder_t* builder, const skb_text_t* source_text)
+{
+	assert(source_text);
+
+	const skb_text_range_t text_range = {
+		.start.offset = 0,
+		.end.offset = skb_text_get_utf32_count(source_text),
+	};
+	skb_rich_text_builder_append_text_range(builder, source_text, text_range);
+}
+
+void skb_rich_text_builder_append_text_range(skb_rich_text_builder_t* builder, const skb_text_t* source_text, skb_text_range_t source_text_range)
+{
+	assert(builder && builder->rich_text);
+	assert(source_text);
+
+	const skb_range_t source_range = skb_text_get_range_from_text_range(source_text, source_text_range);
+
+	// Decode compact text to temp buffer, so that the source text stays compact.
+	uint32_t* decoded_utf32 = NULL;
+	const uint32_t* utf32 = NULL;
+	if (skb_text_is_compact(source_text)) {
+		const int32_t utf32_count = source_range.end - source_range.start;
+		decoded_utf32 = SKB_TEMP_ALLOC(builder->temp_alloc, uint32_t, skb_maxi(1, utf32_count));
+		skb_text_get_utf32_in_range(source_text, source_range, decoded_utf32, utf32_count);
+		utf32 = decoded_utf32;
+	} else {
+		utf32 = skb_text_get_utf32(source_text) + source_range.start;
+	}
+
+	skb_text_builder_t* paragraph_builder = skb__rich_text_builder_get_paragraph_builder(builder);
+
+	int32_t start_offset = source_range.start;
+	int32_t offset = source_range.start;
+	while (offset < source_range.end) {
+		const uint32_t cp = utf32[offset - source_range.start];
+		if (skb_is_paragraph_separator(cp)) {
+			// Handle CRLF
+			if (offset + 1 < source_range.end && cp == SKB_CHAR_CARRIAGE_RETURN && utf32[offset + 1 - source_range.start] == SKB_CHAR_LINE_FEED)
+				offset++; // Skip over CR
+			offset++; // Skip over the separator
+
+			const skb_text_range_t paragraph_range = { .start.offset = start_offset, .end.offset = offset };
+			skb_text_builder_append_range(paragraph_builder, source_text, paragraph_range);
+
+			const skb_text_paragraph_t* last_paragraph = &builder->rich_text->paragraphs[builder->rich_text->paragraphs_count - 1];
+			skb__rich_text_builder_add_paragraph(builder, skb__text_paragraph_get_attributes(last_paragraph));
+			start_offset = offset;
+		} else {
+			offset++;
+		}
+	}
+
+	// The rest
+	const skb_text_range_t paragraph_range = { .start.offset = start_offset, .end.offset = source_range.end };
+	skb_text_builder_append_range(paragraph_builder, source_text, paragraph_range);
+
+	SKB_TEMP_FREE(builder->temp_alloc, decoded_utf32);
+}
+
+void skb_rich_text_builder_append_utf8(skb_rich_text_builder_t* builder, const char* utf8, int32_t utf8_count, skb_attribute_set_t attributes)
+{
+	skb_rich_text_builder_append_utf8_with_payload(builder, utf8, utf8_count, attributes, 0, NULL);
+}
+
+void skb_rich_text_builder_append_utf8_with_payload(skb_rich_text_builder_t* builder, const char* utf8, int32_t utf8_count, skb_attribute_set_t attributes, uint8_t span_flags, const skb_data_blob_t* payload)
+{
+	assert(builder && builder->rich_text);
+	assert(utf8);
+
+	if (utf8_count < 0) utf8_count = (int32_t)strlen(utf8);
+
+	const int32_t utf32_count = skb_utf8_to_utf32(utf8, utf8_count, NULL, 0);
+	uint32_t* utf32 = SKB_TEMP_ALLOC(builder->temp_alloc, uint32_t, utf32_count);
+	skb_utf8_to_utf32(utf8, utf8_count, utf32, utf32_count);
+
+	skb_rich_text_builder_append_utf32_with_payload(builder, utf32, utf32_count, attributes, span_flags, payload);
+
+	SKB_TEMP_FREE(builder->temp_alloc, utf32);
+}
+
+void skb_rich_text_builder_append_utf32(skb_rich_text_builder_t* builder, const uint32_t* utf32, int32_t utf32_count, skb_attribute_set_t attributes)
+{
+	skb_rich_text_builder_append_utf32_with_payload(builder, utf32, utf32_count, attributes, 0, NULL);
+}
+
+void skb_rich_text_builder_append_utf32_with_payload(skb_rich_text_builder_t* builder, const uint32_t* utf32, int32_t utf32_count, skb_attribute_set_t attributes, uint8_t span_flags, const skb_data_blob_t* payload)
+{
+	assert(builder && builder->rich_text);
+
+	if (!utf32)
+		utf32_count = 0;
+	if (utf32_count == -1)
+		utf32_count = skb_utf32_strlen(utf32);
+
+	skb_text_builder_t* paragraph_builder = skb__rich_text_builder_get_paragraph_builder(builder);
+
+	int32_t start_offset = 0;
+	int32_t offset = 0;
+	while (offset < utf32_count) {
+		if (skb_is_paragraph_separator(utf32[offset])) {
+			// Handle CRLF
+			if (offset + 1 < utf32_count && utf32[offset] == SKB_CHAR_CARRIAGE_RETURN && utf32[offset + 1] == SKB_CHAR_LINE_FEED)
+				offset++; // Skip over CR
+			offset++; // Skip over the separator
+
+			skb_text_builder_append_utf32_with_payload(paragraph_builder, utf32 + start_offset, offset - start_offset, attributes, span_flags, payload);
+
+			const skb_text_paragraph_t* last_paragraph = &builder->rich_text->paragraphs[builder->rich_text->paragraphs_count - 1];
+			skb__rich_text_builder_add_paragraph(builder, skb__text_paragraph_get_attributes(last_paragraph));
+			start_offset = offset;
+		} else {
+			offset++;
+		}
+	}
+
+	// The rest
+	if (utf32)
+		skb_text_builder_append_utf32_with_payload(paragraph_builder, utf32 + start_offset, utf32_count - start_offset, attributes, span_flags, payload);
+}
+
+skb_rich_text_change_t skb_rich_text_builder_finish(skb_rich_text_builder_t* builder)
+{
+	assert(builder);
+
+	skb_rich_text_t* rich_text = builder->rich_text;
+	if (!rich_text)
+		return (skb_rich_text_change_t){0};
+
+	skb_text_builder_finish(&builder->paragraph_builder);
+
+	int32_t text_offset = 0;
+	if (rich_text->paragraphs_count > 0) {
+		const skb_text_paragraph_t* last_paragraph = &rich_text->paragraphs[rich_text->paragraphs_count - 1];
+		text_offset = last_paragraph->global_text_offset + skb_text_get_utf32_count(&last_paragraph->text);
+	}
+
+	const skb_rich_text_change_t change = {
+		.start_paragraph_idx = builder->start_paragraphs_count,
+		.inserted_paragraph_count = rich_text->paragraphs_count - builder->start_paragraphs_count,
+		.edit_end_position = {.offset = text_offset - 1},
+	};
+
+	skb__rich_text_compact_paragraphs(rich_text, builder->start_paragraphs_count - 1, rich_text->paragraphs_count);
+
+	SKB_ZERO_STRUCT(builder);
+
+	return change;
+}
+
 static skb_rich_text_change_t skb__rich_text_replace(
 	skb_rich_text_t* rich_text, skb_text_range_t text_range,
 	const skb_text_paragraph_t* source_paragraphs, int32_t source_paragraphs_count,
@@ -1250,6 +1483,10 @@ void skb_rich_text_remove_if(skb_rich_text_t* rich_text, skb_rich_text_remove_fu
 	assert(filter_func);
 
 	for (int32_t pi = 0; pi < rich_text->paragraphs_count; pi++) {
+		// The filter iterates over all codepoints, expand compact paragraph for the duration of the filtering.
+		const bool was_compact = skb_text_is_compact(&rich_text->paragraphs[pi].text);
+		skb_text_expand(&rich_text->paragraphs[pi].text);
+
 		const uint32_t* utf32 = skb_text_get_utf32(&rich_text->paragraphs[pi].text);
 		int32_t utf32_count = skb_text_get_utf32_count(&rich_text->paragraphs[pi].text);
 		int32_t global_text_offset = rich_text->paragraphs[pi].global_text_offset;
@@ -1276,9 +1513,282 @@ void skb_rich_text_remove_if(skb_rich_text_t* rich_text, skb_rich_text_remove_fu
 		if (remove_start != SKB_INVALID_INDEX) {
 			skb_rich_text_change_t change = skb_rich_text_remove(rich_text, (skb_text_range_t){.start.offset = global_text_offset + remove_start, .end.offset = global_text_offset + utf32_count});
 			// We removed the very end of the paragraph, the next paragraph will get merged to this one, so filter the paragraph again.
-			if (change.removed_paragraph_count > change.inserted_paragraph_count)
+			if (change.removed_paragraph_count > change.inserted_paragraph_count) {
 				pi--;
+				continue;
+			}
 		}
+
+		if (was_compact)
+			skb__rich_text_compact_paragraphs(rich_text, pi, pi + 1);
+	}
+}
+
+//
+// Diff
+//
+
+static uint64_t skb__text_paragraph_get_hash(const skb_text_paragraph_t* paragraph)
+{
+	uint64_t hash = skb_hash64_empty();
+
+	hash = skb_text_hash_append(hash, &paragraph->text);
+	hash = skb_attributes_hash_append(hash, skb__text_paragraph_get_attributes(paragraph));
+
+	return hash;
+}
+
+// Hashes are used to find the candidates, and equal hashes are confirmed by comparing the contents.
+static bool skb__text_paragraphs_equal(const skb_text_paragraph_t* paragraph, uint64_t hash, const skb_text_paragraph_t* other_paragraph, uint64_t other_hash)
+{
+	if (hash != other_hash)
+		return false;
+	if (paragraph->attributes_count != other_paragraph->attributes_count)
+		return false;
+	if (paragraph->attributes_count > 0 && memcmp(paragraph->attributes, other_paragraph->attributes, sizeof(skb_attribute_t) * paragraph->attributes_count) != 0)
+		return false;
+	return skb_text_equals(&paragraph->text, &other_paragraph->text);
+}
+
+typedef struct skb__diff_context_t {
+	skb_rich_text_diff_t* diffs;
+	int32_t diffs_count;
+	int32_t diffs_cap;
+	// Pending deleted and inserted paragraphs, combined into modify when flushed.
+	int32_t deleted_start;
+	int32_t deleted_count;
+	int32_t inserted_start;
+	int32_t inserted_count;
+} skb__diff_context_t;
+
+static void skb__diff_emit(skb__diff_context_t* ctx, skb_rich_text_diff_type_t type, int32_t old_idx, int32_t new_idx, int32_t count)
+{
+	if (count <= 0)
+		return;
+
+	// Merge with previous op if possible.
+	if (ctx->diffs_count > 0 && ctx->diffs_count <= ctx->diffs_cap) {
+		skb_rich_text_diff_t* prev = &ctx->diffs[ctx->diffs_count - 1];
+		const bool old_contiguous = type == SKB_RICH_TEXT_DIFF_INSERT || prev->old_paragraph_idx + prev->paragraph_count == old_idx;
+		const bool new_contiguous = type == SKB_RICH_TEXT_DIFF_DELETE || prev->new_paragraph_idx + prev->paragraph_count == new_idx;
+		if (prev->type == type && old_contiguous && new_contiguous) {
+			prev->paragraph_count += count;
+			return;
+		}
+	}
+
+	if (ctx->diffs_count < ctx->diffs_cap) {
+		ctx->diffs[ctx->diffs_count] = (skb_rich_text_diff_t) {
+			.type = (uint8_t)type,
+			.old_paragraph_idx = old_idx,
+			.new_paragraph_idx = new_idx,
+			.paragraph_count = count,
+		};
+	}
+	ctx->diffs_count++;
+}
+
+static void skb__diff_flush_changes(skb__diff_context_t* ctx)
+{
+	// Pair deleted and inserted paragraphs as modified, so that the paragraphs can be updated in place.
+	const int32_t modified_count = skb_mini(ctx->deleted_count, ctx->inserted_count);
+	skb__diff_emit(ctx, SKB_RICH_TEXT_DIFF_MODIFY, ctx->deleted_start, ctx->inserted_start, modified_count);
+	skb__diff_emit(ctx, SKB_RICH_TEXT_DIFF_DELETE, ctx->deleted_start + modified_count, ctx->inserted_start + modified_count, ctx->deleted_count - modified_count);
+	skb__diff_emit(ctx, SKB_RICH_TEXT_DIFF_INSERT, ctx->deleted_start + modified_count, ctx->inserted_start + modified_count, ctx->inserted_count - modified_count);
+	ctx->deleted_count = 0;
+	ctx->inserted_count = 0;
+}
+
+static void skb__diff_delete(skb__diff_context_t* ctx, int32_t old_idx, int32_t new_idx)
+{
+	if (ctx->deleted_count == 0 && ctx->inserted_count == 0) {
+		ctx->deleted_start = old_idx;
+		ctx->inserted_start = new_idx;
+	}
+	ctx->deleted_count++;
+}
+
+static void skb__diff_insert(skb__diff_context_t* ctx, int32_t old_idx, int32_t new_idx)
+{
+	if (ctx->deleted_count == 0 && ctx->inserted_count == 0) {
+		ctx->deleted_start = old_idx;
+		ctx->inserted_start = new_idx;
+	}
+	ctx->inserted_count++;
+}
+
+static void skb__diff_equal(skb__diff_context_t* ctx, int32_t old_idx, int32_t new_idx, int32_t count)
+{
+	skb__diff_flush_changes(ctx);
+	skb__diff_emit(ctx, SKB_RICH_TEXT_DIFF_EQUAL, old_idx, new_idx, count);
+}
+
+// Max number of cells in the LCS table, larger changes are treated as modified paragraphs.
+#define SKB__MAX_DIFF_TABLE_SIZE (1 << 22)
+
+int32_t skb_rich_text_diff(const skb_rich_text_t* rich_text, skb_temp_alloc_t* temp_alloc, const skb_rich_text_t* new_rich_text, skb_rich_text_diff_t* diffs, int32_t diffs_cap)
+{
+	assert(rich_text);
+	assert(new_rich_text);
+
+	skb__diff_context_t ctx = {
+		.diffs = diffs,
+		.diffs_cap = diffs ? diffs_cap : 0,
+	};
+
+	const int32_t old_count = rich_text->paragraphs_count;
+	const int32_t new_count = new_rich_text->paragraphs_count;
+
+	uint64_t* old_hashes = SKB_TEMP_ALLOC(temp_alloc, uint64_t, old_count);
+	uint64_t* new_hashes = SKB_TEMP_ALLOC(temp_alloc, uint64_t, new_count);
+	for (int32_t i = 0; i < old_count; i++)
+		old_hashes[i] = skb__text_paragraph_get_hash(&rich_text->paragraphs[i]);
+	for (int32_t i = 0; i < new_count; i++)
+		new_hashes[i] = skb__text_paragraph_get_hash(&new_rich_text->paragraphs[i]);
+
+	// Skip common prefix and suffix, usually only a small portion of the text changes.
+	int32_t prefix_count = 0;
+	while (prefix_count < old_count && prefix_count < new_count
+		&& skb__text_paragraphs_equal(&rich_text->paragraphs[prefix_count], old_hashes[prefix_count], &new_rich_text->paragraphs[prefix_count], new_hashes[prefix_count]))
+		prefix_count++;
+	int32_t suffix_count = 0;
+	while (suffix_count < (old_count - prefix_count) && suffix_count < (new_count - prefix_count)
+		&& skb__text_paragraphs_equal(&rich_text->paragraphs[old_count - 1 - suffix_count], old_hashes[old_count - 1 - suffix_count],
+			&new_rich_text->paragraphs[new_count - 1 - suffix_count], new_hashes[new_count - 1 - suffix_count]))
+		suffix_count++;
+
+	skb__diff_equal(&ctx, 0, 0, prefix_count);
+
+	const int32_t old_mid_count = old_count - prefix_count - suffix_count;
+	const int32_t new_mid_count = new_count - prefix_count - suffix_count;
+	const uint64_t* old_mid = old_hashes + prefix_count;
+	const uint64_t* new_mid = new_hashes + prefix_count;
+	const skb_text_paragraph_t* old_mid_paragraphs = rich_text->paragraphs + prefix_count;
+	const skb_text_paragraph_t* new_mid_paragraphs = new_rich_text->paragraphs + prefix_count;
+
+	if (old_mid_count > 0 && new_mid_count > 0 && (int64_t)(old_mid_count + 1) * (int64_t)(new_mid_count + 1) <= SKB__MAX_DIFF_TABLE_SIZE) {
+		// Longest common subsequence of the remaining paragraphs. lcs[i][j] is the LCS length of old_mid[i..] and new_mid[j..].
+		const int32_t stride = new_mid_count + 1;
+		int32_t* lcs = SKB_TEMP_ALLOC(temp_alloc, int32_t, (old_mid_count + 1) * stride);
+		for (int32_t j = 0; j <= new_mid_count; j++)
+			lcs[old_mid_count * stride + j] = 0;
+		for (int32_t i = old_mid_count - 1; i >= 0; i--) {
+			lcs[i * stride + new_mid_count] = 0;
+			for (int32_t j = new_mid_count - 1; j >= 0; j--) {
+				if (skb__text_paragraphs_equal(&old_mid_paragraphs[i], old_mid[i], &new_mid_paragraphs[j], new_mid[j]))
+					lcs[i * stride + j] = lcs[(i + 1) * stride + (j + 1)] + 1;
+				else
+					lcs[i * stride + j] = skb_maxi(lcs[(i + 1) * stride + j], lcs[i * stride + (j + 1)]);
+			}
+		}
+
+		int32_t i = 0;
+		int32_t j = 0;
+		while (i < old_mid_count || j < new_mid_count) {
+			if (i < old_mid_count && j < new_mid_count && skb__text_paragraphs_equal(&old_mid_paragraphs[i], old_mid[i], &new_mid_paragraphs[j], new_mid[j])) {
+				skb__diff_equal(&ctx, prefix_count + i, prefix_count + j, 1);
+				i++;
+				j++;
+			} else if (j >= new_mid_count || (i < old_mid_count && lcs[(i + 1) * stride + j] >= lcs[i * stride + (j + 1)])) {
+				skb__diff_delete(&ctx, prefix_count + i, prefix_count + j);
+				i++;
+			} else {
+				skb__diff_insert(&ctx, prefix_count + i, prefix_count + j);
+				j++;
+			}
+		}
+
+		SKB_TEMP_FREE(temp_alloc, lcs);
+	} else {
+		for (int32_t i = 0; i < old_mid_count; i++)
+			skb__diff_delete(&ctx, prefix_count + i, prefix_count);
+		for (int32_t j = 0; j < new_mid_count; j++)
+			skb__diff_insert(&ctx, prefix_count + old_mid_count, prefix_count + j);
+	}
+
+	skb__diff_equal(&ctx, old_count - suffix_count, new_count - suffix_count, suffix_count);
+	skb__diff_flush_changes(&ctx);
+
+	SKB_TEMP_FREE(temp_alloc, new_hashes);
+	SKB_TEMP_FREE(temp_alloc, old_hashes);
+
+	return ctx.diffs_count;
+}
+
+static void skb__text_paragraph_copy(skb_rich_text_t* rich_text, skb_text_paragraph_t* text_paragraph, const skb_text_paragraph_t* source_paragraph)
+{
+	skb_text_reset(&text_paragraph->text);
+	skb_text_append(&text_paragraph->text, &source_paragraph->text);
+	skb__text_paragraph_copy_attributes(text_paragraph, skb__text_paragraph_get_attributes(source_paragraph));
+	text_paragraph->version = ++rich_text->version_counter;
+}
+
+void skb_rich_text_apply_patch(
+	skb_rich_text_t* rich_text, const skb_rich_text_t* new_rich_text, const skb_rich_text_diff_t* diffs, int32_t diffs_count,
+	skb_rich_text_change_func_t* change_func, void* context)
+{
+	assert(rich_text);
+	assert(new_rich_text);
+	assert(diffs || diffs_count == 0);
+
+	// Index of the current paragraph in the patched text.
+	int32_t paragraph_idx = 0;
+
+	for (int32_t di = 0; di < diffs_count; di++) {
+		const skb_rich_text_diff_t* diff = &diffs[di];
+		const int32_t count = diff->paragraph_count;
+		assert(paragraph_idx + (diff->type == SKB_RICH_TEXT_DIFF_INSERT ? 0 : count) <= rich_text->paragraphs_count);
+		assert(diff->type == SKB_RICH_TEXT_DIFF_DELETE || diff->new_paragraph_idx + count <= new_rich_text->paragraphs_count);
+
+		skb_rich_text_change_t change = {
+			.start_paragraph_idx = paragraph_idx,
+		};
+
+		if (diff->type == SKB_RICH_TEXT_DIFF_EQUAL) {
+			// Keep the paragraphs and their versions.
+			paragraph_idx += count;
+			continue;
+		}
+
+		if (diff->type == SKB_RICH_TEXT_DIFF_MODIFY) {
+			for (int32_t i = 0; i < count; i++)
+				skb__text_paragraph_copy(rich_text, &rich_text->paragraphs[paragraph_idx + i], &new_rich_text->paragraphs[diff->new_paragraph_idx + i]);
+			change.removed_paragraph_count = count;
+			change.inserted_paragraph_count = count;
+			paragraph_idx += count;
+		} else if (diff->type == SKB_RICH_TEXT_DIFF_DELETE) {
+			for (int32_t i = 0; i < count; i++)
+				skb__text_paragraph_clear(&rich_text->paragraphs[paragraph_idx + i]);
+			const int32_t tail_count = rich_text->paragraphs_count - (paragraph_idx + count);
+			if (tail_count > 0)
+				memmove(rich_text->paragraphs + paragraph_idx, rich_text->paragraphs + paragraph_idx + count, tail_count * sizeof(skb_text_paragraph_t));
+			rich_text->paragraphs_count -= count;
+			change.removed_paragraph_count = count;
+		} else if (diff->type == SKB_RICH_TEXT_DIFF_INSERT) {
+			SKB_ARRAY_RESERVE(rich_text->paragraphs, rich_text->paragraphs_count + count);
+			const int32_t tail_count = rich_text->paragraphs_count - paragraph_idx;
+			if (tail_count > 0)
+				memmove(rich_text->paragraphs + paragraph_idx + count, rich_text->paragraphs + paragraph_idx, tail_count * sizeof(skb_text_paragraph_t));
+			rich_text->paragraphs_count += count;
+			for (int32_t i = 0; i < count; i++) {
+				const skb_text_paragraph_t* source_paragraph = &new_rich_text->paragraphs[diff->new_paragraph_idx + i];
+				skb_text_paragraph_t* paragraph = &rich_text->paragraphs[paragraph_idx + i];
+				skb__text_paragraph_init(rich_text, paragraph, skb__text_paragraph_get_attributes(source_paragraph));
+				skb_text_append(&paragraph->text, &source_paragraph->text);
+			}
+			change.inserted_paragraph_count = count;
+			paragraph_idx += count;
+		}
+
+		if (change_func)
+			change_func(change, context);
+	}
+
+	// Update start offsets.
+	int32_t global_text_offset = 0;
+	for (int32_t i = 0; i < rich_text->paragraphs_count; i++) {
+		rich_text->paragraphs[i].global_text_offset = global_text_offset;
+		global_text_offset += skb_text_get_utf32_count(&rich_text->paragraphs[i].text);
 	}
 }
 
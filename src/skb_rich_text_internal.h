@@ -22,6 +22,7 @@ typedef struct skb_rich_text_t {
 	int32_t paragraphs_cap;
 
 	uint32_t version_counter;
+	bool compact_storage;			// If true, appended paragraphs are stored in compact form, see skb_rich_text_set_compact_storage().
 	uint8_t should_free_instance;
 } skb_rich_text_t;
 
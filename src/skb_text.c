@@ -5,11 +5,71 @@
 #include "skb_text_internal.h"
 
 #include <assert.h>
+#include <stddef.h>
 #include <string.h>
 
 #include "graphemebreak.h"
 #include "skb_attribute_collection.h"
 
+// Number of codepoints between checkpoints in compact text.
+#define SKB__TEXT_CHECKPOINT_INTERVAL 256
+
+// The codepoints of heap allocated text are stored in a reference counted buffer, so that layouts can share them without copying.
+// The text copies the buffer before modifying it if it is shared, see skb_text_acquire_shared_utf32().
+typedef struct skb__text_buffer_t {
+	volatile int32_t ref_count;
+	uint32_t utf32[];
+} skb__text_buffer_t;
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+static inline int32_t skb__atomic_add_i32(volatile int32_t* value, int32_t delta)
+{
+	return (int32_t)_InterlockedExchangeAdd((volatile long*)value, delta) + delta;
+}
+static inline int32_t skb__atomic_load_i32(volatile int32_t* value)
+{
+	return (int32_t)_InterlockedOr((volatile long*)value, 0);
+}
+#else
+static inline int32_t skb__atomic_add_i32(volatile int32_t* value, int32_t delta)
+{
+	return __atomic_add_fetch(value, delta, __ATOMIC_ACQ_REL);
+}
+static inline int32_t skb__atomic_load_i32(volatile int32_t* value)
+{
+	return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+#endif
+
+static skb__text_buffer_t* skb__text_buffer_from_utf32(const uint32_t* utf32)
+{
+	return (skb__text_buffer_t*)((uintptr_t)utf32 - offsetof(skb__text_buffer_t, utf32));
+}
+
+const uint32_t* skb_text_acquire_shared_utf32(const skb_text_t* text)
+{
+	// Temp allocated text is short lived, and compact text has no utf-32 buffer to share.
+	if (!text || !text->text || text->temp_alloc || text->is_compact)
+		return NULL;
+	skb__atomic_add_i32(&skb__text_buffer_from_utf32(text->text)->ref_count, 1);
+	return text->text;
+}
+
+void skb_text_retain_shared_utf32(const uint32_t* utf32)
+{
+	assert(utf32);
+	skb__atomic_add_i32(&skb__text_buffer_from_utf32(utf32)->ref_count, 1);
+}
+
+void skb_text_release_shared_utf32(const uint32_t* utf32)
+{
+	if (!utf32) return;
+	skb__text_buffer_t* buffer = skb__text_buffer_from_utf32(utf32);
+	if (skb__atomic_add_i32(&buffer->ref_count, -1) == 0)
+		skb_free(buffer);
+}
+
 skb_text_t* skb_text_create(void)
 {
 	skb_text_t* result = skb_malloc(sizeof(skb_text_t));
@@ -38,6 +98,10 @@ void skb_text_destroy(skb_text_t* text)
 {
 	if (!text) return;
 
+	skb_free(text->utf8);
+	skb_free(text->utf8_checkpoints);
+	skb_free(text->utf8_grapheme_breaks);
+
 	skb_temp_alloc_t* temp_alloc = text->temp_alloc;
 	if (temp_alloc) {
 		for (int32_t i = 0; i < text->spans_count; i++)
@@ -48,7 +112,7 @@ void skb_text_destroy(skb_text_t* text)
 	} else {
 		for (int32_t i = 0; i < text->spans_count; i++)
 			skb_data_blob_destroy(text->spans[i].payload);
-		skb_free(text->text);
+		skb_text_release_shared_utf32(text->text);
 		skb_free(text->text_props);
 		skb_free(text->spans);
 	}
@@ -67,12 +131,24 @@ void skb_text_destroy(skb_text_t* text)
 void skb_text_reset(skb_text_t* text)
 {
 	assert(text);
+	if (text->is_compact) {
+		skb_free(text->utf8);
+		skb_free(text->utf8_checkpoints);
+		skb_free(text->utf8_grapheme_breaks);
+		text->utf8 = NULL;
+		text->utf8_count = 0;
+		text->utf8_checkpoints = NULL;
+		text->utf8_grapheme_breaks = NULL;
+		text->is_compact = false;
+	}
 	text->text_count = 0;
 	text->spans_count = 0;
+	text->text_version++;
 }
 
 static void skb__text_reserve(skb_text_t* text, int32_t text_count)
 {
+	text->text_version++;
 	if (text->temp_alloc) {
 		if (text_count > text->text_cap) {
 			const int32_t new_cap = skb_maxi(text_count, text->text_cap ? (text->text_cap + text->text_cap / 2) : 4);
@@ -84,14 +160,28 @@ static void skb__text_reserve(skb_text_t* text, int32_t text_count)
 			text->text_cap = new_cap;
 		}
 	} else {
-		if (text_count > text->text_cap) {
-			const int32_t new_cap = skb_maxi(text_count, text->text_cap ? (text->text_cap + text->text_cap / 2) : 4);
-			text->text = skb_realloc(text->text, sizeof(text->text[0]) * new_cap);
-			text->text_props = skb_realloc(text->text_props, sizeof(text->text_props[0]) * new_cap);
-			assert(text->text);
-			memset(&text->text[text->text_cap], 0, sizeof((text->text)[0]) * (new_cap - text->text_cap));
-			memset(&text->text_props[text->text_cap], 0, sizeof((text->text_props)[0]) * (new_cap - text->text_cap));
-			text->text_cap = new_cap;
+		// Copy on write if the codepoints are shared with a layout.
+		const bool is_shared = text->text && skb__atomic_load_i32(&skb__text_buffer_from_utf32(text->text)->ref_count) > 1;
+		if (text_count > text->text_cap || is_shared) {
+			const int32_t new_cap = text_count > text->text_cap ? skb_maxi(text_count, text->text_cap ? (text->text_cap + text->text_cap / 2) : 4) : text->text_cap;
+			skb__text_buffer_t* buffer = NULL;
+			if (is_shared) {
+				buffer = skb_malloc(sizeof(skb__text_buffer_t) + sizeof(text->text[0]) * new_cap);
+				assert(buffer);
+				memcpy(buffer->utf32, text->text, sizeof(text->text[0]) * text->text_cap);
+				skb_text_release_shared_utf32(text->text);
+			} else {
+				buffer = skb_realloc(text->text ? skb__text_buffer_from_utf32(text->text) : NULL, sizeof(skb__text_buffer_t) + sizeof(text->text[0]) * new_cap);
+				assert(buffer);
+			}
+			buffer->ref_count = 1;
+			text->text = buffer->utf32;
+			if (new_cap > text->text_cap) {
+				text->text_props = skb_realloc(text->text_props, sizeof(text->text_props[0]) * new_cap);
+				memset(&text->text[text->text_cap], 0, sizeof((text->text)[0]) * (new_cap - text->text_cap));
+				memset(&text->text_props[text->text_cap], 0, sizeof((text->text_props)[0]) * (new_cap - text->text_cap));
+				text->text_cap = new_cap;
+			}
 		}
 	}
 }
@@ -108,10 +198,161 @@ static void skb__spans_reserve(skb_text_t* text, int32_t spans_count)
 void skb_text_reserve(skb_text_t* text, int32_t text_count, int32_t spans_count)
 {
 	assert(text);
+	skb_text_expand(text);
 	skb__text_reserve(text, text_count);
 	skb__spans_reserve(text, spans_count);
 }
 
+//
+// Compact storage
+//
+
+void skb_text_compact(skb_text_t* text)
+{
+	assert(text);
+
+	if (text->is_compact || text->temp_alloc || text->text_count == 0)
+		return;
+
+	// Only valid codepoints survive the round trip via utf-8.
+	int32_t utf8_count = 0;
+	for (int32_t i = 0; i < text->text_count; i++) {
+		const uint32_t cp = text->text[i];
+		if (cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff))
+			return;
+		utf8_count += skb_utf8_num_units(cp);
+	}
+
+	const int32_t checkpoints_count = (text->text_count + SKB__TEXT_CHECKPOINT_INTERVAL - 1) / SKB__TEXT_CHECKPOINT_INTERVAL;
+	char* utf8 = skb_malloc(utf8_count);
+	int32_t* checkpoints = skb_malloc(checkpoints_count * sizeof(int32_t));
+	uint8_t* grapheme_breaks = skb_malloc((text->text_count + 7) / 8);
+	memset(grapheme_breaks, 0, (text->text_count + 7) / 8);
+
+	int32_t offset = 0;
+	for (int32_t i = 0; i < text->text_count; i++) {
+		if ((i % SKB__TEXT_CHECKPOINT_INTERVAL) == 0)
+			checkpoints[i / SKB__TEXT_CHECKPOINT_INTERVAL] = offset;
+		offset += skb_utf8_encode(text->text[i], utf8 + offset, utf8_count - offset);
+		if (text->text_props[i] & SKB_TEXT_PROP_GRAPHEME_BREAK)
+			grapheme_breaks[i / 8] |= (uint8_t)(1 << (i % 8));
+	}
+	assert(offset == utf8_count);
+
+	skb_text_release_shared_utf32(text->text);
+	skb_free(text->text_props);
+	text->text = NULL;
+	text->text_props = NULL;
+	text->text_cap = 0;
+
+	text->utf8 = utf8;
+	text->utf8_count = utf8_count;
+	text->utf8_checkpoints = checkpoints;
+	text->utf8_grapheme_breaks = grapheme_breaks;
+	text->is_compact = true;
+	text->text_version++;
+}
+
+bool skb_text_is_compact(const skb_text_t* text)
+{
+	return text ? text->is_compact : false;
+}
+
+void skb_text_expand(skb_text_t* text)
+{
+	if (!text || !text->is_compact)
+		return;
+
+	const int32_t text_count = text->text_count;
+	skb__text_reserve(text, text_count);
+	skb_utf8_to_utf32(text->utf8, text->utf8_count, text->text, text_count);
+	for (int32_t i = 0; i < text_count; i++)
+		text->text_props[i] = (text->utf8_grapheme_breaks[i / 8] & (1 << (i % 8))) ? SKB_TEXT_PROP_GRAPHEME_BREAK : 0;
+
+	skb_free(text->utf8);
+	skb_free(text->utf8_checkpoints);
+	skb_free(text->utf8_grapheme_breaks);
+	text->utf8 = NULL;
+	text->utf8_count = 0;
+	text->utf8_checkpoints = NULL;
+	text->utf8_grapheme_breaks = NULL;
+	text->is_compact = false;
+}
+
+// Returns utf-8 offset of a codepoint in compact text.
+static int32_t skb__text_get_utf8_offset(const skb_text_t* text, int32_t text_offset)
+{
+	assert(text->is_compact);
+	if (text_offset >= text->text_count)
+		return text->utf8_count;
+
+	int32_t offset = text->utf8_checkpoints[text_offset / SKB__TEXT_CHECKPOINT_INTERVAL];
+	int32_t count = text_offset % SKB__TEXT_CHECKPOINT_INTERVAL;
+	while (count > 0) {
+		// Skip over continuation bytes.
+		offset++;
+		while (offset < text->utf8_count && (text->utf8[offset] & 0xc0) == 0x80)
+			offset++;
+		count--;
+	}
+	return offset;
+}
+
+int32_t skb_text_get_utf32_in_range(const skb_text_t* text, skb_range_t range, uint32_t* utf32, int32_t utf32_cap)
+{
+	if (!text)
+		return 0;
+
+	range.start = skb_clampi(range.start, 0, text->text_count);
+	range.end = skb_clampi(range.end, range.start, text->text_count);
+	const int32_t count = range.end - range.start;
+
+	if (text->is_compact) {
+		const int32_t start = skb__text_get_utf8_offset(text, range.start);
+		const int32_t end = skb__text_get_utf8_offset(text, range.end);
+		skb_utf8_to_utf32(text->utf8 + start, end - start, utf32, utf32 ? utf32_cap : 0);
+		return count;
+	}
+
+	return skb_utf32_copy(text->text + range.start, count, utf32, utf32 ? utf32_cap : 0);
+}
+
+int32_t skb_text_get_utf8_in_range(const skb_text_t* text, skb_range_t range, char* utf8, int32_t utf8_cap)
+{
+	if (!text)
+		return 0;
+
+	range.start = skb_clampi(range.start, 0, text->text_count);
+	range.end = skb_clampi(range.end, range.start, text->text_count);
+
+	if (text->is_compact) {
+		const int32_t start = skb__text_get_utf8_offset(text, range.start);
+		const int32_t end = skb__text_get_utf8_offset(text, range.end);
+		if (!utf8)
+			return end - start;
+		int32_t copy_count = skb_mini(end - start, utf8_cap);
+		// Do not split a codepoint.
+		if (copy_count < end - start) {
+			while (copy_count > 0 && (text->utf8[start + copy_count] & 0xc0) == 0x80)
+				copy_count--;
+		}
+		if (copy_count > 0)
+			memcpy(utf8, text->utf8 + start, copy_count);
+		return copy_count;
+	}
+
+	return skb_utf32_to_utf8(text->text + range.start, range.end - range.start, utf8, utf8_cap);
+}
+
+// Copies utf-32 text from source text, compact or not.
+static void skb__text_copy_utf32(const skb_text_t* source_text, int32_t offset, int32_t count, uint32_t* dest)
+{
+	if (source_text->is_compact)
+		skb_text_get_utf32_in_range(source_text, (skb_range_t){ .start = offset, .end = offset + count }, dest, count);
+	else
+		memcpy(dest, source_text->text + offset, count * sizeof(uint32_t));
+}
+
 int32_t skb_text_get_utf32_count(const skb_text_t* text)
 {
 	return text ? text->text_count : 0;
@@ -127,6 +368,63 @@ const uint8_t* skb_text_get_props(const skb_text_t* text)
 	return text ? text->text_props : NULL;
 }
 
+// Reads codepoints of compact text. Nearby offsets are found by stepping from the previous offset, others via the checkpoints.
+typedef struct skb__text_reader_t {
+	const skb_text_t* text;
+	int32_t offset;
+	int32_t utf8_offset;
+} skb__text_reader_t;
+
+static skb__text_reader_t skb__text_reader_make(const skb_text_t* text)
+{
+	return (skb__text_reader_t) { .text = text, .offset = -1 };
+}
+
+static uint32_t skb__text_reader_get(skb__text_reader_t* reader, int32_t offset)
+{
+	const skb_text_t* text = reader->text;
+	assert(offset >= 0 && offset < text->text_count);
+
+	if (!text->is_compact)
+		return text->text[offset];
+
+	if (reader->offset == -1 || skb_absi(offset - reader->offset) >= SKB__TEXT_CHECKPOINT_INTERVAL / 2) {
+		reader->offset = offset;
+		reader->utf8_offset = skb__text_get_utf8_offset(text, offset);
+	}
+	while (reader->offset < offset) {
+		reader->utf8_offset++;
+		while (reader->utf8_offset < text->utf8_count && (text->utf8[reader->utf8_offset] & 0xc0) == 0x80)
+			reader->utf8_offset++;
+		reader->offset++;
+	}
+	while (reader->offset > offset) {
+		reader->utf8_offset--;
+		while (reader->utf8_offset > 0 && (text->utf8[reader->utf8_offset] & 0xc0) == 0x80)
+			reader->utf8_offset--;
+		reader->offset--;
+	}
+
+	uint32_t cp = 0;
+	skb_utf8_to_utf32(text->utf8 + reader->utf8_offset, skb_mini(4, text->utf8_count - reader->utf8_offset), &cp, 1);
+	return cp;
+}
+
+uint32_t skb_text_get_codepoint(const skb_text_t* text, int32_t offset)
+{
+	if (!text || offset < 0 || offset >= text->text_count)
+		return 0;
+	skb__text_reader_t reader = skb__text_reader_make(text);
+	return skb__text_reader_get(&reader, offset);
+}
+
+static bool skb__text_is_grapheme_break(const skb_text_t* text, int32_t offset)
+{
+	if (text->is_compact)
+		return (text->utf8_grapheme_breaks[offset / 8] & (1 << (offset % 8))) != 0;
+	return (text->text_props[offset] & SKB_TEXT_PROP_GRAPHEME_BREAK) != 0;
+}
+
 int32_t skb_text_get_attribute_spans_count(const skb_text_t* text)
 {
 	return text ? text->spans_count : 0;
@@ -137,12 +435,96 @@ const skb_attribute_span_t* skb_text_get_attribute_spans(const skb_text_t* text)
 	return text ? text->spans : NULL;
 }
 
+uint64_t skb_text_hash_append(uint64_t hash, const skb_text_t* text)
+{
+	if (!text)
+		return skb_hash64_append_int32(hash, 0);
+
+	hash = skb_hash64_append_int32(hash, text->text_count);
+	if (text->is_compact) {
+		// Hash the same bytes as the utf-32 text would produce.
+		uint32_t utf32[SKB__TEXT_CHECKPOINT_INTERVAL];
+		for (int32_t offset = 0; offset < text->text_count; offset += SKB__TEXT_CHECKPOINT_INTERVAL) {
+			const skb_range_t range = { .start = offset, .end = skb_mini(offset + SKB__TEXT_CHECKPOINT_INTERVAL, text->text_count) };
+			const int32_t count = skb_text_get_utf32_in_range(text, range, utf32, SKB_COUNTOF(utf32));
+			hash = skb_hash64_append(hash, utf32, count * sizeof(uint32_t));
+		}
+	} else {
+		hash = skb_hash64_append(hash, text->text, text->text_count * sizeof(uint32_t));
+	}
+
+	for (int32_t i = 0; i < text->spans_count; i++) {
+		const skb_attribute_span_t* span = &text->spans[i];
+		hash = skb_hash64_append_int32(hash, span->text_range.start);
+		hash = skb_hash64_append_int32(hash, span->text_range.end);
+		hash = skb_hash64_append_uint8(hash, span->flags);
+		hash = skb_attributes_hash_append(hash, (skb_attribute_set_t){ .attributes = &span->attribute, .attributes_count = 1 });
+		if (span->payload) {
+			int32_t data_size = 0;
+			const void* data = skb_data_blob_get_data(span->payload, &data_size);
+			hash = skb_hash64_append_uint32(hash, skb_data_blob_get_type(span->payload));
+			hash = skb_hash64_append(hash, data, data_size);
+		}
+	}
+
+	return hash;
+}
+
+bool skb_text_equals(const skb_text_t* text, const skb_text_t* other)
+{
+	assert(text);
+	assert(other);
+
+	if (text->text_count != other->text_count || text->spans_count != other->spans_count)
+		return false;
+
+	if (!text->is_compact && !other->is_compact) {
+		if (text->text_count > 0 && memcmp(text->text, other->text, text->text_count * sizeof(uint32_t)) != 0)
+			return false;
+	} else {
+		// Compare the same codepoints as the utf-32 text would have.
+		uint32_t utf32[SKB__TEXT_CHECKPOINT_INTERVAL];
+		uint32_t other_utf32[SKB__TEXT_CHECKPOINT_INTERVAL];
+		for (int32_t offset = 0; offset < text->text_count; offset += SKB__TEXT_CHECKPOINT_INTERVAL) {
+			const skb_range_t range = { .start = offset, .end = skb_mini(offset + SKB__TEXT_CHECKPOINT_INTERVAL, text->text_count) };
+			const int32_t count = skb_text_get_utf32_in_range(text, range, utf32, SKB_COUNTOF(utf32));
+			const int32_t other_count = skb_text_get_utf32_in_range(other, range, other_utf32, SKB_COUNTOF(other_utf32));
+			if (count != other_count || memcmp(utf32, other_utf32, count * sizeof(uint32_t)) != 0)
+				return false;
+		}
+	}
+
+	// The attributes are zero initialized (including padding), and compared the same way as they are hashed.
+	for (int32_t i = 0; i < text->spans_count; i++) {
+		const skb_attribute_span_t* span = &text->spans[i];
+		const skb_attribute_span_t* other_span = &other->spans[i];
+		if (span->text_range.start != other_span->text_range.start || span->text_range.end != other_span->text_range.end || span->flags != other_span->flags)
+			return false;
+		if (memcmp(&span->attribute, &other_span->attribute, sizeof(skb_attribute_t)) != 0)
+			return false;
+		if ((span->payload == NULL) != (other_span->payload == NULL))
+			return false;
+		if (span->payload && span->payload != other_span->payload) {
+			int32_t data_size = 0;
+			int32_t other_data_size = 0;
+			const void* data = skb_data_blob_get_data(span->payload, &data_size);
+			const void* other_data = skb_data_blob_get_data(other_span->payload, &other_data_size);
+			if (skb_data_blob_get_type(span->payload) != skb_data_blob_get_type(other_span->payload) || data_size != other_data_size)
+				return false;
+			if (data_size > 0 && memcmp(data, other_data, data_size) != 0)
+				return false;
+		}
+	}
+
+	return true;
+}
+
 int32_t skb_text_get_next_grapheme_offset(const skb_text_t* text, int32_t text_offset)
 {
 	text_offset = skb_clampi(text_offset, 0, text->text_count); // We allow one past the last codepoint as valid insertion point.
 
 	// Find end of the current grapheme.
-	while (text_offset < text->text_count && !(text->text_props[text_offset] & SKB_TEXT_PROP_GRAPHEME_BREAK))
+	while (text_offset < text->text_count && !skb__text_is_grapheme_break(text, text_offset))
 		text_offset++;
 
 	if (text_offset >= text->text_count)
@@ -163,7 +545,7 @@ int32_t skb_text_get_prev_grapheme_offset(const skb_text_t* text, int32_t text_o
 
 	// Find begining of the current grapheme.
 	if (text->text_count) {
-		while ((text_offset - 1) >= 0 && !(text->text_props[text_offset - 1] & SKB_TEXT_PROP_GRAPHEME_BREAK))
+		while ((text_offset - 1) >= 0 && !skb__text_is_grapheme_break(text, text_offset - 1))
 			text_offset--;
 	}
 
@@ -174,7 +556,7 @@ int32_t skb_text_get_prev_grapheme_offset(const skb_text_t* text, int32_t text_o
 	text_offset--;
 
 	// Find beginning of the previous grapheme.
-	while ((text_offset - 1) >= 0 && !(text->text_props[text_offset - 1] & SKB_TEXT_PROP_GRAPHEME_BREAK))
+	while ((text_offset - 1) >= 0 && !skb__text_is_grapheme_break(text, text_offset - 1))
 		text_offset--;
 
 	return text_offset;
@@ -189,7 +571,7 @@ int32_t skb_text_align_grapheme_offset(const skb_text_t* text, int32_t text_offs
 		return text_offset;
 
 	// Find beginning of the current grapheme.
-	while ((text_offset - 1) >= 0 && !(text->text_props[text_offset - 1] & SKB_TEXT_PROP_GRAPHEME_BREAK))
+	while ((text_offset - 1) >= 0 && !skb__text_is_grapheme_break(text, text_offset - 1))
 		text_offset--;
 
 	if (text_offset <= 0)
@@ -499,11 +881,12 @@ void skb_text_append(skb_text_t* text, const skb_text_t* text_from)
 	if (!text_from || !text_from->text_count)
 		return;
 
+	skb_text_expand(text);
 	skb__text_reserve(text, text->text_count + text_from->text_count);
 	const int32_t start_offset = text->text_count;
 
 	// Copy text
-	memcpy(text->text + start_offset, text_from->text, text_from->text_count * sizeof(uint32_t));
+	skb__text_copy_utf32(text_from, 0, text_from->text_count, text->text + start_offset);
 	skb__set_grapheme_breaks(text->text, start_offset, text_from->text_count, text->text_props);
 
 	text->text_count += text_from->text_count;
@@ -537,11 +920,12 @@ void skb_text_append_range(skb_text_t* text, const skb_text_t* source_text, skb_
 	if (copy_count <= 0)
 		return;
 
+	skb_text_expand(text);
 	skb__text_reserve(text, text->text_count + copy_count);
 	const int32_t start_offset = text->text_count;
 
 	// Copy text
-	memcpy(text->text + start_offset, source_text->text + copy_offset, copy_count * sizeof(uint32_t));
+	skb__text_copy_utf32(source_text, copy_offset, copy_count, text->text + start_offset);
 	skb__set_grapheme_breaks(text->text, start_offset, copy_count, text->text_props);
 	text->text_count += copy_count;
 
@@ -574,6 +958,7 @@ void skb_text_append_utf8_with_payload(skb_text_t* text, const char* utf8, int32
 	if (utf8_count < 0) utf8_count = (int32_t)strlen(utf8);
 
 	const int32_t utf32_count = skb_utf8_to_utf32_count(utf8, utf8_count);
+	skb_text_expand(text);
 	skb__text_reserve(text, text->text_count + utf32_count);
 
 	const skb_range_t range = {
@@ -601,6 +986,7 @@ void skb_text_append_utf32_with_payload(skb_text_t* text, const uint32_t* utf32,
 	if (!utf32) return;
 	if (utf32_count < 0) utf32_count = skb_utf32_strlen(utf32);
 
+	skb_text_expand(text);
 	skb__text_reserve(text, text->text_count + utf32_count);
 
 	const skb_range_t range = {
@@ -616,9 +1002,191 @@ void skb_text_append_utf32_with_payload(skb_text_t* text, const uint32_t* utf32,
 	skb__insert_attributes(text, range, attributes, span_flags, payload);
 }
 
+//
+// Text builder
+//
+
+// Appends span at the end of the span array. The spans are appended in text order, so the array stays sorted.
+static void skb__span_push(skb_text_t* text, skb_range_t text_range, skb_attribute_t attribute, uint8_t span_flags, const skb_data_blob_t* associated_data)
+{
+	assert(text_range.start <= text_range.end);
+	assert(text->spans_count == 0 || text->spans[text->spans_count - 1].text_range.start <= text_range.start);
+
+	skb__spans_reserve(text, text->spans_count + 1);
+	skb_attribute_span_t* span = &text->spans[text->spans_count++];
+
+	span->text_range = text_range;
+	span->attribute = attribute;
+	span->flags = span_flags;
+
+	if (text->temp_alloc)
+		span->payload = skb_data_blob_duplicate_temp(associated_data, text->temp_alloc);
+	else
+		span->payload = skb_data_blob_duplicate(associated_data);
+}
+
+static void skb__push_attributes(skb_text_t* text, skb_range_t range, skb_attribute_set_t attributes, uint8_t span_flags, const skb_data_blob_t* payload)
+{
+	if (attributes.parent_set)
+		skb__push_attributes(text, range, *attributes.parent_set, span_flags, payload);
+
+	if (attributes.set_handle)
+		skb__span_push(text, range, skb_attribute_make_reference(attributes.set_handle), span_flags, payload);
+
+	for (int32_t i = 0; i < attributes.attributes_count; i++)
+		skb__span_push(text, range, attributes.attributes[i], span_flags, payload);
+}
+
+skb_text_builder_t skb_text_builder_begin(skb_text_t* text)
+{
+	assert(text);
+
+	skb_text_expand(text);
+
+	return (skb_text_builder_t) {
+		.text = text,
+		.start_offset = text->text_count,
+		.start_spans_count = text->spans_count,
+		.text_version = text->text_version,
+	};
+}
+
+void skb_text_builder_append(skb_text_builder_t* builder, const skb_text_t* text_from)
+{
+	if (!text_from || !text_from->text_count)
+		return;
+
+	const skb_text_range_t text_range = {
+		.start.offset = 0,
+		.end.offset = text_from->text_count,
+	};
+	skb_text_builder_append_range(builder, text_from, text_range);
+}
+
+void skb_text_builder_append_range(skb_text_builder_t* builder, const skb_text_t* source_text, skb_text_range_t source_text_range)
+{
+	assert(builder && builder->text);
+	skb_text_t* text = builder->text;
+	assert(text->text_version == builder->text_version); // The text should not be changed during build.
+	assert(source_text != text);
+
+	if (!source_text || !source_text->text_count)
+		return;
+
+	const skb_range_t from_range = skb_text_get_range_from_text_range(source_text, source_text_range);
+
+	const int32_t copy_offset = from_range.start;
+	const int32_t copy_count = from_range.end - from_range.start;
+
+	if (copy_count <= 0)
+		return;
+
+	skb__text_reserve(text, text->text_count + copy_count);
+	const int32_t start_offset = text->text_count;
+
+	skb__text_copy_utf32(source_text, copy_offset, copy_count, text->text + start_offset);
+	text->text_count += copy_count;
+
+	const int32_t span_offset = start_offset - copy_offset;
+	for (int32_t i = 0; i < source_text->spans_count; i++) {
+		const skb_attribute_span_t* span = &source_text->spans[i];
+		skb_range_t span_range = {
+			.start = skb_maxi(span->text_range.start, from_range.start) + span_offset,
+			.end = skb_mini(span->text_range.end, from_range.end) + span_offset,
+		};
+		if (span_range.end > span_range.start)
+			skb__span_push(text, span_range, span->attribute, span->flags, span->payload);
+	}
+
+	builder->text_version = text->text_version;
+}
+
+void skb_text_builder_append_utf8(skb_text_builder_t* builder, const char* utf8, int32_t utf8_count, skb_attribute_set_t attributes)
+{
+	skb_text_builder_append_utf8_with_payload(builder, utf8, utf8_count, attributes, 0, NULL);
+}
+
+void skb_text_builder_append_utf8_with_payload(skb_text_builder_t* builder, const char* utf8, int32_t utf8_count, skb_attribute_set_t attributes, uint8_t span_flags, const skb_data_blob_t* payload)
+{
+	assert(builder && builder->text);
+	skb_text_t* text = builder->text;
+	assert(text->text_version == builder->text_version); // The text should not be changed during build.
+
+	if (!utf8) return;
+	if (utf8_count < 0) utf8_count = (int32_t)strlen(utf8);
+
+	const int32_t utf32_count = skb_utf8_to_utf32_count(utf8, utf8_count);
+	skb__text_reserve(text, text->text_count + utf32_count);
+
+	const skb_range_t range = {
+		.start = text->text_count,
+		.end = text->text_count + utf32_count,
+	};
+
+	skb_utf8_to_utf32(utf8, utf8_count, text->text + text->text_count, utf32_count);
+	text->text_count += utf32_count;
+
+	skb__push_attributes(text, range, attributes, span_flags, payload);
+
+	builder->text_version = text->text_version;
+}
+
+void skb_text_builder_append_utf32(skb_text_builder_t* builder, const uint32_t* utf32, int32_t utf32_count, skb_attribute_set_t attributes)
+{
+	skb_text_builder_append_utf32_with_payload(builder, utf32, utf32_count, attributes, 0, NULL);
+}
+
+void skb_text_builder_append_utf32_with_payload(skb_text_builder_t* builder, const uint32_t* utf32, int32_t utf32_count, skb_attribute_set_t attributes, uint8_t span_flags, const skb_data_blob_t* payload)
+{
+	assert(builder && builder->text);
+	skb_text_t* text = builder->text;
+	assert(text->text_version == builder->text_version); // The text should not be changed during build.
+
+	if (!utf32) return;
+	if (utf32_count < 0) utf32_count = skb_utf32_strlen(utf32);
+
+	skb__text_reserve(text, text->text_count + utf32_count);
+
+	const skb_range_t range = {
+		.start = text->text_count,
+		.end = text->text_count + utf32_count,
+	};
+
+	memcpy(text->text + text->text_count, utf32, utf32_count * sizeof(uint32_t));
+	text->text_count += utf32_count;
+
+	skb__push_attributes(text, range, attributes, span_flags, payload);
+
+	builder->text_version = text->text_version;
+}
+
+void skb_text_builder_finish(skb_text_builder_t* builder)
+{
+	assert(builder);
+	skb_text_t* text = builder->text;
+	if (!text)
+		return;
+	assert(text->text_version == builder->text_version); // The text should not be changed during build.
+
+	if (text->text_count > builder->start_offset) {
+		// Start from the last grapheme cluster of the existing text, so that clusters continuing to the appended text are detected.
+		// The last codepoint always has grapheme break, as it was end of the text.
+		int32_t start_offset = skb_maxi(0, builder->start_offset - 1);
+		while (start_offset > 0 && !(text->text_props[start_offset - 1] & SKB_TEXT_PROP_GRAPHEME_BREAK))
+			start_offset--;
+		skb__set_grapheme_breaks(text->text, start_offset, text->text_count - start_offset, text->text_props);
+	}
+
+	if (text->spans_count > builder->start_spans_count)
+		skb__attributes_merge_adjacent(text);
+
+	SKB_ZERO_STRUCT(builder);
+}
+
 void skb_text_insert(skb_text_t* text, skb_text_range_t text_range, const skb_text_t* source_text)
 {
 	assert(text);
+	skb_text_expand(text);
 
 	const skb_range_t range = skb_text_get_range_from_text_range(text, text_range);
 
@@ -635,7 +1203,7 @@ void skb_text_insert(skb_text_t* text, skb_text_range_t text_range, const skb_te
 
 	// Copy
 	if (source_text_count > 0) {
-		memcpy(text->text + range.start, source_text->text, source_text_count * sizeof(uint32_t));
+		skb__text_copy_utf32(source_text, 0, source_text_count, text->text + range.start);
 		skb__set_grapheme_breaks(text->text, range.start, source_text_count, text->text_props);
 	}
 	text->text_count += source_text_count - remove_count;
@@ -666,6 +1234,7 @@ void skb_text_insert_utf8(skb_text_t* text, skb_text_range_t text_range, const c
 void skb_text_insert_utf8_with_payload(skb_text_t* text, skb_text_range_t text_range, const char* utf8, int32_t utf8_count, skb_attribute_set_t attributes, uint8_t span_flags, const skb_data_blob_t* payload)
 {
 	assert(text);
+	skb_text_expand(text);
 
 	const skb_range_t range = skb_text_get_range_from_text_range(text, text_range);
 
@@ -699,6 +1268,7 @@ void skb_text_insert_utf32(skb_text_t* text, skb_text_range_t text_range, const
 void skb_text_insert_utf32_with_payload(skb_text_t* text, skb_text_range_t text_range, const uint32_t* utf32, int32_t utf32_count, skb_attribute_set_t attributes, uint8_t span_flags, const skb_data_blob_t* payload)
 {
 	assert(text);
+	skb_text_expand(text);
 
 	const skb_range_t range = skb_text_get_range_from_text_range(text, text_range);
 
@@ -726,14 +1296,19 @@ void skb_text_insert_utf32_with_payload(skb_text_t* text, skb_text_range_t text_
 void skb_text_remove(skb_text_t* text, skb_text_range_t text_range)
 {
 	assert(text);
+	skb_text_expand(text);
 
 	const skb_range_t range = skb_text_get_range_from_text_range(text, text_range);
 
 	if (range.end <= range.start) return;
 
+	// Make sure the codepoints are not shared before modifying them.
+	skb__text_reserve(text, text->text_count);
+
 	// Remove text
 	memmove(text->text + range.start, text->text + range.end, (text->text_count - range.end) * sizeof(uint32_t));
 	text->text_count -= range.end - range.start;
+	text->text_version++;
 
 	// Remove attributes
 	skb__attributes_replace(text, range, 0, (skb_attribute_set_t){0}, 0, NULL);
@@ -742,6 +1317,7 @@ void skb_text_remove(skb_text_t* text, skb_text_range_t text_range)
 void skb_text_remove_if(skb_text_t* text, skb_text_remove_func_t* filter_func, void* context)
 {
 	assert(filter_func);
+	skb_text_expand(text);
 
 	int32_t remove_start = SKB_INVALID_INDEX;
 	for (int32_t i = 0; i < text->text_count; i++) {
@@ -773,13 +1349,14 @@ skb_text_range_t skb_text_find_reverse_utf32(const skb_text_t* text, skb_text_ra
 
 	uint32_t value_last = value_utf32[value_utf32_count - 1];
 	int32_t text_offset = skb_clampi(search_range.end - 1, 0, text->text_count - 1); // Make sure the offset is in range.
+	skb__text_reader_t reader = skb__text_reader_make(text);
 
 	while (text_offset >= search_range.start) {
-		if (text->text[text_offset] == value_last) {
+		if (skb__text_reader_get(&reader, text_offset) == value_last) {
 			// Try to match the value
 			int32_t end_text_offset = text_offset;
 			int32_t value_offset = value_utf32_count - 1;
-			while (text_offset >= 0 && value_offset >= 0 && value_utf32[value_offset] == text->text[text_offset]) {
+			while (text_offset >= 0 && value_offset >= 0 && value_utf32[value_offset] == skb__text_reader_get(&reader, text_offset)) {
 				value_offset--;
 				text_offset--;
 			}
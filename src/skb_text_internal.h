@@ -7,12 +7,21 @@
 #include <stdint.h>
 
 typedef struct skb_text_t {
-	uint32_t* text;
+	uint32_t* text;			// Codepoints, reference counted when heap allocated, see skb_text_acquire_shared_utf32().
 	int32_t text_count;
 	int32_t text_cap;
 
 	uint8_t* text_props;	// grapheme breaks
 
+	// Compact storage, see skb_text_compact(). When used, 'text' and 'text_props' are NULL, and 'text_count' is the number of codepoints.
+	char* utf8;
+	int32_t utf8_count;
+	int32_t* utf8_checkpoints;	// Byte offset of every SKB__TEXT_CHECKPOINT_INTERVAL'th codepoint.
+	uint8_t* utf8_grapheme_breaks;	// Grapheme break flag of each codepoint, one bit per codepoint.
+	bool is_compact;
+
+	uint32_t text_version;	// Incremented when the codepoints change, used to validate that the text is not changed during build.
+
 	skb_attribute_span_t* spans;
 	int32_t spans_count;
 	int32_t spans_cap;
@@ -30,4 +39,18 @@ typedef struct skb_text_t {
  */
 skb_text_t skb_text_make_empty(void);
 
+/**
+ * Returns a reference to the codepoints of the text, which stays valid until released with skb_text_release_shared_utf32().
+ * The text copies its codepoints before the next modification while they are shared, so the shared codepoints do not change.
+ * @param text text to share.
+ * @return pointer to text_count codepoints, or NULL if the text cannot be shared (temp allocated, compact, or empty).
+ */
+const uint32_t* skb_text_acquire_shared_utf32(const skb_text_t* text);
+
+/** Adds a reference to codepoints returned by skb_text_acquire_shared_utf32(). */
+void skb_text_retain_shared_utf32(const uint32_t* utf32);
+
+/** Releases a reference to codepoints returned by skb_text_acquire_shared_utf32(), NULL is ignored. */
+void skb_text_release_shared_utf32(const uint32_t* utf32);
+
 #endif // SKB_TEXT_INTERNAL_H
@@ -241,10 +241,144 @@ static int test_iter(void)
 	return 0;
 }
 
+static int test_compact(void)
+{
+	skb_text_t* text = skb_text_create();
+	ENSURE(text);
+
+	// Long enough to span multiple checkpoints, with multibyte codepoints.
+	char str[1024];
+	int32_t str_count = 0;
+	for (int32_t i = 0; i < 100; i++) {
+		memcpy(str + str_count, "ab\xc3\xa4\xe2\x82\xac", 7); // a, b, a-umlaut, euro
+		str_count += 7;
+	}
+	skb_attribute_t attributes[] = {
+		skb_attribute_make_font_size(15.f),
+	};
+	skb_text_append_utf8(text, str, str_count, SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(attributes));
+	ENSURE(skb_text_get_utf32_count(text) == 400);
+
+	const uint64_t hash = skb_text_hash_append(skb_hash64_empty(), text);
+
+	skb_text_t* copy = skb_text_create();
+	skb_text_append(copy, text);
+	ENSURE(skb_text_equals(text, copy));
+
+	skb_text_compact(text);
+	ENSURE(skb_text_is_compact(text));
+	ENSURE(skb_text_get_utf32_count(text) == 400);
+	ENSURE(skb_text_get_attribute_spans_count(text) == 1);
+	ENSURE(skb_text_hash_append(skb_hash64_empty(), text) == hash);
+
+	// Compact and expanded text with same contents are equal, different codepoints or attributes are not.
+	ENSURE(skb_text_equals(text, copy));
+	ENSURE(skb_text_equals(copy, text));
+	skb_text_insert_utf8(copy, (skb_text_range_t){ .start.offset = 300, .end.offset = 301 }, "c", -1, SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(attributes));
+	ENSURE(skb_text_get_utf32_count(copy) == 400);
+	ENSURE(!skb_text_equals(text, copy));
+	skb_text_reset(copy);
+	skb_attribute_t other_attributes[] = {
+		skb_attribute_make_font_size(16.f),
+	};
+	skb_text_append_utf8(copy, str, str_count, SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(other_attributes));
+	ENSURE(!skb_text_equals(text, copy));
+	skb_text_destroy(copy);
+
+	// Read ranges across checkpoint without expanding.
+	uint32_t utf32[8];
+	ENSURE(skb_text_get_utf32_in_range(text, (skb_range_t){ .start = 254, .end = 258 }, utf32, 8) == 4);
+	ENSURE(utf32[0] == 0xe4 && utf32[1] == 0x20ac && utf32[2] == 'a' && utf32[3] == 'b');
+	char utf8[16];
+	ENSURE(skb_text_get_utf8_in_range(text, (skb_range_t){ .start = 255, .end = 257 }, NULL, 0) == 4);
+	ENSURE(skb_text_get_utf8_in_range(text, (skb_range_t){ .start = 255, .end = 257 }, utf8, 16) == 4);
+	ENSURE(memcmp(utf8, "\xe2\x82\xac" "a", 4) == 0);
+	ENSURE(skb_text_is_compact(text));
+
+	// Read only access does not expand the text.
+	ENSURE(skb_text_get_utf32(text) == NULL);
+	ENSURE(skb_text_get_props(text) == NULL);
+	ENSURE(skb_text_get_codepoint(text, 255) == 0x20ac);
+	ENSURE(skb_text_get_codepoint(text, 399) == 0x20ac);
+	ENSURE(skb_text_get_codepoint(text, 400) == 0);
+	ENSURE(skb_text_get_next_grapheme_offset(text, 255) == 256);
+	ENSURE(skb_text_get_prev_grapheme_offset(text, 256) == 255);
+	const uint32_t value[] = { 0x20ac, 'a' };
+	const skb_text_range_t found_range = skb_text_find_reverse_utf32(text, (skb_text_range_t){ .start.offset = 0, .end.offset = 258 }, value, 2);
+	ENSURE(found_range.start.offset == 255 && found_range.end.offset == 257);
+	ENSURE(skb_text_is_compact(text));
+
+	// Editing expands the text.
+	skb_text_insert_utf8(text, (skb_text_range_t){ .start.offset = 0, .end.offset = 0 }, "x", -1, (skb_attribute_set_t){0});
+	ENSURE(!skb_text_is_compact(text));
+	ENSURE(skb_text_get_utf32_count(text) == 401);
+	ENSURE(text_cmp(skb_text_get_utf32(text), 4, "xab\xc3\xa4"));
+	ENSURE(skb_text_get_next_grapheme_offset(text, 0) == 1);
+
+	skb_text_destroy(text);
+
+	// Grapheme breaks are kept in compact text.
+	text = skb_text_create();
+	skb_text_append_utf8(text, "e\xcc\x81xy", -1, (skb_attribute_set_t){0}); // e, combining acute accent, x, y
+	skb_text_compact(text);
+	ENSURE(skb_text_is_compact(text));
+	ENSURE(skb_text_get_next_grapheme_offset(text, 0) == 2);
+	ENSURE(skb_text_get_prev_grapheme_offset(text, 2) == 0);
+	ENSURE(skb_text_align_grapheme_offset(text, 1) == 0);
+	ENSURE(skb_text_is_compact(text));
+
+	skb_text_expand(text);
+	ENSURE(!skb_text_is_compact(text));
+	ENSURE(text_cmp(skb_text_get_utf32(text), 4, "e\xcc\x81xy"));
+	ENSURE(skb_text_get_next_grapheme_offset(text, 0) == 2);
+
+	skb_text_destroy(text);
+
+	return 0;
+}
+
+static int test_builder(void)
+{
+	skb_text_t* text = skb_text_create();
+	ENSURE(text);
+
+	skb_attribute_t attributes[] = {
+		skb_attribute_make_font_size(15.f),
+	};
+
+	skb_text_append_utf8(text, "ab", -1, SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(attributes));
+
+	// Combining mark in separate fragment continues the grapheme from the previous fragment.
+	skb_text_builder_t builder = skb_text_builder_begin(text);
+	skb_text_builder_append_utf8(&builder, "c", -1, SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(attributes));
+	skb_text_builder_append_utf8(&builder, "\xcc\x81", -1, SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(attributes)); // combining acute accent
+	for (int32_t i = 0; i < 10; i++)
+		skb_text_builder_append_utf8(&builder, "d", -1, SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(attributes));
+	skb_text_builder_finish(&builder);
+
+	ENSURE(builder.text == NULL);
+	ENSURE(skb_text_get_utf32_count(text) == 14);
+	ENSURE(text_cmp(skb_text_get_utf32(text), 4, "abc\xcc\x81"));
+
+	// Adjacent spans are merged.
+	ENSURE(skb_text_get_attribute_spans_count(text) == 1);
+	ENSURE(skb_text_get_attribute_spans(text)[0].text_range.start == 0);
+	ENSURE(skb_text_get_attribute_spans(text)[0].text_range.end == 14);
+
+	ENSURE(skb_text_get_next_grapheme_offset(text, 1) == 2);
+	ENSURE(skb_text_get_next_grapheme_offset(text, 2) == 4);
+
+	skb_text_destroy(text);
+
+	return 0;
+}
+
 int attributed_text_tests(void)
 {
 	RUN_SUBTEST(test_create);
 	RUN_SUBTEST(test_add_remove);
 	RUN_SUBTEST(test_iter);
+	RUN_SUBTEST(test_compact);
+	RUN_SUBTEST(test_builder);
 	return 0;
 }
@@ -1,9 +1,12 @@
 // SPDX-FileCopyrightText: 2025 Mikko Mononen
 // SPDX-License-Identifier: MIT
 
+#include <float.h>
+#include <string.h>
 #include "test_macros.h"
 
 #include "skb_canvas.h"
+#include "skb_canvas_internal.h"
 #include "skb_common.h"
 
 static int test_init(void)
@@ -29,8 +32,158 @@ static int test_init(void)
 	return 0;
 }
 
+static int test_curve_flattening(void)
+{
+	skb_temp_alloc_t* temp_alloc = skb_temp_alloc_create(512*1024);
+
+	skb_image_t image = {
+		.width = 100,
+		.height = 100,
+		.bpp = 1,
+	};
+	image.buffer = skb_malloc(image.width * image.height * image.bpp);
+	image.stride_bytes = image.width * image.bpp;
+
+	skb_canvas_t* canvas = skb_canvas_create(temp_alloc, &image);
+
+	// Circle from cubics, the cubics are flattened via quadratics.
+	const float cx = 50.f, cy = 50.f, r = 40.f;
+	const float k = 0.5522847f * r;
+	skb_canvas_move_to(canvas, (skb_vec2_t){ cx + r, cy });
+	skb_canvas_cubic_to(canvas, (skb_vec2_t){ cx + r, cy + k }, (skb_vec2_t){ cx + k, cy + r }, (skb_vec2_t){ cx, cy + r });
+	skb_canvas_cubic_to(canvas, (skb_vec2_t){ cx - k, cy + r }, (skb_vec2_t){ cx - r, cy + k }, (skb_vec2_t){ cx - r, cy });
+	skb_canvas_cubic_to(canvas, (skb_vec2_t){ cx - r, cy - k }, (skb_vec2_t){ cx - k, cy - r }, (skb_vec2_t){ cx, cy - r });
+	skb_canvas_cubic_to(canvas, (skb_vec2_t){ cx + k, cy - r }, (skb_vec2_t){ cx + r, cy - k }, (skb_vec2_t){ cx + r, cy });
+	skb_canvas_close(canvas);
+	skb_canvas_fill_mask(canvas);
+
+	float area = 0.f;
+	for (int32_t i = 0; i < image.width * image.height; i++)
+		area += (float)image.buffer[i] / 255.f;
+	const float expected_area = SKB_PI * r * r;
+	ENSURE(skb_absf(area - expected_area) < expected_area * 0.01f);
+
+	skb_canvas_destroy(canvas);
+	skb_free(image.buffer);
+	skb_temp_alloc_destroy(temp_alloc);
+
+	return 0;
+}
+
+static skb_vec2_t test__quad_bezier_eval(skb_vec2_t p0, skb_vec2_t p1, skb_vec2_t p2, float t)
+{
+	const float mt = 1.f - t;
+	return (skb_vec2_t) {
+		.x = mt*mt * p0.x + 2.f*mt*t * p1.x + t*t * p2.x,
+		.y = mt*mt * p0.y + 2.f*mt*t * p1.y + t*t * p2.y,
+	};
+}
+
+static float test__segment_dist(skb_vec2_t pt, skb_vec2_t a, skb_vec2_t b)
+{
+	const skb_vec2_t ab = skb_vec2_sub(b, a);
+	const float len_sqr = skb_vec2_dot(ab, ab);
+	const float t = len_sqr > 0.f ? skb_clampf(skb_vec2_dot(skb_vec2_sub(pt, a), ab) / len_sqr, 0.f, 1.f) : 0.f;
+	return skb_vec2_dist(pt, skb_vec2_mad(a, ab, t));
+}
+
+// Returns the max distance between the quadratic curve and the polyline starting at p0 (Hausdorff distance, measured at samples of both).
+static float test__max_flattening_error(skb_vec2_t p0, skb_vec2_t p1, skb_vec2_t p2, const skb_vec2_t* points, int32_t points_count)
+{
+	enum { CURVE_SAMPLES = 1000, SEGMENT_SAMPLES = 8 };
+	float max_error = 0.f;
+
+	// Distance from the curve to the polyline.
+	for (int32_t i = 0; i <= CURVE_SAMPLES; i++) {
+		const skb_vec2_t pt = test__quad_bezier_eval(p0, p1, p2, (float)i / (float)CURVE_SAMPLES);
+		float dist = FLT_MAX;
+		skb_vec2_t prev = p0;
+		for (int32_t j = 0; j < points_count; j++) {
+			dist = skb_minf(dist, test__segment_dist(pt, prev, points[j]));
+			prev = points[j];
+		}
+		max_error = skb_maxf(max_error, dist);
+	}
+
+	// Distance from the polyline to the curve.
+	skb_vec2_t prev = p0;
+	for (int32_t j = 0; j < points_count; j++) {
+		for (int32_t k = 1; k < SEGMENT_SAMPLES; k++) {
+			const skb_vec2_t pt = skb_vec2_lerp(prev, points[j], (float)k / (float)SEGMENT_SAMPLES);
+			float dist = FLT_MAX;
+			skb_vec2_t curve_prev = p0;
+			for (int32_t i = 1; i <= CURVE_SAMPLES; i++) {
+				const skb_vec2_t curve_pt = test__quad_bezier_eval(p0, p1, p2, (float)i / (float)CURVE_SAMPLES);
+				dist = skb_minf(dist, test__segment_dist(pt, curve_prev, curve_pt));
+				curve_prev = curve_pt;
+			}
+			max_error = skb_maxf(max_error, dist);
+		}
+		prev = points[j];
+	}
+
+	return max_error;
+}
+
+// Flattens quadratic curve using the canvas, and returns the number of points after the start point.
+static int32_t test__flatten_quad(skb_canvas_t* canvas, skb_vec2_t p0, skb_vec2_t p1, skb_vec2_t p2, skb_vec2_t* points, int32_t points_cap)
+{
+	skb_canvas_move_to(canvas, p0);
+	skb_canvas_quad_to(canvas, p1, p2);
+	// The first point is the start point.
+	const int32_t points_count = skb_mini(canvas->points_count - 1, points_cap);
+	memcpy(points, canvas->points + 1, sizeof(skb_vec2_t) * points_count);
+	// Discard the path, only the flattened points are needed.
+	canvas->points_count = 0;
+	return points_count;
+}
+
+static int test_curve_flattening_error(void)
+{
+	skb_temp_alloc_t* temp_alloc = skb_temp_alloc_create(512*1024);
+
+	skb_image_t image = {
+		.width = 512,
+		.height = 512,
+		.bpp = 1,
+	};
+	image.buffer = skb_malloc(image.width * image.height * image.bpp);
+	image.stride_bytes = image.width * image.bpp;
+
+	skb_canvas_t* canvas = skb_canvas_create(temp_alloc, &image);
+
+	// Large arc, curve with the parabola apex (cusp) near the end point, small curve, and curve which folds back on itself.
+	const skb_vec2_t curves[][3] = {
+		{ { 10.f, 10.f }, { 250.f, 500.f }, { 490.f, 10.f } },
+		{ { 10.f, 250.f }, { 490.f, 250.f }, { 20.f, 260.f } },
+		{ { 100.f, 100.f }, { 110.f, 120.f }, { 120.f, 100.f } },
+		{ { 76.f, 56.f }, { 78.f, 82.f }, { 73.f, 23.f } },
+	};
+
+	skb_vec2_t points[1024];
+	for (int32_t i = 0; i < (int32_t)SKB_COUNTOF(curves); i++) {
+		const skb_vec2_t p0 = curves[i][0];
+		const skb_vec2_t p1 = curves[i][1];
+		const skb_vec2_t p2 = curves[i][2];
+
+		const int32_t points_count = test__flatten_quad(canvas, p0, p1, p2, points, SKB_COUNTOF(points));
+
+		// The flattened curve should stay within the tolerance.
+		ENSURE(points_count > 0);
+		ENSURE(test__max_flattening_error(p0, p1, p2, points, points_count) <= SKB_CURVE_TOL * 1.05f);
+	}
+
+	skb_canvas_destroy(canvas);
+	skb_free(image.buffer);
+	skb_temp_alloc_destroy(temp_alloc);
+
+	return 0;
+}
+
 int canvas_tests(void)
 {
 	RUN_SUBTEST(test_init);
+	RUN_SUBTEST(test_curve_flattening);
+	RUN_SUBTEST(test_curve_flattening_error);
 	return 0;
 }
@@ -382,6 +382,325 @@ static int test_option_word_navigation_macos(void)
 	return 0;
 }
 
+static bool text_equals(const skb_editor_t* editor, const char* expected)
+{
+	char text[64];
+	const int32_t text_count = skb_editor_get_text_utf8(editor, text, SKB_COUNTOF(text));
+	return text_count == (int32_t)strlen(expected) && memcmp(text, expected, text_count) == 0;
+}
+
+static void count_text_changes(skb_editor_t* editor, skb_editor_text_change_reason_t reason, void* context)
+{
+	int32_t* count = context;
+	(*count)++;
+}
+
+static int test_batch_multi_selection(void)
+{
+	skb_temp_alloc_t* temp_alloc = skb_temp_alloc_create(1024);
+	ENSURE(temp_alloc != NULL);
+
+	skb_font_collection_t* font_collection = skb_font_collection_create();
+	ENSURE(font_collection != NULL);
+	skb_font_handle_t font_handle = skb_font_collection_add_font(font_collection, "data/IBMPlexSans-Regular.ttf", SKB_FONT_FAMILY_DEFAULT, NULL);
+	ENSURE(font_handle);
+
+	skb_attribute_t attributes[] = {
+		skb_attribute_make_font_size(15.f),
+	};
+
+	skb_editor_params_t params = {
+		.font_collection = font_collection,
+		.caret_mode = SKB_CARET_MODE_SKRIBIDI,
+		.paragraph_attributes = SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(attributes),
+	};
+
+	skb_editor_t* editor = skb_editor_create(&params);
+	ENSURE(editor != NULL);
+
+	const char* test_text = "aa bb\naa cc";
+	skb_editor_set_text_utf8(editor, temp_alloc, test_text, -1);
+
+	int32_t text_change_count = 0;
+	skb_editor_set_on_text_change_callback(editor, count_text_changes, &text_change_count);
+
+	// Replace all "aa" in one batch, the change is reported once.
+	skb_editor_begin_batch(editor);
+	ENSURE(skb_editor_is_in_batch(editor));
+	const skb_text_range_t first_range = { .start = { .offset = 0 }, .end = { .offset = 2 } };
+	const skb_text_range_t second_range = { .start = { .offset = 6 }, .end = { .offset = 8 } };
+	skb_editor_insert_text_utf8(editor, temp_alloc, second_range, "xyz", -1);
+	skb_editor_insert_text_utf8(editor, temp_alloc, first_range, "xyz", -1);
+	ENSURE(text_change_count == 0);
+	skb_editor_end_batch(editor, temp_alloc);
+	ENSURE(!skb_editor_is_in_batch(editor));
+	ENSURE(text_change_count == 1);
+
+	ENSURE(text_equals(editor, "xyz bb\nxyz cc"));
+	ENSURE(skb_editor_get_paragraph_count(editor) == 2);
+	ENSURE(skb_layout_get_text_count(skb_editor_get_paragraph_layout(editor, 1)) == 6);
+
+	// Type at two carets, the secondary caret is moved by the edit at the primary caret.
+	const skb_text_position_t caret_pos = { .offset = 0, .affinity = SKB_AFFINITY_TRAILING };
+	skb_editor_select(editor, (skb_text_range_t){ .start = caret_pos, .end = caret_pos });
+	const skb_text_position_t secondary_caret_pos = { .offset = 8, .affinity = SKB_AFFINITY_TRAILING };
+	skb_editor_add_secondary_selection(editor, (skb_text_range_t){ .start = secondary_caret_pos, .end = secondary_caret_pos });
+	ENSURE(skb_editor_get_secondary_selections_count(editor) == 1);
+
+	text_change_count = 0;
+	skb_editor_insert_text_utf8_at_selections(editor, temp_alloc, "-", -1);
+	ENSURE(text_change_count == 1);
+
+	ENSURE(text_equals(editor, "-xyz bb\nx-yz cc"));
+	// The carets are at the leading edge of the inserted character.
+	ENSURE(skb_editor_get_current_selection(editor).end.offset == 0);
+	ENSURE(skb_editor_get_current_selection(editor).end.affinity == SKB_AFFINITY_LEADING);
+	ENSURE(skb_editor_get_secondary_selection(editor, 0).end.offset == 9);
+	ENSURE(skb_editor_get_secondary_selection(editor, 0).end.affinity == SKB_AFFINITY_LEADING);
+
+	// Single undo reverts both edits.
+	skb_editor_undo(editor, temp_alloc);
+	ENSURE(text_equals(editor, "xyz bb\nxyz cc"));
+	ENSURE(skb_editor_get_secondary_selections_count(editor) == 0);
+
+	skb_editor_destroy(editor);
+	skb_font_collection_destroy(font_collection);
+	skb_temp_alloc_destroy(temp_alloc);
+
+	return 0;
+}
+
+static int test_overlapping_selections(void)
+{
+	skb_temp_alloc_t* temp_alloc = skb_temp_alloc_create(1024);
+	ENSURE(temp_alloc != NULL);
+
+	skb_font_collection_t* font_collection = skb_font_collection_create();
+	ENSURE(font_collection != NULL);
+	skb_font_handle_t font_handle = skb_font_collection_add_font(font_collection, "data/IBMPlexSans-Regular.ttf", SKB_FONT_FAMILY_DEFAULT, NULL);
+	ENSURE(font_handle);
+
+	skb_attribute_t attributes[] = {
+		skb_attribute_make_font_size(15.f),
+	};
+
+	skb_editor_params_t params = {
+		.font_collection = font_collection,
+		.caret_mode = SKB_CARET_MODE_SKRIBIDI,
+		.paragraph_attributes = SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(attributes),
+	};
+
+	skb_editor_t* editor = skb_editor_create(&params);
+	ENSURE(editor != NULL);
+
+	skb_editor_set_text_utf8(editor, temp_alloc, "aa bb cc", -1);
+
+	// Overlapping and touching selections are merged.
+	const skb_text_position_t caret_pos = { .offset = 0, .affinity = SKB_AFFINITY_TRAILING };
+	skb_editor_select(editor, (skb_text_range_t){ .start = caret_pos, .end = caret_pos });
+	skb_editor_add_secondary_selection(editor, (skb_text_range_t){ .start = { .offset = 3 }, .end = { .offset = 5 } });
+	skb_editor_add_secondary_selection(editor, (skb_text_range_t){ .start = { .offset = 4 }, .end = { .offset = 7 } });
+	const skb_text_position_t touching_caret_pos = { .offset = 7, .affinity = SKB_AFFINITY_TRAILING };
+	skb_editor_add_secondary_selection(editor, (skb_text_range_t){ .start = touching_caret_pos, .end = touching_caret_pos });
+	ENSURE(skb_editor_get_secondary_selections_count(editor) == 1);
+	ENSURE(skb_editor_get_secondary_selection(editor, 0).start.offset == 3);
+	ENSURE(skb_editor_get_secondary_selection(editor, 0).end.offset == 7);
+
+	// The text is inserted once at each selection.
+	skb_editor_insert_text_utf8_at_selections(editor, temp_alloc, "-", -1);
+	ENSURE(text_equals(editor, "-aa -c"));
+	ENSURE(skb_editor_get_secondary_selections_count(editor) == 1);
+
+	// Carets which are collapsed together by an edit are merged.
+	skb_editor_set_text_utf8(editor, temp_alloc, "aa bb cc", -1);
+	skb_editor_select(editor, (skb_text_range_t){ .start = caret_pos, .end = caret_pos });
+	const skb_text_position_t first_caret_pos = { .offset = 6, .affinity = SKB_AFFINITY_TRAILING };
+	const skb_text_position_t second_caret_pos = { .offset = 7, .affinity = SKB_AFFINITY_TRAILING };
+	skb_editor_add_secondary_selection(editor, (skb_text_range_t){ .start = first_caret_pos, .end = first_caret_pos });
+	skb_editor_add_secondary_selection(editor, (skb_text_range_t){ .start = second_caret_pos, .end = second_caret_pos });
+	ENSURE(skb_editor_get_secondary_selections_count(editor) == 2);
+
+	skb_editor_remove(editor, temp_alloc, (skb_text_range_t){ .start = { .offset = 5 }, .end = { .offset = 8 } });
+	ENSURE(text_equals(editor, "aa bb"));
+	ENSURE(skb_editor_get_secondary_selections_count(editor) == 1);
+
+	skb_editor_insert_text_utf8_at_selections(editor, temp_alloc, "-", -1);
+	ENSURE(text_equals(editor, "-aa bb-"));
+
+	// Selections added out of order are kept in text order, and each receives the edit once.
+	skb_editor_set_text_utf8(editor, temp_alloc, "aa bb cc", -1);
+	const skb_text_position_t middle_caret_pos = { .offset = 3 };
+	skb_editor_select(editor, (skb_text_range_t){ .start = middle_caret_pos, .end = middle_caret_pos });
+	const skb_text_position_t last_caret_pos = { .offset = 6 };
+	skb_editor_add_secondary_selection(editor, (skb_text_range_t){ .start = last_caret_pos, .end = last_caret_pos });
+	skb_editor_add_secondary_selection(editor, (skb_text_range_t){ .start = { .offset = 0 }, .end = { .offset = 0 } });
+	skb_editor_add_secondary_selection(editor, (skb_text_range_t){ .start = last_caret_pos, .end = last_caret_pos });
+	ENSURE(skb_editor_get_secondary_selections_count(editor) == 2);
+	ENSURE(skb_editor_get_secondary_selection(editor, 0).start.offset == 0);
+	ENSURE(skb_editor_get_secondary_selection(editor, 1).start.offset == 6);
+
+	skb_editor_insert_text_utf8_at_selections(editor, temp_alloc, "--", -1);
+	ENSURE(text_equals(editor, "--aa --bb --cc"));
+	ENSURE(skb_editor_get_current_selection(editor).end.offset == 6);
+	ENSURE(skb_editor_get_secondary_selection(editor, 1).end.offset == 11);
+
+	skb_editor_destroy(editor);
+	skb_font_collection_destroy(font_collection);
+	skb_temp_alloc_destroy(temp_alloc);
+
+	return 0;
+}
+
+static int test_deferred_layout(void)
+{
+	skb_temp_alloc_t* temp_alloc = skb_temp_alloc_create(1024);
+	ENSURE(temp_alloc != NULL);
+
+	skb_font_collection_t* font_collection = skb_font_collection_create();
+	ENSURE(font_collection != NULL);
+	skb_font_handle_t font_handle = skb_font_collection_add_font(font_collection, "data/IBMPlexSans-Regular.ttf", SKB_FONT_FAMILY_DEFAULT, NULL);
+	ENSURE(font_handle);
+
+	skb_attribute_t attributes[] = {
+		skb_attribute_make_font_size(15.f),
+	};
+
+	skb_editor_params_t params = {
+		.font_collection = font_collection,
+		.caret_mode = SKB_CARET_MODE_SKRIBIDI,
+		.paragraph_attributes = SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(attributes),
+		.defer_layout = true,
+	};
+
+	skb_editor_t* editor = skb_editor_create(&params);
+	ENSURE(editor != NULL);
+
+	// Setting the text lays out immediately.
+	skb_editor_set_text_utf8(editor, temp_alloc, "Hello", -1);
+	ENSURE(!skb_editor_needs_layout_update(editor));
+	ENSURE(skb_layout_get_text_count(skb_editor_get_paragraph_layout(editor, 0)) == 5);
+
+	// Edits are applied to the text, the layout is updated later.
+	skb_editor_insert_text_utf8(editor, temp_alloc, SKB_CURRENT_SELECTION, "abc", -1);
+	skb_editor_insert_text_utf8(editor, temp_alloc, SKB_CURRENT_SELECTION, "def", -1);
+	ENSURE(skb_editor_needs_layout_update(editor));
+	ENSURE(skb_editor_get_text_utf32_count(editor) == 11);
+	ENSURE(skb_layout_get_text_count(skb_editor_get_paragraph_layout(editor, 0)) == 5);
+
+	skb_editor_update_layout(editor, temp_alloc);
+	ENSURE(!skb_editor_needs_layout_update(editor));
+	ENSURE(skb_layout_get_text_count(skb_editor_get_paragraph_layout(editor, 0)) == 11);
+
+	// Navigation updates the layout first.
+	skb_editor_insert_text_utf8(editor, temp_alloc, SKB_CURRENT_SELECTION, "!", -1);
+	skb_editor_process_key_pressed(editor, temp_alloc, SKB_KEY_END, 0);
+	ENSURE(!skb_editor_needs_layout_update(editor));
+	ENSURE(skb_layout_get_text_count(skb_editor_get_paragraph_layout(editor, 0)) == 12);
+
+	// Edit keys update the layout first too.
+	skb_editor_insert_text_utf8(editor, temp_alloc, SKB_CURRENT_SELECTION, "?", -1);
+	skb_editor_process_key_pressed(editor, temp_alloc, SKB_KEY_BACKSPACE, 0);
+	ENSURE(!skb_editor_needs_layout_update(editor));
+	ENSURE(skb_layout_get_text_count(skb_editor_get_paragraph_layout(editor, 0)) == 12);
+
+	// Hit testing the stale layout stays within the new text.
+	skb_editor_select_all(editor);
+	skb_editor_insert_text_utf8(editor, temp_alloc, SKB_CURRENT_SELECTION, "x", -1);
+	ENSURE(skb_editor_needs_layout_update(editor));
+	ENSURE(skb_layout_get_text_count(skb_editor_get_paragraph_layout(editor, 0)) == 12);
+	skb_text_position_t hit_pos = skb_editor_hit_test(editor, SKB_MOVEMENT_CARET, 1000.f, 5.f);
+	ENSURE(hit_pos.offset == 0);
+	skb_editor_process_mouse_click(editor, 1000.f, 5.f, 0, 0.0);
+	skb_editor_process_mouse_click(editor, 1000.f, 5.f, 0, 0.1);
+	skb_editor_process_mouse_click(editor, 1000.f, 5.f, 0, 0.2);
+	ENSURE(skb_editor_get_current_selection(editor).start.offset <= 1);
+	ENSURE(skb_editor_get_current_selection(editor).end.offset <= 1);
+
+	skb_editor_destroy(editor);
+	skb_font_collection_destroy(font_collection);
+	skb_temp_alloc_destroy(temp_alloc);
+
+	return 0;
+}
+
+static void count_replay_events(skb_editor_t* editor, const skb_editor_replay_event_t* event, void* context)
+{
+	int32_t* count = (int32_t*)context;
+	if (event->total_us >= 0)
+		(*count)++;
+}
+
+static int test_input_replay(void)
+{
+	skb_temp_alloc_t* temp_alloc = skb_temp_alloc_create(1024);
+	ENSURE(temp_alloc != NULL);
+
+	skb_font_collection_t* font_collection = skb_font_collection_create();
+	ENSURE(font_collection != NULL);
+	skb_font_handle_t font_handle = skb_font_collection_add_font(font_collection, "data/IBMPlexSans-Regular.ttf", SKB_FONT_FAMILY_DEFAULT, NULL);
+	ENSURE(font_handle);
+
+	skb_attribute_t attributes[] = {
+		skb_attribute_make_font_size(15.f),
+	};
+
+	skb_editor_params_t params = {
+		.font_collection = font_collection,
+		.caret_mode = SKB_CARET_MODE_SKRIBIDI,
+		.paragraph_attributes = SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(attributes),
+	};
+
+	skb_editor_t* editor = skb_editor_create(&params);
+	ENSURE(editor != NULL);
+	skb_editor_set_text_utf8(editor, temp_alloc, "Hello", -1);
+
+	// Record a short editing session.
+	skb_editor_begin_input_recording(editor);
+	ENSURE(skb_editor_is_recording_input(editor));
+	skb_editor_process_mouse_click(editor, 5.f, 5.f, 0, 0.0);
+	skb_editor_process_key_pressed(editor, temp_alloc, SKB_KEY_END, 0);
+	skb_editor_insert_text_utf8(editor, temp_alloc, SKB_CURRENT_SELECTION, " world", -1);
+	skb_editor_insert_codepoint(editor, temp_alloc, SKB_CURRENT_SELECTION, '!');
+	skb_editor_process_key_pressed(editor, temp_alloc, SKB_KEY_BACKSPACE, 0);
+	skb_editor_undo(editor, temp_alloc);
+	skb_editor_end_input_recording(editor);
+	ENSURE(!skb_editor_is_recording_input(editor));
+
+	char expected_text[64];
+	skb_editor_get_text_utf8(editor, expected_text, SKB_COUNTOF(expected_text));
+
+	int32_t data_count = 0;
+	const uint8_t* data = skb_editor_get_input_recording(editor, &data_count);
+	ENSURE(data != NULL && data_count > 0);
+
+	// Replaying on a fresh editor with the same initial state reproduces the edits.
+	skb_editor_t* replay_editor = skb_editor_create(&params);
+	ENSURE(replay_editor != NULL);
+	skb_editor_set_text_utf8(replay_editor, temp_alloc, "Hello", -1);
+
+	// Record the replay too, the recording should be byte identical.
+	skb_editor_begin_input_recording(replay_editor);
+	int32_t event_count = 0;
+	ENSURE(skb_editor_replay_input(replay_editor, temp_alloc, data, data_count, count_replay_events, &event_count) == 6);
+	ENSURE(event_count == 6);
+	ENSURE(text_equals(replay_editor, expected_text));
+	skb_editor_end_input_recording(replay_editor);
+	int32_t replay_data_count = 0;
+	const uint8_t* replay_data = skb_editor_get_input_recording(replay_editor, &replay_data_count);
+	ENSURE(replay_data_count == data_count);
+	ENSURE(memcmp(replay_data, data, data_count) == 0);
+
+	// Malformed data is rejected.
+	ENSURE(skb_editor_replay_input(replay_editor, temp_alloc, data, data_count - 1, NULL, NULL) == -1);
+
+	skb_editor_destroy(replay_editor);
+	skb_editor_destroy(editor);
+	skb_font_collection_destroy(font_collection);
+	skb_temp_alloc_destroy(temp_alloc);
+
+	return 0;
+}
+
 int editor_tests(void)
 {
 	RUN_SUBTEST(test_init);
@@ -389,5 +708,9 @@ int editor_tests(void)
 	RUN_SUBTEST(test_command_document_navigation_macos);
 	RUN_SUBTEST(test_shift_command_text_selection_macos);
 	RUN_SUBTEST(test_option_word_navigation_macos);
+	RUN_SUBTEST(test_batch_multi_selection);
+	RUN_SUBTEST(test_overlapping_selections);
+	RUN_SUBTEST(test_deferred_layout);
+	RUN_SUBTEST(test_input_replay);
 	return 0;
 }
@@ -6,6 +6,7 @@
 #include "skb_layout.h"
 #include <stdlib.h>
 #include <stdbool.h>
+#include <hb.h>
 
 static int test_init(void)
 {
@@ -32,6 +33,11 @@ static int test_add_remove(void)
 	ENSURE(count == 1);
 	ENSURE(font_handle2);
 
+	// Language should not filter out fonts in the public match function.
+	skb_font_handle_t font_handle_ja = 0;
+	ENSURE(skb_font_collection_match_fonts(font_collection, "ja", script, SKB_FONT_FAMILY_DEFAULT, SKB_WEIGHT_NORMAL, SKB_STYLE_NORMAL, SKB_STRETCH_NORMAL, &font_handle_ja, 1) == 1);
+	ENSURE(font_handle_ja == font_handle2);
+
 	bool removed = skb_font_collection_remove_font(font_collection, font_handle);
 	ENSURE(removed);
 
@@ -123,6 +129,61 @@ static int test_add_font_from_data(void)
 	return 0;
 }
 
+static void* test__read_file(const char* path, long* size)
+{
+	FILE* f = fopen(path, "rb");
+	if (!f) return NULL;
+	fseek(f, 0, SEEK_END);
+	*size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	void* data = malloc(*size);
+	if (data && fread(data, 1, *size, f) != (size_t)*size) {
+		free(data);
+		data = NULL;
+	}
+	fclose(f);
+	return data;
+}
+
+static int test_font_hash(void)
+{
+	long regular_size = 0;
+	void* regular_data = test__read_file("data/IBMPlexSans-Regular.ttf", &regular_size);
+	ENSURE(regular_data != NULL);
+	long arabic_size = 0;
+	void* arabic_data = test__read_file("data/IBMPlexSansArabic-Regular.ttf", &arabic_size);
+	ENSURE(arabic_data != NULL);
+
+	skb_font_collection_t* font_collection = skb_font_collection_create();
+	skb_font_handle_t font_handle = skb_font_collection_add_font(font_collection, "data/IBMPlexSans-Regular.ttf", SKB_FONT_FAMILY_DEFAULT, NULL);
+	ENSURE(font_handle);
+	const uint64_t hash = skb_font_get_hash(font_collection, font_handle);
+
+	// Same data with different name should have the same hash.
+	skb_font_collection_t* same_data_collection = skb_font_collection_create();
+	skb_font_handle_t same_data_handle = skb_font_collection_add_font_from_data(
+		same_data_collection, "Renamed", regular_data, regular_size, NULL, NULL, SKB_FONT_FAMILY_DEFAULT, NULL);
+	ENSURE(same_data_handle);
+	ENSURE(skb_font_get_hash(same_data_collection, same_data_handle) == hash);
+	ENSURE(skb_font_collection_find_font_by_hash(same_data_collection, hash) == same_data_handle);
+
+	// Different data with same name should have different hash.
+	skb_font_collection_t* same_name_collection = skb_font_collection_create();
+	skb_font_handle_t same_name_handle = skb_font_collection_add_font_from_data(
+		same_name_collection, "data/IBMPlexSans-Regular.ttf", arabic_data, arabic_size, NULL, NULL, SKB_FONT_FAMILY_DEFAULT, NULL);
+	ENSURE(same_name_handle);
+	ENSURE(skb_font_get_hash(same_name_collection, same_name_handle) != hash);
+	ENSURE(skb_font_collection_find_font_by_hash(same_name_collection, hash) == 0);
+
+	skb_font_collection_destroy(same_name_collection);
+	skb_font_collection_destroy(same_data_collection);
+	skb_font_collection_destroy(font_collection);
+	free(arabic_data);
+	free(regular_data);
+
+	return 0;
+}
+
 static int test_add_font_failures(void)
 {
 	skb_font_collection_t* font_collection = skb_font_collection_create();
@@ -158,11 +219,96 @@ static int test_add_font_failures(void)
 	return 0;
 }
 
+static int test_glyph_cache(void)
+{
+	skb_font_collection_t* font_collection = skb_font_collection_create();
+	ENSURE(font_collection != NULL);
+
+	const char* font_paths[] = {
+		"data/IBMPlexSans-Regular.ttf",
+		"data/IBMPlexSansArabic-Regular.ttf",
+	};
+	for (int32_t fi = 0; fi < (int32_t)SKB_COUNTOF(font_paths); fi++) {
+		skb_font_handle_t font_handle = skb_font_collection_add_font(font_collection, font_paths[fi], SKB_FONT_FAMILY_DEFAULT, NULL);
+		ENSURE(font_handle);
+
+		// The font returned by the collection has the cached lookups, and the parent is the plain Harfbuzz font.
+		hb_font_t* cached_font = skb_font_get_hb_font(font_collection, font_handle);
+		ENSURE(cached_font != NULL);
+		hb_font_t* parent_font = hb_font_get_parent(cached_font);
+		ENSURE(parent_font != NULL);
+
+		// Glyph lookups, including codepoints outside the BMP.
+		for (hb_codepoint_t unicode = 0; unicode < 0x20000; unicode++) {
+			hb_codepoint_t cached_gid = 0;
+			hb_codepoint_t gid = 0;
+			const hb_bool_t cached_found = hb_font_get_nominal_glyph(cached_font, unicode, &cached_gid);
+			const hb_bool_t found = hb_font_get_nominal_glyph(parent_font, unicode, &gid);
+			ENSURE(cached_found == found);
+			if (found)
+				ENSURE(cached_gid == gid);
+		}
+
+		// Advances, in reverse order to fill the last partial page first, and past the end of the glyphs.
+		const int32_t glyphs_count = (int32_t)hb_face_get_glyph_count(hb_font_get_face(cached_font));
+		ENSURE(glyphs_count > 0);
+		for (int32_t gid = glyphs_count + 10; gid >= 0; gid--)
+			ENSURE(hb_font_get_glyph_h_advance(cached_font, gid) == hb_font_get_glyph_h_advance(parent_font, gid));
+	}
+
+	skb_font_collection_destroy(font_collection);
+
+	return 0;
+}
+
+static int test_font_index(void)
+{
+	skb_font_index_t* font_index = skb_font_index_create();
+	ENSURE(font_index != NULL);
+
+	const int32_t scanned_count = skb_font_index_scan_directory(font_index, "data", NULL, NULL);
+	ENSURE(scanned_count > 0);
+	ENSURE(skb_font_index_get_faces_count(font_index) > 0);
+
+	// Nothing has changed, the files should not be scanned again.
+	ENSURE(skb_font_index_scan_directory(font_index, "data/", NULL, NULL) == 0);
+
+	// Serialized index should match the original.
+	const int32_t data_count = skb_font_index_serialize(font_index, NULL, 0);
+	uint8_t* data = malloc(data_count);
+	ENSURE(skb_font_index_serialize(font_index, data, data_count) == data_count);
+	skb_font_index_t* loaded_font_index = skb_font_index_create();
+	ENSURE(skb_font_index_deserialize(loaded_font_index, data, data_count));
+	ENSURE(skb_font_index_get_faces_count(loaded_font_index) == skb_font_index_get_faces_count(font_index));
+	ENSURE(!skb_font_index_deserialize(loaded_font_index, data, data_count - 1));
+	ENSURE(skb_font_index_get_faces_count(loaded_font_index) == 0);
+	skb_font_index_destroy(loaded_font_index);
+	free(data);
+
+	// The fallback should load font for the missing script.
+	skb_font_collection_t* font_collection = skb_font_collection_create();
+	skb_font_collection_set_on_font_fallback(font_collection, skb_font_index_font_fallback, font_index);
+
+	uint8_t script = skb_script_from_iso15924_tag(SKB_TAG_STR("Thai"));
+	skb_font_handle_t font_handle = 0;
+	int32_t count = skb_font_collection_match_fonts(font_collection, "th", script, SKB_FONT_FAMILY_DEFAULT, SKB_WEIGHT_NORMAL, SKB_STYLE_NORMAL, SKB_STRETCH_NORMAL, &font_handle, 1);
+	ENSURE(count == 1);
+	ENSURE(skb_font_collection_font_has_codepoint(font_collection, font_handle, 0x0e01)); // Thai character ko kai
+
+	skb_font_collection_destroy(font_collection);
+	skb_font_index_destroy(font_index);
+
+	return 0;
+}
+
 int font_collection_tests(void)
 {
 	RUN_SUBTEST(test_init);
 	RUN_SUBTEST(test_add_remove);
 	RUN_SUBTEST(test_add_font_from_data);
+	RUN_SUBTEST(test_font_hash);
 	RUN_SUBTEST(test_add_font_failures);
+	RUN_SUBTEST(test_glyph_cache);
+	RUN_SUBTEST(test_font_index);
 	return 0;
 }
@@ -3,6 +3,15 @@
 
 #include "test_macros.h"
 #include "skb_image_atlas.h"
+#include "skb_font_collection.h"
+#include "skb_rasterizer.h"
+
+#if defined(__has_include)
+#if __has_include(<threads.h>) && !defined(__STDC_NO_THREADS__)
+#include <threads.h>
+#define TEST_HAS_THREADS 1
+#endif
+#endif
 
 static int test_init(void)
 {
@@ -14,8 +23,179 @@ static int test_init(void)
 	return 0;
 }
 
+static bool quad_equals(skb_quad_t a, skb_quad_t b)
+{
+	return a.texture.x == b.texture.x && a.texture.y == b.texture.y && a.texture.width == b.texture.width && a.texture.height == b.texture.height
+		&& a.geom.x == b.geom.x && a.geom.y == b.geom.y && a.geom.width == b.geom.width && a.geom.height == b.geom.height
+		&& a.texture_idx == b.texture_idx;
+}
+
+#define TEST_GLYPH_COUNT 64
+
+typedef struct test_lookup_context_t {
+	const skb_image_atlas_t* atlas;
+	skb_image_atlas_staging_t* staging;
+	skb_font_collection_t* font_collection;
+	skb_font_handle_t font_handle;
+	const skb_quad_t* expected_quads;
+	int32_t failed_count;
+} test_lookup_context_t;
+
+static int lookup_glyphs(void* arg)
+{
+	test_lookup_context_t* ctx = arg;
+	for (int32_t iter = 0; iter < 200; iter++) {
+		for (int32_t i = 0; i < TEST_GLYPH_COUNT; i++) {
+			skb_quad_t quad = {0};
+			const bool found = skb_image_atlas_find_glyph_quad(ctx->atlas, ctx->staging, 0.f, 0.f, 1.f,
+				ctx->font_collection, ctx->font_handle, (uint32_t)(i + 1), 24.f, skb_rgba(0,0,0,255), SKB_RASTERIZE_ALPHA_MASK, &quad);
+			if (!found || !quad_equals(quad, ctx->expected_quads[i]))
+				ctx->failed_count++;
+		}
+	}
+	return 0;
+}
+
+static int test_staged_lookup(void)
+{
+	skb_temp_alloc_t* temp_alloc = skb_temp_alloc_create(1024);
+	skb_rasterizer_t* rasterizer = skb_rasterizer_create(NULL);
+	skb_font_collection_t* font_collection = skb_font_collection_create();
+	skb_font_handle_t font_handle = skb_font_collection_add_font(font_collection, "data/IBMPlexSans-Regular.ttf", SKB_FONT_FAMILY_DEFAULT, NULL);
+	ENSURE(font_handle);
+
+	skb_image_atlas_t* atlas = skb_image_atlas_create(NULL);
+	skb_image_atlas_staging_t* staging = skb_image_atlas_staging_create();
+
+	// Missing glyphs are recorded, and added on commit.
+	skb_quad_t quad = {0};
+	ENSURE(!skb_image_atlas_find_glyph_quad(atlas, staging, 0.f, 0.f, 1.f, font_collection, font_handle, 1, 24.f, skb_rgba(0,0,0,255), SKB_RASTERIZE_ALPHA_MASK, &quad));
+	for (int32_t i = 1; i < TEST_GLYPH_COUNT; i++)
+		skb_image_atlas_find_glyph_quad(atlas, staging, 0.f, 0.f, 1.f, font_collection, font_handle, (uint32_t)(i + 1), 24.f, skb_rgba(0,0,0,255), SKB_RASTERIZE_ALPHA_MASK, &quad);
+	ENSURE(skb_image_atlas_commit_staging(atlas, &staging, 1) == TEST_GLYPH_COUNT);
+	ENSURE(skb_image_atlas_commit_staging(atlas, &staging, 1) == 0);
+	skb_image_atlas_rasterize_missing_items(atlas, temp_alloc, rasterizer);
+
+	// Found glyphs match the quads from the mutable path.
+	skb_quad_t expected_quads[TEST_GLYPH_COUNT];
+	for (int32_t i = 0; i < TEST_GLYPH_COUNT; i++) {
+		expected_quads[i] = skb_image_atlas_get_glyph_quad(atlas, 0.f, 0.f, 1.f, font_collection, font_handle, (uint32_t)(i + 1), 24.f, skb_rgba(0,0,0,255), SKB_RASTERIZE_ALPHA_MASK);
+		ENSURE(skb_image_atlas_find_glyph_quad(atlas, staging, 0.f, 0.f, 1.f, font_collection, font_handle, (uint32_t)(i + 1), 24.f, skb_rgba(0,0,0,255), SKB_RASTERIZE_ALPHA_MASK, &quad));
+		ENSURE(quad_equals(quad, expected_quads[i]));
+	}
+	ENSURE(skb_image_atlas_commit_staging(atlas, &staging, 1) == 0);
+
+#if defined(TEST_HAS_THREADS)
+	// Look up the glyphs from multiple threads at the same time.
+	enum { THREAD_COUNT = 8 };
+	thrd_t threads[THREAD_COUNT];
+	test_lookup_context_t contexts[THREAD_COUNT];
+	skb_image_atlas_staging_t* stagings[THREAD_COUNT];
+	for (int32_t i = 0; i < THREAD_COUNT; i++) {
+		stagings[i] = skb_image_atlas_staging_create();
+		contexts[i] = (test_lookup_context_t) {
+			.atlas = atlas,
+			.staging = stagings[i],
+			.font_collection = font_collection,
+			.font_handle = font_handle,
+			.expected_quads = expected_quads,
+		};
+		ENSURE(thrd_create(&threads[i], lookup_glyphs, &contexts[i]) == thrd_success);
+	}
+	for (int32_t i = 0; i < THREAD_COUNT; i++) {
+		thrd_join(threads[i], NULL);
+		ENSURE(contexts[i].failed_count == 0);
+	}
+	ENSURE(skb_image_atlas_commit_staging(atlas, stagings, THREAD_COUNT) == 0);
+	for (int32_t i = 0; i < THREAD_COUNT; i++)
+		skb_image_atlas_staging_destroy(stagings[i]);
+#endif
+
+	skb_image_atlas_staging_destroy(staging);
+	skb_image_atlas_destroy(atlas);
+	skb_font_collection_destroy(font_collection);
+	skb_rasterizer_destroy(rasterizer);
+	skb_temp_alloc_destroy(temp_alloc);
+
+	return 0;
+}
+
+static void count_rects(int32_t x, int32_t y, int32_t width, int32_t height, void* context)
+{
+	int32_t* count = context;
+	(*count)++;
+}
+
+static int32_t count_used_rects(skb_image_atlas_t* atlas)
+{
+	int32_t count = 0;
+	for (int32_t i = 0; i < skb_image_atlas_get_texture_count(atlas); i++)
+		skb_image_atlas_debug_iterate_used_rects(atlas, i, count_rects, &count);
+	return count;
+}
+
+#define TEST_EVICT_GLYPH_COUNT 64
+#define TEST_RECENT_GLYPH_COUNT 8
+
+static int test_evict_least_recently_used(void)
+{
+	skb_temp_alloc_t* temp_alloc = skb_temp_alloc_create(1024);
+	skb_rasterizer_t* rasterizer = skb_rasterizer_create(NULL);
+	skb_font_collection_t* font_collection = skb_font_collection_create();
+	skb_font_handle_t font_handle = skb_font_collection_add_font(font_collection, "data/IBMPlexSans-Regular.ttf", SKB_FONT_FAMILY_DEFAULT, NULL);
+	ENSURE(font_handle);
+
+	// Small atlas which cannot grow, the glyphs do not fit in one texture.
+	skb_image_atlas_config_t config = skb_image_atlas_get_default_config();
+	config.init_width = 128;
+	config.init_height = 128;
+	config.max_width = 128;
+	config.max_height = 128;
+	config.evict_inactive_duration = 2;
+	skb_image_atlas_t* atlas = skb_image_atlas_create(&config);
+
+	// Frame 1: use all glyphs.
+	skb_quad_t quads[TEST_EVICT_GLYPH_COUNT];
+	for (int32_t i = 0; i < TEST_EVICT_GLYPH_COUNT; i++)
+		quads[i] = skb_image_atlas_get_glyph_quad(atlas, 0.f, 0.f, 1.f, font_collection, font_handle, (uint32_t)(i + 1), 24.f, skb_rgba(0,0,0,255), SKB_RASTERIZE_ALPHA_MASK);
+	skb_image_atlas_rasterize_missing_items(atlas, temp_alloc, rasterizer);
+	const int32_t textures_count = skb_image_atlas_get_texture_count(atlas);
+	ENSURE(textures_count > 1);
+	const int32_t used_rects_count = count_used_rects(atlas);
+	ENSURE(used_rects_count == TEST_EVICT_GLYPH_COUNT);
+	skb_image_atlas_compact(atlas);
+
+	// Frame 2: use only the first glyphs, the rest are least recently used, and get evicted.
+	for (int32_t i = 0; i < TEST_RECENT_GLYPH_COUNT; i++)
+		skb_image_atlas_get_glyph_quad(atlas, 0.f, 0.f, 1.f, font_collection, font_handle, (uint32_t)(i + 1), 24.f, skb_rgba(0,0,0,255), SKB_RASTERIZE_ALPHA_MASK);
+	skb_image_atlas_rasterize_missing_items(atlas, temp_alloc, rasterizer);
+	ENSURE(skb_image_atlas_compact(atlas));
+	ENSURE(count_used_rects(atlas) == TEST_RECENT_GLYPH_COUNT);
+
+	// Frame 3: the recently used glyphs are still in place, and the evicted glyphs reuse the freed space.
+	for (int32_t i = 0; i < TEST_RECENT_GLYPH_COUNT; i++) {
+		const skb_quad_t quad = skb_image_atlas_get_glyph_quad(atlas, 0.f, 0.f, 1.f, font_collection, font_handle, (uint32_t)(i + 1), 24.f, skb_rgba(0,0,0,255), SKB_RASTERIZE_ALPHA_MASK);
+		ENSURE(quad_equals(quad, quads[i]));
+	}
+	ENSURE(count_used_rects(atlas) == TEST_RECENT_GLYPH_COUNT);
+	for (int32_t i = TEST_RECENT_GLYPH_COUNT; i < TEST_EVICT_GLYPH_COUNT; i++)
+		skb_image_atlas_get_glyph_quad(atlas, 0.f, 0.f, 1.f, font_collection, font_handle, (uint32_t)(i + 1), 24.f, skb_rgba(0,0,0,255), SKB_RASTERIZE_ALPHA_MASK);
+	skb_image_atlas_rasterize_missing_items(atlas, temp_alloc, rasterizer);
+	ENSURE(count_used_rects(atlas) == TEST_EVICT_GLYPH_COUNT);
+	ENSURE(skb_image_atlas_get_texture_count(atlas) == textures_count);
+
+	skb_image_atlas_destroy(atlas);
+	skb_font_collection_destroy(font_collection);
+	skb_rasterizer_destroy(rasterizer);
+	skb_temp_alloc_destroy(temp_alloc);
+
+	return 0;
+}
+
 int image_atlas_tests(void)
 {
 	RUN_SUBTEST(test_init);
+	RUN_SUBTEST(test_staged_lookup);
+	RUN_SUBTEST(test_evict_least_recently_used);
 	return 0;
 }
@@ -1,6 +1,7 @@
 // SPDX-FileCopyrightText: 2025 Mikko Mononen
 // SPDX-License-Identifier: MIT
 
+#include <string.h>
 #include "test_macros.h"
 #include "skb_layout.h"
 #include "skb_font_collection.h"
@@ -49,9 +50,604 @@ static int test_missing_script(void)
 	return 0;
 }
 
+static int test_shaping_across_paint_runs(void)
+{
+	skb_temp_alloc_t* temp_alloc = skb_temp_alloc_create(1024);
+	ENSURE(temp_alloc != NULL);
+
+	skb_font_collection_t* font_collection = skb_font_collection_create();
+	skb_font_handle_t font_handle = skb_font_collection_add_font(font_collection, "data/IBMPlexSans-Regular.ttf", SKB_FONT_FAMILY_DEFAULT, NULL);
+	ENSURE(font_handle);
+
+	skb_layout_params_t layout_params = {
+		.font_collection = font_collection,
+	};
+	skb_attribute_t red_attributes[] = {
+		skb_attribute_make_font_size(15.f),
+		skb_attribute_make_paint_color(SKB_PAINT_TEXT, SKB_PAINT_STATE_DEFAULT, skb_rgba(255,0,0,255)),
+	};
+	skb_attribute_t green_attributes[] = {
+		skb_attribute_make_font_size(15.f),
+		skb_attribute_make_paint_color(SKB_PAINT_TEXT, SKB_PAINT_STATE_DEFAULT, skb_rgba(0,255,0,255)),
+	};
+	skb_content_run_t runs[] = {
+		skb_content_run_make_utf8("int ", -1, SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(red_attributes), 0),
+		skb_content_run_make_utf8("value", -1, SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(green_attributes), 0),
+		skb_content_run_make_utf8(";", -1, SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(red_attributes), 0),
+	};
+
+	// The runs differ only by paint, they are shaped together, but the layout runs should still follow the content runs.
+	skb_layout_t* layout = skb_layout_create_from_runs(temp_alloc, &layout_params, runs, SKB_COUNTOF(runs));
+	ENSURE(layout != NULL);
+	ENSURE(skb_layout_get_glyphs_count(layout) == 10);
+
+	const skb_layout_run_t* layout_runs = skb_layout_get_layout_runs(layout);
+	ENSURE(skb_layout_get_layout_runs_count(layout) == 3);
+	for (int32_t i = 0; i < 3; i++) {
+		ENSURE(layout_runs[i].content_run_idx == i);
+		ENSURE(layout_runs[i].flags & SKB_LAYOUT_RUN_HAS_START);
+		ENSURE(layout_runs[i].flags & SKB_LAYOUT_RUN_HAS_END);
+	}
+	ENSURE(layout_runs[0].glyph_range.end == layout_runs[1].glyph_range.start);
+	ENSURE(layout_runs[1].glyph_range.end == layout_runs[2].glyph_range.start);
+
+	skb_layout_destroy(layout);
+	skb_font_collection_destroy(font_collection);
+	skb_temp_alloc_destroy(temp_alloc);
+
+	return 0;
+}
+
+static int test_partial_shaping_single_line(void)
+{
+	skb_temp_alloc_t* temp_alloc = skb_temp_alloc_create(1024);
+	ENSURE(temp_alloc != NULL);
+
+	skb_font_collection_t* font_collection = skb_font_collection_create();
+	skb_font_handle_t font_handle = skb_font_collection_add_font(font_collection, "data/IBMPlexSans-Regular.ttf", SKB_FONT_FAMILY_DEFAULT, NULL);
+	ENSURE(font_handle);
+
+	char text[2048] = {0};
+	int32_t text_count = 0;
+	for (int32_t i = 0; i < 60; i++)
+		text_count += snprintf(text + text_count, sizeof(text) - text_count, "Lorem ipsum dolor sit amet ");
+
+	skb_attribute_t layout_attributes[] = {
+		skb_attribute_make_text_wrap(SKB_WRAP_NONE),
+		skb_attribute_make_text_overflow(SKB_OVERFLOW_ELLIPSIS),
+	};
+	skb_layout_params_t layout_params = {
+		.font_collection = font_collection,
+		.layout_width = 100.f,
+		.layout_height = -1.f,
+		.layout_attributes = SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(layout_attributes),
+	};
+	skb_attribute_t text_attributes[] = {
+		skb_attribute_make_font_size(15.f),
+	};
+
+	// Only the start of the text fits in the layout box, the rest of the text should not get shaped.
+	skb_layout_t* layout = skb_layout_create_utf8(temp_alloc, &layout_params, text, text_count, SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(text_attributes));
+	ENSURE(layout != NULL);
+	ENSURE(skb_layout_get_flags(layout) & SKB_LAYOUT_IS_PARTIALLY_SHAPED);
+
+	const skb_range_t shaped_text_range = skb_layout_get_shaped_text_range(layout);
+	ENSURE(shaped_text_range.end > 0);
+	ENSURE(shaped_text_range.end < skb_layout_get_text_count(layout));
+
+	ENSURE(skb_layout_get_lines_count(layout) == 1);
+	const skb_layout_line_t* lines = skb_layout_get_lines(layout);
+	ENSURE(lines[0].flags & SKB_LAYOUT_LINE_IS_TRUNCATED);
+
+	skb_layout_destroy(layout);
+
+	// Without overflow handling all of the text is shaped.
+	layout_params.layout_attributes = (skb_attribute_set_t){0};
+	layout = skb_layout_create_utf8(temp_alloc, &layout_params, text, text_count, SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(text_attributes));
+	ENSURE(layout != NULL);
+	ENSURE((skb_layout_get_flags(layout) & SKB_LAYOUT_IS_PARTIALLY_SHAPED) == 0);
+	ENSURE(skb_layout_get_shaped_text_range(layout).end == skb_layout_get_text_count(layout));
+
+	skb_layout_destroy(layout);
+	skb_font_collection_destroy(font_collection);
+	skb_temp_alloc_destroy(temp_alloc);
+
+	return 0;
+}
+
+// Returns true if the glyph range of each layout run covers exactly the glyphs of its clusters.
+static bool test__layout_run_glyphs_match_clusters(const skb_layout_t* layout)
+{
+	const skb_cluster_t* clusters = skb_layout_get_clusters(layout);
+	const skb_layout_run_t* layout_runs = skb_layout_get_layout_runs(layout);
+	for (int32_t i = 0; i < skb_layout_get_layout_runs_count(layout); i++) {
+		const skb_layout_run_t* run = &layout_runs[i];
+		int32_t glyphs_count = 0;
+		for (int32_t ci = run->cluster_range.start; ci < run->cluster_range.end; ci++) {
+			const skb_cluster_t* cluster = &clusters[ci];
+			if (cluster->glyphs_offset < run->glyph_range.start || cluster->glyphs_offset + cluster->glyphs_count > run->glyph_range.end)
+				return false;
+			glyphs_count += cluster->glyphs_count;
+		}
+		if (glyphs_count != run->glyph_range.end - run->glyph_range.start)
+			return false;
+	}
+	return true;
+}
+
+static int test_partial_shaping_rtl(void)
+{
+	skb_temp_alloc_t* temp_alloc = skb_temp_alloc_create(1024);
+	ENSURE(temp_alloc != NULL);
+
+	skb_font_collection_t* font_collection = skb_font_collection_create();
+	skb_font_handle_t font_handle = skb_font_collection_add_font(font_collection, "data/IBMPlexSansArabic-Regular.ttf", SKB_FONT_FAMILY_DEFAULT, NULL);
+	ENSURE(font_handle);
+
+	// Arabic text, longer than the chunk size used for partial shaping (256 codepoints).
+	char text[8192] = {0};
+	int32_t text_count = 0;
+	for (int32_t i = 0; i < 200; i++)
+		text_count += snprintf(text + text_count, sizeof(text) - text_count, "\xd9\x85\xd8\xb1\xd8\xad\xd8\xa8\xd8\xa7 \xd8\xa8\xd8\xa7\xd9\x84\xd8\xb9\xd8\xa7\xd9\x84\xd9\x85 ");
+
+	skb_attribute_t layout_attributes[] = {
+		skb_attribute_make_text_wrap(SKB_WRAP_WORD),
+		skb_attribute_make_text_overflow(SKB_OVERFLOW_CLIP),
+	};
+	skb_layout_params_t layout_params = {
+		.font_collection = font_collection,
+		.layout_width = 2000.f,
+		.layout_height = -1.f,
+		.layout_attributes = SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(layout_attributes),
+	};
+	skb_attribute_t text_attributes[] = {
+		skb_attribute_make_font_size(15.f),
+	};
+
+	// Without height constraint all of the text is shaped at once.
+	skb_layout_t* ref_layout = skb_layout_create_utf8(temp_alloc, &layout_params, text, text_count, SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(text_attributes));
+	ENSURE(ref_layout != NULL);
+	ENSURE(skb_layout_get_text_count(ref_layout) > 512);
+	ENSURE((skb_layout_get_flags(ref_layout) & SKB_LAYOUT_IS_PARTIALLY_SHAPED) == 0);
+	ENSURE(skb_layout_get_lines_count(ref_layout) > 1);
+	ENSURE(test__layout_run_glyphs_match_clusters(ref_layout));
+
+	// With height constraint the text is shaped in chunks, and the first line spans over the chunk boundary.
+	layout_params.layout_height = 20.f;
+	skb_layout_t* layout = skb_layout_create_utf8(temp_alloc, &layout_params, text, text_count, SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(text_attributes));
+	ENSURE(layout != NULL);
+	ENSURE(skb_layout_get_flags(layout) & SKB_LAYOUT_IS_PARTIALLY_SHAPED);
+	ENSURE(test__layout_run_glyphs_match_clusters(layout));
+
+	const skb_layout_line_t* ref_line = &skb_layout_get_lines(ref_layout)[0];
+	const skb_layout_line_t* line = &skb_layout_get_lines(layout)[0];
+	ENSURE(ref_line->text_range.end > 256);
+	ENSURE(line->text_range.start == ref_line->text_range.start && line->text_range.end == ref_line->text_range.end);
+	ENSURE(skb_equalsf(line->bounds.width, ref_line->bounds.width, 0.01f));
+
+	skb_layout_destroy(layout);
+	skb_layout_destroy(ref_layout);
+	skb_font_collection_destroy(font_collection);
+	skb_temp_alloc_destroy(temp_alloc);
+
+	return 0;
+}
+
+static int test_layout_from_shaped_runs(void)
+{
+	skb_temp_alloc_t* temp_alloc = skb_temp_alloc_create(1024);
+	ENSURE(temp_alloc != NULL);
+
+	skb_font_collection_t* font_collection = skb_font_collection_create();
+	skb_font_handle_t font_handle = skb_font_collection_add_font(font_collection, "data/IBMPlexSans-Regular.ttf", SKB_FONT_FAMILY_DEFAULT, NULL);
+	ENSURE(font_handle);
+
+	skb_layout_params_t layout_params = {
+		.font_collection = font_collection,
+	};
+	skb_attribute_t attributes[] = {
+		skb_attribute_make_font_size(15.f),
+	};
+	skb_content_run_t runs[] = {
+		skb_content_run_make_utf8("Hello world", -1, SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(attributes), 0),
+	};
+
+	// Shape the text normally, and use the result as the pre-shaped input.
+	skb_layout_t* ref_layout = skb_layout_create_from_runs(temp_alloc, &layout_params, runs, SKB_COUNTOF(runs));
+	ENSURE(ref_layout != NULL);
+	ENSURE(skb_layout_get_layout_runs_count(ref_layout) == 1);
+	const skb_layout_run_t* ref_run = &skb_layout_get_layout_runs(ref_layout)[0];
+
+	skb_glyph_t glyphs[32];
+	skb_cluster_t clusters[32];
+	const int32_t glyphs_count = skb_layout_get_glyphs_count(ref_layout);
+	const int32_t clusters_count = skb_layout_get_clusters_count(ref_layout);
+	ENSURE(glyphs_count <= (int32_t)SKB_COUNTOF(glyphs));
+	ENSURE(clusters_count <= (int32_t)SKB_COUNTOF(clusters));
+	for (int32_t i = 0; i < glyphs_count; i++) {
+		glyphs[i] = skb_layout_get_glyphs(ref_layout)[i];
+		glyphs[i].offset_x = 0.f;
+		glyphs[i].offset_y = 0.f;
+	}
+	for (int32_t i = 0; i < clusters_count; i++)
+		clusters[i] = skb_layout_get_clusters(ref_layout)[i];
+
+	const skb_shaped_run_t shaped_runs[] = {
+		{
+			.text_range = { .start = 0, .end = skb_layout_get_text_count(ref_layout) },
+			.glyphs = glyphs,
+			.glyphs_count = glyphs_count,
+			.clusters = clusters,
+			.clusters_count = clusters_count,
+			.font_handle = ref_run->font_handle,
+			.font_size = ref_run->font_size,
+			.script = ref_run->script,
+			.bidi_level = ref_run->bidi_level,
+		},
+	};
+
+	skb_layout_t* layout = skb_layout_create_from_shaped_runs(temp_alloc, &layout_params, runs, SKB_COUNTOF(runs), shaped_runs, SKB_COUNTOF(shaped_runs));
+	ENSURE(layout != NULL);
+	ENSURE(skb_layout_get_lines_count(layout) == 1);
+	ENSURE(skb_layout_get_glyphs_count(layout) == glyphs_count);
+	ENSURE(skb_layout_get_layout_runs_count(layout) == 1);
+	ENSURE(skb_layout_get_layout_runs(layout)[0].font_handle == ref_run->font_handle);
+	ENSURE(skb_equalsf(skb_layout_get_bounds(layout).width, skb_layout_get_bounds(ref_layout).width, 0.01f));
+
+	// The line breaks are still calculated, the text should wrap at the space.
+	skb_attribute_t layout_attributes[] = {
+		skb_attribute_make_text_wrap(SKB_WRAP_WORD),
+	};
+	layout_params.layout_width = skb_layout_get_bounds(ref_layout).width * 0.75f;
+	layout_params.layout_attributes = SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(layout_attributes);
+	ENSURE(skb_layout_set_from_shaped_runs(layout, temp_alloc, &layout_params, runs, SKB_COUNTOF(runs), shaped_runs, SKB_COUNTOF(shaped_runs)));
+	ENSURE(skb_layout_get_lines_count(layout) == 2);
+
+	// Malformed runs should fail instead of reading out of bounds.
+	clusters[clusters_count - 1].glyphs_count = glyphs_count + 1;
+	ENSURE(!skb_layout_set_from_shaped_runs(layout, temp_alloc, &layout_params, runs, SKB_COUNTOF(runs), shaped_runs, SKB_COUNTOF(shaped_runs)));
+	ENSURE(skb_layout_get_glyphs_count(layout) == 0);
+	ENSURE(skb_layout_get_lines_count(layout) == 0);
+	clusters[clusters_count - 1] = skb_layout_get_clusters(ref_layout)[clusters_count - 1];
+	clusters[0].glyphs_count = 0;
+	ENSURE(!skb_layout_set_from_shaped_runs(layout, temp_alloc, &layout_params, runs, SKB_COUNTOF(runs), shaped_runs, SKB_COUNTOF(shaped_runs)));
+	clusters[0] = skb_layout_get_clusters(ref_layout)[0];
+	clusters[0].text_count = 0;
+	ENSURE(!skb_layout_set_from_shaped_runs(layout, temp_alloc, &layout_params, runs, SKB_COUNTOF(runs), shaped_runs, SKB_COUNTOF(shaped_runs)));
+	clusters[0] = skb_layout_get_clusters(ref_layout)[0];
+
+	skb_shaped_run_t bad_runs[] = { shaped_runs[0] };
+	bad_runs[0].text_range.end = skb_layout_get_text_count(ref_layout) + 1;
+	ENSURE(skb_layout_create_from_shaped_runs(temp_alloc, &layout_params, runs, SKB_COUNTOF(runs), bad_runs, SKB_COUNTOF(bad_runs)) == NULL);
+	bad_runs[0] = shaped_runs[0];
+	bad_runs[0].font_handle = 0;
+	ENSURE(skb_layout_create_from_shaped_runs(temp_alloc, &layout_params, runs, SKB_COUNTOF(runs), bad_runs, SKB_COUNTOF(bad_runs)) == NULL);
+
+	skb_layout_destroy(layout);
+	skb_layout_destroy(ref_layout);
+	skb_font_collection_destroy(font_collection);
+	skb_temp_alloc_destroy(temp_alloc);
+
+	return 0;
+}
+
+static int test_relayout_at_scale(void)
+{
+	skb_temp_alloc_t* temp_alloc = skb_temp_alloc_create(1024);
+	ENSURE(temp_alloc != NULL);
+
+	skb_font_collection_t* font_collection = skb_font_collection_create();
+	skb_font_handle_t font_handle = skb_font_collection_add_font(font_collection, "data/IBMPlexSans-Regular.ttf", SKB_FONT_FAMILY_DEFAULT, NULL);
+	ENSURE(font_handle);
+
+	skb_layout_params_t layout_params = {
+		.font_collection = font_collection,
+	};
+	skb_attribute_t attributes[] = {
+		skb_attribute_make_font_size(15.f),
+	};
+	skb_attribute_t attributes_x2[] = {
+		skb_attribute_make_font_size(30.f),
+	};
+	const char* text = "Hello world";
+
+	skb_layout_t* ref_layout = skb_layout_create_utf8(temp_alloc, &layout_params, text, -1, SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(attributes_x2));
+	ENSURE(ref_layout != NULL);
+
+	// First relayout shapes the text, the second one scales the shaped glyphs, both should match the layout at double size.
+	skb_layout_t* layout = skb_layout_create_utf8(temp_alloc, &layout_params, text, -1, SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(attributes));
+	ENSURE(layout != NULL);
+	skb_layout_relayout_at_scale(layout, temp_alloc, 2.f);
+	ENSURE(skb_equalsf(skb_layout_get_bounds(layout).width, skb_layout_get_bounds(ref_layout).width, 0.01f));
+	ENSURE(skb_equalsf(skb_layout_get_bounds(layout).height, skb_layout_get_bounds(ref_layout).height, 0.01f));
+
+	skb_layout_relayout_at_scale(layout, temp_alloc, 1.f);
+	skb_layout_relayout_at_scale(layout, temp_alloc, 2.f);
+	ENSURE(skb_layout_get_font_scale(layout) == 2.f);
+	ENSURE(skb_layout_get_glyphs_count(layout) == skb_layout_get_glyphs_count(ref_layout));
+	ENSURE(skb_equalsf(skb_layout_get_bounds(layout).width, skb_layout_get_bounds(ref_layout).width, 0.01f));
+	ENSURE(skb_equalsf(skb_layout_get_bounds(layout).height, skb_layout_get_bounds(ref_layout).height, 0.01f));
+
+	// Fit the text in half of the reference width.
+	const float fit_width = skb_layout_get_bounds(ref_layout).width * 0.5f;
+	skb_layout_destroy(layout);
+	layout_params.layout_width = fit_width;
+	layout = skb_layout_create_utf8(temp_alloc, &layout_params, text, -1, SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(attributes));
+	ENSURE(layout != NULL);
+
+	const float fit_scale = skb_layout_fit_font_size(layout, temp_alloc, 0.1f, 4.f);
+	ENSURE(fit_scale > 0.5f && fit_scale < 2.f);
+	ENSURE(skb_layout_get_font_scale(layout) == fit_scale);
+	ENSURE(skb_layout_get_bounds(layout).width <= fit_width + 0.01f);
+
+	skb_layout_destroy(layout);
+	skb_layout_destroy(ref_layout);
+	skb_font_collection_destroy(font_collection);
+	skb_temp_alloc_destroy(temp_alloc);
+
+	return 0;
+}
+
+static int test_layout_snapshot(void)
+{
+	skb_temp_alloc_t* temp_alloc = skb_temp_alloc_create(1024);
+	ENSURE(temp_alloc != NULL);
+
+	skb_font_collection_t* font_collection = skb_font_collection_create();
+	skb_font_handle_t font_handle = skb_font_collection_add_font(font_collection, "data/IBMPlexSans-Regular.ttf", SKB_FONT_FAMILY_DEFAULT, NULL);
+	ENSURE(font_handle);
+
+	skb_layout_params_t layout_params = {
+		.font_collection = font_collection,
+		.layout_width = 100.f,
+	};
+	skb_attribute_t attributes[] = {
+		skb_attribute_make_font_size(15.f),
+		skb_attribute_make_lang("fi-FI"),
+	};
+
+	skb_layout_t* layout = skb_layout_create_utf8(temp_alloc, &layout_params, "Hello world, this text wraps.", -1, SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(attributes));
+	ENSURE(layout != NULL);
+
+	const int32_t data_count = skb_layout_serialize(layout, NULL, 0);
+	ENSURE(data_count > 0);
+	uint8_t* data = skb_malloc(data_count);
+	ENSURE(skb_layout_serialize(layout, data, data_count) == data_count);
+
+	skb_layout_params_t load_params = {
+		.font_collection = font_collection,
+	};
+	skb_layout_t* loaded_layout = skb_layout_create(NULL);
+	ENSURE(skb_layout_deserialize(loaded_layout, &load_params, data, data_count));
+	ENSURE(skb_layout_get_params(loaded_layout)->layout_width == 100.f);
+	ENSURE(skb_layout_get_text_count(loaded_layout) == skb_layout_get_text_count(layout));
+	ENSURE(skb_layout_get_lines_count(loaded_layout) == skb_layout_get_lines_count(layout));
+	ENSURE(skb_layout_get_glyphs_count(loaded_layout) == skb_layout_get_glyphs_count(layout));
+	ENSURE(skb_layout_get_layout_runs_count(loaded_layout) == skb_layout_get_layout_runs_count(layout));
+	ENSURE(skb_layout_get_layout_runs(loaded_layout)[0].font_handle == font_handle);
+	ENSURE(memcmp(skb_layout_get_glyphs(loaded_layout), skb_layout_get_glyphs(layout), sizeof(skb_glyph_t) * skb_layout_get_glyphs_count(layout)) == 0);
+	ENSURE(skb_layout_get_bounds(loaded_layout).width == skb_layout_get_bounds(layout).width);
+
+	const skb_attribute_set_t run_attributes = skb_layout_get_layout_run_attributes(loaded_layout, &skb_layout_get_layout_runs(loaded_layout)[0]);
+	ENSURE(skb_attributes_get_lang(run_attributes, NULL) == skb_attribute_make_lang("fi-FI").lang.lang);
+
+	// Truncated snapshot, or missing font should fail.
+	ENSURE(!skb_layout_deserialize(loaded_layout, &load_params, data, data_count / 2));
+	ENSURE(skb_layout_get_text_count(loaded_layout) == 0);
+
+	// Snapshot with out of range index should fail. Find the glyphs in the snapshot and corrupt the cluster index of the first glyph.
+	const skb_glyph_t* glyphs = skb_layout_get_glyphs(layout);
+	const int32_t glyphs_size = (int32_t)sizeof(skb_glyph_t) * skb_layout_get_glyphs_count(layout);
+	int32_t glyphs_offset = -1;
+	for (int32_t i = 0; i + glyphs_size <= data_count && glyphs_offset == -1; i += 8) {
+		if (memcmp(data + i, glyphs, glyphs_size) == 0)
+			glyphs_offset = i;
+	}
+	ENSURE(glyphs_offset != -1);
+	uint8_t* corrupt_data = skb_malloc(data_count);
+	memcpy(corrupt_data, data, data_count);
+	skb_glyph_t corrupt_glyph = glyphs[0];
+	corrupt_glyph.cluster_idx = 100000;
+	memcpy(corrupt_data + glyphs_offset, &corrupt_glyph, sizeof(skb_glyph_t));
+	ENSURE(!skb_layout_deserialize(loaded_layout, &load_params, corrupt_data, data_count));
+	ENSURE(skb_layout_get_glyphs_count(loaded_layout) == 0);
+
+	// Snapshot with an empty cluster should fail.
+	const skb_cluster_t* clusters = skb_layout_get_clusters(layout);
+	const int32_t clusters_size = (int32_t)sizeof(skb_cluster_t) * skb_layout_get_clusters_count(layout);
+	int32_t clusters_offset = -1;
+	for (int32_t i = 0; i + clusters_size <= data_count && clusters_offset == -1; i += 4) {
+		if (memcmp(data + i, clusters, clusters_size) == 0)
+			clusters_offset = i;
+	}
+	ENSURE(clusters_offset != -1);
+	memcpy(corrupt_data, data, data_count);
+	skb_cluster_t corrupt_cluster = clusters[0];
+	corrupt_cluster.glyphs_count = 0;
+	memcpy(corrupt_data + clusters_offset, &corrupt_cluster, sizeof(skb_cluster_t));
+	ENSURE(!skb_layout_deserialize(loaded_layout, &load_params, corrupt_data, data_count));
+	skb_free(corrupt_data);
+
+	skb_font_collection_t* empty_font_collection = skb_font_collection_create();
+	load_params.font_collection = empty_font_collection;
+	ENSURE(!skb_layout_deserialize(loaded_layout, &load_params, data, data_count));
+
+	skb_free(data);
+	skb_layout_destroy(loaded_layout);
+	skb_layout_destroy(layout);
+	skb_font_collection_destroy(empty_font_collection);
+	skb_font_collection_destroy(font_collection);
+	skb_temp_alloc_destroy(temp_alloc);
+
+	return 0;
+}
+
+static int test_text_is_shared(void)
+{
+	skb_temp_alloc_t* temp_alloc = skb_temp_alloc_create(1024);
+	ENSURE(temp_alloc != NULL);
+
+	skb_font_collection_t* font_collection = skb_font_collection_create();
+	skb_font_handle_t font_handle = skb_font_collection_add_font(font_collection, "data/IBMPlexSans-Regular.ttf", SKB_FONT_FAMILY_DEFAULT, NULL);
+	ENSURE(font_handle);
+
+	skb_attribute_t attributes[] = {
+		skb_attribute_make_font_size(15.f),
+	};
+
+	skb_text_t* text = skb_text_create();
+	skb_text_append_utf8(text, "Hello ", -1, SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(attributes));
+	skb_text_append_utf8(text, "world", -1, (skb_attribute_set_t){0});
+
+	skb_layout_params_t layout_params = {
+		.font_collection = font_collection,
+	};
+	skb_layout_t* ref_layout = skb_layout_create_utf8(temp_alloc, &layout_params, "Hello world", -1, SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(attributes));
+	ENSURE(ref_layout != NULL);
+
+	// Layout from text shares the codepoints and reuses the grapheme breaks of the text, and should match the layout created from utf-8.
+	skb_layout_t* layout = skb_layout_create_from_text(temp_alloc, &layout_params, text, SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(attributes));
+	ENSURE(layout != NULL);
+	ENSURE(skb_layout_get_text(layout) == skb_text_get_utf32(text));
+	ENSURE(skb_layout_get_text_count(layout) == skb_text_get_utf32_count(text));
+	ENSURE(skb_layout_get_glyphs_count(layout) == skb_layout_get_glyphs_count(ref_layout));
+	ENSURE(skb_equalsf(skb_layout_get_bounds(layout).width, skb_layout_get_bounds(ref_layout).width, 0.01f));
+	const skb_text_property_t* props = skb_layout_get_text_properties(layout);
+	const skb_text_property_t* ref_props = skb_layout_get_text_properties(ref_layout);
+	for (int32_t i = 0; i < skb_layout_get_text_count(layout); i++)
+		ENSURE(props[i].flags == ref_props[i].flags);
+
+	// A copy of the layout shares the same codepoints.
+	skb_layout_t* layout_copy = skb_layout_create_copy(layout);
+	ENSURE(skb_layout_get_text(layout_copy) == skb_layout_get_text(layout));
+
+	// The text copies the shared codepoints on write, the layout stays valid when the source text is changed and destroyed.
+	const uint32_t* shared_utf32 = skb_layout_get_text(layout);
+	skb_text_remove(text, (skb_text_range_t){ .start.offset = 0, .end.offset = 6 });
+	ENSURE(skb_text_get_utf32(text) != shared_utf32);
+	ENSURE(skb_layout_get_text(layout) == shared_utf32);
+	for (int32_t i = 0; i < 64; i++)
+		skb_text_append_utf8(text, "reallocate ", -1, (skb_attribute_set_t){0});
+	skb_text_destroy(text);
+	skb_layout_destroy(layout_copy);
+
+	ENSURE(skb_layout_get_text_count(layout) == skb_layout_get_text_count(ref_layout));
+	ENSURE(memcmp(skb_layout_get_text(layout), skb_layout_get_text(ref_layout), sizeof(uint32_t) * skb_layout_get_text_count(layout)) == 0);
+	skb_layout_relayout_at_scale(layout, temp_alloc, 2.f);
+	ENSURE(skb_layout_get_glyphs_count(layout) == skb_layout_get_glyphs_count(ref_layout));
+
+	// Compact text is copied.
+	skb_text_t* compact_text = skb_text_create();
+	skb_text_append_utf8(compact_text, "Hello world", -1, (skb_attribute_set_t){0});
+	skb_text_compact(compact_text);
+	skb_layout_set_from_text(layout, temp_alloc, &layout_params, compact_text, SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(attributes));
+	skb_text_destroy(compact_text);
+	ENSURE(skb_layout_get_text_count(layout) == skb_layout_get_text_count(ref_layout));
+	ENSURE(memcmp(skb_layout_get_text(layout), skb_layout_get_text(ref_layout), sizeof(uint32_t) * skb_layout_get_text_count(layout)) == 0);
+
+	skb_layout_destroy(layout);
+	skb_layout_destroy(ref_layout);
+	skb_font_collection_destroy(font_collection);
+	skb_temp_alloc_destroy(temp_alloc);
+
+	return 0;
+}
+
+typedef struct serial_parallel_for_context_t {
+	int32_t max_task_count;
+} serial_parallel_for_context_t;
+
+static void serial_parallel_for(int32_t task_count, skb_task_func_t* task_func, void* task_context, void* context)
+{
+	serial_parallel_for_context_t* ctx = context;
+	ctx->max_task_count = skb_maxi(ctx->max_task_count, task_count);
+	// Run in reverse order, the tasks should not depend on each other.
+	for (int32_t i = task_count - 1; i >= 0; i--)
+		task_func(i, task_context);
+}
+
+static int test_parallel_text_analysis(void)
+{
+	skb_temp_alloc_t* temp_alloc = skb_temp_alloc_create(1024);
+	ENSURE(temp_alloc != NULL);
+
+	skb_font_collection_t* font_collection = skb_font_collection_create();
+	skb_font_handle_t font_handle = skb_font_collection_add_font(font_collection, "data/IBMPlexSans-Regular.ttf", SKB_FONT_FAMILY_DEFAULT, NULL);
+	ENSURE(font_handle);
+
+	skb_attribute_t attributes[] = {
+		skb_attribute_make_font_size(15.f),
+	};
+
+	// Random text with characters that have context dependent breaks.
+	static const char* pieces[] = {
+		"a", "b", "Z", "7", "word", " ", " ", "  ", "\t", ".", ",", "(", ")", "\"", "-", "1.5", "$",
+		"\xcc\x81",						// combining acute accent
+		"\xe4\xb8\xad",					// CJK ideograph
+		"\xe0\xb8\x81",					// Thai
+		"\xd7\x90",						// Hebrew
+		"\xf0\x9f\x91\x8d",				// emoji
+		"\xf0\x9f\x8f\xbd",				// emoji modifier
+		"\xe2\x80\x8d",					// zero width joiner
+		"\xf0\x9f\x87\xab",				// regional indicator
+		"\xf0\x9f\x87\xae",				// regional indicator
+		"\xc2\xa0",						// no-break space
+	};
+	const int32_t text_cap = 200000;
+	char* text = skb_malloc(text_cap);
+	int32_t text_count = 0;
+	uint32_t seed = 12345;
+	while (text_count < text_cap - 16) {
+		seed = seed * 1664525u + 1013904223u;
+		const char* piece = pieces[(seed >> 16) % SKB_COUNTOF(pieces)];
+		const int32_t piece_count = (int32_t)strlen(piece);
+		memcpy(text + text_count, piece, piece_count);
+		text_count += piece_count;
+	}
+
+	skb_layout_params_t layout_params = {
+		.font_collection = font_collection,
+	};
+	skb_layout_t* ref_layout = skb_layout_create_utf8(temp_alloc, &layout_params, text, text_count, SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(attributes));
+	ENSURE(ref_layout != NULL);
+
+	serial_parallel_for_context_t parallel_for_context = {0};
+	layout_params.parallel_for = serial_parallel_for;
+	layout_params.parallel_for_context = &parallel_for_context;
+	skb_layout_t* layout = skb_layout_create_utf8(temp_alloc, &layout_params, text, text_count, SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(attributes));
+	ENSURE(layout != NULL);
+	ENSURE(parallel_for_context.max_task_count > 1);
+
+	// Chunked analysis should match the serial analysis.
+	ENSURE(skb_layout_get_text_count(layout) == skb_layout_get_text_count(ref_layout));
+	const skb_text_property_t* props = skb_layout_get_text_properties(layout);
+	const skb_text_property_t* ref_props = skb_layout_get_text_properties(ref_layout);
+	for (int32_t i = 0; i < skb_layout_get_text_count(layout); i++) {
+		ENSURE(props[i].flags == ref_props[i].flags);
+		ENSURE(props[i].script == ref_props[i].script);
+	}
+	ENSURE(skb_layout_get_lines_count(layout) == skb_layout_get_lines_count(ref_layout));
+
+	skb_layout_destroy(layout);
+	skb_layout_destroy(ref_layout);
+	skb_free(text);
+	skb_font_collection_destroy(font_collection);
+	skb_temp_alloc_destroy(temp_alloc);
+
+	return 0;
+}
+
 int layout_tests(void)
 {
 	RUN_SUBTEST(test_init);
 	RUN_SUBTEST(test_missing_script);
+	RUN_SUBTEST(test_shaping_across_paint_runs);
+	RUN_SUBTEST(test_partial_shaping_single_line);
+	RUN_SUBTEST(test_partial_shaping_rtl);
+	RUN_SUBTEST(test_layout_from_shaped_runs);
+	RUN_SUBTEST(test_relayout_at_scale);
+	RUN_SUBTEST(test_layout_snapshot);
+	RUN_SUBTEST(test_text_is_shared);
+	RUN_SUBTEST(test_parallel_text_analysis);
 	return 0;
 }
@@ -1,8 +1,10 @@
 // SPDX-FileCopyrightText: 2025 Mikko Mononen
 // SPDX-License-Identifier: MIT
 
+#include <string.h>
 #include "test_macros.h"
 #include "skb_layout_cache.h"
+#include "skb_font_collection.h"
 
 static int test_init(void)
 {
@@ -14,8 +16,81 @@ static int test_init(void)
 	return 0;
 }
 
+static int test_paint_only_change(void)
+{
+	skb_temp_alloc_t* temp_alloc = skb_temp_alloc_create(1024);
+	ENSURE(temp_alloc != NULL);
+
+	skb_font_collection_t* font_collection = skb_font_collection_create();
+	skb_font_handle_t font_handle = skb_font_collection_add_font(font_collection, "data/IBMPlexSans-Regular.ttf", SKB_FONT_FAMILY_DEFAULT, NULL);
+	ENSURE(font_handle);
+
+	skb_layout_cache_t* layout_cache = skb_layout_cache_create();
+	ENSURE(layout_cache != NULL);
+
+	skb_layout_params_t layout_params = {
+		.font_collection = font_collection,
+	};
+	skb_attribute_t red_attributes[] = {
+		skb_attribute_make_font_size(15.f),
+		skb_attribute_make_paint_color(SKB_PAINT_TEXT, SKB_PAINT_STATE_DEFAULT, skb_rgba(255,0,0,255)),
+	};
+	skb_attribute_t blue_attributes[] = {
+		skb_attribute_make_font_size(15.f),
+		skb_attribute_make_paint_color(SKB_PAINT_TEXT, SKB_PAINT_STATE_DEFAULT, skb_rgba(0,0,255,255)),
+	};
+	skb_attribute_t large_attributes[] = {
+		skb_attribute_make_font_size(30.f),
+		skb_attribute_make_paint_color(SKB_PAINT_TEXT, SKB_PAINT_STATE_DEFAULT, skb_rgba(0,0,255,255)),
+	};
+
+	// Layouts which differ only by paint should have separate layouts with same shape.
+	const skb_layout_t* red_layout = skb_layout_cache_get_utf8(layout_cache, temp_alloc, &layout_params, "Hello", -1, SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(red_attributes));
+	ENSURE(red_layout != NULL);
+	ENSURE(skb_layout_get_layout_runs_count(red_layout) > 0);
+	skb_attribute_set_t run_attributes = skb_layout_get_layout_run_attributes(red_layout, &skb_layout_get_layout_runs(red_layout)[0]);
+	ENSURE(skb_attributes_get_paint(SKB_PAINT_TEXT, SKB_PAINT_STATE_DEFAULT, run_attributes, NULL).color.r == 255);
+
+	const skb_layout_t* blue_layout = skb_layout_cache_get_utf8(layout_cache, temp_alloc, &layout_params, "Hello", -1, SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(blue_attributes));
+	ENSURE(blue_layout != NULL);
+	ENSURE(blue_layout != red_layout);
+	ENSURE(skb_layout_get_glyphs_count(blue_layout) == skb_layout_get_glyphs_count(red_layout));
+	ENSURE(skb_layout_get_glyphs(blue_layout) == skb_layout_get_glyphs(red_layout));
+	run_attributes = skb_layout_get_layout_run_attributes(blue_layout, &skb_layout_get_layout_runs(blue_layout)[0]);
+	ENSURE(skb_attributes_get_paint(SKB_PAINT_TEXT, SKB_PAINT_STATE_DEFAULT, run_attributes, NULL).color.b == 255);
+
+	// The layout returned earlier should keep its paint.
+	run_attributes = skb_layout_get_layout_run_attributes(red_layout, &skb_layout_get_layout_runs(red_layout)[0]);
+	ENSURE(skb_attributes_get_paint(SKB_PAINT_TEXT, SKB_PAINT_STATE_DEFAULT, run_attributes, NULL).color.r == 255);
+
+	// Requesting the same paint again should return the same layout.
+	ENSURE(skb_layout_cache_get_utf8(layout_cache, temp_alloc, &layout_params, "Hello", -1, SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(red_attributes)) == red_layout);
+
+	// Layout affecting change should create a new layout.
+	const skb_layout_t* large_layout = skb_layout_cache_get_utf8(layout_cache, temp_alloc, &layout_params, "Hello", -1, SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(large_attributes));
+	ENSURE(large_layout != blue_layout);
+	ENSURE(skb_layout_get_glyphs(large_layout) != skb_layout_get_glyphs(blue_layout));
+
+	// Evicting one paint variant should keep the shared glyphs of the others.
+	for (int32_t i = 0; i < 101; i++) {
+		ENSURE(skb_layout_cache_get_utf8(layout_cache, temp_alloc, &layout_params, "Hello", -1, SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(blue_attributes)) == blue_layout);
+		skb_layout_cache_compact(layout_cache);
+	}
+	run_attributes = skb_layout_get_layout_run_attributes(blue_layout, &skb_layout_get_layout_runs(blue_layout)[0]);
+	ENSURE(skb_attributes_get_paint(SKB_PAINT_TEXT, SKB_PAINT_STATE_DEFAULT, run_attributes, NULL).color.b == 255);
+	red_layout = skb_layout_cache_get_utf8(layout_cache, temp_alloc, &layout_params, "Hello", -1, SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(red_attributes));
+	ENSURE(skb_layout_get_glyphs(red_layout) == skb_layout_get_glyphs(blue_layout));
+
+	skb_layout_cache_destroy(layout_cache);
+	skb_font_collection_destroy(font_collection);
+	skb_temp_alloc_destroy(temp_alloc);
+
+	return 0;
+}
+
 int layout_cache_tests(void)
 {
 	RUN_SUBTEST(test_init);
+	RUN_SUBTEST(test_paint_only_change);
 	return 0;
 }
@@ -0,0 +1,213 @@
+// SPDX-FileCopyrightText: 2025 Mikko Mononen
+// SPDX-License-Identifier: MIT
+
+#include <string.h>
+#include "test_macros.h"
+#include "skb_mesh_cache.h"
+#include "skb_rasterizer.h"
+#include "skb_font_collection.h"
+
+static int test_init(void)
+{
+	skb_mesh_cache_t* mesh_cache = skb_mesh_cache_create(0);
+	ENSURE(mesh_cache != NULL);
+	ENSURE(skb_mesh_cache_get_memory_usage(mesh_cache) == 0);
+
+	skb_mesh_cache_destroy(mesh_cache);
+
+	return 0;
+}
+
+typedef struct test__instances_t {
+	skb_glyph_mesh_instance_t instances[16];
+	int32_t instances_count;
+} test__instances_t;
+
+static void test__collect_instance(const skb_glyph_mesh_instance_t* instance, void* context)
+{
+	test__instances_t* ctx = (test__instances_t*)context;
+	if (ctx->instances_count < (int32_t)SKB_COUNTOF(ctx->instances))
+		ctx->instances[ctx->instances_count++] = *instance;
+}
+
+// Returns true if the triangle edges which do not cancel out form closed loops.
+static bool test__is_watertight(const skb_glyph_mesh_t* mesh)
+{
+	const int32_t max_edges = mesh->interior_indices_count + mesh->curve_indices_count;
+	int32_t* edges = skb_malloc(sizeof(int32_t) * 2 * max_edges);
+	int32_t edges_count = 0;
+
+	for (int32_t set = 0; set < 2; set++) {
+		const uint16_t* indices = set == 0 ? mesh->interior_indices : mesh->curve_indices;
+		const int32_t indices_count = set == 0 ? mesh->interior_indices_count : mesh->curve_indices_count;
+		for (int32_t i = 0; i < indices_count; i++) {
+			const int32_t from = indices[i];
+			const int32_t to = indices[(i % 3) == 2 ? i - 2 : i + 1];
+			// Cancel out with opposite edge.
+			bool cancelled = false;
+			for (int32_t j = 0; j < edges_count; j++) {
+				if (edges[j*2] == to && edges[j*2+1] == from) {
+					edges[j*2] = edges[(edges_count-1)*2];
+					edges[j*2+1] = edges[(edges_count-1)*2+1];
+					edges_count--;
+					cancelled = true;
+					break;
+				}
+			}
+			if (!cancelled) {
+				edges[edges_count*2] = from;
+				edges[edges_count*2+1] = to;
+				edges_count++;
+			}
+		}
+	}
+
+	bool balanced = edges_count > 0;
+	for (int32_t i = 0; i < mesh->points_count && balanced; i++) {
+		int32_t degree = 0;
+		for (int32_t j = 0; j < edges_count; j++) {
+			if (edges[j*2] == i) degree++;
+			if (edges[j*2+1] == i) degree--;
+		}
+		balanced = degree == 0;
+	}
+
+	skb_free(edges);
+
+	return balanced;
+}
+
+static int32_t test__triangle_winding(skb_vec2_t a, skb_vec2_t b, skb_vec2_t c, skb_vec2_t pt, bool is_curve)
+{
+	const float d = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+	if (d == 0.f)
+		return 0;
+	const float lb = ((pt.x - a.x) * (c.y - a.y) - (pt.y - a.y) * (c.x - a.x)) / d;
+	const float lc = ((b.x - a.x) * (pt.y - a.y) - (b.y - a.y) * (pt.x - a.x)) / d;
+	const float la = 1.f - lb - lc;
+	if (la < 0.f || lb < 0.f || lc < 0.f)
+		return 0;
+	if (is_curve) {
+		// Loop-Blinn coordinates (0,0), (0.5,0), (1,1).
+		const float u = lb * 0.5f + lc;
+		const float v = lc;
+		if (u * u - v > 0.f)
+			return 0;
+	}
+	return d > 0.f ? 1 : -1;
+}
+
+static bool test__mesh_covers(const skb_glyph_mesh_t* mesh, skb_vec2_t pt)
+{
+	int32_t winding = 0;
+	for (int32_t i = 0; i < mesh->interior_indices_count; i += 3) {
+		const uint16_t* tri = &mesh->interior_indices[i];
+		winding += test__triangle_winding(mesh->points[tri[0]], mesh->points[tri[1]], mesh->points[tri[2]], pt, false);
+	}
+	for (int32_t i = 0; i < mesh->curve_indices_count; i += 3) {
+		const uint16_t* tri = &mesh->curve_indices[i];
+		winding += test__triangle_winding(mesh->points[tri[0]], mesh->points[tri[1]], mesh->points[tri[2]], pt, true);
+	}
+	return winding != 0;
+}
+
+static int test_glyph_meshes(void)
+{
+	skb_temp_alloc_t* temp_alloc = skb_temp_alloc_create(1024);
+	skb_rasterizer_t* rasterizer = skb_rasterizer_create(NULL);
+	skb_font_collection_t* font_collection = skb_font_collection_create();
+	skb_font_handle_t font_handle = skb_font_collection_add_font(font_collection, "data/IBMPlexSans-Regular.ttf", SKB_FONT_FAMILY_DEFAULT, NULL);
+	ENSURE(font_handle);
+
+	skb_mesh_cache_t* mesh_cache = skb_mesh_cache_create(1);
+	ENSURE(mesh_cache != NULL);
+
+	const float font_size = 64.f;
+	skb_layout_params_t layout_params = {
+		.font_collection = font_collection,
+	};
+	skb_attribute_t attributes[] = {
+		skb_attribute_make_font_size(font_size),
+	};
+	skb_layout_t* layout = skb_layout_create_utf8(temp_alloc, &layout_params, "Bo8 g", -1, SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(attributes));
+	ENSURE(layout != NULL);
+
+	// Space has no outline, and should be skipped.
+	test__instances_t ctx = {0};
+	skb_mesh_cache_iterate_layout_meshes(mesh_cache, layout, (skb_vec2_t){ 10.f, 20.f }, test__collect_instance, &ctx);
+	ENSURE(ctx.instances_count == 4);
+	ENSURE(skb_mesh_cache_get_memory_usage(mesh_cache) > 0);
+
+	const skb_glyph_t* glyphs = skb_layout_get_glyphs(layout);
+	const skb_layout_run_t* layout_runs = skb_layout_get_layout_runs(layout);
+
+	for (int32_t i = 0; i < ctx.instances_count; i++) {
+		const skb_glyph_mesh_instance_t* instance = &ctx.instances[i];
+		const skb_glyph_t* glyph = &glyphs[instance->glyph_idx];
+		const skb_layout_run_t* run = &layout_runs[instance->layout_run_idx];
+		const skb_glyph_mesh_t* mesh = instance->mesh;
+
+		ENSURE(instance->transform.xx == font_size);
+		ENSURE(instance->transform.dx == 10.f + glyph->offset_x);
+		ENSURE(instance->transform.dy == 20.f + glyph->offset_y);
+		ENSURE(mesh->curve_indices_count > 0);
+		ENSURE(test__is_watertight(mesh));
+
+		// Cached mesh should be returned for the same glyph.
+		ENSURE(skb_mesh_cache_get_glyph_mesh(mesh_cache, font_collection, run->font_handle, glyph->gid) == mesh);
+
+		// Compare the coverage of the mesh at pixel centers to the rasterized glyph.
+		const skb_font_t* font = skb_font_collection_get_font(font_collection, run->font_handle);
+		const skb_rect2i_t bounds = skb_rasterizer_get_glyph_dimensions(glyph->gid, font, font_size, 2);
+		skb_image_t image = {
+			.buffer = skb_malloc(bounds.width * bounds.height),
+			.width = bounds.width,
+			.height = bounds.height,
+			.stride_bytes = bounds.width,
+			.bpp = 1,
+		};
+		ENSURE(skb_rasterizer_draw_alpha_glyph(rasterizer, temp_alloc, glyph->gid, font, font_size, SKB_RASTERIZE_ALPHA_MASK, (float)-bounds.x, (float)-bounds.y, &image));
+
+		int32_t mismatches = 0;
+		int32_t covered_count = 0;
+		int32_t coverage_sum = 0;
+		for (int32_t y = 0; y < image.height; y++) {
+			for (int32_t x = 0; x < image.width; x++) {
+				const skb_vec2_t pt = {
+					((float)(x + bounds.x) + 0.5f) / font_size,
+					((float)(y + bounds.y) + 0.5f) / font_size,
+				};
+				const bool covered = test__mesh_covers(mesh, pt);
+				const uint8_t alpha = image.buffer[x + y * image.stride_bytes];
+				if ((covered && alpha < 64) || (!covered && alpha > 192))
+					mismatches++;
+				covered_count += covered ? 1 : 0;
+				coverage_sum += alpha;
+			}
+		}
+		ENSURE(covered_count > 0);
+		ENSURE(mismatches * 100 <= image.width * image.height);
+		ENSURE(skb_absf((float)covered_count - (float)coverage_sum / 255.f) < (float)covered_count * 0.05f);
+
+		skb_free(image.buffer);
+	}
+
+	// The memory budget is exceeded, compacting should evict all the meshes.
+	ENSURE(skb_mesh_cache_compact(mesh_cache));
+	ENSURE(skb_mesh_cache_get_memory_usage(mesh_cache) == 0);
+
+	skb_layout_destroy(layout);
+	skb_mesh_cache_destroy(mesh_cache);
+	skb_font_collection_destroy(font_collection);
+	skb_rasterizer_destroy(rasterizer);
+	skb_temp_alloc_destroy(temp_alloc);
+
+	return 0;
+}
+
+int mesh_cache_tests(void)
+{
+	RUN_SUBTEST(test_init);
+	RUN_SUBTEST(test_glyph_meshes);
+	return 0;
+}
@@ -1,8 +1,10 @@
 // SPDX-FileCopyrightText: 2025 Mikko Mononen
 // SPDX-License-Identifier: MIT
 
+#include <string.h>
 #include "test_macros.h"
 #include "skb_rasterizer.h"
+#include "skb_font_collection.h"
 
 static int test_init(void)
 {
@@ -14,8 +16,117 @@ static int test_init(void)
 	return 0;
 }
 
+static int32_t sum_coverage(const skb_image_t* image)
+{
+	int32_t sum = 0;
+	for (int32_t y = 0; y < image->height; y++) {
+		for (int32_t x = 0; x < image->width; x++)
+			sum += image->buffer[x + y * image->stride_bytes];
+	}
+	return sum;
+}
+
+static int test_glyph_effect(void)
+{
+	skb_temp_alloc_t* temp_alloc = skb_temp_alloc_create(1024);
+	skb_rasterizer_t* rasterizer = skb_rasterizer_create(NULL);
+	skb_font_collection_t* font_collection = skb_font_collection_create();
+	skb_font_handle_t font_handle = skb_font_collection_add_font(font_collection, "data/IBMPlexSans-Regular.ttf", SKB_FONT_FAMILY_DEFAULT, NULL);
+	ENSURE(font_handle);
+	const skb_font_t* font = skb_font_collection_get_font(font_collection, font_handle);
+
+	const uint32_t glyph_id = 36; // Glyph from the middle of latin range, not space.
+	const float font_size = 32.f;
+	const skb_glyph_effect_t shadow = { .type = SKB_GLYPH_EFFECT_SHADOW, .radius = 4.f, .spread = 1.f };
+	const skb_glyph_effect_t outline = { .type = SKB_GLYPH_EFFECT_OUTLINE, .radius = 0.f, .spread = 2.f };
+	ENSURE(skb_rasterizer_get_glyph_effect_padding(shadow) >= 5);
+
+	const skb_rect2i_t bounds = skb_rasterizer_get_glyph_dimensions(glyph_id, font, font_size, skb_rasterizer_get_glyph_effect_padding(shadow));
+	ENSURE(bounds.width > 0 && bounds.height > 0);
+
+	skb_image_t image = {
+		.buffer = skb_malloc(bounds.width * bounds.height),
+		.width = bounds.width,
+		.height = bounds.height,
+		.stride_bytes = bounds.width,
+		.bpp = 1,
+	};
+
+	ENSURE(skb_rasterizer_draw_alpha_glyph(rasterizer, temp_alloc, glyph_id, font, font_size, SKB_RASTERIZE_ALPHA_MASK, (float)-bounds.x, (float)-bounds.y, &image));
+	const int32_t glyph_coverage = sum_coverage(&image);
+	ENSURE(glyph_coverage > 0);
+
+	// Find fully covered pixel inside the glyph.
+	int32_t inside_idx = -1;
+	for (int32_t i = 0; i < bounds.width * bounds.height && inside_idx == -1; i++) {
+		if (image.buffer[i] == 255)
+			inside_idx = i;
+	}
+	ENSURE(inside_idx != -1);
+
+	// Spread grows the coverage, and blur keeps it roughly same.
+	ENSURE(skb_rasterizer_draw_glyph_effect(rasterizer, temp_alloc, glyph_id, font, font_size, shadow, (float)-bounds.x, (float)-bounds.y, &image));
+	ENSURE(sum_coverage(&image) > glyph_coverage);
+
+	// Outline should not cover the glyph.
+	ENSURE(skb_rasterizer_draw_glyph_effect(rasterizer, temp_alloc, glyph_id, font, font_size, outline, (float)-bounds.x, (float)-bounds.y, &image));
+	ENSURE(sum_coverage(&image) > 0);
+	ENSURE(image.buffer[inside_idx] == 0);
+
+	skb_free(image.buffer);
+	skb_font_collection_destroy(font_collection);
+	skb_rasterizer_destroy(rasterizer);
+	skb_temp_alloc_destroy(temp_alloc);
+
+	return 0;
+}
+
+static int test_session(void)
+{
+	skb_temp_alloc_t* temp_alloc = skb_temp_alloc_create(1024);
+	skb_rasterizer_t* rasterizer = skb_rasterizer_create(NULL);
+	skb_font_collection_t* font_collection = skb_font_collection_create();
+	skb_font_handle_t font_handle = skb_font_collection_add_font(font_collection, "data/IBMPlexSans-Regular.ttf", SKB_FONT_FAMILY_DEFAULT, NULL);
+	ENSURE(font_handle);
+	const skb_font_t* font = skb_font_collection_get_font(font_collection, font_handle);
+
+	const uint32_t glyph_id = 36;
+	const float font_sizes[] = { 16.f, 48.f, 12.f };
+	const skb_rect2i_t bounds = skb_rasterizer_get_glyph_dimensions(glyph_id, font, 48.f, 2);
+	const int32_t buffer_size = bounds.width * bounds.height;
+	uint8_t* expected = skb_malloc(buffer_size);
+	uint8_t* result = skb_malloc(buffer_size);
+
+	// Draws in a session should match the one-shot draws, also when the canvas is reused for smaller and larger glyphs.
+	skb_rasterizer_session_t* session = skb_rasterizer_begin_session(rasterizer, temp_alloc);
+	ENSURE(session != NULL);
+
+	for (int32_t i = 0; i < (int32_t)SKB_COUNTOF(font_sizes); i++) {
+		const skb_rect2i_t glyph_bounds = skb_rasterizer_get_glyph_dimensions(glyph_id, font, font_sizes[i], 2);
+		ENSURE(glyph_bounds.width * glyph_bounds.height <= buffer_size);
+		skb_image_t expected_image = { .buffer = expected, .width = glyph_bounds.width, .height = glyph_bounds.height, .stride_bytes = glyph_bounds.width, .bpp = 1 };
+		skb_image_t result_image = { .buffer = result, .width = glyph_bounds.width, .height = glyph_bounds.height, .stride_bytes = glyph_bounds.width, .bpp = 1 };
+
+		ENSURE(skb_rasterizer_draw_alpha_glyph(rasterizer, temp_alloc, glyph_id, font, font_sizes[i], SKB_RASTERIZE_ALPHA_SDF, (float)-glyph_bounds.x, (float)-glyph_bounds.y, &expected_image));
+		ENSURE(skb_rasterizer_session_draw_alpha_glyph(session, glyph_id, font, font_sizes[i], SKB_RASTERIZE_ALPHA_SDF, (float)-glyph_bounds.x, (float)-glyph_bounds.y, &result_image));
+		ENSURE(memcmp(expected, result, glyph_bounds.width * glyph_bounds.height) == 0);
+	}
+
+	skb_rasterizer_end_session(session);
+
+	skb_free(result);
+	skb_free(expected);
+	skb_font_collection_destroy(font_collection);
+	skb_rasterizer_destroy(rasterizer);
+	skb_temp_alloc_destroy(temp_alloc);
+
+	return 0;
+}
+
 int rasterizer_tests(void)
 {
 	RUN_SUBTEST(test_init);
+	RUN_SUBTEST(test_glyph_effect);
+	RUN_SUBTEST(test_session);
 	return 0;
 }
@@ -2,6 +2,9 @@
 // SPDX-License-Identifier: MIT
 
 #include "skb_rich_text.h"
+#include "skb_rich_layout.h"
+#include "skb_rich_layout_internal.h"
+#include "skb_font_collection.h"
 #include "test_macros.h"
 
 static int test_rich_text_create(void)
@@ -94,10 +97,259 @@ static int test_rich_text_append(void)
 	return 0;
 }
 
+static int test_rich_text_builder(void)
+{
+	skb_temp_alloc_t* temp_alloc = skb_temp_alloc_create(1024);
+	ENSURE(temp_alloc != NULL);
+
+	skb_rich_text_t* rich_text = skb_rich_text_create();
+	skb_rich_text_append_utf8(rich_text, temp_alloc, "abc", -1, (skb_attribute_set_t){0});
+
+	skb_rich_text_builder_t builder = skb_rich_text_builder_begin(rich_text, temp_alloc);
+	skb_rich_text_builder_append_utf8(&builder, "12", -1, (skb_attribute_set_t){0});
+	skb_rich_text_builder_append_utf8(&builder, "3\n45", -1, (skb_attribute_set_t){0});
+	skb_rich_text_builder_append_utf8(&builder, "6\n789", -1, (skb_attribute_set_t){0});
+	skb_rich_text_change_t change = skb_rich_text_builder_finish(&builder);
+
+	ENSURE(change.start_paragraph_idx == 1);
+	ENSURE(change.inserted_paragraph_count == 2);
+	ENSURE(skb_rich_text_get_utf32_count(rich_text) == 14);
+	ENSURE(skb_rich_text_get_paragraphs_count(rich_text) == 3); // abc123\n | 456\n | 789
+	ENSURE(skb_rich_text_get_paragraph_text_utf32_count(rich_text, 0) == 7);
+	ENSURE(skb_rich_text_get_paragraph_text_offset(rich_text, 1) == 7);
+	ENSURE(skb_rich_text_get_paragraph_text_offset(rich_text, 2) == 11);
+
+	skb_rich_text_destroy(rich_text);
+
+	skb_temp_alloc_destroy(temp_alloc);
+
+	return 0;
+}
+
+static int test_rich_text_diff(void)
+{
+	skb_temp_alloc_t* temp_alloc = skb_temp_alloc_create(1024);
+	ENSURE(temp_alloc != NULL);
+
+	skb_rich_text_t* rich_text = skb_rich_text_create();
+	skb_rich_text_append_utf8(rich_text, temp_alloc, "a\nb\nc\nd", -1, (skb_attribute_set_t){0});
+	ENSURE(skb_rich_text_get_paragraphs_count(rich_text) == 4);
+
+	skb_rich_text_t* new_rich_text = skb_rich_text_create();
+	skb_rich_text_append_utf8(new_rich_text, temp_alloc, "a\nXY\nc\nnew\nd", -1, (skb_attribute_set_t){0});
+	ENSURE(skb_rich_text_get_paragraphs_count(new_rich_text) == 5);
+
+	uint32_t old_versions[4];
+	for (int32_t i = 0; i < 4; i++)
+		old_versions[i] = skb_rich_text_get_paragraph_version(rich_text, i);
+
+	skb_rich_text_diff_t diffs[9];
+	const int32_t diffs_count = skb_rich_text_diff(rich_text, temp_alloc, new_rich_text, diffs, SKB_COUNTOF(diffs));
+	ENSURE(diffs_count == 5); // a | b -> XY | c | +new | d
+	ENSURE(diffs[0].type == SKB_RICH_TEXT_DIFF_EQUAL);
+	ENSURE(diffs[1].type == SKB_RICH_TEXT_DIFF_MODIFY && diffs[1].old_paragraph_idx == 1 && diffs[1].new_paragraph_idx == 1);
+	ENSURE(diffs[2].type == SKB_RICH_TEXT_DIFF_EQUAL);
+	ENSURE(diffs[3].type == SKB_RICH_TEXT_DIFF_INSERT && diffs[3].new_paragraph_idx == 3 && diffs[3].paragraph_count == 1);
+	ENSURE(diffs[4].type == SKB_RICH_TEXT_DIFF_EQUAL);
+
+	skb_rich_text_apply_patch(rich_text, new_rich_text, diffs, diffs_count, NULL, NULL);
+	ENSURE(skb_rich_text_get_paragraphs_count(rich_text) == 5);
+	ENSURE(skb_rich_text_get_utf32_count(rich_text) == skb_rich_text_get_utf32_count(new_rich_text));
+	for (int32_t i = 0; i < 5; i++) {
+		ENSURE(skb_rich_text_get_paragraph_text_utf32_count(rich_text, i) == skb_rich_text_get_paragraph_text_utf32_count(new_rich_text, i));
+		ENSURE(skb_rich_text_get_paragraph_text_offset(rich_text, i) == skb_rich_text_get_paragraph_text_offset(new_rich_text, i));
+	}
+
+	// Equal paragraphs retain their versions.
+	ENSURE(skb_rich_text_get_paragraph_version(rich_text, 0) == old_versions[0]);
+	ENSURE(skb_rich_text_get_paragraph_version(rich_text, 1) != old_versions[1]);
+	ENSURE(skb_rich_text_get_paragraph_version(rich_text, 2) == old_versions[2]);
+	ENSURE(skb_rich_text_get_paragraph_version(rich_text, 4) == old_versions[3]);
+
+	// Patched text is equal to the new text.
+	ENSURE(skb_rich_text_diff(rich_text, temp_alloc, new_rich_text, diffs, SKB_COUNTOF(diffs)) == 1);
+	ENSURE(diffs[0].type == SKB_RICH_TEXT_DIFF_EQUAL && diffs[0].paragraph_count == 5);
+
+	skb_rich_text_destroy(rich_text);
+	skb_rich_text_destroy(new_rich_text);
+
+	skb_temp_alloc_destroy(temp_alloc);
+
+	return 0;
+}
+
+static void apply_layout_change(skb_rich_text_change_t change, void* context)
+{
+	skb_rich_layout_apply_change((skb_rich_layout_t*)context, change);
+}
+
+static int test_rich_layout_reuse(void)
+{
+	skb_temp_alloc_t* temp_alloc = skb_temp_alloc_create(1024);
+	ENSURE(temp_alloc != NULL);
+
+	skb_font_collection_t* font_collection = skb_font_collection_create();
+	ENSURE(font_collection != NULL);
+	skb_font_handle_t font_handle = skb_font_collection_add_font(font_collection, "data/IBMPlexSans-Regular.ttf", SKB_FONT_FAMILY_DEFAULT, NULL);
+	ENSURE(font_handle);
+
+	skb_attribute_t attributes[] = {
+		skb_attribute_make_font_size(15.f),
+	};
+	skb_layout_params_t layout_params = {
+		.font_collection = font_collection,
+		.layout_attributes = SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(attributes),
+	};
+
+	skb_rich_text_t* rich_text = skb_rich_text_create();
+	skb_rich_text_append_utf8(rich_text, temp_alloc, "a\nbcd\ne", -1, (skb_attribute_set_t){0});
+	skb_rich_text_t* removed_rich_text = skb_rich_text_create();
+	skb_rich_text_append_utf8(removed_rich_text, temp_alloc, "a\ne", -1, (skb_attribute_set_t){0});
+	skb_rich_text_t* restored_rich_text = skb_rich_text_create();
+	skb_rich_text_append_utf8(restored_rich_text, temp_alloc, "a\nbcd\ne", -1, (skb_attribute_set_t){0});
+
+	skb_rich_layout_t* rich_layout = skb_rich_layout_create();
+	skb_rich_layout_set_from_rich_text(rich_layout, temp_alloc, &layout_params, rich_text, 0, NULL);
+	ENSURE(skb_rich_layout_get_paragraphs_count(rich_layout) == 3);
+	ENSURE(skb_rich_layout_get_detached_layouts_size(rich_layout) == 0);
+
+	skb_rich_text_diff_t diffs[8];
+
+	// Removed paragraph layout is retained.
+	int32_t diffs_count = skb_rich_text_diff(rich_text, temp_alloc, removed_rich_text, diffs, SKB_COUNTOF(diffs));
+	skb_rich_text_apply_patch(rich_text, removed_rich_text, diffs, diffs_count, apply_layout_change, rich_layout);
+	skb_rich_layout_set_from_rich_text(rich_layout, temp_alloc, &layout_params, rich_text, 0, NULL);
+	ENSURE(skb_rich_layout_get_paragraphs_count(rich_layout) == 2);
+	ENSURE(skb_rich_layout_get_detached_layouts_size(rich_layout) > 0);
+
+	// Inserting the same paragraph again adopts the retained layout.
+	diffs_count = skb_rich_text_diff(rich_text, temp_alloc, restored_rich_text, diffs, SKB_COUNTOF(diffs));
+	skb_rich_text_apply_patch(rich_text, restored_rich_text, diffs, diffs_count, apply_layout_change, rich_layout);
+	skb_rich_layout_set_from_rich_text(rich_layout, temp_alloc, &layout_params, rich_text, 0, NULL);
+	ENSURE(skb_rich_layout_get_paragraphs_count(rich_layout) == 3);
+	ENSURE(skb_rich_layout_get_detached_layouts_size(rich_layout) == 0);
+	ENSURE(skb_layout_get_text_count(skb_rich_layout_get_layout(rich_layout, 1)) == 4);
+	ENSURE(skb_rich_layout_get_layout_offset(rich_layout, 2).y > skb_rich_layout_get_layout_offset(rich_layout, 1).y);
+
+	// A retained layout with matching hash but different text is not adopted.
+	diffs_count = skb_rich_text_diff(rich_text, temp_alloc, removed_rich_text, diffs, SKB_COUNTOF(diffs));
+	skb_rich_text_apply_patch(rich_text, removed_rich_text, diffs, diffs_count, apply_layout_change, rich_layout);
+	skb_rich_layout_set_from_rich_text(rich_layout, temp_alloc, &layout_params, rich_text, 0, NULL);
+	ENSURE(rich_layout->detached_layouts_count == 1);
+	uint32_t* detached_text = (uint32_t*)skb_layout_get_text(&rich_layout->detached_layouts[0].layout);
+	detached_text[0] = 'x';
+	diffs_count = skb_rich_text_diff(rich_text, temp_alloc, restored_rich_text, diffs, SKB_COUNTOF(diffs));
+	skb_rich_text_apply_patch(rich_text, restored_rich_text, diffs, diffs_count, apply_layout_change, rich_layout);
+	skb_rich_layout_set_from_rich_text(rich_layout, temp_alloc, &layout_params, rich_text, 0, NULL);
+	ENSURE(rich_layout->detached_layouts_count == 1);
+	ENSURE(skb_layout_get_text(skb_rich_layout_get_layout(rich_layout, 1))[0] == 'b');
+
+	// Zero budget disables retaining.
+	skb_rich_layout_set_detached_layouts_budget(rich_layout, 0);
+	diffs_count = skb_rich_text_diff(rich_text, temp_alloc, removed_rich_text, diffs, SKB_COUNTOF(diffs));
+	skb_rich_text_apply_patch(rich_text, removed_rich_text, diffs, diffs_count, apply_layout_change, rich_layout);
+	skb_rich_layout_set_from_rich_text(rich_layout, temp_alloc, &layout_params, rich_text, 0, NULL);
+	ENSURE(skb_rich_layout_get_detached_layouts_size(rich_layout) == 0);
+
+	skb_rich_layout_destroy(rich_layout);
+	skb_rich_text_destroy(rich_text);
+	skb_rich_text_destroy(removed_rich_text);
+	skb_rich_text_destroy(restored_rich_text);
+	skb_font_collection_destroy(font_collection);
+	skb_temp_alloc_destroy(temp_alloc);
+
+	return 0;
+}
+
+typedef struct test__view_rects_context_t {
+	skb_rect2_t view_bounds;
+	int32_t rects_count;
+	int32_t outside_rects_count;
+} test__view_rects_context_t;
+
+static void count_view_rects(skb_rect2_t rect, void* context)
+{
+	test__view_rects_context_t* ctx = context;
+	ctx->rects_count++;
+	if (rect.y + rect.height <= ctx->view_bounds.y || rect.y >= ctx->view_bounds.y + ctx->view_bounds.height)
+		ctx->outside_rects_count++;
+}
+
+static int test_rich_layout_bounds_in_view(void)
+{
+	skb_temp_alloc_t* temp_alloc = skb_temp_alloc_create(1024);
+	ENSURE(temp_alloc != NULL);
+
+	skb_font_collection_t* font_collection = skb_font_collection_create();
+	ENSURE(font_collection != NULL);
+	skb_font_handle_t font_handle = skb_font_collection_add_font(font_collection, "data/IBMPlexSans-Regular.ttf", SKB_FONT_FAMILY_DEFAULT, NULL);
+	ENSURE(font_handle);
+
+	skb_attribute_t attributes[] = {
+		skb_attribute_make_font_size(15.f),
+	};
+	skb_layout_params_t layout_params = {
+		.font_collection = font_collection,
+		.layout_attributes = SKB_ATTRIBUTE_SET_FROM_STATIC_ARRAY(attributes),
+	};
+
+	skb_rich_text_t* rich_text = skb_rich_text_create();
+	for (int32_t i = 0; i < 100; i++)
+		skb_rich_text_append_utf8(rich_text, temp_alloc, "Line\n", -1, (skb_attribute_set_t){0});
+
+	skb_rich_layout_t* rich_layout = skb_rich_layout_create();
+	skb_rich_layout_set_from_rich_text(rich_layout, temp_alloc, &layout_params, rich_text, 0, NULL);
+	const int32_t paragraphs_count = skb_rich_layout_get_paragraphs_count(rich_layout);
+	ENSURE(paragraphs_count >= 100);
+
+	// View over paragraphs 10-12.
+	const float view_top_y = skb_rich_layout_get_layout_offset(rich_layout, 10).y;
+	const float view_bot_y = skb_rich_layout_get_layout_offset(rich_layout, 13).y;
+	test__view_rects_context_t ctx = {
+		.view_bounds = { .x = 0.f, .y = view_top_y + 1.f, .width = 1000.f, .height = view_bot_y - view_top_y - 2.f },
+	};
+
+	const skb_range_t visible_paragraphs = skb_rich_layout_get_visible_paragraphs_range(rich_layout, ctx.view_bounds);
+	ENSURE(visible_paragraphs.start >= 9 && visible_paragraphs.start <= 10);
+	ENSURE(visible_paragraphs.end >= 13 && visible_paragraphs.end <= 14);
+
+	// Select all, only the visible lines are reported.
+	const skb_text_range_t text_range = {
+		.start = { .offset = 0 },
+		.end = { .offset = skb_rich_text_get_utf32_count(rich_text) },
+	};
+	skb_text_range_bounds_clip_info_t clip_info = skb_rich_layout_get_text_range_bounds_in_view(rich_layout, text_range, ctx.view_bounds, count_view_rects, &ctx);
+	ENSURE(clip_info.visible_paragraphs_count == visible_paragraphs.end - visible_paragraphs.start);
+	ENSURE(clip_info.visible_paragraphs_count + clip_info.clipped_paragraphs_count == paragraphs_count);
+	ENSURE(clip_info.visible_lines_count >= 3 && clip_info.visible_lines_count <= 5);
+	ENSURE(ctx.rects_count == clip_info.visible_lines_count);
+	ENSURE(ctx.outside_rects_count <= 2);
+
+	// View outside of the text.
+	ctx.view_bounds.y = -1000.f;
+	ctx.view_bounds.height = 10.f;
+	ctx.rects_count = 0;
+	clip_info = skb_rich_layout_get_text_range_bounds_in_view(rich_layout, text_range, ctx.view_bounds, count_view_rects, &ctx);
+	ENSURE(clip_info.visible_paragraphs_count == 0);
+	ENSURE(clip_info.clipped_paragraphs_count == paragraphs_count);
+	ENSURE(ctx.rects_count == 0);
+
+	skb_rich_layout_destroy(rich_layout);
+	skb_rich_text_destroy(rich_text);
+	skb_font_collection_destroy(font_collection);
+	skb_temp_alloc_destroy(temp_alloc);
+
+	return 0;
+}
+
 int rich_text_tests(void)
 {
 	RUN_SUBTEST(test_rich_text_create);
 	RUN_SUBTEST(test_rich_text_replace);
 	RUN_SUBTEST(test_rich_text_append);
+	RUN_SUBTEST(test_rich_text_builder);
+	RUN_SUBTEST(test_rich_text_diff);
+	RUN_SUBTEST(test_rich_layout_reuse);
+	RUN_SUBTEST(test_rich_layout_bounds_in_view);
 	return 0;
 }
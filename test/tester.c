@@ -13,6 +13,7 @@ int editor_tests(void);
 int layout_tests(void);
 int layout_cache_tests(void);
 int rasterizer_tests(void);
+int mesh_cache_tests(void);
 int image_atlas_tests(void);
 int cpp_tests(void);
 int attributed_text_tests(void);
@@ -33,6 +34,7 @@ int main( void )
 	RUN_TEST(layout_tests);
 	RUN_TEST(layout_cache_tests);
 	RUN_TEST(rasterizer_tests);
+	RUN_TEST(mesh_cache_tests);
 	RUN_TEST(image_atlas_tests);
 	RUN_TEST(cpp_tests);
 	RUN_TEST(attributed_text_tests);